@@ -0,0 +1,155 @@
+#include "BufferLease.h"
+#include "Logger.h"
+#include <cstdio>
+#include <ctime>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+int64_t monotonic_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+int current_tid() {
+    static thread_local int tid = static_cast<int>(syscall(SYS_gettid));
+    return tid;
+}
+
+// 缓冲区耗尽时的诊断输出最多每5秒一次，避免持续高负载下刷屏
+constexpr int64_t kExhaustedDumpIntervalUs = 5000000;
+
+} // namespace
+
+BufferLeaseTracker& BufferLeaseTracker::instance() {
+    static BufferLeaseTracker tracker;
+    return tracker;
+}
+
+void BufferLeaseTracker::register_source(int camera_id, const std::string& name, size_t buffer_count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Source& source = sources_[camera_id];
+    source.name = name;
+    source.leases.assign(buffer_count, Lease());
+    source.outstanding = 0;
+    source.last_exhausted_dump_us = 0;
+}
+
+void BufferLeaseTracker::acquire(int camera_id, int buf_index, uint32_t sequence) {
+    bool exhausted = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = sources_.find(camera_id);
+        if (it == sources_.end()) return;
+        Source& source = it->second;
+        if (buf_index < 0 || static_cast<size_t>(buf_index) >= source.leases.size()) return;
+
+        Lease& lease = source.leases[buf_index];
+        if (lease.held) {
+            LOG_ERROR("BufferLease", "[%s] buffer %d dequeued while still held by %s (seq %u)",
+                      source.name.c_str(), buf_index, lease.holder, lease.sequence);
+        } else {
+            ++source.outstanding;
+        }
+        lease.held = true;
+        lease.sequence = sequence;
+        lease.since_us = monotonic_us();
+        lease.holder = "dequeued";
+        lease.tid = current_tid();
+
+        if (source.outstanding == source.leases.size() &&
+            lease.since_us - source.last_exhausted_dump_us >= kExhaustedDumpIntervalUs) {
+            source.last_exhausted_dump_us = lease.since_us;
+            exhausted = true;
+        }
+    }
+    if (exhausted) {
+        dump(camera_id, "all buffers outstanding, driver has nothing to fill");
+    }
+}
+
+void BufferLeaseTracker::transfer(int camera_id, int buf_index, const char* holder) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sources_.find(camera_id);
+    if (it == sources_.end()) return;
+    Source& source = it->second;
+    if (buf_index < 0 || static_cast<size_t>(buf_index) >= source.leases.size()) return;
+
+    Lease& lease = source.leases[buf_index];
+    if (!lease.held) {
+        LOG_ERROR("BufferLease", "[%s] buffer %d used by %s after it was returned",
+                  source.name.c_str(), buf_index, holder);
+        return;
+    }
+    lease.holder = holder;
+    lease.tid = current_tid();
+}
+
+void BufferLeaseTracker::release(int camera_id, int buf_index) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sources_.find(camera_id);
+    if (it == sources_.end()) return;
+    Source& source = it->second;
+    if (buf_index < 0 || static_cast<size_t>(buf_index) >= source.leases.size()) return;
+
+    Lease& lease = source.leases[buf_index];
+    if (!lease.held) {
+        LOG_ERROR("BufferLease", "[%s] buffer %d returned twice (last seq %u)",
+                  source.name.c_str(), buf_index, lease.sequence);
+        return;
+    }
+    lease.held = false;
+    --source.outstanding;
+}
+
+size_t BufferLeaseTracker::outstanding(int camera_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sources_.find(camera_id);
+    return it == sources_.end() ? 0 : it->second.outstanding;
+}
+
+std::string BufferLeaseTracker::report(int camera_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = sources_.find(camera_id);
+    if (it == sources_.end()) return std::string();
+    return report_locked(camera_id, it->second);
+}
+
+std::string BufferLeaseTracker::report_locked(int camera_id, const Source& source) const {
+    std::ostringstream out;
+    int64_t now = monotonic_us();
+    out << "camera " << camera_id << " (" << source.name << "): "
+        << source.outstanding << "/" << source.leases.size() << " buffers outstanding";
+    for (size_t i = 0; i < source.leases.size(); ++i) {
+        const Lease& lease = source.leases[i];
+        char line[160];
+        if (lease.held) {
+            snprintf(line, sizeof(line), "\n  buf %zu: seq %u, held %.1f ms by %s (tid %d)",
+                     i, lease.sequence, (now - lease.since_us) / 1000.0, lease.holder, lease.tid);
+        } else {
+            snprintf(line, sizeof(line), "\n  buf %zu: queued to driver (last seq %u)", i, lease.sequence);
+        }
+        out << line;
+    }
+    return out.str();
+}
+
+void BufferLeaseTracker::dump(int camera_id, const char* reason) const {
+    std::string text = report(camera_id);
+    if (text.empty()) return;
+    // 日志单行长度有限，逐行输出
+    std::istringstream lines(text);
+    std::string line;
+    bool first = true;
+    while (std::getline(lines, line)) {
+        if (first) {
+            LOG_ERROR("BufferLease", "%s: %s", reason, line.c_str());
+            first = false;
+        } else {
+            LOG_ERROR("BufferLease", "%s", line.c_str());
+        }
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+/**
+ * @file BufferLease.h
+ * @class BufferLeaseTracker
+ * @brief 采集缓冲区租借追踪（调试用的泄漏检测）
+ *
+ * 帧源交付的每个CameraFrame都“借出”了一个V4L2缓冲区，直到return_buffer()才归还。
+ * 只要某条路径漏掉一次归还（如encoding_loop中提前continue），缓冲区会逐个耗尽，
+ * 最终采集彻底停住，日志里只剩“Capture timeout”。
+ *
+ * 本追踪器按摄像头记录每个缓冲区当前由谁持有、从何时开始、对应哪一帧（sequence），
+ * 在以下时机输出诊断：
+ * - 借出数量达到缓冲区总数（驱动已无缓冲可填，再不归还必然丢帧/停流）
+ * - 采集超时（由CameraCapture调用dump）
+ * - 重复归还、归还未借出的缓冲区
+ *
+ * 打点通过BUFFER_LEASE_*宏完成，只有定义BUFFER_LEASE_DEBUG（CMake选项同名）时才生效，
+ * 发布构建中不产生任何开销。
+ */
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class BufferLeaseTracker {
+public:
+    /**
+     * @brief 获取全局追踪器实例
+     */
+    static BufferLeaseTracker& instance();
+
+    /**
+     * @brief 登记帧源（REQBUFS之后调用，重复调用会清空该摄像头的租借记录）
+     * @param camera_id 摄像头ID
+     * @param name 设备名，用于诊断输出
+     * @param buffer_count 缓冲区数量
+     */
+    void register_source(int camera_id, const std::string& name, size_t buffer_count);
+
+    /**
+     * @brief 缓冲区被借出（DQBUF成功）
+     */
+    void acquire(int camera_id, int buf_index, uint32_t sequence);
+
+    /**
+     * @brief 更新缓冲区持有者（帧在流水线中换手时调用）
+     * @param holder 持有者描述，必须是字符串字面量等静态存储的字符串
+     */
+    void transfer(int camera_id, int buf_index, const char* holder);
+
+    /**
+     * @brief 缓冲区被归还（QBUF之前调用）
+     */
+    void release(int camera_id, int buf_index);
+
+    /**
+     * @brief 当前借出的缓冲区数量
+     */
+    size_t outstanding(int camera_id) const;
+
+    /**
+     * @brief 生成某个摄像头的租借状态报告
+     */
+    std::string report(int camera_id) const;
+
+    /**
+     * @brief 把租借状态报告写入日志
+     * @param reason 触发原因
+     */
+    void dump(int camera_id, const char* reason) const;
+
+private:
+    BufferLeaseTracker() = default;
+
+    struct Lease {
+        bool held = false;
+        uint32_t sequence = 0;
+        int64_t since_us = 0;
+        const char* holder = "";
+        int tid = 0;             // 最后一次换手所在的线程
+    };
+
+    struct Source {
+        std::string name;
+        std::vector<Lease> leases;
+        size_t outstanding = 0;
+        int64_t last_exhausted_dump_us = 0;
+    };
+
+    std::string report_locked(int camera_id, const Source& source) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::map<int, Source> sources_;
+};
+
+#ifdef BUFFER_LEASE_DEBUG
+#define BUFFER_LEASE_REGISTER(camera_id, name, count) \
+    BufferLeaseTracker::instance().register_source((camera_id), (name), (count))
+#define BUFFER_LEASE_ACQUIRE(camera_id, index, sequence) \
+    BufferLeaseTracker::instance().acquire((camera_id), (index), (sequence))
+#define BUFFER_LEASE_TRANSFER(frame, holder) \
+    BufferLeaseTracker::instance().transfer((frame).camera_id, (frame).buf_index, (holder))
+#define BUFFER_LEASE_RELEASE(camera_id, index) \
+    BufferLeaseTracker::instance().release((camera_id), (index))
+#define BUFFER_LEASE_DUMP(camera_id, reason) \
+    BufferLeaseTracker::instance().dump((camera_id), (reason))
+#else
+#define BUFFER_LEASE_REGISTER(camera_id, name, count) do {} while (0)
+#define BUFFER_LEASE_ACQUIRE(camera_id, index, sequence) do {} while (0)
+#define BUFFER_LEASE_TRANSFER(frame, holder) do {} while (0)
+#define BUFFER_LEASE_RELEASE(camera_id, index) do {} while (0)
+#define BUFFER_LEASE_DUMP(camera_id, reason) do {} while (0)
+#endif
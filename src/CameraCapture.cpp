@@ -1,4 +1,8 @@
 #include "CameraCapture.h"
+#include "Logger.h"
+#include "FrameTrace.h"
+#include "BufferLease.h"
+#include "FaultInjector.h"
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
@@ -6,7 +10,6 @@
 #include <sys/time.h>
 #include <cstring>
 #include <cerrno>
-#include <iostream>
 #include <system_error>
 
 #define MODULE_TEST 0
@@ -128,6 +131,8 @@ void CameraCapture::start() {
         return;
     }
     
+    register_metrics();
+    BUFFER_LEASE_REGISTER(camera_id_, device_path_, buffers_.size());
     running_ = true;
     capture_thread_ = std::make_unique<std::thread>(&CameraCapture::capture_thread, this);
 }
@@ -144,6 +149,20 @@ void CameraCapture::stop() {
     stop_streaming();
 }
 
+void CameraCapture::register_metrics() {
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    MetricLabels labels = {{"camera", std::to_string(camera_id_)}, {"device", device_path_}};
+    frames_captured_ = &registry.counter("camera_frames_captured_total",
+                                         "Frames dequeued from the V4L2 device", labels);
+    frames_dropped_ = &registry.counter("camera_frames_dropped_total",
+                                        "Frames lost by the driver, derived from sequence numbers", labels);
+    sequence_gaps_ = &registry.counter("camera_sequence_gaps_total",
+                                       "Number of discontinuities in the V4L2 sequence", labels);
+    capture_timeouts_ = &registry.counter("camera_capture_timeouts_total",
+                                          "select() timeouts while waiting for a frame", labels);
+    last_sequence_ = -1;
+}
+
 void CameraCapture::set_frame_callback(const FrameCallback &callback) {
     frame_callback_ = callback;
 }
@@ -156,6 +175,7 @@ void CameraCapture::capture_thread() {
     while (running_) {
         CameraFrame frame;
         if (get_frame(frame)) {
+            BUFFER_LEASE_TRANSFER(frame, "frame_callback");
             if (frame_callback_) {
                 frame_callback_(frame);
             }
@@ -288,6 +308,9 @@ bool CameraCapture::get_frame(CameraFrame& frame) {
     tv.tv_usec = 0;
     
     int r = select(fd_ + 1, &fds, nullptr, nullptr, &tv);
+    if (r > 0 && FAULT_POINT(CaptureTimeout, device_path_)) {
+        r = 0;
+    }
     if (r == -1) {
         if (errno == EINTR) return false;  // 中断，重试
         report_error("select failed");
@@ -295,7 +318,9 @@ bool CameraCapture::get_frame(CameraFrame& frame) {
     }
     
     if (r == 0) {
+        capture_timeouts_->inc();
         report_error("Capture timeout");
+        BUFFER_LEASE_DUMP(camera_id_, "Capture timeout");
         return false;
     }
     
@@ -304,6 +329,11 @@ bool CameraCapture::get_frame(CameraFrame& frame) {
     buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     buf.memory = V4L2_MEMORY_MMAP;
     
+    if (FAULT_POINT(CaptureDqbuf, device_path_)) {
+        errno = EIO;
+        report_error("VIDIOC_DQBUF failed");
+        return false;
+    }
     if (IOCTL_RETRY(fd_, VIDIOC_DQBUF, &buf) == -1) {
         if (errno == EAGAIN) return false;  // 非阻塞模式，无数据
         report_error("VIDIOC_DQBUF failed");
@@ -314,15 +344,43 @@ bool CameraCapture::get_frame(CameraFrame& frame) {
         report_error("Invalid buffer index");
         return false;
     }
+
+    BUFFER_LEASE_ACQUIRE(camera_id_, static_cast<int>(buf.index), buf.sequence);
+    frames_captured_->inc();
+    if (last_sequence_ >= 0 && buf.sequence > static_cast<uint32_t>(last_sequence_) + 1) {
+        sequence_gaps_->inc();
+        frames_dropped_->inc(buf.sequence - static_cast<uint32_t>(last_sequence_) - 1);
+    }
+    last_sequence_ = buf.sequence;
+
+    // 驱动标记为损坏的帧（如USB传输出错）直接归还，不交给下游
+    if (buf.flags & V4L2_BUF_FLAG_ERROR) {
+        frames_dropped_->inc();
+        report_error("Corrupted frame dropped (V4L2_BUF_FLAG_ERROR)");
+        return_buffer_to_queue(buf.index);
+        return false;
+    }
+
+    if (FAULT_POINT(CaptureBytesUsed, device_path_)) {
+        buf.bytesused = FAULT_PARAM(CaptureBytesUsed, 1) ? buf.bytesused / 2 : 0;
+    }
+    // 非压缩格式的帧必须是完整的一帧，残帧（bytesused不足或越界）送下游会读越界或花屏
+    size_t frame_bytes = static_cast<size_t>(stride_) * height_;
+    if (buf.bytesused > buffers_[buf.index].length ||
+        (pixel_format_ == V4L2_PIX_FMT_YUYV && buf.bytesused < frame_bytes)) {
+        frames_dropped_->inc();
+        report_error("Incomplete frame dropped (bytesused " + std::to_string(buf.bytesused) + ")");
+        return_buffer_to_queue(buf.index);
+        return false;
+    }
     
-    // 填充帧数据
-    std::cout << "Captured frame - buf.index: " << buf.index
-              << ", data: " << buffers_[buf.index].start
-              << ", length: " << buffers_[buf.index].length
-              << ", width: " << width_
-              << ", height: " << height_
-              << ", stride: " << stride_
-              << ", fd: " << buffers_[buf.index].dma_fd << std::endl;
+    // 填充帧数据（逐帧日志限速为每秒一条）
+    LOG_DEBUG_EVERY_MS_FOR("CameraCapture", device_path_, 1000,
+              "[%s] captured frame - buf.index: %u, data: %p, length: %zu, "
+              "width: %u, height: %u, stride: %u, fd: %d, sequence: %u",
+              device_path_.c_str(), buf.index, buffers_[buf.index].start,
+              buffers_[buf.index].length, width_, height_, stride_,
+              buffers_[buf.index].dma_fd, buf.sequence);
     frame.camera_id = camera_id_;
     frame.buf_index = buf.index;
     frame.fd = buffers_[buf.index].dma_fd;
@@ -335,6 +393,9 @@ bool CameraCapture::get_frame(CameraFrame& frame) {
     frame.pixel_format = pixel_format_;
     frame.timestamp = buf.timestamp;
     frame.sequence = buf.sequence;
+    FrameTracer& tracer = FrameTracer::instance();
+    frame.trace_id = tracer.enabled() ? tracer.next_trace_id() : 0;
+    tracer.record(frame.trace_id, TraceStage::Dqbuf, camera_id_);
     frame.return_buffer = [this, index = buf.index]() {
         this->return_buffer_to_queue(index);
     };
@@ -347,6 +408,7 @@ bool CameraCapture::return_buffer_to_queue(int index) {
         return false;
     }
     
+    BUFFER_LEASE_RELEASE(camera_id_, index);
     v4l2_buffer buf;
     CLEAR(buf);
     buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -376,11 +438,32 @@ int CameraCapture::export_dma_buf(int index) {
 }
 
 void CameraCapture::report_error(const std::string& message) {
-    std::cerr << "CameraCapture[" << device_path_ << "]: " << message;
-    if (errno) {
-        std::cerr << " (errno: " << errno << " - " << strerror(errno) << ")";
+    int err = errno;
+    // 连续重复的同一错误（如持续超时）每秒最多输出一条，避免刷屏拖慢采集；
+    // 不同的错误总是立即输出
+    uint32_t suppressed = 0;
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    if (message != last_error_) {
+        // 换成新错误前，补上一条上个错误被抑制的条数
+        uint32_t previous = 0;
+        error_limiter_.allow(0, previous);
+        if (previous) {
+            Logger::instance().log(LogLevel::Error, "CameraCapture", previous,
+                                   "[%s] %s", device_path_.c_str(), last_error_.c_str());
+        }
+        last_error_ = message;
+    } else if (!error_limiter_.allow(1000, suppressed)) {
+        return;
+    }
+
+    if (err) {
+        Logger::instance().log(LogLevel::Error, "CameraCapture", suppressed,
+                               "[%s] %s (errno: %d - %s)",
+                               device_path_.c_str(), message.c_str(), err, strerror(err));
+    } else {
+        Logger::instance().log(LogLevel::Error, "CameraCapture", suppressed,
+                               "[%s] %s", device_path_.c_str(), message.c_str());
     }
-    std::cerr << std::endl;
 }
 
 
@@ -28,32 +28,19 @@
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <linux/videodev2.h>
 #include <thread>
+#include "FrameSource.h"
+#include "Logger.h"
+#include "Metrics.h"
 
-// 摄像头帧数据结构
-struct CameraFrame {
-    int camera_id;          // 摄像头标识
-    int buf_index;          // buf 索引
-    int fd;                 // DMA-BUF文件描述符
-    void* data;             // 内存映射地址指针
-    size_t length;          // 数据长度
-    size_t bytes_used;      // 实际使用字节数
-    uint32_t width;         // 图像宽度
-    uint32_t height;        // 图像高度
-    uint32_t stride;        // 步长
-    uint32_t pixel_format;  // 像素格式 (V4L2_PIX_FMT_*)
-    timeval timestamp;      // 时间戳
-    uint32_t sequence;      // 帧序列号
-    std::function<void()> return_buffer; //释放缓冲回调
-};
-
-class CameraCapture {
+class CameraCapture : public FrameSource {
 public:
     // 回调函数类型定义
-    using FrameCallback = std::function<void(const CameraFrame&)>;
+    using FrameCallback = FrameSource::FrameCallback;
     
     /**
      * @brief 构造函数，初始化采集参数
@@ -73,52 +60,57 @@ public:
      * @brief 析构函数，释放所有资源
      * 自动调用stop()停止采集，释放缓冲区，关闭设备文件描述符
      */
-    ~CameraCapture();
+    ~CameraCapture() override;
     
     /**
      * @brief 初始化摄像头设备
      * 流程：打开设备 -> 检查设备能力 -> 设置像素格式、分辨率、帧率 -> 申请缓冲区 -> 映射缓冲区
      * @return 成功返回true，失败返回false
      */
-    bool initialize();
+    bool initialize() override;
     
     /**
      * @brief 开始采集
      * 启动采集线程，线程中循环获取帧数据并通过回调函数推送
      * 注意：需先调用initialize()并返回成功后才能调用此函数
      */
-    void start();
+    void start() override;
     
     /**
      * @brief 停止采集
      * 停止采集线程，暂停帧数据获取
      */
-    void stop();
+    void stop() override;
     
     /**
      * @brief 设置帧数据回调函数（左值引用版本和右值引用版本，支持移动语义）
      * @param callback 回调函数对象，当有新帧到达时会被调用
      */
-    void set_frame_callback(const FrameCallback &callback); 
-    void set_frame_callback(FrameCallback &&callback);
+    void set_frame_callback(const FrameCallback &callback) override; 
+    void set_frame_callback(FrameCallback &&callback) override;
     
     /**
      * @brief 获取当前采集状态
      * @return 正在采集返回true，否则返回false
      */
-    bool is_running() const { return running_; }
+    bool is_running() const override { return running_; }
     
     /**
      * @brief 设置摄像头ID（多摄像头场景下使用）
      * @param id 摄像头标识ID
      */
-    void set_camera_id(int id) { camera_id_ = id; }
+    void set_camera_id(int id) override { camera_id_ = id; }
 
     /**
      * @brief 获取当前摄像头ID
      * @return 摄像头标识ID
      */
-    int get_camera_id() const { return camera_id_; }
+    int get_camera_id() const override { return camera_id_; }
+
+    /**
+     * @brief 按序列号推算的驱动丢帧数
+     */
+    uint64_t dropped_frames() const override { return frames_dropped_ ? frames_dropped_->value() : 0; }
 
 private:
     /**
@@ -214,9 +206,26 @@ private:
     // 回调函数
     FrameCallback frame_callback_;
     
+    // 运行指标（start()时按camera_id注册，之后只在采集线程中更新）
+    Counter* frames_captured_ = nullptr;   // 成功取出的帧数
+    Counter* frames_dropped_ = nullptr;    // 按序列号推算的驱动丢帧数
+    Counter* sequence_gaps_ = nullptr;     // 序列号不连续的次数
+    Counter* capture_timeouts_ = nullptr;  // select超时次数
+    int64_t last_sequence_ = -1;
+    
+    /**
+     * @brief 注册本摄像头的运行指标
+     */
+    void register_metrics();
+    
+    // 错误日志限速状态（仅用于连续重复的同一错误）；采集线程和归还缓冲区的编码线程都会报错，由error_mutex_保护
+    std::mutex error_mutex_;
+    std::string last_error_;
+    LogRateLimiter error_limiter_;
+    
     /**
      * @brief 错误处理函数
-     * 打印错误信息（可扩展为日志输出）
+     * 通过异步日志输出错误信息，连续重复的同一错误会被限速
      * @param message 错误描述信息
      */
     void report_error(const std::string& message);
@@ -1,5 +1,12 @@
 #include "EncoderStreamer.h"
-#include <iostream>
+#include "Logger.h"
+#include "FrameTrace.h"
+#include "BufferLease.h"
+#include "FaultInjector.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ctime>
 #include <stdexcept>
 
 EncoderStreamer::EncoderStreamer(const std::string& rtmp_url, 
@@ -10,8 +17,114 @@ EncoderStreamer::EncoderStreamer(const std::string& rtmp_url,
     : rtmp_url_(rtmp_url),
       width_(width),
       height_(height),
-      fps_(fps),
-      bitrate_(bitrate) {}
+      fps_(fps) {
+    settings_.bitrate = bitrate;
+    settings_.gop = fps;
+    register_metrics();
+}
+
+namespace {
+
+int64_t monotonic_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t realtime_us() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t timeval_us(const timeval& tv) {
+    return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+} // namespace
+
+void EncoderStreamer::register_metrics() {
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    MetricLabels labels = {{"stream", rtmp_url_}};
+    auto stage = [&](const char* name) {
+        MetricLabels stage_labels = labels;
+        stage_labels.emplace_back("stage", name);
+        return &registry.histogram("pipeline_stage_seconds",
+                                   "Per-stage frame latency in seconds", stage_labels);
+    };
+    metrics_.queue_depth = &registry.gauge("encoder_queue_depth", "Frames waiting in the encoder input queue", labels);
+    metrics_.frames_encoded = &registry.counter("encoder_frames_total", "Frames submitted to the encoder", labels);
+    metrics_.frames_dropped = &registry.counter("encoder_frames_dropped_total", "Frames discarded before encoding", labels);
+    metrics_.queue_latency = stage("queue");
+    metrics_.convert_latency = stage("convert");
+    metrics_.process_latency = stage("process");
+    metrics_.encode_latency = stage("encode");
+    metrics_.capture_to_packet = stage("capture_to_packet");
+    metrics_.encoder_fps = &registry.gauge("encoder_fps", "Encoded frames per second over the last second", labels);
+    metrics_.output_bitrate = &registry.gauge("output_bitrate_bps", "Output bitrate over the last second", labels);
+    metrics_.keyframes_forced = &registry.counter("encoder_keyframes_forced_total", "IDR frames forced on request", labels);
+    metrics_.scene_cuts = &registry.counter("encoder_scene_cuts_total", "IDR frames forced by scene-change detection", labels);
+    metrics_.frames_static = &registry.counter("encoder_frames_static_total", "Unchanged frames that skipped conversion and processing", labels);
+    MetricLabels dirty_labels = labels;
+    dirty_labels.emplace_back("state", "dirty");
+    MetricLabels reused_labels = labels;
+    reused_labels.emplace_back("state", "reused");
+    metrics_.tiles_dirty = &registry.counter("processor_tiles_total", "Tiles reprocessed or reused in tiled processing", dirty_labels);
+    metrics_.tiles_reused = &registry.counter("processor_tiles_total", "Tiles reprocessed or reused in tiled processing", reused_labels);
+    metrics_.sei_bytes = &registry.counter("encoder_sei_bytes_total", "Bytes of frame metadata SEI inserted into the stream", labels);
+    metrics_.roi_regions = &registry.gauge("encoder_roi_regions", "Regions of interest attached to the last encoded frame", labels);
+    metrics_.busy_ratio = &registry.gauge("encoder_busy_ratio", "Fraction of time the encoding thread spent on frames", labels);
+    metrics_.resolution_rung = &registry.gauge("encoder_resolution_rung", "Current resolution/frame-rate rung (0 = capture size)", labels);
+    metrics_.resolution_switches = &registry.counter("encoder_resolution_switches_total", "Encoder resolution or frame-rate changes", labels);
+    metrics_.frames_decimated = &registry.counter("encoder_frames_decimated_total", "Frames skipped by a reduced frame-rate rung", labels);
+    auto reconfigure = [&](const char* method) {
+        MetricLabels method_labels = labels;
+        method_labels.emplace_back("method", method);
+        return &registry.histogram("encoder_reconfigure_seconds",
+                                   "Time to apply an encoder parameter change", method_labels);
+    };
+    metrics_.reconfigure_in_place = reconfigure("in_place");
+    metrics_.reconfigure_swap = reconfigure("swap");
+}
+
+void EncoderStreamer::update_rate_metrics() {
+    int64_t now = monotonic_us();
+    if (rate_window_start_us_ == 0) {
+        rate_window_start_us_ = now;
+        return;
+    }
+    int64_t elapsed = now - rate_window_start_us_;
+    if (elapsed < 1000000) return;
+    
+    double seconds = elapsed / 1e6;
+    double busy_ratio = busy_us_ / static_cast<double>(elapsed);
+    metrics_.encoder_fps->set(rate_window_frames_ / seconds);
+    metrics_.output_bitrate->set(rate_window_bytes_ * 8 / seconds);
+    metrics_.busy_ratio->set(busy_ratio);
+    rate_window_start_us_ = now;
+    rate_window_frames_ = 0;
+    rate_window_bytes_ = 0;
+    busy_us_ = 0;
+
+    if (resolution_controller_ && !switch_pending_) {
+        ResolutionController::Sample sample;
+        sample.now_us = now;
+        sample.busy_ratio = busy_ratio;
+        sample.queue_depth = input_queue_.size();
+        uint64_t congestion = outputs_.empty() ? 0 : outputs_[0]->congestion_events();
+        sample.network_congested = congestion != congestion_seen_;
+        congestion_seen_ = congestion;
+        size_t target = resolution_controller_->update(sample);
+        if (target != resolution_controller_->rung()) {
+            pending_rung_ = target;
+            switch_pending_ = true;
+            switch_wait_frames_ = 0;
+            if (swap_requested_us_ == 0) {
+                swap_requested_us_ = now;
+            }
+        }
+    }
+}
 
 EncoderStreamer::~EncoderStreamer() {
     stop();
@@ -26,6 +139,9 @@ bool EncoderStreamer::initialize() {
 void EncoderStreamer::start() {
     if (running_) return;
     
+    for (auto& output : outputs_) {
+        output->start();
+    }
     running_ = true;
     encoding_thread_ = std::thread(&EncoderStreamer::encoding_loop, this);
 }
@@ -35,197 +151,412 @@ void EncoderStreamer::stop() {
     if (encoding_thread_.joinable()) {
         encoding_thread_.join();
     }
+    // 编码器已刷新，发送完各目的地队列中剩余的包
+    for (auto& output : outputs_) {
+        output->stop();
+    }
 }
 
 void EncoderStreamer::push_frame(const CameraFrame& frame) {
+    FrameTracer::instance().record(frame.trace_id, TraceStage::QueuePush, frame.camera_id);
+    BUFFER_LEASE_TRANSFER(frame, "encoder_queue");
     input_queue_.push(frame);
+    metrics_.queue_depth->set(static_cast<double>(input_queue_.size()));
+}
+
+void EncoderStreamer::remember_frame(int64_t pts, const CameraFrame& frame) {
+    FrameInfo& info = frame_info_[static_cast<uint64_t>(pts) % kFrameInfoSlots];
+    info.pts = pts;
+    info.trace_id = frame.trace_id;
+    info.camera_id = frame.camera_id;
+    info.sequence = frame.sequence;
+    info.skipped = frames_skipped_;
+    frames_skipped_ = 0;
+    info.capture_us = timeval_us(frame.timestamp);
+    info.send_us = monotonic_us();
+    info.regions = regions_;
+    if (frame_sei_) {
+        // 采集时间戳是CLOCK_MONOTONIC，按当前两个时钟的差换算为系统时间
+        info.capture_wall_us = info.capture_us > 0 ? realtime_us() - (info.send_us - info.capture_us) : 0;
+        info.metadata = frame_metadata_;
+    }
+}
+
+const EncoderStreamer::FrameInfo* EncoderStreamer::find_frame_info(int64_t pts) const {
+    if (pts < 0) return nullptr;
+    const FrameInfo& info = frame_info_[static_cast<uint64_t>(pts) % kFrameInfoSlots];
+    return info.pts == pts ? &info : nullptr;
 }
 
 void EncoderStreamer::encoding_loop() {
     while (running_) {
         CameraFrame frame;
         if (input_queue_.pop(frame, 50)) { // 50ms超时  
+            FrameTracer& tracer = FrameTracer::instance();
+            tracer.record(frame.trace_id, TraceStage::QueuePop, frame.camera_id);
+            BUFFER_LEASE_TRANSFER(frame, "encoding_loop");
+            int64_t pop_us = monotonic_us();
+            int64_t capture_us = timeval_us(frame.timestamp);
+            metrics_.queue_depth->set(static_cast<double>(input_queue_.size()));
+            if (capture_us > 0 && pop_us >= capture_us) {
+                metrics_.queue_latency->observe((pop_us - capture_us) / 1e6);
+            }
+            if (motion_detector_) {
+                motion_detector_->process(static_cast<const uint8_t*>(frame.data), frame.stride, width_, height_,
+                                          frame.camera_id, capture_us > 0 ? capture_us : pop_us);
+            }
 
-            if (!rgb_frame_) {
-                rgb_frame_ = av_frame_alloc();
-                rgb_frame_->format = AV_PIX_FMT_YUV420P;
-                rgb_frame_->width = width_;
-                rgb_frame_->height = height_;
-                if (av_frame_get_buffer(rgb_frame_, 32) < 0) {
-                    std::cerr << "Could not allocate the video frame data" << std::endl;
-                    if (frame.return_buffer) {
-                        frame.return_buffer();
-                    }
-                    continue;
-                }
+            if (reconfig_pending_) {
+                apply_reconfig();
             }
-            
-            uint8_t* src_data[1] = {static_cast<uint8_t*>(frame.data)};
-            int src_linesize[1] = {static_cast<int>(frame.stride)};
-            sws_scale(rgb_ctx_, 
-                     src_data, src_linesize, 
-                     0, height_,
-                     rgb_frame_->data, rgb_frame_->linesize);
-
-            cv::Mat rgb_mat(
-                height_, width_, CV_8UC3,  // 高度、宽度、3通道8位（BGR）
-                rgb_frame_->data[0],       // 数据指针（指向RGB数据）
-                rgb_frame_->linesize[0]    // linesize（每行字节数）
-            );
-
-            processor_->processFrame(rgb_mat);
-
-            int mat_width = rgb_mat.cols;
-            int mat_height = rgb_mat.rows;
-            AVPixelFormat src_pix_fmt;
-            if (rgb_mat.type() == CV_8UC3) {
-                src_pix_fmt = AV_PIX_FMT_BGR24;  // OpenCV默认BGR
-            } else if (rgb_mat.type() == CV_8UC1) {
-                src_pix_fmt = AV_PIX_FMT_GRAY8;  // 灰度图
-            } else {// 跳过不支持的格式，注意归还v4l2缓冲
-                std::cerr << "Unsupported Mat format (type=" << rgb_mat.type() << ")" << std::endl;
-                if (frame.return_buffer) {
-                    frame.return_buffer();
+            if (external_keyframe_request_.exchange(false)) {
+                keyframe_requested_ = true;
+            }
+            if (switch_pending_ || swap_pending_) {
+                // 在GOP边界换编码器，不额外插入IDR；GOP较长时最多等待1秒
+                bool at_keyframe = frames_since_keyframe_ == 0 || keyframe_requested_;
+                if (at_keyframe || ++switch_wait_frames_ >= fps_) {
+                    if (switch_pending_) {
+                        switch_resolution(pending_rung_);
+                    } else {
+                        swap_encoder(encode_width_, encode_height_, frame_step_);
+                    }
                 }
-                continue;  
             }
-            sws_ctx_ = sws_getCachedContext(sws_ctx_, 
-                             mat_width, mat_height, src_pix_fmt,
-                             width_, height_, AV_PIX_FMT_YUV420P,
-                             SWS_BILINEAR, 0, 0, 0);
-            if (!sws_ctx_) {//注意归还v4l2缓冲
-                std::cerr << "Could not initialize the conversion context" << std::endl;
+            if (frame_step_ > 1 && pts_ % frame_step_ != 0) {
+                // 降帧率档位：跳过该帧，时间戳照常前进
+                ++pts_;
+                ++frames_skipped_;
+                metrics_.frames_decimated->inc();
                 if (frame.return_buffer) {
                     frame.return_buffer();
                 }
                 continue;
             }
 
-            // 使用SWS转换cv::Mat到YUV420P
-            uint8_t* mat_data[1] = {static_cast<uint8_t*>(rgb_mat.data)};
-            int mat_linesize[1] = {static_cast<int>(rgb_mat.step[0])};
-
-            if (!sws_frame_) {
-                sws_frame_ = av_frame_alloc();
-                sws_frame_->format = AV_PIX_FMT_YUV420P;
-                sws_frame_->width = width_;
-                sws_frame_->height = height_;
-                if (av_frame_get_buffer(sws_frame_, 32) < 0) {//注意归还v4l2缓冲
-                    std::cerr << "Could not allocate the video frame data" << std::endl;
+            // 静止画面：跳过转换和图像处理，丢弃该帧或重复提交上一帧
+            bool repeat = false;
+            if (static_detector_ &&
+                static_detector_->unchanged(static_cast<const uint8_t*>(frame.data), frame.stride,
+                                            width_, height_, pop_us)) {
+                metrics_.frames_static->inc();
+                if (static_options_.mode == StaticSceneMode::Drop && !keyframe_requested_) {
+                    ++pts_;
+                    ++frames_skipped_;
                     if (frame.return_buffer) {
                         frame.return_buffer();
                     }
+                    busy_us_ += monotonic_us() - pop_us;
+                    continue;
+                }
+                repeat = frame_ready_;  // 没有可重复的帧（刚换过尺寸）时仍完整处理
+            }
+            if (!repeat) {
+                frame_ready_ = false;
+                if (!convert_and_process(frame, pop_us)) {
+                    if (frame.return_buffer) {//注意归还v4l2缓冲
+                        frame.return_buffer();
+                    }
                     continue;
                 }
+                frame_ready_ = true;
             }
             
-            sws_scale(sws_ctx_, 
-                     mat_data, mat_linesize, 
-                     0, mat_height,
-                     sws_frame_->data, sws_frame_->linesize);
+            if (!repeat && scene_detector_ &&
+                scene_detector_->update(sws_frame_->data[0], sws_frame_->linesize[0], encode_width_, encode_height_)) {
+                int64_t since_keyframe_ms = static_cast<int64_t>(frames_since_keyframe_) * frame_step_ * 1000 / fps_;
+                if (!keyframe_requested_ && since_keyframe_ms >= adaptive_gop_options_.min_interval_ms) {
+                    keyframe_requested_ = true;
+                    metrics_.scene_cuts->inc();
+                }
+            }
             
             // 设置时间戳
             sws_frame_->pts = pts_++;//以帧率为时间基，pts累加
+            if (keyframe_requested_) {
+                // 输出刚重连等场景：强制IDR，不必等到下一个GOP
+                sws_frame_->pict_type = AV_PICTURE_TYPE_I;
+                keyframe_requested_ = false;
+                frames_since_keyframe_ = 0;
+                metrics_.keyframes_forced->inc();
+            } else {
+                sws_frame_->pict_type = AV_PICTURE_TYPE_NONE;
+            }
             sws_frame_->best_effort_timestamp = sws_frame_->pts;
+            attach_regions(sws_frame_);
+            remember_frame(sws_frame_->pts, frame);
 
             // 编码并发送
+            metrics_.frames_encoded->inc();
+            ++rate_window_frames_;
             if (!encode_and_send_frame(sws_frame_)) {
-                std::cerr << "Encoding failed for frame: " << frame.sequence << std::endl;
+                LOG_ERROR_EVERY_MS_FOR("EncoderStreamer", rtmp_url_, 1000, "[%s] Encoding failed for frame: %u", rtmp_url_.c_str(), frame.sequence);
             }
+            frames_since_keyframe_ = (frames_since_keyframe_ + 1) % std::max(1, codec_ctx_->gop_size);
             
             // 归还摄像头缓冲区
             if (frame.return_buffer) {
                 frame.return_buffer();
             }
+            busy_us_ += monotonic_us() - pop_us;
         }
+        update_rate_metrics();
     }
     
     // 刷新编码器
     encode_and_send_frame(nullptr);
 }
 
-bool EncoderStreamer::init_ffmpeg() {
-    avformat_network_init();
-    std::cout << "avformat_network_init success !!!" << std::endl;
-    // 初始化输出格式上下文
-    avformat_alloc_output_context2(&fmt_ctx_, nullptr, "flv", rtmp_url_.c_str());
-    if (!fmt_ctx_) {
-        std::cerr << "Could not create output context" << std::endl;
-        return false;
+bool EncoderStreamer::convert_and_process(const CameraFrame& frame, int64_t pop_us) {
+    FrameTracer& tracer = FrameTracer::instance();
+    if (!rgb_frame_) {
+        rgb_frame_ = av_frame_alloc();
+        rgb_frame_->format = AV_PIX_FMT_YUV420P;
+        rgb_frame_->width = width_;
+        rgb_frame_->height = height_;
+        if (av_frame_get_buffer(rgb_frame_, 32) < 0) {
+            LOG_ERROR_EVERY_MS_FOR("EncoderStreamer", rtmp_url_, 1000, "[%s] Could not allocate the video frame data", rtmp_url_.c_str());
+            metrics_.frames_dropped->inc();
+            return false;
+        }
     }
     
-    // 查找编码器
-    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_H264);
-    if (!codec) {
-        std::cerr << "software Codec not found" << std::endl;
-        return false;
+    uint8_t* src_data[1] = {static_cast<uint8_t*>(frame.data)};
+    int src_linesize[1] = {static_cast<int>(frame.stride)};
+    sws_scale(rgb_ctx_, 
+             src_data, src_linesize, 
+             0, height_,
+             rgb_frame_->data, rgb_frame_->linesize);
+    tracer.record(frame.trace_id, TraceStage::ConvertDone, frame.camera_id);
+    int64_t convert_us = monotonic_us();
+    metrics_.convert_latency->observe((convert_us - pop_us) / 1e6);
+
+    cv::Mat rgb_mat(
+        height_, width_, CV_8UC3,  // 高度、宽度、3通道8位（BGR）
+        rgb_frame_->data[0],       // 数据指针（指向RGB数据）
+        rgb_frame_->linesize[0]    // linesize（每行字节数）
+    );
+
+    if (tile_tracker_) {
+        process_tiles(frame, rgb_mat, pop_us);
+    } else {
+        processor_->processFrame(rgb_mat);
     }
-    
-    // 创建编码器上下文
-    codec_ctx_ = avcodec_alloc_context3(codec);
-    if (!codec_ctx_) {
-        std::cerr << "Could not allocate video codec context" << std::endl;
-        return false;
+    regions_ = processor_->regionsOfInterest();
+    if (frame_sei_) {
+        frame_metadata_ = processor_->frameMetadata();
     }
-    
-    // 配置编码器
-    codec_ctx_->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
-    codec_ctx_->codec_id = codec->id;
-    codec_ctx_->thread_count = 8;
-    codec_ctx_->bit_rate = bitrate_;
-    codec_ctx_->width = width_;
-    codec_ctx_->height = height_;
-    codec_ctx_->time_base = (AVRational){1, fps_};
-    codec_ctx_->framerate = (AVRational){fps_, 1};
-    codec_ctx_->gop_size = fps_;
-    codec_ctx_->max_b_frames = 0;
-    codec_ctx_->pix_fmt = AV_PIX_FMT_YUV420P;
-    
-    // H264预设
-    AVDictionary *codec_options = NULL;
-    av_dict_set(&codec_options, "crf", "23", 0);
-    av_dict_set(&codec_options, "preset", "ultrafast", 0);
-    
-    // 打开编码器
-    if (avcodec_open2(codec_ctx_, codec, &codec_options) < 0) {
-        std::cerr << "Could not open codec" << std::endl;
+    tracer.record(frame.trace_id, TraceStage::ProcessDone, frame.camera_id);
+    metrics_.process_latency->observe((monotonic_us() - convert_us) / 1e6);
+
+    int mat_width = rgb_mat.cols;
+    int mat_height = rgb_mat.rows;
+    AVPixelFormat src_pix_fmt;
+    if (rgb_mat.type() == CV_8UC3) {
+        src_pix_fmt = AV_PIX_FMT_BGR24;  // OpenCV默认BGR
+    } else if (rgb_mat.type() == CV_8UC1) {
+        src_pix_fmt = AV_PIX_FMT_GRAY8;  // 灰度图
+    } else {// 跳过不支持的格式，注意归还v4l2缓冲
+        LOG_ERROR_EVERY_MS_FOR("EncoderStreamer", rtmp_url_, 1000, "[%s] Unsupported Mat format (type=%d)", rtmp_url_.c_str(),
+                               rgb_mat.type());
+        metrics_.frames_dropped->inc();
         return false;
     }
-    std::cout << "avcodec_open2 success!" << std::endl;
-    
-    // 创建输出流
-    video_stream_ = avformat_new_stream(fmt_ctx_, codec);
-    if (!video_stream_) {
-        std::cerr << "Failed allocating output stream" << std::endl;
+    sws_ctx_ = sws_getCachedContext(sws_ctx_, 
+                     mat_width, mat_height, src_pix_fmt,
+                     encode_width_, encode_height_, AV_PIX_FMT_YUV420P,
+                     SWS_BILINEAR, 0, 0, 0);
+    if (!sws_ctx_) {//注意归还v4l2缓冲
+        LOG_ERROR_EVERY_MS_FOR("EncoderStreamer", rtmp_url_, 1000, "[%s] Could not initialize the conversion context",
+                               rtmp_url_.c_str());
+        metrics_.frames_dropped->inc();
         return false;
     }
-    video_stream_->codecpar->codec_tag = 0;
-    video_stream_->time_base = codec_ctx_->time_base;
+
+    // 使用SWS转换cv::Mat到YUV420P
+    uint8_t* mat_data[1] = {static_cast<uint8_t*>(rgb_mat.data)};
+    int mat_linesize[1] = {static_cast<int>(rgb_mat.step[0])};
+
+    if (!sws_frame_) {
+        sws_frame_ = av_frame_alloc();
+        sws_frame_->format = AV_PIX_FMT_YUV420P;
+        sws_frame_->width = encode_width_;
+        sws_frame_->height = encode_height_;
+        if (av_frame_get_buffer(sws_frame_, 32) < 0) {//注意归还v4l2缓冲
+            LOG_ERROR_EVERY_MS_FOR("EncoderStreamer", rtmp_url_, 1000, "[%s] Could not allocate the video frame data", rtmp_url_.c_str());
+            metrics_.frames_dropped->inc();
+            return false;
+        }
+    }
     
-    // 复制编码参数到流
-    if (avcodec_parameters_from_context(video_stream_->codecpar, codec_ctx_) < 0) {
-        std::cerr << "Failed to copy codec parameters" << std::endl;
-        return false;
+    sws_scale(sws_ctx_, 
+             mat_data, mat_linesize, 
+             0, mat_height,
+             sws_frame_->data, sws_frame_->linesize);
+    return true;
+}
+
+void EncoderStreamer::process_tiles(const CameraFrame& frame, cv::Mat& mat, int64_t now_us) {
+    int dirty = tile_tracker_->update(static_cast<const uint8_t*>(frame.data), frame.stride, width_, height_, now_us);
+    std::vector<ImageTile>& tiles = tile_tracker_->tiles();
+    if (tile_output_.size() != mat.size() || tile_output_.type() != mat.type()) {
+        // 没有可复用的输出：本帧全部块重新处理
+        if (dirty < static_cast<int>(tiles.size())) {
+            for (ImageTile& tile : tiles) {
+                tile.dirty = true;
+            }
+            dirty = static_cast<int>(tiles.size());
+        }
+        tile_output_.create(mat.size(), mat.type());
+    }
+    if (dirty > 0) {
+        processor_->processTiles(mat, tiles);
+        if (mat.size() != tile_output_.size() || mat.type() != tile_output_.type()) {
+            LOG_ERROR_EVERY_MS_FOR("EncoderStreamer", rtmp_url_, 1000, "[%s] processTiles() must not change the Mat size or type",
+                                   rtmp_url_.c_str());
+            tile_output_.release();
+            tile_tracker_->invalidate();
+            return;
+        }
+    }
+    for (const ImageTile& tile : tiles) {
+        if (tile.dirty) {
+            mat(tile.rect).copyTo(tile_output_(tile.rect));
+        } else {
+            tile_output_(tile.rect).copyTo(mat(tile.rect));
+        }
     }
+    metrics_.tiles_dirty->inc(dirty);
+    metrics_.tiles_reused->inc(tiles.size() - dirty);
+}
 
-    fmt_ctx_->max_delay = 0;  // 消除格式容器延迟
-    av_dict_set(&fmt_ctx_->metadata, "stimeout", "2000000", 0); // 2秒超时
-    av_dict_set_int(&fmt_ctx_->metadata, "buffer_size", 1024*400, 0);
-    av_dict_set_int(&fmt_ctx_->metadata, "fifo_size", 1024*100, 0);
-    
-    // 打开输出
-    if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
-        if (avio_open(&fmt_ctx_->pb, rtmp_url_.c_str(), AVIO_FLAG_WRITE) < 0) {
-            std::cerr << "Could not open output URL: " << rtmp_url_ << std::endl;
-            return false;
+void EncoderStreamer::attach_regions(AVFrame* frame) {
+    av_frame_remove_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+    if (!roi_options_.enabled) return;
+
+    // 优先级高的在前：区域重叠时libx264使用数组中靠前的区域
+    std::vector<const ImageRegion*> ordered;
+    cv::Rect bounds(0, 0, width_, height_);
+    for (const ImageRegion& region : regions_) {
+        if (region.priority > 0 && (region.rect & bounds).area() > 0) {
+            ordered.push_back(&region);
         }
     }
+    std::stable_sort(ordered.begin(), ordered.end(), [](const ImageRegion* a, const ImageRegion* b) {
+        return a->priority > b->priority;
+    });
+    if (ordered.size() > static_cast<size_t>(std::max(0, roi_options_.max_regions))) {
+        ordered.resize(std::max(0, roi_options_.max_regions));
+    }
+    size_t count = ordered.size() + (roi_options_.background_qp_offset != 0 && !ordered.empty() ? 1 : 0);
+    metrics_.roi_regions->set(static_cast<double>(ordered.size()));
+    if (count == 0) return;
+
+    AVFrameSideData* side = av_frame_new_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST,
+                                                   count * sizeof(AVRegionOfInterest));
+    if (!side) {
+        LOG_WARN_EVERY_MS_FOR("EncoderStreamer", rtmp_url_, 1000, "[%s] Could not allocate ROI side data", rtmp_url_.c_str());
+        return;
+    }
+    // qoffset为QP偏移/51（libx264按QP范围换算回QP），坐标按编码档位缩放
+    AVRegionOfInterest* roi = reinterpret_cast<AVRegionOfInterest*>(side->data);
+    double scale_x = static_cast<double>(encode_width_) / width_;
+    double scale_y = static_cast<double>(encode_height_) / height_;
+    for (const ImageRegion* region : ordered) {
+        cv::Rect rect = region->rect & bounds;
+        roi->self_size = sizeof(AVRegionOfInterest);
+        roi->left = static_cast<int>(rect.x * scale_x);
+        roi->top = static_cast<int>(rect.y * scale_y);
+        roi->right = std::min(encode_width_, static_cast<int>(std::ceil((rect.x + rect.width) * scale_x)));
+        roi->bottom = std::min(encode_height_, static_cast<int>(std::ceil((rect.y + rect.height) * scale_y)));
+        roi->qoffset = av_make_q(std::max(-51, std::min(51, roi_options_.qp_offset * region->priority)), 51);
+        ++roi;
+    }
+    if (count > ordered.size()) {
+        // 整个画面放在最后，只对不属于任何区域的宏块生效
+        roi->self_size = sizeof(AVRegionOfInterest);
+        roi->left = 0;
+        roi->top = 0;
+        roi->right = encode_width_;
+        roi->bottom = encode_height_;
+        roi->qoffset = av_make_q(std::max(-51, std::min(51, roi_options_.background_qp_offset)), 51);
+    }
+}
+
+void EncoderStreamer::insert_frame_sei(AVPacket* pkt, const FrameInfo& info, int64_t now_us) {
+    size_t offset = h264_sei_insert_offset(pkt->data, static_cast<size_t>(pkt->size));
+    if (offset >= static_cast<size_t>(pkt->size)) return;  // 没有视频slice
+
+    FrameSeiData data;
+    data.camera_id = info.camera_id;
+    data.sequence = info.sequence;
+    data.skipped = static_cast<uint8_t>(std::min<uint32_t>(info.skipped, 255));
+    data.capture_us = info.capture_us;
+    data.capture_wall_us = info.capture_wall_us;
+    data.pipeline_us = info.capture_us > 0 && now_us > info.capture_us ? static_cast<uint32_t>(now_us - info.capture_us) : 0;
+    data.blob = info.metadata;
+    std::vector<uint8_t> sei = build_frame_sei(data);
+
+    size_t old_size = static_cast<size_t>(pkt->size);
+    if (av_grow_packet(pkt, static_cast<int>(sei.size())) < 0) {
+        LOG_WARN_EVERY_MS_FOR("EncoderStreamer", rtmp_url_, 1000, "[%s] Could not grow packet for frame SEI", rtmp_url_.c_str());
+        return;
+    }
+    memmove(pkt->data + offset + sei.size(), pkt->data + offset, old_size - offset);
+    memcpy(pkt->data + offset, sei.data(), sei.size());
+    metrics_.sei_bytes->inc(sei.size());
+}
+
+bool EncoderStreamer::init_ffmpeg() {
+    avformat_network_init();
+    LOG_INFO("EncoderStreamer", "avformat_network_init success !!!");
     
-    // 写入文件头
-    if (avformat_write_header(fmt_ctx_, nullptr) < 0) {
-        std::cerr << "Error occurred when opening output URL" << std::endl;
+    temporal_layers_ = std::max(1, std::min(temporal_layers_, 3));
+    encode_width_ = width_;
+    encode_height_ = height_;
+    if (adaptive_gop_options_.enabled) {
+        settings_.gop = std::max(1, static_cast<int>(static_cast<int64_t>(fps_) * adaptive_gop_options_.max_interval_ms / 1000));
+        scene_detector_.reset(new SceneChangeDetector(adaptive_gop_options_));
+    }
+    if (static_options_.enabled) {
+        static_detector_.reset(new StaticSceneDetector(static_options_));
+    }
+    if (processor_->tiledProcessing()) {
+        tile_tracker_.reset(new TileTracker(tile_options_));
+    }
+    if (motion_options_.enabled) {
+        motion_detector_.reset(new MotionDetector(motion_options_, {{"stream", rtmp_url_}}));
+        motion_detector_->set_callback(motion_callback_);
+    }
+    target_settings_ = settings_;
+    if (adaptive_options_.enabled) {
+        resolution_controller_.reset(new ResolutionController(adaptive_options_, width_, height_, fps_));
+    }
+    codec_ctx_ = open_encoder(width_, height_, 1);
+    if (!codec_ctx_) {
         return false;
     }
+    LOG_INFO("EncoderStreamer", "avcodec_open2 success!");
+    
+    // 创建各目的地并连接（断线后由各自的发送线程自动重连）
+    OutputOptions primary;
+    primary.format = output_format_;
+    primary.backup_urls = backup_urls_;
+    primary.pacing_multiplier = pacing_multiplier_;
+    std::vector<std::pair<std::string, OutputOptions>> destinations = {{rtmp_url_, primary}};
+    destinations.insert(destinations.end(), extra_outputs_.begin(), extra_outputs_.end());
+    for (const auto& destination : destinations) {
+        MetricLabels labels = {{"stream", rtmp_url_}, {"destination", destination.first}};
+        std::unique_ptr<OutputSender> output(new OutputSender(destination.first, destination.second, labels));
+        if (!output->open(codec_ctx_)) {
+            if (outputs_.empty()) {
+                return false;  // 主目的地的所有接入地址都不可用
+            }
+            LOG_WARN("EncoderStreamer", "[%s] Output %s unavailable, will keep retrying",
+                     rtmp_url_.c_str(), destination.first.c_str());
+        }
+        outputs_.push_back(std::move(output));
+    }
 
     // YUYV->BGR24
     rgb_ctx_ = sws_getCachedContext(
@@ -235,7 +566,7 @@ bool EncoderStreamer::init_ffmpeg() {
         SWS_BILINEAR, nullptr, nullptr, nullptr
     );
     if (!rgb_ctx_) {
-        std::cerr << "Failed to create YUYV→RGB converter" << std::endl;
+        LOG_ERROR("EncoderStreamer", "Failed to create YUYV→RGB converter");
         return false;
     }
     // YUYV->cv::Mat frame
@@ -244,61 +575,377 @@ bool EncoderStreamer::init_ffmpeg() {
     rgb_frame_->width = width_;
     rgb_frame_->height = height_;
     if (av_frame_get_buffer(rgb_frame_, 32) < 0) {
-        std::cerr << "Failed to allocate RGB frame buffer" << std::endl;
+        LOG_ERROR("EncoderStreamer", "Failed to allocate RGB frame buffer");
         return false;
     }
     //// cv::Mat->YUV420P frame
     sws_frame_ = av_frame_alloc();
     sws_frame_->format = AV_PIX_FMT_YUV420P;
-    sws_frame_->width = width_;
-    sws_frame_->height = height_;
+    sws_frame_->width = encode_width_;
+    sws_frame_->height = encode_height_;
     sws_frame_->pts = 0;
     if (av_frame_get_buffer(sws_frame_, 32) < 0) {
-        std::cerr << "Could not allocate the video frame data" << std::endl;
+        LOG_ERROR("EncoderStreamer", "Could not allocate the video frame data");
         return false;
     }
 
-    std::cout << "init ffmpeg end" << std::endl;
+    LOG_INFO("EncoderStreamer", "[%s] init ffmpeg end", rtmp_url_.c_str());
+    
+    return true;
+}
+
+AVCodecContext* EncoderStreamer::open_encoder(int width, int height, int frame_step) {
+    // 查找编码器
+    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (!codec) {
+        LOG_ERROR("EncoderStreamer", "software Codec not found");
+        return nullptr;
+    }
+    
+    // 创建编码器上下文
+    AVCodecContext* ctx = avcodec_alloc_context3(codec);
+    if (!ctx) {
+        LOG_ERROR("EncoderStreamer", "Could not allocate video codec context");
+        return nullptr;
+    }
+    
+    // 配置编码器；降档时码率按比例缩放
+    const EncoderSettings& settings = target_settings_;
+    int fps = std::max(1, fps_ / frame_step);
+    double scale = bitrate_scale(width, height, frame_step);
+    ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    ctx->codec_id = codec->id;
+    ctx->thread_count = 8;
+    ctx->bit_rate = static_cast<int64_t>(settings.bitrate * scale);
+    ctx->rc_max_rate = static_cast<int64_t>(settings.max_rate * scale);
+    ctx->rc_buffer_size = static_cast<int>(settings.buffer_size * scale);
+    ctx->width = width;
+    ctx->height = height;
+    ctx->time_base = (AVRational){1, fps_};           // 时间基固定为采集帧率，降帧率时pts按间隔跳跃
+    ctx->framerate = (AVRational){fps_, frame_step};
+    ctx->gop_size = std::max(1, settings.gop / frame_step);
+    ctx->max_b_frames = 0;
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    
+    // H264预设
+    AVDictionary *codec_options = NULL;
+    if (settings.crf > 0) {
+        av_dict_set(&codec_options, "crf", std::to_string(settings.crf).c_str(), 0);
+    }
+    av_dict_set(&codec_options, "preset", settings.preset.c_str(), 0);
+    av_dict_set(&codec_options, "forced-idr", "1", 0);  // 强制的关键帧编码为IDR，解码端可以从该帧开始
+    if (roi_options_.enabled) {
+        // libx264只在开启AQ时使用ROI，ultrafast等预设关闭了AQ，这里显式打开（预设之后生效）
+        av_dict_set(&codec_options, "aq-mode", "1", 0);
+    }
+    if (temporal_layers_ == 3) {
+        // 固定GOP结构的分层B帧：P b B b P，层号由nal_ref_idc区分
+        ctx->max_b_frames = 3;
+        av_dict_set(&codec_options, "b-pyramid", "strict", 0);
+        av_dict_set(&codec_options, "b-adapt", "0", 0);
+    } else if (temporal_layers_ == 2) {
+        ctx->max_b_frames = 1;
+        av_dict_set(&codec_options, "b-pyramid", "none", 0);
+        av_dict_set(&codec_options, "b-adapt", "0", 0);
+    } else if (droppable_frames_ > 0) {
+        // 非参考B帧：丢弃后不影响其他帧解码
+        ctx->max_b_frames = droppable_frames_;
+        av_dict_set(&codec_options, "b-pyramid", "none", 0);
+    }
     
+    // 打开编码器
+    int open_ret = avcodec_open2(ctx, codec, &codec_options);
+    av_dict_free(&codec_options);
+    if (open_ret < 0) {
+        LOG_ERROR("EncoderStreamer", "Could not open codec (%dx%d@%d)", width, height, fps);
+        avcodec_free_context(&ctx);
+        return nullptr;
+    }
+    return ctx;
+}
+
+double EncoderStreamer::bitrate_scale(int width, int height, int frame_step) const {
+    // 像素率减半时码率约降到60%
+    double pixel_rate = static_cast<double>(width) * height / (static_cast<double>(width_) * height_) /
+                        std::max(1, frame_step);
+    return std::pow(std::min(pixel_rate, 1.0), 0.75);
+}
+
+bool EncoderStreamer::swap_encoder(int width, int height, int frame_step) {
+    switch_pending_ = false;
+    swap_pending_ = false;
+    int64_t start_us = monotonic_us();
+    std::string change = swap_change_;
+    int64_t requested_us = swap_requested_us_ > 0 ? swap_requested_us_ : start_us;
+    swap_change_.clear();
+    swap_requested_us_ = 0;
+
+    // 先打开新编码器，失败时继续使用原编码器和原参数
+    AVCodecContext* ctx = open_encoder(width, height, frame_step);
+    if (!ctx) {
+        target_settings_ = settings_;
+        LOG_ERROR_EVERY_MS_FOR("EncoderStreamer", rtmp_url_, 10000, "[%s] Could not apply encoder change (%s), keeping current encoder",
+                               rtmp_url_.c_str(), change.c_str());
+        return false;
+    }
+    // 刷出旧编码器中缓存的帧，切换点之前的帧全部发出
+    encode_and_send_frame(nullptr);
+    avcodec_free_context(&codec_ctx_);
+    codec_ctx_ = ctx;
+    settings_ = target_settings_;
+
+    // 有B帧时新编码器的首个dts早于其pts，留出重排延迟保证dts单调递增
+    if (ctx->max_b_frames > 0) {
+        pts_ += static_cast<int64_t>(ctx->max_b_frames + 1) * frame_step;
+    }
+    if (sws_frame_ && (sws_frame_->width != width || sws_frame_->height != height)) {
+        av_frame_free(&sws_frame_);  // 下一帧按新尺寸分配
+        frame_ready_ = false;
+    }
+    encode_width_ = width;
+    encode_height_ = height;
+    frame_step_ = frame_step;
+    frames_since_keyframe_ = 0;
+    keyframe_requested_ = false;  // 新编码器的第一帧就是IDR
+    announce_extradata_ = true;
+    update_pacing();
+
+    int64_t now = monotonic_us();
+    metrics_.reconfigure_swap->observe((now - start_us) / 1e6);
+    record_change(requested_us, now, now - start_us, true, change);
+    return true;
+}
+
+void EncoderStreamer::update_pacing() {
+    int64_t target_bps = codec_ctx_->rc_max_rate > 0 ? codec_ctx_->rc_max_rate : codec_ctx_->bit_rate;
+    if (target_bps <= 0) return;
+    for (auto& output : outputs_) {
+        output->set_target_bitrate(target_bps);
+    }
+}
+
+bool EncoderStreamer::switch_resolution(size_t rung) {
+    const ResolutionRung& target = resolution_controller_->rung_at(rung);
+    int step = std::max(1, (fps_ + target.fps / 2) / std::max(1, target.fps));
+    if (!swap_change_.empty()) swap_change_ += ' ';
+    swap_change_ += "resolution=" + std::to_string(target.width) + "x" + std::to_string(target.height) +
+                    "@" + std::to_string(fps_ / step);
+    if (!swap_encoder(target.width, target.height, step)) {
+        return false;
+    }
+    resolution_controller_->set_rung(rung, monotonic_us());
+    resolution_rung_ = rung;
+    metrics_.resolution_rung->set(static_cast<double>(rung));
+    metrics_.resolution_switches->inc();
+    LOG_INFO("EncoderStreamer", "[%s] Resolution rung %zu, next step-up after %d s",
+             rtmp_url_.c_str(), rung, resolution_controller_->up_delay_s());
     return true;
 }
 
+void EncoderStreamer::reconfigure(const EncoderReconfig& change) {
+    std::lock_guard<std::mutex> lock(reconfig_mutex_);
+    if (!reconfig_pending_) {
+        pending_reconfig_ = EncoderReconfig();
+        pending_reconfig_us_ = monotonic_us();
+    }
+    // 与尚未处理的变更合并，后提交的字段覆盖先提交的
+    if (change.bitrate >= 0) pending_reconfig_.bitrate = change.bitrate;
+    if (change.max_rate >= 0) pending_reconfig_.max_rate = change.max_rate;
+    if (change.buffer_size >= 0) pending_reconfig_.buffer_size = change.buffer_size;
+    if (change.crf >= 0) pending_reconfig_.crf = change.crf;
+    if (change.gop > 0) pending_reconfig_.gop = change.gop;
+    if (!change.preset.empty()) pending_reconfig_.preset = change.preset;
+    reconfig_pending_ = true;
+}
+
+void EncoderStreamer::apply_reconfig() {
+    EncoderReconfig change;
+    int64_t requested_us;
+    {
+        std::lock_guard<std::mutex> lock(reconfig_mutex_);
+        change = pending_reconfig_;
+        requested_us = pending_reconfig_us_;
+        reconfig_pending_ = false;
+    }
+    int64_t start_us = monotonic_us();
+
+    EncoderSettings next = target_settings_;
+    std::string description;
+    auto describe = [&](const std::string& item) {
+        if (!description.empty()) description += ' ';
+        description += item;
+    };
+    if (change.bitrate >= 0 && change.bitrate != next.bitrate) {
+        next.bitrate = change.bitrate;
+        describe("bitrate=" + std::to_string(next.bitrate));
+    }
+    if (change.max_rate >= 0 && change.max_rate != next.max_rate) {
+        next.max_rate = change.max_rate;
+        describe("maxrate=" + std::to_string(next.max_rate));
+    }
+    if (change.buffer_size >= 0 && change.buffer_size != next.buffer_size) {
+        next.buffer_size = change.buffer_size;
+        describe("bufsize=" + std::to_string(next.buffer_size));
+    }
+    if (change.crf >= 0 && change.crf != next.crf) {
+        next.crf = change.crf;
+        describe(next.crf > 0 ? "crf=" + std::to_string(next.crf) : std::string("ratecontrol=abr"));
+    }
+    if (change.gop > 0 && change.gop != next.gop) {
+        next.gop = change.gop;
+        describe("gop=" + std::to_string(next.gop));
+    }
+    if (!change.preset.empty() && change.preset != next.preset) {
+        next.preset = change.preset;
+        describe("preset=" + next.preset);
+    }
+    if (description.empty()) return;
+
+    // x264_encoder_reconfig不能修改GOP、预设、码控模式，也不能开关VBV
+    bool needs_swap = swap_pending_ || next.gop != settings_.gop || next.preset != settings_.preset ||
+                      (next.crf > 0) != (settings_.crf > 0) ||
+                      (next.max_rate > 0 && next.buffer_size > 0) != (settings_.max_rate > 0 && settings_.buffer_size > 0);
+    target_settings_ = next;
+    if (needs_swap) {
+        if (!swap_change_.empty()) swap_change_ += ' ';
+        swap_change_ += description;
+        if (swap_requested_us_ == 0) {
+            swap_requested_us_ = requested_us;
+        }
+        if (!swap_pending_ && !switch_pending_) {
+            switch_wait_frames_ = 0;
+        }
+        swap_pending_ = true;
+        return;
+    }
+
+    // libx264在下一帧检查这些字段并调用x264_encoder_reconfig
+    double scale = bitrate_scale(encode_width_, encode_height_, frame_step_);
+    codec_ctx_->bit_rate = static_cast<int64_t>(next.bitrate * scale);
+    codec_ctx_->rc_max_rate = static_cast<int64_t>(next.max_rate * scale);
+    codec_ctx_->rc_buffer_size = static_cast<int>(next.buffer_size * scale);
+    if (next.crf > 0) {
+        av_opt_set_double(codec_ctx_->priv_data, "crf", next.crf, 0);
+    }
+    settings_ = next;
+    update_pacing();
+    int64_t now = monotonic_us();
+    metrics_.reconfigure_in_place->observe((now - start_us) / 1e6);
+    record_change(requested_us, now, now - start_us, false, description);
+}
+
+void EncoderStreamer::record_change(int64_t requested_us, int64_t applied_us, int64_t cost_us, bool swapped,
+                                    const std::string& change) {
+    EncoderChangeRecord record;
+    record.requested_us = requested_us;
+    record.applied_us = applied_us;
+    record.cost_us = cost_us;
+    record.encoder_swapped = swapped;
+    record.change = change;
+    LOG_INFO("EncoderStreamer", "[%s] Encoder %s: %s (cost %.1f ms, %.1f ms after request)", rtmp_url_.c_str(),
+             swapped ? "swapped" : "reconfigured", change.c_str(), cost_us / 1000.0,
+             (applied_us - requested_us) / 1000.0);
+    std::lock_guard<std::mutex> lock(history_mutex_);
+    change_history_.push_back(record);
+    if (change_history_.size() > kChangeHistory) {
+        change_history_.pop_front();
+    }
+}
+
+std::vector<EncoderChangeRecord> EncoderStreamer::change_history() const {
+    std::lock_guard<std::mutex> lock(history_mutex_);
+    return std::vector<EncoderChangeRecord>(change_history_.begin(), change_history_.end());
+}
+
 bool EncoderStreamer::encode_and_send_frame(const AVFrame* frame) {
     // 发送帧到编码器
-    int ret = avcodec_send_frame(codec_ctx_, frame);
+    int ret = FAULT_POINT(EncoderSend, rtmp_url_) ? AVERROR(EINVAL) : avcodec_send_frame(codec_ctx_, frame);
     if (ret < 0) {
-        std::cerr << "Error sending a frame to the encoder: " << ret << std::endl;
+        LOG_ERROR_EVERY_MS_FOR("EncoderStreamer", rtmp_url_, 1000, "[%s] Error sending a frame to the encoder: %d", rtmp_url_.c_str(), ret);
         return false;
     }
+    FrameTracer& tracer = FrameTracer::instance();
+    if (frame && tracer.enabled()) {
+        const FrameInfo* info = find_frame_info(frame->pts);
+        if (info) {
+            tracer.record(info->trace_id, TraceStage::EncoderSend, info->camera_id);
+        }
+    }
     
     AVPacket* pkt = av_packet_alloc();
     if (!pkt){
-        return -1;
+        return false;
     }
     
     while (ret >= 0) {
         ret = avcodec_receive_packet(codec_ctx_, pkt);
+        if (ret >= 0 && FAULT_POINT(EncoderReceive, rtmp_url_)) {
+            ret = AVERROR(EIO);
+        }
         if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
             break;
         } else if (ret < 0) {
-            std::cerr << "Error during encoding: " << ret << std::endl;
-            av_packet_unref(pkt);
+            LOG_ERROR_EVERY_MS_FOR("EncoderStreamer", rtmp_url_, 1000, "[%s] Error during encoding: %d", rtmp_url_.c_str(), ret);
+            // 丢了一个编码包：各目的地丢弃到下一个关键帧，下一帧编为IDR
+            for (auto& output : outputs_) {
+                output->drop_until_keyframe();
+            }
+            keyframe_requested_ = true;
+            av_packet_free(&pkt);
             return false;
         }
         
-        // 重新缩放PTS/DTS
-        av_packet_rescale_ts(pkt, codec_ctx_->time_base, video_stream_->time_base);
-        pkt->stream_index = video_stream_->index;
-        
-        // 写入帧
-        ret = av_interleaved_write_frame(fmt_ctx_, pkt);
-        if (ret < 0) {
-            std::cerr << "Error while writing video packet: " << ret << std::endl;
+        const FrameInfo* info = find_frame_info(pkt->pts);
+        if (info) {
+            tracer.record(info->trace_id, TraceStage::PacketReceived, info->camera_id);
+            int64_t now = monotonic_us();
+            metrics_.encode_latency->observe((now - info->send_us) / 1e6);
+            if (info->capture_us > 0 && now >= info->capture_us) {
+                metrics_.capture_to_packet->observe((now - info->capture_us) / 1e6);
+            }
+        }
+        if (announce_extradata_ && (pkt->flags & AV_PKT_FLAG_KEY) && codec_ctx_->extradata_size > 0) {
+            // 换过分辨率：关键帧附带新的SPS/PPS，muxer据此写出新的序列头（与上次相同时muxer忽略）
+            uint8_t* side = av_packet_new_side_data(pkt, AV_PKT_DATA_NEW_EXTRADATA, codec_ctx_->extradata_size);
+            if (side) {
+                memcpy(side, codec_ctx_->extradata, codec_ctx_->extradata_size);
+                announce_extradata_ = false;  // 只需新编码器的第一个关键帧携带
+            }
+        }
+        if (frame_sei_ && info) {
+            insert_frame_sei(pkt, *info, monotonic_us());
+        }
+        int packet_size = pkt->size;
+        rate_window_bytes_ += packet_size;
+        int ref_idc = -1;
+        PacketPriority priority = classify_h264_packet(pkt->data, static_cast<size_t>(pkt->size), &ref_idc);
+        int temporal_layer = h264_temporal_layer(ref_idc, temporal_layers_);
+        if (packet_callback_) {
+            EncodedPacketInfo packet_info;
+            packet_info.camera_id = info ? info->camera_id : -1;
+            packet_info.sequence = info ? info->sequence : 0;
+            packet_info.capture_us = info ? info->capture_us : 0;
+            packet_info.packet_us = monotonic_us();
+            packet_info.keyframe = (pkt->flags & AV_PKT_FLAG_KEY) != 0;
+            packet_info.size = packet_size;
+            packet_info.priority = priority;
+            packet_info.temporal_layer = temporal_layer;
+            packet_info.regions = info && !info->regions.empty() ? &info->regions : nullptr;
+            packet_callback_(pkt, packet_info);
         }
         
+        // 分发到各目的地的发送队列（引用计数，不复制数据），写入和重连在各自的发送线程中进行
+        for (auto& output : outputs_) {
+            output->enqueue(pkt, info ? info->trace_id : 0, info ? info->camera_id : -1, priority,
+                            temporal_layer);
+            if (output->take_keyframe_request()) {
+                keyframe_requested_ = true;
+            }
+        }
         av_packet_unref(pkt);
     }
     
+    av_packet_free(&pkt);
     return true;
 }
 
@@ -307,14 +954,11 @@ void EncoderStreamer::cleanup() {
         processor_->cleanup();
     }
 
-    if (fmt_ctx_ && !(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
-        avio_closep(&fmt_ctx_->pb);
-    }
-    
-    if (fmt_ctx_) {
-        avformat_free_context(fmt_ctx_);
-        fmt_ctx_ = nullptr;
+    for (auto& output : outputs_) {
+        output->stop();
+        output->close();
     }
+    outputs_.clear();
     
     if (codec_ctx_) {
         avcodec_free_context(&codec_ctx_);
@@ -15,12 +15,25 @@
 
 #include "thread_safe_queue.h"
 #include "CameraCapture.h"
+#include "FrameSei.h"
 #include "ImageProcessor.h"
+#include "Metrics.h"
+#include "MotionDetector.h"
+#include "OutputSender.h"
+#include "ResolutionController.h"
+#include "SceneChangeDetector.h"
+#include "StaticSceneDetector.h"
+#include "TileTracker.h"
 #include <memory>
 #include <atomic>
+#include <deque>
+#include <mutex>
 #include <thread>
 #include <string>
 #include <iostream>
+#include <functional>
+#include <utility>
+#include <vector>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -30,8 +43,51 @@ extern "C" {
 #include <libavutil/pixfmt.h>
 }
 
+// 编码输出包的附加信息（通过PacketCallback提供给调用者）
+struct EncodedPacketInfo {
+    int camera_id;          // 来源摄像头ID
+    uint32_t sequence;      // 来源帧序列号
+    int64_t capture_us;     // 采集时间戳（CLOCK_MONOTONIC，微秒；未知时为0）
+    int64_t packet_us;      // 收到编码包的时间（CLOCK_MONOTONIC，微秒）
+    bool keyframe;          // 是否为关键帧
+    int size;               // 包大小（字节）
+    PacketPriority priority; // 包优先级（IDR/参考帧/非参考帧）
+    int temporal_layer;     // 时域层号（未分层时为0）
+    const std::vector<ImageRegion>* regions; // 该帧的关注区域（采集分辨率坐标），没有时为nullptr，只在回调期间有效
+};
+
+// ROI编码配置（区域来自ImageProcessor::regionsOfInterest()）
+struct RoiOptions {
+    bool enabled = false;
+    int qp_offset = -4;              // 每级优先级的QP偏移（负数提高区域画质）
+    int background_qp_offset = 0;    // 区域以外画面的QP偏移（正数降低背景画质，码率进一步下降）
+    int max_regions = 32;            // 每帧最多使用的区域数（按优先级保留）
+};
+
+// 运行中修改的编码参数（负数或空表示不修改）
+struct EncoderReconfig {
+    int64_t bitrate = -1;      // 目标码率（bit/s，采集分辨率下，ABR模式使用）
+    int64_t max_rate = -1;     // VBV最大码率（bit/s），0表示关闭VBV
+    int buffer_size = -1;      // VBV缓冲区大小（bit）
+    double crf = -1;           // CRF值（1~51），0表示改用ABR码控
+    int gop = -1;              // 关键帧间隔（帧，按采集帧率）
+    std::string preset;        // x264预设
+};
+
+// 一次编码参数变更的记录
+struct EncoderChangeRecord {
+    int64_t requested_us;   // 请求时间（CLOCK_MONOTONIC微秒）
+    int64_t applied_us;     // 生效时间
+    int64_t cost_us;        // 应用耗时（原地修改为设置参数的耗时，换编码器为打开新编码器并刷出旧编码器的耗时）
+    bool encoder_swapped;   // 是否换了编码器
+    std::string change;     // 变更内容，如"bitrate=1500000 crf=26"
+};
+
 class EncoderStreamer {
 public:
+    // 编码包回调类型（在编码线程中调用，packet在回调返回后失效）
+    using PacketCallback = std::function<void(const AVPacket* packet, const EncodedPacketInfo& info)>;
+    
     /**
      * @brief 构造函数，初始化编码器推流器基本参数
      * @param rtmp_url RTMP服务器地址
@@ -89,6 +145,156 @@ public:
         processor_ = std::unique_ptr<ImageProcessor>(processor);
     }
     
+    /**
+     * @brief 设置主目的地（构造时的rtmp_url）的输出容器格式（需在initialize()前调用）
+     * @param format FFmpeg muxer名称，默认"flv"；基准测试可用"null"丢弃输出，或"mp4"等写文件
+     */
+    void set_output_format(const std::string& format) { output_format_ = format; }
+    
+    /**
+     * @brief 添加推流目的地（需在initialize()前调用）
+     * 所有目的地共用同一路编码输出，各自有独立的发送线程、队列、丢包策略和重连状态，
+     * 一个目的地变慢或断开不影响其他目的地。备用目的地首次连接失败不影响initialize()，之后自动重连。
+     * @param url 目的地地址，如备用RTMP服务器或第三方平台
+     * @param options 目的地配置
+     */
+    void add_output(const std::string& url, const OutputOptions& options = OutputOptions()) {
+        extra_outputs_.emplace_back(url, options);
+    }
+
+    /**
+     * @brief 设置主目的地的备用接入地址（需在initialize()前调用）
+     * 主地址断线或持续拥塞时自动切换到备用地址，主地址恢复后在关键帧处切回；
+     * 任一地址可以连接时initialize()即成功。
+     * @param urls 备用接入地址，按优先级排列
+     */
+    void set_backup_urls(const std::vector<std::string>& urls) { backup_urls_ = urls; }
+
+    /**
+     * @brief 设置主目的地的发送限速（需在initialize()前调用）
+     * 关键帧按目标码率的multiplier倍匀速发出，避免每个GOP在上行链路上形成突发。
+     * @param multiplier 目标码率的倍数（建议1.5~3），0表示不限速
+     */
+    void set_output_pacing(double multiplier) { pacing_multiplier_ = multiplier; }
+    
+    /**
+     * @brief 设置x264预设（需在initialize()前调用，运行中修改用reconfigure()）
+     * @param preset 如"ultrafast"（默认）、"superfast"、"veryfast"
+     */
+    void set_preset(const std::string& preset) { settings_.preset = preset; }
+
+    /**
+     * @brief 运行中修改编码参数（任意线程调用）
+     * 码率、VBV大小和CRF在下一帧原地生效（libx264每帧检查这些参数并调用x264_encoder_reconfig）；
+     * GOP、预设、码控模式（CRF/ABR）和VBV开关x264不能原地修改，在下一个GOP边界换编码器
+     * （最多等待1秒，新编码器从IDR开始，推流连接不断开）。
+     * CRF模式下码率只受VBV限制，bitrate在改用ABR或切换分辨率档位时使用。
+     * 每次变更连同请求时间和耗时记入change_history()。
+     */
+    void reconfigure(const EncoderReconfig& change);
+
+    /**
+     * @brief 请求下一帧编码为IDR（任意线程调用），用于新观众加入、场景切换等
+     */
+    void request_keyframe() { external_keyframe_request_ = true; }
+
+    /**
+     * @brief 最近的编码参数变更记录（含分辨率档位切换），按时间先后排列
+     */
+    std::vector<EncoderChangeRecord> change_history() const;
+
+    /**
+     * @brief 产生可丢弃帧（需在initialize()前调用）
+     * 每两个参考P帧之间插入count个非参考B帧（b-pyramid=none），拥塞时发送端可以只丢这些帧，
+     * 不会破坏其余帧的解码；代价是增加count帧的编码延迟。
+     * @param count 连续B帧数量，0表示关闭（默认）
+     */
+    void set_droppable_frames(int count) { droppable_frames_ = count; }
+
+    /**
+     * @brief 时域分层编码（需在initialize()前调用，优先于set_droppable_frames()）
+     * x264没有分层P帧，用分层B帧实现：2层为P b P b（b不被参考），3层为P b B b P（strict b-pyramid，
+     * 中间的B只被两侧的b参考）。丢弃最高层帧率减半，丢弃1层以上帧率为1/4，其余帧都能正确解码。
+     * 编码延迟增加layers==2时1帧、layers==3时3帧。
+     * 包的层号通过EncodedPacketInfo::temporal_layer提供，并随包传给各目的地（OutputSender::set_max_temporal_layer()）。
+     * @param layers 层数，1表示关闭（默认），最大3
+     */
+    void set_temporal_layers(int layers) { temporal_layers_ = layers; }
+
+    /**
+     * @brief 开启分辨率/帧率自适应（需在initialize()前调用）
+     * 每秒按编码线程忙碌比例、输入队列积压和主目的地拥塞选择档位（ResolutionController），
+     * 在下一个GOP边界（最多等待1秒）换用新尺寸的编码器：旧编码器刷出缓存帧后释放，新编码器从IDR开始，
+     * 关键帧带新的序列头（AV_PKT_DATA_NEW_EXTRADATA），RTMP连接不断开。
+     * 降帧率档位按整数间隔跳过输入帧，时间基不变；码率按像素率的0.75次方缩放。
+     * 图像处理（processFrame）仍按采集分辨率进行，只有最后的缩放和编码使用档位尺寸。
+     */
+    void set_adaptive_resolution(const AdaptiveResolutionOptions& options) { adaptive_options_ = options; }
+
+    /**
+     * @brief 开启自适应GOP（需在initialize()前调用）
+     * 关键帧间隔放宽到max_interval_ms（静止的监控画面不再每秒一个IDR），
+     * SceneChangeDetector在编码前的Y平面上检测到场景切换时强制IDR（间隔不小于min_interval_ms）；
+     * 新观众加入用request_keyframe()，目的地重连或拥塞丢包后由OutputSender请求IDR。
+     */
+    void set_adaptive_gop(const AdaptiveGopOptions& options) { adaptive_gop_options_ = options; }
+
+    /**
+     * @brief 开启静止画面低功耗模式（需在initialize()前调用）
+     * StaticSceneDetector在YUYV缓冲区上判断画面没有变化时，跳过YUYV→BGR转换、processFrame和YUV420P转换：
+     * Drop模式不编码该帧（可变帧率），Repeat模式把上一帧YUV再次送入编码器（x264几乎全部编码为skip宏块）。
+     * 画面一有变化，当前帧就完整处理；静止时每refresh_ms仍完整处理一帧。
+     */
+    void set_static_scene(const StaticSceneOptions& options) { static_options_ = options; }
+
+    /**
+     * @brief 开启移动侦测（需在initialize()前调用）
+     * MotionDetector在每个采集帧的YUYV缓冲区上运行（在降帧率、静止画面跳过之前），
+     * 事件在编码线程中通过callback回调，并计入motion_*指标。
+     * @param options 侦测配置（区域等）
+     * @param callback 事件回调，可为空（只记录日志和指标）
+     */
+    void set_motion_detection(const MotionOptions& options, MotionDetector::EventCallback callback) {
+        motion_options_ = options;
+        motion_callback_ = std::move(callback);
+    }
+
+    /**
+     * @brief 设置分块增量处理参数（需在initialize()前调用）
+     * 处理器的tiledProcessing()返回true时生效：TileTracker在YUYV缓冲区上找出变化的64x64块，
+     * processTiles()只重新处理这些块，其余块用上次处理后的输出覆盖，再送去转换编码。
+     */
+    void set_tile_tracking(const TileTrackingOptions& options) { tile_options_ = options; }
+
+    /**
+     * @brief 开启ROI编码（需在initialize()前调用）
+     * 处理器返回的区域按优先级从高到低作为AV_FRAME_DATA_REGIONS_OF_INTEREST附加到送编码器的帧上，
+     * libx264据此调整区域内宏块的QP。libx264只在开启AQ时使用ROI，
+     * 默认的ultrafast预设关闭了AQ，开启ROI编码时编码器固定使用aq-mode=1（方差AQ）。ABR码控下总码率不变，
+     * 区域内的码率取自背景；background_qp_offset为正时背景画质和码率都进一步降低。
+     * 区域坐标按当前编码档位缩放。不开启时区域仍通过EncodedPacketInfo::regions提供给调用者。
+     */
+    void set_roi_encoding(const RoiOptions& options) { roi_options_ = options; }
+
+    /**
+     * @brief 开启帧元数据SEI（需在initialize()前调用）
+     * 每个编码包的第一个视频slice之前插入user data unregistered SEI，包含采集时间、序列号、摄像头ID、
+     * 设备上的处理耗时和ImageProcessor::frameMetadata()，格式见FrameSei.h。
+     * 接收端可以据此计算端到端延迟、把分析结果与帧对齐（tools/sei_latency）。
+     */
+    void set_frame_sei(bool enabled) { frame_sei_ = enabled; }
+
+    /**
+     * @brief 当前编码档位（0为采集分辨率，任意线程调用）
+     */
+    size_t resolution_rung() const { return resolution_rung_; }
+    
+    /**
+     * @brief 设置编码包回调（需在start()前调用）
+     * 每个编码输出包在写入muxer前回调一次，可用于统计延迟、录制等
+     */
+    void set_packet_callback(PacketCallback callback) { packet_callback_ = std::move(callback); }
+    
 private:
     /**
      * @brief 编码循环线程函数，处理队列中的帧并推流
@@ -100,6 +306,73 @@ private:
      * @return 初始化成功返回true，否则返回false
      */
     bool init_ffmpeg();
+
+    /**
+     * @brief YUYV→BGR转换、processFrame，再缩放为编码尺寸的YUV420P（写入sws_frame_）
+     * @return 失败时已记录丢帧，返回false（调用者负责归还缓冲区）
+     */
+    bool convert_and_process(const CameraFrame& frame, int64_t pop_us);
+
+    /**
+     * @brief 分块增量处理：只把变化的块交给processTiles()，其余块用tile_output_覆盖
+     */
+    void process_tiles(const CameraFrame& frame, cv::Mat& mat, int64_t now_us);
+
+    /**
+     * @brief 把当前关注区域作为ROI附加数据写入送编码器的帧（替换上一帧的ROI）
+     */
+    void attach_regions(AVFrame* frame);
+
+    /**
+     * @brief 按指定尺寸创建并打开H.264编码器
+     * @param frame_step 帧间隔（1为采集帧率，2为半帧率）
+     * @return 打开的编码器上下文，失败返回nullptr
+     */
+    AVCodecContext* open_encoder(int width, int height, int frame_step);
+
+    /**
+     * @brief 按target_settings_和指定尺寸换用新编码器（编码线程在帧之间调用）
+     * 先打开新编码器，成功后刷出并释放旧编码器
+     * @return 新编码器打开失败时保持原编码器和原参数，返回false
+     */
+    bool swap_encoder(int width, int height, int frame_step);
+
+    /**
+     * @brief 编码器码率变化后（原地修改或换编码器），按新的目标码率更新各目的地的发送限速
+     */
+    void update_pacing();
+
+    /**
+     * @brief 换用指定档位的编码器
+     */
+    bool switch_resolution(size_t rung);
+
+    /**
+     * @brief 取出reconfigure()提交的变更，能原地修改的立即生效，其余安排换编码器（编码线程调用）
+     */
+    void apply_reconfig();
+
+    /**
+     * @brief 编码尺寸/帧率相对采集参数的码率系数（像素率的0.75次方）
+     */
+    double bitrate_scale(int width, int height, int frame_step) const;
+
+    /**
+     * @brief 记录一次参数变更
+     */
+    void record_change(int64_t requested_us, int64_t applied_us, int64_t cost_us, bool swapped,
+                       const std::string& change);
+
+    // 编码参数（open_encoder()按此创建编码器）
+    struct EncoderSettings {
+        int64_t bitrate = 0;      // 目标码率（采集分辨率下）
+        int64_t max_rate = 0;     // VBV最大码率，0表示不启用VBV
+        int buffer_size = 0;      // VBV缓冲区（bit）
+        double crf = 23;          // >0为CRF码控，0为ABR码控
+        int gop = 0;              // 关键帧间隔（按采集帧率的帧数）
+        std::string preset = "ultrafast";
+    };
+    static constexpr size_t kChangeHistory = 64;
     
     /**
      * @brief 清理FFmpeg相关资源
@@ -113,13 +386,103 @@ private:
      */
     bool encode_and_send_frame(const AVFrame* frame);
     
+    // 已送入编码器的帧信息，按pts索引，用于把编码输出的包关联回原始采集帧
+    struct FrameInfo {
+        int64_t pts = -1;
+        uint64_t trace_id = 0;
+        int camera_id = 0;
+        uint32_t sequence = 0;
+        uint32_t skipped = 0;    // 上一个编码帧之后有意跳过的采集帧数（降帧率、静止画面丢帧）
+        int64_t capture_us = 0;  // 采集时间戳（CLOCK_MONOTONIC，微秒）
+        int64_t send_us = 0;     // 送入编码器的时间
+        std::vector<ImageRegion> regions;  // 该帧的关注区域
+        int64_t capture_wall_us = 0;       // 采集时间换算成的系统时间（Unix纪元微秒）
+        std::string metadata;              // 处理器提供的帧元数据（开启帧元数据SEI时）
+    };
+    static constexpr size_t kFrameInfoSlots = 64;
+    
+    /**
+     * @brief 记录即将送入编码器的帧信息
+     */
+    void remember_frame(int64_t pts, const CameraFrame& frame);
+    
+    /**
+     * @brief 按编码器时间基下的pts查找帧信息
+     * @return 找到返回指针，否则返回nullptr（如帧信息已被覆盖）
+     */
+    const FrameInfo* find_frame_info(int64_t pts) const;
+
+    /**
+     * @brief 在编码包的第一个视频slice之前插入帧元数据SEI
+     */
+    void insert_frame_sei(AVPacket* pkt, const FrameInfo& info, int64_t now_us);
+    
+    /**
+     * @brief 注册本路推流的运行指标
+     */
+    void register_metrics();
+    
+    /**
+     * @brief 每秒更新一次编码帧率和输出码率
+     */
+    void update_rate_metrics();
+    
+    // 运行指标（构造时按推流地址注册）
+    struct StreamMetrics {
+        Gauge* queue_depth = nullptr;
+        Counter* frames_encoded = nullptr;
+        Counter* frames_dropped = nullptr;
+        Histogram* queue_latency = nullptr;      // 采集→编码线程取出
+        Histogram* convert_latency = nullptr;    // YUYV→BGR
+        Histogram* process_latency = nullptr;    // processFrame
+        Histogram* encode_latency = nullptr;     // 送编码器→收到编码包
+        Histogram* capture_to_packet = nullptr;  // 采集→收到编码包
+        Gauge* encoder_fps = nullptr;
+        Gauge* output_bitrate = nullptr;
+        Counter* keyframes_forced = nullptr;
+        Counter* scene_cuts = nullptr;
+        Counter* frames_static = nullptr;
+        Counter* tiles_dirty = nullptr;
+        Counter* tiles_reused = nullptr;
+        Gauge* roi_regions = nullptr;
+        Counter* sei_bytes = nullptr;
+        Gauge* busy_ratio = nullptr;
+        Gauge* resolution_rung = nullptr;
+        Counter* resolution_switches = nullptr;
+        Counter* frames_decimated = nullptr;
+        Histogram* reconfigure_in_place = nullptr;
+        Histogram* reconfigure_swap = nullptr;
+    };
+    
 private:
     std::unique_ptr<ImageProcessor> processor_ = std::make_unique<ImageProcessor>(); // 默认实例
     std::string rtmp_url_;
     int width_;
     int height_;
     int fps_;
-    int bitrate_;
+    std::string output_format_ = "flv";
+    EncoderSettings settings_;         // 当前编码器使用的参数
+    EncoderSettings target_settings_;  // 等待换编码器生效的参数（没有待换时与settings_相同）
+    int droppable_frames_ = 0;
+    int temporal_layers_ = 1;
+    AdaptiveResolutionOptions adaptive_options_;
+    AdaptiveGopOptions adaptive_gop_options_;
+    std::unique_ptr<SceneChangeDetector> scene_detector_;
+    StaticSceneOptions static_options_;
+    std::unique_ptr<StaticSceneDetector> static_detector_;
+    bool frame_ready_ = false;             // sws_frame_中是当前尺寸下完整处理过的帧（可重复提交）
+    TileTrackingOptions tile_options_;
+    std::unique_ptr<TileTracker> tile_tracker_;
+    cv::Mat tile_output_;                  // 分块处理模式下上一帧处理后的输出（用于覆盖没有变化的块）
+    RoiOptions roi_options_;
+    std::vector<ImageRegion> regions_;     // 最近一次处理的帧的关注区域
+    bool frame_sei_ = false;
+    std::string frame_metadata_;           // 最近一次处理的帧的元数据
+    uint32_t frames_skipped_ = 0;          // 上一个编码帧之后有意跳过的采集帧数（写入帧元数据SEI）
+    MotionOptions motion_options_;
+    MotionDetector::EventCallback motion_callback_;
+    std::unique_ptr<MotionDetector> motion_detector_;
+    PacketCallback packet_callback_;
     
     std::atomic<bool> running_{false};
     std::thread encoding_thread_;
@@ -128,12 +491,48 @@ private:
     ThreadSafeQueue<CameraFrame> input_queue_;
     
     // FFmpeg 上下文
-    AVFormatContext* fmt_ctx_ = nullptr;
     AVCodecContext* codec_ctx_ = nullptr;
-    AVStream* video_stream_ = nullptr;
+    std::vector<std::pair<std::string, OutputOptions>> extra_outputs_;
+    std::vector<std::string> backup_urls_;                 // 主目的地的备用接入地址
+    double pacing_multiplier_ = 0;                         // 主目的地发送限速倍数
+    std::vector<std::unique_ptr<OutputSender>> outputs_;   // outputs_[0]为主目的地
+    bool keyframe_requested_ = false;         // 下一帧强制编码为IDR
     SwsContext* rgb_ctx_ = nullptr;
     SwsContext* sws_ctx_ = nullptr;
     AVFrame* rgb_frame_ = nullptr;
     AVFrame* sws_frame_ = nullptr;
     int64_t pts_ = 0;
+
+    // 分辨率/帧率自适应（编码线程使用）
+    std::unique_ptr<ResolutionController> resolution_controller_;
+    std::atomic<size_t> resolution_rung_{0};
+    int encode_width_ = 0;                 // 当前编码尺寸
+    int encode_height_ = 0;
+    int frame_step_ = 1;                   // 每frame_step_个输入帧编码一帧
+    int frames_since_keyframe_ = 0;        // 当前GOP已编码的帧数
+    bool switch_pending_ = false;          // 等待GOP边界切换档位
+    size_t pending_rung_ = 0;
+    int switch_wait_frames_ = 0;
+    bool announce_extradata_ = false;      // 下一个关键帧附带序列头（换过编码器后，附带一次即清除）
+    int64_t busy_us_ = 0;                  // 本统计窗口内处理帧的时间
+    uint64_t congestion_seen_ = 0;         // 上次采样时主目的地的拥塞次数
+
+    // 运行中参数修改
+    std::mutex reconfig_mutex_;
+    EncoderReconfig pending_reconfig_;     // reconfigure()合并的待处理变更（受reconfig_mutex_保护）
+    int64_t pending_reconfig_us_ = 0;
+    std::atomic<bool> reconfig_pending_{false};
+    std::atomic<bool> external_keyframe_request_{false};
+    bool swap_pending_ = false;            // 等待GOP边界换编码器
+    std::string swap_change_;              // 待换编码器的变更内容
+    int64_t swap_requested_us_ = 0;
+    mutable std::mutex history_mutex_;
+    std::deque<EncoderChangeRecord> change_history_;
+    
+    FrameInfo frame_info_[kFrameInfoSlots];
+    
+    StreamMetrics metrics_;
+    int64_t rate_window_start_us_ = 0;
+    uint64_t rate_window_frames_ = 0;
+    uint64_t rate_window_bytes_ = 0;
 };
\ No newline at end of file
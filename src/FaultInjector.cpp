@@ -0,0 +1,193 @@
+#include "FaultInjector.h"
+#include "Logger.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+namespace {
+
+const char* const kPointNames[] = {
+    "capture.dqbuf",
+    "capture.timeout",
+    "capture.bytesused",
+    "encoder.send",
+    "encoder.receive",
+    "muxer.eagain",
+    "muxer.epipe",
+    "muxer.slow",
+};
+static_assert(sizeof(kPointNames) / sizeof(kPointNames[0]) == static_cast<size_t>(FaultPoint::Count),
+              "fault point names out of sync");
+
+// splitmix64：由（种子、故障点、流、经过次数）得到确定的伪随机数
+uint64_t mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// FNV-1a：流标识的哈希（与std::hash不同，跨平台、跨版本结果一致）
+uint64_t hash_stream(const std::string& stream) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : stream) {
+        h = (h ^ c) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+} // namespace
+
+FaultInjector& FaultInjector::instance() {
+    static FaultInjector injector;
+    return injector;
+}
+
+const char* FaultInjector::point_name(FaultPoint point) {
+    size_t index = static_cast<size_t>(point);
+    return index < kPoints ? kPointNames[index] : "unknown";
+}
+
+void FaultInjector::clear() {
+    active_.store(false, std::memory_order_release);
+    for (auto& rule : rules_) {
+        rule.trigger = Trigger::None;
+        rule.has_param = false;
+        rule.hits = 0;
+        rule.fired = 0;
+        std::lock_guard<std::mutex> lock(rule.mutex);
+        rule.stream_hits.clear();
+    }
+}
+
+bool FaultInjector::configure(const std::string& spec, uint64_t seed) {
+    clear();
+    seed_ = seed;
+    std::stringstream ss(spec);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) continue;
+        if (!parse_rule(item)) {
+            LOG_ERROR("FaultInjector", "Bad fault rule: %s", item.c_str());
+            clear();
+            return false;
+        }
+    }
+    bool any = false;
+    for (const auto& rule : rules_) any = any || rule.trigger != Trigger::None;
+    active_.store(any, std::memory_order_release);
+    if (any) {
+        LOG_WARN("FaultInjector", "Fault injection active (seed %llu): %s",
+                 static_cast<unsigned long long>(seed), spec.c_str());
+    }
+    return true;
+}
+
+bool FaultInjector::parse_rule(const std::string& text) {
+    size_t at = text.find('@');
+    if (at == std::string::npos) return false;
+    std::string point = text.substr(0, at);
+    std::string trigger = text.substr(at + 1);
+
+    int param = 0;
+    bool has_param = false;
+    size_t eq = point.find('=');
+    if (eq != std::string::npos) {
+        param = atoi(point.c_str() + eq + 1);
+        has_param = true;
+        point.resize(eq);
+    }
+
+    size_t index = 0;
+    while (index < kPoints && point != kPointNames[index]) ++index;
+    if (index == kPoints) return false;
+    Rule& rule = rules_[index];
+
+    unsigned long long a = 0, b = 0;
+    double p = 0;
+    if (sscanf(trigger.c_str(), "p=%lf", &p) == 1 && p >= 0 && p <= 1) {
+        rule.trigger = Trigger::Probability;
+        rule.probability = p;
+    } else if (sscanf(trigger.c_str(), "every=%llu", &a) == 1 && a > 0) {
+        rule.trigger = Trigger::Every;
+        rule.every = a;
+    } else if (sscanf(trigger.c_str(), "at=%llu", &a) == 1) {
+        rule.trigger = Trigger::Range;
+        rule.from = rule.to = a;
+    } else if (sscanf(trigger.c_str(), "from=%llu-%llu", &a, &b) == 2 && a <= b) {
+        rule.trigger = Trigger::Range;
+        rule.from = a;
+        rule.to = b;
+    } else {
+        return false;
+    }
+    rule.param = param;
+    rule.has_param = has_param;
+    return true;
+}
+
+bool FaultInjector::should_fire(FaultPoint point, const std::string& stream) {
+    if (!active_.load(std::memory_order_acquire)) return false;
+    Rule& rule = rules_[static_cast<size_t>(point)];
+    if (rule.trigger == Trigger::None) return false;
+
+    // 每一路流的经过次数各自从1开始计，多路流并发时互不影响
+    uint64_t key = hash_stream(stream);
+    uint64_t n;
+    {
+        std::lock_guard<std::mutex> lock(rule.mutex);
+        n = ++rule.stream_hits[key];
+    }
+    rule.hits.fetch_add(1, std::memory_order_relaxed);
+    bool fire = false;
+    switch (rule.trigger) {
+    case Trigger::Probability: {
+        uint64_t r = mix(seed_ ^ mix(key ^ mix((static_cast<uint64_t>(point) << 56) ^ n)));
+        fire = (r >> 11) * (1.0 / 9007199254740992.0) < rule.probability;
+        break;
+    }
+    case Trigger::Every:
+        fire = n % rule.every == 0;
+        break;
+    case Trigger::Range:
+        fire = n >= rule.from && n <= rule.to;
+        break;
+    case Trigger::None:
+        break;
+    }
+    if (fire) {
+        rule.fired.fetch_add(1, std::memory_order_relaxed);
+    }
+    return fire;
+}
+
+int FaultInjector::param(FaultPoint point, int default_value) const {
+    const Rule& rule = rules_[static_cast<size_t>(point)];
+    return rule.has_param ? rule.param : default_value;
+}
+
+uint64_t FaultInjector::hits(FaultPoint point) const {
+    return rules_[static_cast<size_t>(point)].hits.load(std::memory_order_relaxed);
+}
+
+uint64_t FaultInjector::fired(FaultPoint point) const {
+    return rules_[static_cast<size_t>(point)].fired.load(std::memory_order_relaxed);
+}
+
+uint64_t FaultInjector::total_fired() const {
+    uint64_t total = 0;
+    for (const auto& rule : rules_) total += rule.fired.load(std::memory_order_relaxed);
+    return total;
+}
+
+std::string FaultInjector::summary() const {
+    std::ostringstream out;
+    for (size_t i = 0; i < kPoints; ++i) {
+        const Rule& rule = rules_[i];
+        if (rule.trigger == Trigger::None) continue;
+        if (out.tellp() > 0) out << ' ';
+        out << kPointNames[i] << ' ' << rule.fired.load() << '/' << rule.hits.load();
+    }
+    return out.str();
+}
@@ -0,0 +1,128 @@
+#pragma once
+/**
+ * @file FaultInjector.h
+ * @class FaultInjector
+ * @brief 故障注入框架（采集、编码、输出路径）
+ *
+ * 在CameraCapture::get_frame、EncoderStreamer::encode_and_send_frame和muxer写入处
+ * 放置编译期开关控制的故障点（FAULT_POINT宏），按“调度表”决定某一路流第N次经过某个故障点时是否触发，
+ * 用于在没有故障硬件的情况下验证流水线的降级行为。
+ *
+ * 调度表语法（逗号分隔多条规则）：
+ *   <故障点>[=<参数>]@<触发条件>
+ *   触发条件：p=0.01        每次经过以1%概率触发
+ *             every=100     每第100次触发
+ *             at=300        仅第300次触发
+ *             from=300-320  第300~320次触发
+ * 例：capture.dqbuf@p=0.01,muxer.slow=200@every=50,encoder.send@from=300-320
+ *
+ * 经过次数按（故障点、流）分别计数，流由调用点传入的标识区分（摄像头设备路径、推流地址），
+ * 触发条件对每一路流独立生效（every=100即每一路流各自每第100次触发）。
+ * 概率触发的判定只取决于（种子、故障点、流标识、经过次数），与线程调度和其他流、其他故障点无关，
+ * 同一种子、同一调度表、同样的流配置，每次运行每一路流的触发序列完全一致，多路基准测试中的故障场景也可复现。
+ *
+ * 故障点只在定义ENABLE_FAULT_INJECTION（CMake选项同名）时编译进代码，否则FAULT_POINT恒为false。
+ * configure()需在流水线线程启动前调用。
+ */
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+enum class FaultPoint : uint8_t {
+    CaptureDqbuf = 0,    // capture.dqbuf     DQBUF返回EIO
+    CaptureTimeout,      // capture.timeout   select超时
+    CaptureBytesUsed,    // capture.bytesused bytesused被破坏（参数：0置零，否则截为一半）
+    EncoderSend,         // encoder.send      avcodec_send_frame失败
+    EncoderReceive,      // encoder.receive   avcodec_receive_packet失败
+    MuxerEagain,         // muxer.eagain      写入返回EAGAIN
+    MuxerEpipe,          // muxer.epipe       写入返回EPIPE（连接断开）
+    MuxerSlow,           // muxer.slow        写入前阻塞（参数：毫秒，默认100）
+    Count
+};
+
+class FaultInjector {
+public:
+    /**
+     * @brief 获取全局实例
+     */
+    static FaultInjector& instance();
+
+    /**
+     * @brief 加载调度表并清零统计
+     * @param spec 调度表，空字符串表示不注入
+     * @param seed 随机种子
+     * @return 语法正确返回true，否则返回false（此时不注入任何故障）
+     */
+    bool configure(const std::string& spec, uint64_t seed);
+
+    /**
+     * @brief 清除调度表
+     */
+    void clear();
+
+    /**
+     * @brief 经过故障点，判断本次是否触发（热路径）
+     * @param point 故障点
+     * @param stream 流标识（摄像头设备路径、推流地址），经过次数按流分别计数
+     */
+    bool should_fire(FaultPoint point, const std::string& stream);
+
+    /**
+     * @brief 故障点参数（未配置时返回default_value）
+     */
+    int param(FaultPoint point, int default_value) const;
+
+    /**
+     * @brief 统计：经过次数、触发次数（所有流合计）
+     */
+    uint64_t hits(FaultPoint point) const;
+    uint64_t fired(FaultPoint point) const;
+    uint64_t total_fired() const;
+
+    /**
+     * @brief 生成统计摘要，如"capture.dqbuf 12/1200 muxer.slow 24/1180"
+     */
+    std::string summary() const;
+
+    /**
+     * @brief 故障点名称
+     */
+    static const char* point_name(FaultPoint point);
+
+private:
+    FaultInjector() = default;
+
+    enum class Trigger : uint8_t { None, Probability, Every, Range };
+
+    struct Rule {
+        Trigger trigger = Trigger::None;
+        double probability = 0;
+        uint64_t every = 0;
+        uint64_t from = 0;
+        uint64_t to = 0;
+        int param = 0;
+        bool has_param = false;
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> fired{0};
+        std::mutex mutex;
+        std::unordered_map<uint64_t, uint64_t> stream_hits;  // 流标识的哈希 -> 该流的经过次数
+    };
+
+    bool parse_rule(const std::string& text);
+
+private:
+    static constexpr size_t kPoints = static_cast<size_t>(FaultPoint::Count);
+    Rule rules_[kPoints];
+    uint64_t seed_ = 0;
+    std::atomic<bool> active_{false};
+};
+
+#ifdef ENABLE_FAULT_INJECTION
+#define FAULT_POINT(point, stream) FaultInjector::instance().should_fire(FaultPoint::point, (stream))
+#define FAULT_PARAM(point, default_value) FaultInjector::instance().param(FaultPoint::point, (default_value))
+#else
+#define FAULT_POINT(point, stream) false
+#define FAULT_PARAM(point, default_value) (default_value)
+#endif
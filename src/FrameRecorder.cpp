@@ -0,0 +1,220 @@
+#include "FrameRecorder.h"
+#include "Logger.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+namespace {
+
+uint64_t align_up(uint64_t value) {
+    return (value + kRawRecordAlign - 1) & ~(kRawRecordAlign - 1);
+}
+
+} // namespace
+
+FrameRecorder::FrameRecorder(const std::string& path, size_t max_pending)
+    : path_(path), max_pending_(max_pending ? max_pending : 1) {
+    memset(&header_, 0, sizeof(header_));
+}
+
+FrameRecorder::~FrameRecorder() {
+    close();
+}
+
+bool FrameRecorder::open() {
+    if (fd_ >= 0) return true;
+
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        LOG_ERROR("FrameRecorder", "Cannot create %s: %s", path_.c_str(), strerror(errno));
+        return false;
+    }
+
+    timeval now;
+    gettimeofday(&now, nullptr);
+    memset(&header_, 0, sizeof(header_));
+    memcpy(header_.magic, kRawCaptureMagic, sizeof(header_.magic));
+    header_.version = kRawCaptureVersion;
+    header_.header_size = static_cast<uint32_t>(kRawCaptureAlign);
+    header_.start_time_us = static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_usec;
+    format_set_ = false;
+
+    // 先写一页占位文件头：第一帧写盘前写入格式字段，close()时回填帧数和索引偏移
+    std::vector<uint8_t> page(kRawCaptureAlign, 0);
+    memcpy(page.data(), &header_, sizeof(header_));
+    if (!write_all(page.data(), page.size())) {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    write_offset_ = kRawCaptureAlign;
+    index_.clear();
+    header_written_ = false;
+    write_failed_ = false;
+    stopping_ = false;
+    recorded_ = 0;
+    dropped_ = 0;
+
+    thread_ = std::thread(&FrameRecorder::writer_thread, this);
+    LOG_INFO("FrameRecorder", "Recording raw frames to %s", path_.c_str());
+    return true;
+}
+
+bool FrameRecorder::record(const CameraFrame& frame) {
+    if (!frame.data) return false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (fd_ < 0 || stopping_ || write_failed_) return false;
+
+    if (!format_set_) {
+        header_.width = frame.width;
+        header_.height = frame.height;
+        header_.stride = frame.stride;
+        header_.pixel_format = frame.pixel_format;
+        header_.buffer_length = static_cast<uint32_t>(frame.length);
+        header_.camera_id = frame.camera_id;
+        format_set_ = true;
+    } else if (frame.width != header_.width || frame.height != header_.height ||
+               frame.pixel_format != header_.pixel_format) {
+        ++dropped_;
+        LOG_WARN_EVERY_MS_FOR("FrameRecorder", path_, 1000, "Frame format changed mid-recording, frame dropped: %s",
+                              path_.c_str());
+        return false;
+    }
+
+    if (pending_.size() >= max_pending_) {
+        ++dropped_;
+        LOG_WARN_EVERY_MS_FOR("FrameRecorder", path_, 1000, "Disk writer falling behind, frame dropped: %s",
+                              path_.c_str());
+        return false;
+    }
+
+    PendingFrame pending;
+    if (!spare_buffers_.empty()) {
+        pending.data.swap(spare_buffers_.back());
+        spare_buffers_.pop_back();
+    }
+    lock.unlock();
+
+    // 拷贝在锁外进行，写盘线程不会因大块拷贝被阻塞
+    size_t bytes = frame.bytes_used ? frame.bytes_used : frame.length;
+    pending.data.resize(bytes);
+    memcpy(pending.data.data(), frame.data, bytes);
+    memset(&pending.record, 0, sizeof(pending.record));
+    pending.record.magic = kRawFrameMagic;
+    pending.record.sequence = frame.sequence;
+    pending.record.timestamp_us = static_cast<int64_t>(frame.timestamp.tv_sec) * 1000000 +
+                                  frame.timestamp.tv_usec;
+    pending.record.bytes_used = bytes;
+    pending.record.record_size = kRawFrameDataOffset + align_up(bytes);
+
+    lock.lock();
+    pending_.push_back(std::move(pending));
+    lock.unlock();
+    cond_.notify_one();
+    return true;
+}
+
+void FrameRecorder::writer_thread() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        cond_.wait(lock, [this] { return stopping_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            if (stopping_) break;
+            continue;
+        }
+
+        PendingFrame frame = std::move(pending_.front());
+        pending_.pop_front();
+        lock.unlock();
+
+        bool ok = write_frame(frame);
+
+        lock.lock();
+        if (!ok) {
+            write_failed_ = true;
+            dropped_ += pending_.size();
+            pending_.clear();
+        }
+        spare_buffers_.push_back(std::move(frame.data));
+    }
+}
+
+bool FrameRecorder::write_header() {
+    if (pwrite(fd_, &header_, sizeof(header_), 0) != static_cast<ssize_t>(sizeof(header_))) {
+        LOG_ERROR("FrameRecorder", "Cannot update header of %s: %s", path_.c_str(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+bool FrameRecorder::write_frame(const PendingFrame& frame) {
+    // 格式在第一帧入队前已确定：立即写入文件头，录制中断（崩溃、被杀）后按记录扫描仍可回放
+    if (!header_written_) {
+        if (!write_header()) return false;
+        header_written_ = true;
+    }
+
+    // 记录头补齐到kRawFrameDataOffset，数据末尾补零到kRawRecordAlign边界
+    static const uint8_t zero_pad[kRawRecordAlign] = {};
+    uint8_t head[kRawFrameDataOffset];
+    memset(head, 0, sizeof(head));
+    memcpy(head, &frame.record, sizeof(frame.record));
+
+    uint64_t padding = align_up(frame.record.bytes_used) - frame.record.bytes_used;
+    if (!write_all(head, sizeof(head)) ||
+        !write_all(frame.data.data(), frame.data.size()) ||
+        (padding && !write_all(zero_pad, padding))) {
+        return false;
+    }
+
+    index_.push_back(write_offset_);
+    write_offset_ += frame.record.record_size;
+    ++recorded_;
+    return true;
+}
+
+bool FrameRecorder::write_all(const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    while (len > 0) {
+        ssize_t n = ::write(fd_, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("FrameRecorder", "Write to %s failed: %s", path_.c_str(), strerror(errno));
+            return false;
+        }
+        p += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void FrameRecorder::close() {
+    if (fd_ < 0) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cond_.notify_one();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    // 追加索引并回填文件头；写失败时保留index_offset为0，回放端按记录扫描
+    if (!write_failed_) {
+        header_.frame_count = index_.size();
+        header_.index_offset = write_offset_;
+        if (write_all(index_.data(), index_.size() * sizeof(uint64_t))) {
+            write_header();
+        }
+    }
+
+    ::close(fd_.exchange(-1));
+    spare_buffers_.clear();
+    LOG_INFO("FrameRecorder", "Recorded %llu frames to %s (%llu dropped)",
+             static_cast<unsigned long long>(recorded_.load()), path_.c_str(),
+             static_cast<unsigned long long>(dropped_.load()));
+}
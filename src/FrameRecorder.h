@@ -0,0 +1,121 @@
+#pragma once
+/**
+ * @file FrameRecorder.h
+ * @class FrameRecorder
+ * @brief 原始采集录制器
+ *
+ * 把帧源交付的原始缓冲区（bytes_used字节）连同timestamp、sequence、格式信息
+ * 原样写入.rcap文件（格式见RawCaptureFormat.h），供ReplaySource回放复现现场问题。
+ *
+ * record()只做一次内存拷贝并入队，磁盘写入在独立线程完成，不会拖慢采集线程；
+ * 写入跟不上时丢弃新帧并计数，不会阻塞调用方，也不会长时间占用V4L2缓冲区。
+ *
+ * 典型用法：
+ * @code
+ * FrameRecorder recorder("/data/cam0.rcap");
+ * recorder.open();
+ * cam.set_frame_callback([&](const CameraFrame& frame) {
+ *     recorder.record(frame);
+ *     stream.push_frame(frame);
+ * });
+ * ...
+ * recorder.close();
+ * @endcode
+ */
+#include "FrameSource.h"
+#include "RawCaptureFormat.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FrameRecorder {
+public:
+    /**
+     * @brief 构造函数
+     * @param path 输出文件路径
+     * @param max_pending 等待写盘的最大帧数，超过后丢弃新帧
+     */
+    explicit FrameRecorder(const std::string& path, size_t max_pending = 16);
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    /**
+     * @brief 创建输出文件并启动写盘线程
+     * @return 成功返回true，失败返回false
+     */
+    bool open();
+
+    /**
+     * @brief 录制一帧（拷贝数据后立即返回，不调用frame.return_buffer）
+     * @param frame 帧源交付的帧，第一帧决定文件的分辨率和像素格式
+     * @return 入队成功返回true；未打开、格式与首帧不一致或队列已满返回false
+     */
+    bool record(const CameraFrame& frame);
+
+    /**
+     * @brief 写完所有待写帧，写入索引并更新文件头
+     */
+    void close();
+
+    bool is_open() const { return fd_ >= 0; }
+    uint64_t recorded_frames() const { return recorded_; }
+    uint64_t dropped_frames() const { return dropped_; }
+    const std::string& path() const { return path_; }
+
+private:
+    struct PendingFrame {
+        RawFrameRecord record;
+        std::vector<uint8_t> data;
+    };
+
+    /**
+     * @brief 写盘线程：取出待写帧，按kRawRecordAlign对齐写入记录头和数据
+     */
+    void writer_thread();
+
+    /**
+     * @brief 把当前文件头写回文件开头（写盘线程写第一帧前、close()时调用）
+     * @return 成功返回true，失败返回false
+     */
+    bool write_header();
+
+    /**
+     * @brief 写入一帧记录
+     * @return 成功返回true，失败返回false
+     */
+    bool write_frame(const PendingFrame& frame);
+
+    /**
+     * @brief 完整写入len字节（处理部分写和EINTR）
+     */
+    bool write_all(const void* data, size_t len);
+
+private:
+    std::string path_;
+    size_t max_pending_;
+    std::atomic<int> fd_{-1};
+
+    RawCaptureHeader header_;
+    bool format_set_ = false;
+    bool header_written_ = false;  // 格式字段已写入文件头（写盘线程使用）
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<PendingFrame> pending_;
+    std::vector<std::vector<uint8_t>> spare_buffers_;  // 复用帧数据缓冲区，避免每帧分配
+    bool stopping_ = false;
+
+    uint64_t write_offset_ = 0;
+    std::vector<uint64_t> index_;
+    bool write_failed_ = false;
+
+    std::atomic<uint64_t> recorded_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
@@ -0,0 +1,165 @@
+#include "FrameSei.h"
+#include <algorithm>
+
+const uint8_t kFrameSeiUuid[16] = {
+    0x6b, 0x1c, 0x3e, 0x52, 0x9d, 0x47, 0x4f, 0x0a, 0xb5, 0x61, 0x2e, 0x8f, 0x73, 0xc4, 0x19, 0xd6,
+};
+
+namespace {
+
+constexpr uint8_t kNalSei = 6;
+constexpr uint8_t kSeiUserDataUnregistered = 5;
+constexpr uint8_t kPayloadVersion = 1;
+constexpr size_t kFixedPayloadSize = 32;
+
+void put_be(std::vector<uint8_t>& out, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) {
+        out.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+}
+
+uint64_t get_be(const uint8_t* data, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+size_t find_start_code(const uint8_t* data, size_t size, size_t pos) {
+    for (; pos + 3 <= size; ++pos) {
+        if (data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1) return pos + 3;
+    }
+    return size;
+}
+
+bool is_annexb(const uint8_t* data, size_t size) {
+    return (size >= 3 && data[0] == 0 && data[1] == 0 && data[2] == 1) ||
+           (size >= 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1);
+}
+
+bool parse_payload(const uint8_t* payload, size_t size, FrameSeiData* out) {
+    if (size < 16 + kFixedPayloadSize) return false;
+    for (int i = 0; i < 16; ++i) {
+        if (payload[i] != kFrameSeiUuid[i]) return false;
+    }
+    const uint8_t* p = payload + 16;
+    if (p[0] != kPayloadVersion) return false;
+    size_t blob_size = static_cast<size_t>(get_be(p + 30, 2));
+    if (16 + kFixedPayloadSize + blob_size > size) return false;
+    out->skipped = p[1];
+    out->camera_id = static_cast<int32_t>(get_be(p + 2, 4));
+    out->sequence = static_cast<uint32_t>(get_be(p + 6, 4));
+    out->capture_us = static_cast<int64_t>(get_be(p + 10, 8));
+    out->capture_wall_us = static_cast<int64_t>(get_be(p + 18, 8));
+    out->pipeline_us = static_cast<uint32_t>(get_be(p + 26, 4));
+    out->blob.assign(reinterpret_cast<const char*>(p + kFixedPayloadSize), blob_size);
+    return true;
+}
+
+// 解析一个SEI NAL（从NAL头开始，不含起始码）
+bool parse_sei_nal(const uint8_t* nal, size_t size, FrameSeiData* out) {
+    if (size < 2 || (nal[0] & 0x1f) != kNalSei) return false;
+    // 去掉防竞争字节得到RBSP
+    std::vector<uint8_t> rbsp;
+    rbsp.reserve(size);
+    int zeros = 0;
+    for (size_t i = 1; i < size; ++i) {
+        if (zeros >= 2 && nal[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        zeros = nal[i] == 0 ? zeros + 1 : 0;
+        rbsp.push_back(nal[i]);
+    }
+
+    size_t pos = 0;
+    while (pos < rbsp.size() && rbsp[pos] != 0x80) {
+        size_t type = 0;
+        while (pos < rbsp.size() && rbsp[pos] == 0xff) type += rbsp[pos++];
+        if (pos >= rbsp.size()) return false;
+        type += rbsp[pos++];
+        size_t payload_size = 0;
+        while (pos < rbsp.size() && rbsp[pos] == 0xff) payload_size += rbsp[pos++];
+        if (pos >= rbsp.size()) return false;
+        payload_size += rbsp[pos++];
+        if (payload_size > rbsp.size() - pos) return false;
+        if (type == kSeiUserDataUnregistered && parse_payload(&rbsp[pos], payload_size, out)) return true;
+        pos += payload_size;
+    }
+    return false;
+}
+
+} // namespace
+
+std::vector<uint8_t> build_frame_sei(const FrameSeiData& data) {
+    size_t blob_size = std::min(data.blob.size(), kMaxFrameSeiBlob);
+    std::vector<uint8_t> payload(kFrameSeiUuid, kFrameSeiUuid + 16);
+    payload.reserve(16 + kFixedPayloadSize + blob_size);
+    payload.push_back(kPayloadVersion);
+    payload.push_back(data.skipped);
+    put_be(payload, static_cast<uint32_t>(data.camera_id), 4);
+    put_be(payload, data.sequence, 4);
+    put_be(payload, static_cast<uint64_t>(data.capture_us), 8);
+    put_be(payload, static_cast<uint64_t>(data.capture_wall_us), 8);
+    put_be(payload, data.pipeline_us, 4);
+    put_be(payload, blob_size, 2);
+    payload.insert(payload.end(), data.blob.begin(), data.blob.begin() + blob_size);
+
+    std::vector<uint8_t> rbsp;
+    rbsp.push_back(kSeiUserDataUnregistered);
+    size_t remaining = payload.size();
+    for (; remaining >= 255; remaining -= 255) rbsp.push_back(0xff);
+    rbsp.push_back(static_cast<uint8_t>(remaining));
+    rbsp.insert(rbsp.end(), payload.begin(), payload.end());
+    rbsp.push_back(0x80);  // rbsp_trailing_bits
+
+    std::vector<uint8_t> nal = {0, 0, 0, 1, kNalSei};
+    nal.reserve(nal.size() + rbsp.size() + rbsp.size() / 64);
+    int zeros = 0;
+    for (uint8_t byte : rbsp) {
+        if (zeros >= 2 && byte <= 0x03) {
+            nal.push_back(0x03);  // emulation_prevention_three_byte
+            zeros = 0;
+        }
+        zeros = byte == 0 ? zeros + 1 : 0;
+        nal.push_back(byte);
+    }
+    return nal;
+}
+
+size_t h264_sei_insert_offset(const uint8_t* data, size_t size) {
+    if (!is_annexb(data, size)) return size;
+    for (size_t pos = find_start_code(data, size, 0); pos < size; pos = find_start_code(data, size, pos)) {
+        uint8_t type = data[pos] & 0x1f;
+        if (type >= 1 && type <= 5) {
+            // 回到起始码开头（4字节起始码多一个0）
+            size_t start = pos - 3;
+            return start > 0 && data[start - 1] == 0 ? start - 1 : start;
+        }
+    }
+    return size;
+}
+
+bool find_frame_sei(const uint8_t* data, size_t size, FrameSeiData* out) {
+    if (!data || !out) return false;
+    if (is_annexb(data, size)) {
+        size_t pos = find_start_code(data, size, 0);
+        while (pos < size) {
+            size_t next = find_start_code(data, size, pos);
+            size_t end = next < size ? next - 3 : size;
+            while (end > pos && data[end - 1] == 0) --end;  // 下一个起始码前的0（4字节起始码/trailing_zero）
+            if (parse_sei_nal(data + pos, end - pos, out)) return true;
+            pos = next;
+        }
+        return false;
+    }
+    size_t pos = 0;
+    while (pos + 4 < size) {
+        size_t length = static_cast<size_t>(get_be(data + pos, 4));
+        if (length == 0 || length > size - pos - 4) break;
+        if (parse_sei_nal(data + pos + 4, length, out)) return true;
+        pos += 4 + length;
+    }
+    return false;
+}
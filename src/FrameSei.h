@@ -0,0 +1,62 @@
+#pragma once
+/**
+ * @file FrameSei.h
+ * @brief 随H.264码流传递的逐帧元数据（user data unregistered SEI）
+ *
+ * EncoderStreamer::set_frame_sei()开启后，每个编码包的第一个视频slice之前插入一个SEI NAL（payloadType 5），
+ * 内容为kFrameSeiUuid加上以下字段（大端）：
+ *
+ *   偏移  长度  字段
+ *   0     1     版本（当前为1）
+ *   1     1     skipped           上一个编码帧之后有意跳过的采集帧数（降帧率档位、静止画面Drop模式，最大255）
+ *   2     4     camera_id
+ *   6     4     sequence
+ *   10    8     capture_us        设备上的采集时间（CLOCK_MONOTONIC微秒）
+ *   18    8     capture_wall_us   采集时间换算成的系统时间（Unix纪元微秒）
+ *   26    4     pipeline_us       设备上从采集到得到编码包的耗时
+ *   30    2     blob长度
+ *   32    n     处理器提供的元数据（ImageProcessor::frameMetadata()，如检测结果）
+ *
+ * 同一摄像头相邻两帧的sequence差减1再减去skipped，才是采集后、编码前真正丢掉的帧数。
+ * 接收端和设备的系统时钟同步（NTP/PTP）时，接收时间 - capture_wall_us即为端到端延迟；
+ * 解析工具见tools/sei_latency.cpp。Annex B和AVCC（4字节长度前缀）格式的包都可以解析。
+ */
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern const uint8_t kFrameSeiUuid[16];
+
+constexpr size_t kMaxFrameSeiBlob = 1024;
+
+// 一帧的元数据
+struct FrameSeiData {
+    int camera_id = 0;
+    uint32_t sequence = 0;
+    uint8_t skipped = 0;          // 上一个编码帧之后有意跳过的帧数
+    int64_t capture_us = 0;
+    int64_t capture_wall_us = 0;
+    uint32_t pipeline_us = 0;
+    std::string blob;             // 超过kMaxFrameSeiBlob的部分不写入
+};
+
+/**
+ * @brief 生成SEI NAL单元（4字节起始码 + NAL头 + 加入防竞争字节的RBSP）
+ */
+std::vector<uint8_t> build_frame_sei(const FrameSeiData& data);
+
+/**
+ * @brief Annex B编码包中SEI的插入位置（第一个视频slice的起始码）
+ * @return 插入偏移；不是Annex B或没有视频slice时返回size
+ */
+size_t h264_sei_insert_offset(const uint8_t* data, size_t size);
+
+/**
+ * @brief 在一个编码包（访问单元）中查找并解析帧元数据SEI
+ * @param data 包数据（Annex B或AVCC）
+ * @param size 包大小
+ * @param out 输出
+ * @return 找到返回true
+ */
+bool find_frame_sei(const uint8_t* data, size_t size, FrameSeiData* out);
@@ -0,0 +1,79 @@
+#pragma once
+/**
+ * @file FrameSource.h
+ * @class FrameSource
+ * @brief 帧源抽象接口
+ *
+ * 统一真实摄像头（CameraCapture）、合成帧源（SyntheticSource）、录制回放（ReplaySource）等的使用方式，
+ * 使EncoderStreamer和基准测试工具无需关心帧来自哪里。
+ *
+ * 所有实现都遵循与V4L2相同的缓冲区语义：回调拿到的CameraFrame在调用
+ * return_buffer()之前一直占用源内部的一个缓冲区，缓冲区耗尽时源无法再产出新帧。
+ */
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <sys/time.h>
+
+// 摄像头帧数据结构
+struct CameraFrame {
+    int camera_id;          // 摄像头标识
+    int buf_index;          // buf 索引
+    int fd;                 // DMA-BUF文件描述符
+    void* data;             // 内存映射地址指针
+    size_t length;          // 数据长度
+    size_t bytes_used;      // 实际使用字节数
+    uint32_t width;         // 图像宽度
+    uint32_t height;        // 图像高度
+    uint32_t stride;        // 步长
+    uint32_t pixel_format;  // 像素格式 (V4L2_PIX_FMT_*)
+    timeval timestamp;      // 时间戳
+    uint32_t sequence;      // 帧序列号
+    uint64_t trace_id = 0;  // 帧追踪ID（0表示未开启追踪，见FrameTrace.h）
+    std::function<void()> return_buffer; //释放缓冲回调
+};
+
+class FrameSource {
+public:
+    using FrameCallback = std::function<void(const CameraFrame&)>;
+
+    virtual ~FrameSource() = default;
+
+    /**
+     * @brief 初始化帧源
+     * @return 成功返回true，失败返回false
+     */
+    virtual bool initialize() = 0;
+
+    /**
+     * @brief 开始产出帧（在内部线程中调用帧回调）
+     */
+    virtual void start() = 0;
+
+    /**
+     * @brief 停止产出帧
+     */
+    virtual void stop() = 0;
+
+    /**
+     * @brief 设置帧回调
+     */
+    virtual void set_frame_callback(const FrameCallback& callback) = 0;
+    virtual void set_frame_callback(FrameCallback&& callback) = 0;
+
+    /**
+     * @brief 获取当前运行状态
+     */
+    virtual bool is_running() const = 0;
+
+    /**
+     * @brief 设置/获取帧源ID（写入CameraFrame::camera_id）
+     */
+    virtual void set_camera_id(int id) = 0;
+    virtual int get_camera_id() const = 0;
+
+    /**
+     * @brief 因没有空闲缓冲区而丢失的帧数（不支持统计的实现返回0）
+     */
+    virtual uint64_t dropped_frames() const { return 0; }
+};
@@ -0,0 +1,222 @@
+#include "FrameTrace.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <set>
+#include <unordered_map>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+int64_t monotonic_ns() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// 二进制格式头部
+struct BinaryHeader {
+    char magic[4];          // "FTRC"
+    uint32_t version;
+    uint32_t thread_count;
+    uint32_t event_size;    // sizeof(TraceEvent)，便于解析端校验
+};
+
+} // namespace
+
+static_assert((FrameTracer::kEventsPerThread & (FrameTracer::kEventsPerThread - 1)) == 0,
+              "kEventsPerThread must be a power of two");
+
+FrameTracer& FrameTracer::instance() {
+    static FrameTracer tracer;
+    return tracer;
+}
+
+const char* FrameTracer::stage_name(TraceStage stage) {
+    switch (stage) {
+        case TraceStage::Dqbuf:          return "Dqbuf";
+        case TraceStage::QueuePush:      return "QueuePush";
+        case TraceStage::QueuePop:       return "QueuePop";
+        case TraceStage::ConvertDone:    return "ConvertDone";
+        case TraceStage::ProcessDone:    return "ProcessDone";
+        case TraceStage::EncoderSend:    return "EncoderSend";
+        case TraceStage::PacketReceived: return "PacketReceived";
+        case TraceStage::MuxerWrite:     return "MuxerWrite";
+        default:                         return "Unknown";
+    }
+}
+
+FrameTracer::ThreadBuffer* FrameTracer::thread_buffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        auto owned = std::make_shared<ThreadBuffer>();
+        owned->tid = static_cast<int>(syscall(SYS_gettid));
+        std::lock_guard<std::mutex> lock(buffers_mutex_);
+        buffers_.push_back(owned);
+        buffer = owned.get();
+    }
+    return buffer;
+}
+
+void FrameTracer::record_event(uint64_t trace_id, TraceStage stage, int camera_id) {
+    ThreadBuffer* buffer = thread_buffer();
+    uint64_t pos = buffer->write_pos.load(std::memory_order_relaxed);
+    size_t slot = pos & (kEventsPerThread - 1);
+    // 先把槽位标记为写入中，导出线程据此丢弃拷贝期间被覆盖的事件（每槽位一个seqlock）
+    buffer->commits[slot].store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceEvent& ev = buffer->events[slot];
+    ev.trace_id = trace_id;
+    ev.timestamp_ns = monotonic_ns();
+    ev.camera_id = camera_id;
+    ev.stage = static_cast<uint8_t>(stage);
+    buffer->commits[slot].store(pos + 1, std::memory_order_release);
+    buffer->write_pos.store(pos + 1, std::memory_order_release);
+}
+
+void FrameTracer::snapshot(std::vector<std::pair<int, std::vector<TraceEvent>>>& out) {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    out.clear();
+    out.reserve(buffers_.size());
+    for (const auto& buffer : buffers_) {
+        uint64_t end = buffer->write_pos.load(std::memory_order_acquire);
+        uint64_t begin = std::max(buffer->start_pos.load(std::memory_order_relaxed),
+                                  end > kEventsPerThread ? end - kEventsPerThread : 0);
+        std::vector<TraceEvent> events;
+        events.reserve(end - begin);
+        for (uint64_t i = begin; i < end; ++i) {
+            size_t slot = i & (kEventsPerThread - 1);
+            // 拷贝前后提交序号都必须是i + 1：否则该槽位已被（或正在被）新事件覆盖
+            uint64_t commit = buffer->commits[slot].load(std::memory_order_acquire);
+            if (commit != i + 1) continue;
+            TraceEvent ev = buffer->events[slot];
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (buffer->commits[slot].load(std::memory_order_relaxed) != commit) continue;
+            events.push_back(ev);
+        }
+        out.emplace_back(buffer->tid, std::move(events));
+    }
+}
+
+void FrameTracer::clear() {
+    std::lock_guard<std::mutex> lock(buffers_mutex_);
+    for (const auto& buffer : buffers_) {
+        buffer->start_pos.store(buffer->write_pos.load(std::memory_order_acquire),
+                                std::memory_order_relaxed);
+    }
+}
+
+bool FrameTracer::dump_chrome_json(const std::string& path) {
+    std::vector<std::pair<int, std::vector<TraceEvent>>> threads;
+    snapshot(threads);
+
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+
+    // 按trace_id分组，用于生成跨线程的异步区间
+    struct Point {
+        int64_t timestamp_ns;
+        uint8_t stage;
+        int camera_id;
+    };
+    std::unordered_map<uint64_t, std::vector<Point>> frames;
+    std::set<int> cameras;
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    auto separator = [&]() {
+        if (!first) fputs(",\n", fp);
+        first = false;
+    };
+
+    for (const auto& thread : threads) {
+        for (const auto& ev : thread.second) {
+            separator();
+            fprintf(fp, "{\"name\":\"%s\",\"cat\":\"stage\",\"ph\":\"i\",\"s\":\"t\","
+                        "\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"trace_id\":%" PRIu64 "}}",
+                    stage_name(static_cast<TraceStage>(ev.stage)), ev.timestamp_ns / 1000.0,
+                    ev.camera_id, thread.first, ev.trace_id);
+            frames[ev.trace_id].push_back(Point{ev.timestamp_ns, ev.stage, ev.camera_id});
+            cameras.insert(ev.camera_id);
+        }
+    }
+
+    for (auto& entry : frames) {
+        auto& points = entry.second;
+        std::sort(points.begin(), points.end(), [](const Point& a, const Point& b) {
+            return a.timestamp_ns < b.timestamp_ns;
+        });
+        int pid = points.front().camera_id;
+
+        // 整帧区间
+        separator();
+        fprintf(fp, "{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"b\",\"id\":\"0x%" PRIx64 "\","
+                    "\"ts\":%.3f,\"pid\":%d,\"tid\":0}",
+                entry.first, points.front().timestamp_ns / 1000.0, pid);
+
+        // 相邻阶段之间的区间
+        for (size_t i = 1; i < points.size(); ++i) {
+            char name[64];
+            snprintf(name, sizeof(name), "%s->%s",
+                     stage_name(static_cast<TraceStage>(points[i - 1].stage)),
+                     stage_name(static_cast<TraceStage>(points[i].stage)));
+            separator();
+            fprintf(fp, "{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"b\",\"id\":\"0x%" PRIx64 "\","
+                        "\"ts\":%.3f,\"pid\":%d,\"tid\":0}",
+                    name, entry.first, points[i - 1].timestamp_ns / 1000.0, pid);
+            separator();
+            fprintf(fp, "{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"e\",\"id\":\"0x%" PRIx64 "\","
+                        "\"ts\":%.3f,\"pid\":%d,\"tid\":0}",
+                    name, entry.first, points[i].timestamp_ns / 1000.0, pid);
+        }
+
+        separator();
+        fprintf(fp, "{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"e\",\"id\":\"0x%" PRIx64 "\","
+                    "\"ts\":%.3f,\"pid\":%d,\"tid\":0}",
+                entry.first, points.back().timestamp_ns / 1000.0, pid);
+    }
+
+    // 进程轨道命名
+    for (int camera : cameras) {
+        separator();
+        fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                    "\"args\":{\"name\":\"camera %d\"}}", camera, camera);
+    }
+
+    fprintf(fp, "\n]}\n");
+    bool ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+}
+
+bool FrameTracer::dump_binary(const std::string& path) {
+    std::vector<std::pair<int, std::vector<TraceEvent>>> threads;
+    snapshot(threads);
+
+    FILE* fp = fopen(path.c_str(), "wb");
+    if (!fp) {
+        return false;
+    }
+
+    BinaryHeader header{{'F', 'T', 'R', 'C'}, 1,
+                        static_cast<uint32_t>(threads.size()),
+                        static_cast<uint32_t>(sizeof(TraceEvent))};
+    fwrite(&header, sizeof(header), 1, fp);
+    for (const auto& thread : threads) {
+        int32_t tid = thread.first;
+        uint32_t count = static_cast<uint32_t>(thread.second.size());
+        fwrite(&tid, sizeof(tid), 1, fp);
+        fwrite(&count, sizeof(count), 1, fp);
+        if (count) {
+            fwrite(thread.second.data(), sizeof(TraceEvent), count, fp);
+        }
+    }
+
+    bool ok = !ferror(fp);
+    fclose(fp);
+    return ok;
+}
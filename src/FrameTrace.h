@@ -0,0 +1,140 @@
+#pragma once
+/**
+ * @file FrameTrace.h
+ * @class FrameTracer
+ * @brief 逐帧生命周期追踪
+ *
+ * 每个CameraFrame在DQBUF时分配唯一的trace_id，之后在各个处理阶段
+ * （入队、出队、YUYV→BGR、processFrame、送编码器、收包、写muxer）打点记录时间戳，
+ * 用于定位单帧延迟究竟消耗在哪个环节。
+ *
+ * 主要功能特点：
+ * - 每个线程独立的无锁环形事件缓冲（单写者，写满后覆盖最旧事件）；
+ *   每个槽位带提交序号，导出时跳过写入线程正在覆盖的槽位，不会导出写了一半的事件
+ * - 关闭时打点开销仅为一次relaxed原子读
+ * - 按需导出为Chrome trace_event JSON（可直接在Perfetto/chrome://tracing打开）
+ *   或紧凑二进制格式
+ *
+ * 使用方式：
+ *   FrameTracer::instance().set_enabled(true);
+ *   FrameTracer::instance().record(frame.trace_id, TraceStage::QueuePush, frame.camera_id);
+ *   FrameTracer::instance().dump_chrome_json("/tmp/frame_trace.json");
+ */
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// 帧处理阶段（顺序即帧在流水线中的先后顺序）
+enum class TraceStage : uint8_t {
+    Dqbuf = 0,       // 从V4L2取出缓冲
+    QueuePush,       // 推入编码输入队列
+    QueuePop,        // 编码线程取出
+    ConvertDone,     // YUYV→BGR完成
+    ProcessDone,     // processFrame完成
+    EncoderSend,     // avcodec_send_frame完成
+    PacketReceived,  // 收到对应的编码包
+    MuxerWrite,      // 写入muxer完成
+    Count
+};
+
+// 单条追踪事件
+struct TraceEvent {
+    uint64_t trace_id;
+    int64_t timestamp_ns;   // CLOCK_MONOTONIC
+    int32_t camera_id;
+    uint8_t stage;
+    uint8_t reserved[3];
+};
+
+class FrameTracer {
+public:
+    // 每个线程缓冲的事件数量（必须为2的幂）
+    static constexpr size_t kEventsPerThread = 16384;
+
+    /**
+     * @brief 获取全局追踪器实例
+     */
+    static FrameTracer& instance();
+
+    /**
+     * @brief 开启/关闭追踪
+     */
+    void set_enabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 分配新的trace_id（从1开始，0表示未追踪）
+     */
+    uint64_t next_trace_id() { return next_id_.fetch_add(1, std::memory_order_relaxed); }
+
+    /**
+     * @brief 记录一个阶段时间戳（热路径，写入当前线程的缓冲）
+     * @param trace_id 帧追踪ID，0时忽略
+     * @param stage 处理阶段
+     * @param camera_id 摄像头ID，导出时作为进程轨道
+     */
+    void record(uint64_t trace_id, TraceStage stage, int camera_id) {
+        if (trace_id == 0 || !enabled()) return;
+        record_event(trace_id, stage, camera_id);
+    }
+
+    /**
+     * @brief 导出为Chrome trace_event JSON
+     * 每帧的相邻阶段之间生成一个异步区间，同时每个打点生成一个线程内即时事件
+     * @param path 输出文件路径
+     * @return 成功返回true
+     */
+    bool dump_chrome_json(const std::string& path);
+
+    /**
+     * @brief 导出为紧凑二进制格式
+     * 格式：头部{"FTRC", version, thread_count}，之后每个线程{tid, event_count, TraceEvent[]}
+     * @param path 输出文件路径
+     * @return 成功返回true
+     */
+    bool dump_binary(const std::string& path);
+
+    /**
+     * @brief 清空所有线程缓冲中的事件
+     */
+    void clear();
+
+    /**
+     * @brief 获取阶段名称
+     */
+    static const char* stage_name(TraceStage stage);
+
+    FrameTracer(const FrameTracer&) = delete;
+    FrameTracer& operator=(const FrameTracer&) = delete;
+
+private:
+    FrameTracer() = default;
+
+    // 单个线程的事件缓冲，线程退出后仍由追踪器持有，保证导出完整
+    struct ThreadBuffer {
+        int tid = 0;
+        std::atomic<uint64_t> write_pos{0};
+        std::atomic<uint64_t> start_pos{0};  // clear()后的起始位置
+        std::unique_ptr<TraceEvent[]> events{new TraceEvent[kEventsPerThread]};
+        // 每个槽位的提交序号：写入位置pos的事件写完后为pos + 1，写入过程中为0
+        std::unique_ptr<std::atomic<uint64_t>[]> commits{new std::atomic<uint64_t>[kEventsPerThread]()};
+    };
+
+    void record_event(uint64_t trace_id, TraceStage stage, int camera_id);
+    ThreadBuffer* thread_buffer();
+
+    /**
+     * @brief 拷贝所有线程缓冲的事件快照（跳过拷贝期间被改写的槽位）
+     */
+    void snapshot(std::vector<std::pair<int, std::vector<TraceEvent>>>& out);
+
+private:
+    std::atomic<bool> enabled_{false};
+    std::atomic<uint64_t> next_id_{1};
+
+    std::mutex buffers_mutex_;  // 仅在线程首次打点和导出时使用
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+};
@@ -0,0 +1,15 @@
+#pragma once
+/**
+ * @file ImageDiff.h
+ * @brief 帧间比较用的SAD计算（NEON/SSE2，其他平台用标量实现）
+ */
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 两段字节的绝对差之和
+ * @param n 字节数，不超过kMaxSadBytes（NEON的16位累加器不会溢出）
+ */
+uint32_t sad_bytes(const uint8_t* a, const uint8_t* b, size_t n);
+
+constexpr size_t kMaxSadBytes = 2048;
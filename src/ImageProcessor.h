@@ -7,12 +7,46 @@
  *  - 继承并实现processFrame()可自定义图像处理逻辑,processFrame提供 BGR24 格式cv::Mat数据，
  *    直接使用opencv处理图像，需要保证本地操作或处理后的数据拷贝给提供的cv::Mat从而保证后续处
  *    理正常执行
+ *  - 重写tiledProcessing()返回true可改为分块增量处理：框架按64x64块比较前后两帧，
+ *    processTiles()只需重新处理有变化的块，其余块由框架用上次的处理结果覆盖
+ *  - 重写regionsOfInterest()返回人脸、车牌等关注区域，编码器按优先级降低这些区域的QP（ROI编码），
+ *    区域信息同时通过EncodedPacketInfo提供给调用者
+ *  - 重写frameMetadata()可把检测结果等紧凑数据随帧写入码流（EncoderStreamer::set_frame_sei()）
  */
 
 #pragma once
 #include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
 #include <opencv2/opencv.hpp>
 
+/**
+ * @brief 分块处理的单块结果（由处理器派生，如检测框、OCR文本），框架只负责按块缓存
+ */
+struct TileResult {
+    virtual ~TileResult() = default;
+};
+
+/**
+ * @brief 分块处理中的一个块
+ */
+struct ImageTile {
+    int index;                           // 块序号（行优先）
+    cv::Rect rect;                       // 块在图像中的位置（右边和下边的块可能不足64x64）
+    bool dirty;                          // 与上次处理时相比有变化（或到达定期刷新）
+    std::shared_ptr<TileResult> result;  // 该块最近一次的处理结果，处理dirty块后可替换
+};
+
+/**
+ * @brief 关注区域（ROI）
+ */
+struct ImageRegion {
+    cv::Rect rect;       // 区域位置（processFrame的图像坐标）
+    int priority = 1;    // 优先级，越大画质越高（QP偏移为RoiOptions::qp_offset × priority），0表示只作元数据
+    std::string label;   // 区域类型（如"face"、"plate"），只作元数据
+};
+
 class ImageProcessor {
 public:
     /**
@@ -60,7 +94,35 @@ public:
      * @details 用户需在该函数中进行本地图像处理操作，处理后的数据需拷贝给输入的mat参数，
      *          以确保后续处理流程能正常使用处理后的图像数据
      */
-    virtual void processFrame(cv::Mat& mat) {}
+    virtual void processFrame(cv::Mat& /*mat*/) {}
+
+    /**
+     * @brief 是否使用分块增量处理
+     * @details 返回true时框架调用processTiles()而不是processFrame()
+     */
+    virtual bool tiledProcessing() const { return false; }
+
+    /**
+     * @brief 分块处理接口（tiledProcessing()返回true时使用）
+     * @param mat 输入输出参数，BGR24格式的完整图像，只需修改dirty块的区域，不能改变尺寸和格式
+     * @param tiles 全部块，dirty块需要重新处理并可更新result；非dirty块的区域处理后会被上次的输出覆盖
+     * @details 没有dirty块的帧不会调用
+     */
+    virtual void processTiles(cv::Mat& /*mat*/, std::vector<ImageTile>& /*tiles*/) {}
+
+    /**
+     * @brief 当前帧的关注区域
+     * @details 每帧处理（processFrame()/processTiles()）之后调用，默认没有区域；
+     *          静止画面重复上一帧时沿用上一次的区域
+     */
+    virtual std::vector<ImageRegion> regionsOfInterest() { return {}; }
+
+    /**
+     * @brief 当前帧随码流传递的元数据
+     * @details 开启帧元数据SEI时，每帧处理之后调用，返回的字节串（最多1024字节，格式由处理器定义）
+     *          写入该帧的SEI，接收端可以把分析结果与帧对齐；默认为空
+     */
+    virtual std::string frameMetadata() { return {}; }
     
     /**
      * @brief 清理接口
@@ -0,0 +1,200 @@
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <sys/time.h>
+
+namespace {
+
+// 槽位中附加的元数据打包在文本前，由写线程负责格式化时间戳和级别前缀
+struct LineHeader {
+    int64_t timestamp_us;
+    uint32_t suppressed;
+    int level;
+};
+
+const char* level_name(int level) {
+    switch (level) {
+        case 0: return "D";
+        case 1: return "I";
+        case 2: return "W";
+        case 3: return "E";
+        default: return "?";
+    }
+}
+
+int64_t now_realtime_us() {
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+int64_t now_steady_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+static_assert((Logger::kRingSize & (Logger::kRingSize - 1)) == 0, "kRingSize must be a power of two");
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : ring_(new Slot[kRingSize]) {
+    for (size_t i = 0; i < kRingSize; ++i) {
+        ring_[i].sequence.store(i, std::memory_order_relaxed);
+        ring_[i].length = 0;
+    }
+    writer_ = std::thread(&Logger::writer_thread, this);
+}
+
+Logger::~Logger() {
+    running_ = false;
+    wake_cv_.notify_all();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void Logger::log(LogLevel level, const char* tag, uint32_t suppressed, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    vlog(level, tag, suppressed, fmt, args);
+    va_end(args);
+}
+
+void Logger::vlog(LogLevel level, const char* tag, uint32_t suppressed, const char* fmt, va_list args) {
+    if (!enabled(level)) return;
+
+    // 先在栈上格式化，避免占用槽位期间阻塞写线程
+    char text[kMessageSize];
+    LineHeader header{now_realtime_us(), suppressed, static_cast<int>(level)};
+    memcpy(text, &header, sizeof(header));
+    size_t used = sizeof(header);
+    int n = snprintf(text + used, kMessageSize - used, "%s: ", tag ? tag : "");
+    if (n > 0) used += std::min(static_cast<size_t>(n), kMessageSize - used - 1);
+    n = vsnprintf(text + used, kMessageSize - used, fmt, args);
+    if (n > 0) used += std::min(static_cast<size_t>(n), kMessageSize - used - 1);
+
+    // Vyukov有界队列入队：抢占槽位失败（队列满）时直接丢弃
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    for (;;) {
+        slot = &ring_[pos & (kRingSize - 1)];
+        size_t seq = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = enqueue_pos_.load(std::memory_order_relaxed);
+        }
+    }
+
+    memcpy(slot->text, text, used);
+    slot->length = used;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool Logger::pop(char* line, size_t& len) {
+    Slot& slot = ring_[dequeue_pos_ & (kRingSize - 1)];
+    size_t seq = slot.sequence.load(std::memory_order_acquire);
+    if (seq != dequeue_pos_ + 1) {
+        return false;
+    }
+    len = slot.length;
+    memcpy(line, slot.text, len);
+    slot.sequence.store(dequeue_pos_ + kRingSize, std::memory_order_release);
+    ++dequeue_pos_;
+    return true;
+}
+
+void Logger::writer_thread() {
+    char raw[kMessageSize];
+    char out[kMessageSize + 96];
+    uint64_t reported_dropped = 0;
+
+    for (;;) {
+        size_t len = 0;
+        bool wrote = false;
+        while (pop(raw, len)) {
+            LineHeader header;
+            memcpy(&header, raw, sizeof(header));
+
+            time_t secs = static_cast<time_t>(header.timestamp_us / 1000000);
+            struct tm tm_local;
+            localtime_r(&secs, &tm_local);
+            int n = static_cast<int>(strftime(out, sizeof(out), "[%H:%M:%S", &tm_local));
+            n += snprintf(out + n, sizeof(out) - n, ".%03d] [%s] ",
+                          static_cast<int>((header.timestamp_us / 1000) % 1000),
+                          level_name(header.level));
+            fwrite(out, 1, n, stderr);
+            fwrite(raw + sizeof(header), 1, len - sizeof(header), stderr);
+            if (header.suppressed) {
+                fprintf(stderr, " (suppressed %u similar)", header.suppressed);
+            }
+            fputc('\n', stderr);
+            written_.fetch_add(1, std::memory_order_release);
+            wrote = true;
+        }
+
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (dropped != reported_dropped) {
+            fprintf(stderr, "Logger: %llu log lines dropped (ring full)\n",
+                    static_cast<unsigned long long>(dropped - reported_dropped));
+            reported_dropped = dropped;
+            wrote = true;
+        }
+        if (wrote) {
+            fflush(stderr);
+        }
+
+        if (!running_) {
+            // 退出前持续排空，直到一轮中没有新日志
+            if (!wrote) break;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_cv_.wait_for(lock, std::chrono::milliseconds(10));
+    }
+}
+
+void Logger::flush() {
+    uint64_t target = enqueue_pos_.load(std::memory_order_acquire);
+    wake_cv_.notify_all();
+    while (written_.load(std::memory_order_acquire) < target && running_) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+bool LogRateLimiter::allow(int64_t interval_ms, uint32_t& suppressed) {
+    int64_t now = now_steady_ms();
+    int64_t last = last_ms_.load(std::memory_order_relaxed);
+    if (now - last >= interval_ms &&
+        last_ms_.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool KeyedLogRateLimiter::allow(const std::string& key, int64_t interval_ms, uint32_t& suppressed) {
+    LogRateLimiter* limiter;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        limiter = &limiters_[key];  // unordered_map的节点地址在插入后保持不变
+    }
+    return limiter->allow(interval_ms, suppressed);
+}
@@ -0,0 +1,212 @@
+#pragma once
+/**
+ * @file Logger.h
+ * @class Logger
+ * @brief 异步环形缓冲日志
+ *
+ * 热路径（采集线程、编码线程）只做一次snprintf格式化并写入无锁环形缓冲区，
+ * 由后台线程统一写到stderr，避免std::cout/std::endl的同步刷新和iostream锁。
+ *
+ * 主要功能特点：
+ * - 多生产者单消费者无锁环形缓冲（有界，满时丢弃并计数，绝不阻塞调用者）
+ * - 日志级别：DEBUG/INFO/WARN/ERROR，低于阈值的日志在格式化前直接返回
+ * - 调用点级别限速：LOG_*_EVERY_MS宏在每个调用点维护独立的时间窗口，
+ *   被抑制的条数会在下一次输出时附带打印
+ * - 按键限速：LOG_*_EVERY_MS_FOR宏在调用点内再按键（设备路径、推流地址等）分别限速，
+ *   多个摄像头/推流实例共用同一段代码时，一个实例的错误不会把另一个实例的错误挡掉
+ *
+ * 使用方式：
+ *   LOG_INFO("CameraCapture", "opened %s", path.c_str());
+ *   LOG_DEBUG_EVERY_MS("CameraCapture", 1000, "frame %u", seq);
+ *   LOG_DEBUG_EVERY_MS_FOR("CameraCapture", device_path_, 1000, "frame %u", seq);
+ */
+#include <atomic>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+enum class LogLevel : int {
+    Debug = 0,
+    Info  = 1,
+    Warn  = 2,
+    Error = 3,
+    Off   = 4
+};
+
+class Logger {
+public:
+    // 单条日志最大长度（超出部分截断）
+    static constexpr size_t kMessageSize = 256;
+    // 环形缓冲槽位数量（必须为2的幂）
+    static constexpr size_t kRingSize = 1024;
+
+    /**
+     * @brief 获取全局日志实例（首次调用时启动后台写线程）
+     */
+    static Logger& instance();
+
+    /**
+     * @brief 设置输出阈值，低于该级别的日志直接丢弃
+     * @param level 日志级别
+     */
+    void set_level(LogLevel level) { level_.store(static_cast<int>(level), std::memory_order_relaxed); }
+
+    /**
+     * @brief 判断某级别日志是否会输出（用于宏中提前短路）
+     */
+    bool enabled(LogLevel level) const {
+        return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 格式化并写入环形缓冲（不阻塞）
+     * @param level 日志级别
+     * @param tag 模块标识（如"CameraCapture"）
+     * @param suppressed 该调用点此前被限速抑制的条数（0表示无）
+     * @param fmt printf风格格式串
+     */
+    void log(LogLevel level, const char* tag, uint32_t suppressed, const char* fmt, ...)
+        __attribute__((format(printf, 5, 6)));
+    void vlog(LogLevel level, const char* tag, uint32_t suppressed, const char* fmt, va_list args);
+
+    /**
+     * @brief 等待当前缓冲中的日志全部写出
+     */
+    void flush();
+
+    /**
+     * @brief 因缓冲区满而被丢弃的日志条数
+     */
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+private:
+    Logger();
+
+    /**
+     * @brief 后台写线程：从环形缓冲取出日志并写到stderr
+     */
+    void writer_thread();
+
+    /**
+     * @brief 取出一条日志（仅写线程调用）
+     * @return 有数据返回true
+     */
+    bool pop(char* line, size_t& len);
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        size_t length;
+        char text[kMessageSize];
+    };
+
+    std::unique_ptr<Slot[]> ring_;
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) size_t dequeue_pos_ = 0;
+
+    std::atomic<int> level_{static_cast<int>(LogLevel::Info)};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<bool> running_{true};
+
+    // 写线程空闲时的休眠/唤醒（仅写线程和flush()使用，生产者不加锁）
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    std::atomic<uint64_t> written_{0};
+
+    std::thread writer_;
+};
+
+/**
+ * @brief 调用点限速状态
+ * 每个LOG_*_EVERY_MS调用点持有一个静态实例（按键限速时每个键一个），记录上次输出时间和期间被抑制的条数
+ */
+class LogRateLimiter {
+public:
+    /**
+     * @brief 判断本次是否允许输出
+     * @param interval_ms 最小输出间隔（毫秒）
+     * @param suppressed 输出参数，允许输出时返回此前被抑制的条数
+     * @return 允许输出返回true
+     */
+    bool allow(int64_t interval_ms, uint32_t& suppressed);
+
+private:
+    std::atomic<int64_t> last_ms_{INT64_MIN / 2};
+    std::atomic<uint32_t> suppressed_{0};
+};
+
+/**
+ * @brief 按键限速状态
+ * 每个LOG_*_EVERY_MS_FOR调用点持有一个静态实例，每个键对应一个LogRateLimiter。
+ * 查找时短暂加锁（只在该级别日志开启时发生），键的数量等于实例数量，不会回收
+ */
+class KeyedLogRateLimiter {
+public:
+    /**
+     * @brief 判断键为key的本次日志是否允许输出
+     * @param key 实例标识（如设备路径、推流地址）
+     * @param interval_ms 最小输出间隔（毫秒）
+     * @param suppressed 输出参数，允许输出时返回该键此前被抑制的条数
+     * @return 允许输出返回true
+     */
+    bool allow(const std::string& key, int64_t interval_ms, uint32_t& suppressed);
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, LogRateLimiter> limiters_;
+};
+
+#define LOG_AT(level, tag, ...)                                               \
+    do {                                                                      \
+        if (Logger::instance().enabled(level)) {                              \
+            Logger::instance().log(level, tag, 0, __VA_ARGS__);               \
+        }                                                                     \
+    } while (0)
+
+#define LOG_AT_EVERY_MS(level, tag, interval_ms, ...)                         \
+    do {                                                                      \
+        if (Logger::instance().enabled(level)) {                              \
+            static LogRateLimiter _log_limiter;                               \
+            uint32_t _log_suppressed = 0;                                     \
+            if (_log_limiter.allow(interval_ms, _log_suppressed)) {           \
+                Logger::instance().log(level, tag, _log_suppressed, __VA_ARGS__); \
+            }                                                                 \
+        }                                                                     \
+    } while (0)
+
+#define LOG_AT_EVERY_MS_FOR(level, tag, key, interval_ms, ...)               \
+    do {                                                                      \
+        if (Logger::instance().enabled(level)) {                              \
+            static KeyedLogRateLimiter _log_limiter;                          \
+            uint32_t _log_suppressed = 0;                                     \
+            if (_log_limiter.allow(key, interval_ms, _log_suppressed)) {      \
+                Logger::instance().log(level, tag, _log_suppressed, __VA_ARGS__); \
+            }                                                                 \
+        }                                                                     \
+    } while (0)
+
+#define LOG_DEBUG(tag, ...) LOG_AT(LogLevel::Debug, tag, __VA_ARGS__)
+#define LOG_INFO(tag, ...)  LOG_AT(LogLevel::Info, tag, __VA_ARGS__)
+#define LOG_WARN(tag, ...)  LOG_AT(LogLevel::Warn, tag, __VA_ARGS__)
+#define LOG_ERROR(tag, ...) LOG_AT(LogLevel::Error, tag, __VA_ARGS__)
+
+#define LOG_DEBUG_EVERY_MS(tag, ms, ...) LOG_AT_EVERY_MS(LogLevel::Debug, tag, ms, __VA_ARGS__)
+#define LOG_INFO_EVERY_MS(tag, ms, ...)  LOG_AT_EVERY_MS(LogLevel::Info, tag, ms, __VA_ARGS__)
+#define LOG_WARN_EVERY_MS(tag, ms, ...)  LOG_AT_EVERY_MS(LogLevel::Warn, tag, ms, __VA_ARGS__)
+#define LOG_ERROR_EVERY_MS(tag, ms, ...) LOG_AT_EVERY_MS(LogLevel::Error, tag, ms, __VA_ARGS__)
+
+#define LOG_DEBUG_EVERY_MS_FOR(tag, key, ms, ...) LOG_AT_EVERY_MS_FOR(LogLevel::Debug, tag, key, ms, __VA_ARGS__)
+#define LOG_INFO_EVERY_MS_FOR(tag, key, ms, ...)  LOG_AT_EVERY_MS_FOR(LogLevel::Info, tag, key, ms, __VA_ARGS__)
+#define LOG_WARN_EVERY_MS_FOR(tag, key, ms, ...)  LOG_AT_EVERY_MS_FOR(LogLevel::Warn, tag, key, ms, __VA_ARGS__)
+#define LOG_ERROR_EVERY_MS_FOR(tag, key, ms, ...) LOG_AT_EVERY_MS_FOR(LogLevel::Error, tag, key, ms, __VA_ARGS__)
@@ -0,0 +1,317 @@
+#include "Metrics.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+std::string format_labels(const MetricLabels& labels) {
+    std::string out;
+    for (const auto& kv : labels) {
+        if (!out.empty()) out += ',';
+        out += kv.first;
+        out += "=\"";
+        for (char c : kv.second) {
+            if (c == '\\' || c == '"') out += '\\';
+            if (c == '\n') { out += "\\n"; continue; }
+            out += c;
+        }
+        out += '"';
+    }
+    return out;
+}
+
+void append_sample(std::string& out, const std::string& name, const std::string& labels, double value) {
+    char buf[64];
+    out += name;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    if (std::isinf(value)) {
+        snprintf(buf, sizeof(buf), " %s\n", value > 0 ? "+Inf" : "-Inf");
+    } else {
+        snprintf(buf, sizeof(buf), " %.17g\n", value);
+    }
+    out += buf;
+}
+
+const char* type_name(int type) {
+    switch (type) {
+        case 0: return "counter";
+        case 1: return "gauge";
+        default: return "histogram";
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------- Histogram
+
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)),
+      buckets_(new std::atomic<uint64_t>[bounds_.size() + 1]) {
+    for (size_t i = 0; i <= bounds_.size(); ++i) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double v) {
+    size_t i = 0;
+    while (i < bounds_.size() && v > bounds_[i]) {
+        ++i;
+    }
+    buckets_[i].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    double cur = sum_.load(std::memory_order_relaxed);
+    while (!sum_.compare_exchange_weak(cur, cur + v, std::memory_order_relaxed)) {}
+}
+
+double Histogram::quantile(double q) const {
+    uint64_t total = count();
+    if (total == 0) return 0.0;
+    double rank = q * static_cast<double>(total);
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= bounds_.size(); ++i) {
+        uint64_t n = bucket_count(i);
+        if (n && static_cast<double>(cumulative + n) >= rank) {
+            double lower = i == 0 ? 0.0 : bounds_[i - 1];
+            if (i == bounds_.size()) return lower;  // 落在+Inf桶，只能返回下界
+            double upper = bounds_[i];
+            double fraction = (rank - static_cast<double>(cumulative)) / static_cast<double>(n);
+            return lower + (upper - lower) * std::max(0.0, std::min(1.0, fraction));
+        }
+        cumulative += n;
+    }
+    return bounds_.empty() ? 0.0 : bounds_.back();
+}
+
+std::vector<double> Histogram::latency_buckets() {
+    return {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+            0.05, 0.1, 0.25, 0.5, 1.0, 2.0};
+}
+
+// ---------------------------------------------------------------- MetricsRegistry
+
+MetricsRegistry& MetricsRegistry::instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::Series& MetricsRegistry::find_or_create(const std::string& name, const std::string& help,
+                                                         Type type, const MetricLabels& labels) {
+    std::string label_str = format_labels(labels);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = families_.find(name);
+    if (it == families_.end()) {
+        Family family;
+        family.type = type;
+        family.help = help;
+        it = families_.emplace(name, std::move(family)).first;
+    }
+    for (auto& series : it->second.series) {
+        if (series->labels == label_str) {
+            return *series;
+        }
+    }
+    std::unique_ptr<Series> series(new Series());
+    series->labels = label_str;
+    it->second.series.push_back(std::move(series));
+    return *it->second.series.back();
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    Series& series = find_or_create(name, help, Type::Counter, labels);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!series.counter) series.counter.reset(new Counter());
+    return *series.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help, const MetricLabels& labels) {
+    Series& series = find_or_create(name, help, Type::Gauge, labels);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!series.gauge) series.gauge.reset(new Gauge());
+    return *series.gauge;
+}
+
+Histogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                      const MetricLabels& labels, const std::vector<double>& bounds) {
+    Series& series = find_or_create(name, help, Type::Histogram, labels);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!series.histogram) series.histogram.reset(new Histogram(bounds));
+    return *series.histogram;
+}
+
+std::string MetricsRegistry::render_prometheus() const {
+    std::string out;
+    out.reserve(8192);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : families_) {
+        const std::string& name = entry.first;
+        const Family& family = entry.second;
+        out += "# HELP " + name + " " + family.help + "\n";
+        out += "# TYPE " + name + " " + type_name(static_cast<int>(family.type)) + "\n";
+        for (const auto& series : family.series) {
+            if (series->counter) {
+                append_sample(out, name, series->labels, static_cast<double>(series->counter->value()));
+            } else if (series->gauge) {
+                append_sample(out, name, series->labels, series->gauge->value());
+            } else if (series->histogram) {
+                const Histogram& h = *series->histogram;
+                std::string prefix = series->labels.empty() ? "" : series->labels + ",";
+                uint64_t cumulative = 0;
+                char le[64];
+                for (size_t i = 0; i < h.bounds().size(); ++i) {
+                    cumulative += h.bucket_count(i);
+                    snprintf(le, sizeof(le), "le=\"%g\"", h.bounds()[i]);
+                    append_sample(out, name + "_bucket", prefix + le, static_cast<double>(cumulative));
+                }
+                cumulative += h.bucket_count(h.bounds().size());
+                append_sample(out, name + "_bucket", prefix + "le=\"+Inf\"", static_cast<double>(cumulative));
+                append_sample(out, name + "_sum", series->labels, h.sum());
+                append_sample(out, name + "_count", series->labels, static_cast<double>(h.count()));
+            }
+        }
+    }
+    return out;
+}
+
+// ---------------------------------------------------------------- MetricsExporter
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+bool MetricsExporter::start_http_server(int port, const std::string& bind_addr) {
+    if (http_thread_.joinable()) return true;
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        LOG_ERROR("MetricsExporter", "socket failed: %s", strerror(errno));
+        return false;
+    }
+    int on = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, bind_addr.c_str(), &addr.sin_addr) != 1 ||
+        bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd_, 8) < 0) {
+        LOG_ERROR("MetricsExporter", "cannot listen on %s:%d: %s", bind_addr.c_str(), port, strerror(errno));
+        close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+
+    running_ = true;
+    http_thread_ = std::thread(&MetricsExporter::http_loop, this);
+    LOG_INFO("MetricsExporter", "serving metrics on http://%s:%d/metrics", bind_addr.c_str(), port);
+    return true;
+}
+
+void MetricsExporter::http_loop() {
+    while (running_) {
+        pollfd pfd{listen_fd_, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+        int client = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client < 0) {
+            continue;
+        }
+
+        // 只需要请求行，读取一次即可（带超时，防止慢客户端卡住导出线程）
+        timeval tv{1, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        char request[1024];
+        ssize_t n = recv(client, request, sizeof(request) - 1, 0);
+        if (n <= 0) {
+            close(client);
+            continue;
+        }
+        request[n] = '\0';
+
+        std::string body;
+        std::string status;
+        if (strncmp(request, "GET /metrics", 12) == 0) {
+            status = "200 OK";
+            body = MetricsRegistry::instance().render_prometheus();
+        } else {
+            status = "404 Not Found";
+            body = "not found\n";
+        }
+        std::string response = "HTTP/1.1 " + status + "\r\n"
+                               "Content-Type: text/plain; version=0.0.4\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                               "Connection: close\r\n\r\n" + body;
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t w = send(client, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (w <= 0) break;
+            sent += static_cast<size_t>(w);
+        }
+        close(client);
+    }
+}
+
+bool MetricsExporter::write_textfile(const std::string& path) {
+    std::string tmp = path + ".tmp";
+    FILE* fp = fopen(tmp.c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+    std::string text = MetricsRegistry::instance().render_prometheus();
+    bool ok = fwrite(text.data(), 1, text.size(), fp) == text.size();
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+void MetricsExporter::start_textfile_writer(const std::string& path, int interval_ms) {
+    if (textfile_thread_.joinable()) return;
+    running_ = true;
+    textfile_thread_ = std::thread(&MetricsExporter::textfile_loop, this, path, interval_ms);
+}
+
+void MetricsExporter::textfile_loop(std::string path, int interval_ms) {
+    while (running_) {
+        if (!write_textfile(path)) {
+            LOG_WARN_EVERY_MS_FOR("MetricsExporter", path, 60000, "failed to write %s", path.c_str());
+        }
+        // 分段休眠，保证stop()及时返回
+        for (int waited = 0; waited < interval_ms && running_; waited += 100) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+}
+
+void MetricsExporter::stop() {
+    running_ = false;
+    if (http_thread_.joinable()) {
+        http_thread_.join();
+    }
+    if (textfile_thread_.joinable()) {
+        textfile_thread_.join();
+    }
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+}
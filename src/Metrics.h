@@ -0,0 +1,186 @@
+#pragma once
+/**
+ * @file Metrics.h
+ * @brief 低开销运行指标（计数器/仪表/固定桶直方图）及Prometheus文本导出
+ *
+ * 指标在初始化阶段通过MetricsRegistry注册（加锁，仅一次），返回的引用在进程生命周期内有效；
+ * 热路径只对缓存的引用做relaxed原子操作，单次记录耗时为纳秒级。
+ *
+ * 导出方式：
+ * - MetricsExporter::start_http_server() 在本地端口提供 GET /metrics
+ * - MetricsExporter::start_textfile_writer() 周期性写入node_exporter textfile目录
+ *
+ * 使用方式：
+ *   Counter& frames = MetricsRegistry::instance().counter(
+ *       "camera_frames_captured_total", "Frames dequeued from V4L2", {{"camera", "0"}});
+ *   frames.inc();
+ */
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// 指标标签，如 {{"camera", "0"}, {"stage", "convert"}}
+using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * @brief 单调递增计数器
+ */
+class Counter {
+public:
+    void inc(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+/**
+ * @brief 可增可减的瞬时值
+ */
+class Gauge {
+public:
+    void set(double v) { value_.store(v, std::memory_order_relaxed); }
+    void add(double v) {
+        double cur = value_.load(std::memory_order_relaxed);
+        while (!value_.compare_exchange_weak(cur, cur + v, std::memory_order_relaxed)) {}
+    }
+    double value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value_{0.0};
+};
+
+/**
+ * @brief 固定桶直方图（桶边界在注册时确定，记录时线性查找）
+ */
+class Histogram {
+public:
+    explicit Histogram(std::vector<double> bounds);
+
+    /**
+     * @brief 记录一个观测值
+     */
+    void observe(double v);
+
+    const std::vector<double>& bounds() const { return bounds_; }
+    // 第i个桶（非累计）的计数，i == bounds().size() 为+Inf桶
+    uint64_t bucket_count(size_t i) const { return buckets_[i].load(std::memory_order_relaxed); }
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    double sum() const { return sum_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief 基于桶计数估算分位数（桶内线性插值）
+     * @param q 分位数（0~1）
+     */
+    double quantile(double q) const;
+
+    // 常用桶边界：延迟（秒），从100us到2s
+    static std::vector<double> latency_buckets();
+
+private:
+    const std::vector<double> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<double> sum_{0.0};
+};
+
+/**
+ * @brief 指标注册表（全局单例）
+ * 同名同标签重复注册返回同一实例
+ */
+class MetricsRegistry {
+public:
+    static MetricsRegistry& instance();
+
+    Counter& counter(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    Gauge& gauge(const std::string& name, const std::string& help, const MetricLabels& labels = {});
+    Histogram& histogram(const std::string& name, const std::string& help, const MetricLabels& labels = {},
+                         const std::vector<double>& bounds = Histogram::latency_buckets());
+
+    /**
+     * @brief 按Prometheus文本格式（version 0.0.4）输出全部指标
+     */
+    std::string render_prometheus() const;
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+private:
+    MetricsRegistry() = default;
+
+    enum class Type { Counter, Gauge, Histogram };
+
+    struct Series {
+        std::string labels;  // 已格式化的标签串：k1="v1",k2="v2"
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    struct Family {
+        Type type;
+        std::string help;
+        std::vector<std::unique_ptr<Series>> series;
+    };
+
+    Series& find_or_create(const std::string& name, const std::string& help,
+                           Type type, const MetricLabels& labels);
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_;
+};
+
+/**
+ * @brief 指标导出器：本地HTTP /metrics端点或node_exporter textfile
+ */
+class MetricsExporter {
+public:
+    MetricsExporter() = default;
+    ~MetricsExporter();
+
+    /**
+     * @brief 启动HTTP服务线程
+     * @param port 监听端口
+     * @param bind_addr 监听地址（默认仅本机）
+     * @return 成功返回true
+     */
+    bool start_http_server(int port, const std::string& bind_addr = "127.0.0.1");
+
+    /**
+     * @brief 启动textfile周期写入线程（先写临时文件再rename，保证原子替换）
+     * @param path 输出文件路径（如/var/lib/node_exporter/textfile/camera.prom）
+     * @param interval_ms 写入间隔（毫秒）
+     */
+    void start_textfile_writer(const std::string& path, int interval_ms = 5000);
+
+    /**
+     * @brief 立即写一次textfile
+     * @return 成功返回true
+     */
+    static bool write_textfile(const std::string& path);
+
+    /**
+     * @brief 停止所有导出线程
+     */
+    void stop();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+private:
+    void http_loop();
+    void textfile_loop(std::string path, int interval_ms);
+
+private:
+    std::atomic<bool> running_{false};
+    int listen_fd_ = -1;
+    std::thread http_thread_;
+    std::thread textfile_thread_;
+};
@@ -0,0 +1,262 @@
+#include "MotionDetector.h"
+#include "Logger.h"
+#include <algorithm>
+#include <ctime>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+constexpr int kCellSize = 8;      // 单元边长（缩小后的像素）
+constexpr size_t kMaxZones = 8;
+
+int64_t monotonic_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 偶奇规则判断点是否在多边形内
+bool inside_polygon(const std::vector<MotionPoint>& polygon, float x, float y) {
+    bool inside = false;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        const MotionPoint& a = polygon[i];
+        const MotionPoint& b = polygon[j];
+        if ((a.y > y) != (b.y > y) && x < (b.x - a.x) * (y - a.y) / (b.y - a.y) + a.x) {
+            inside = !inside;
+        }
+    }
+    return inside;
+}
+
+// 更新Q8背景并输出前景掩码：|cur - bg| > threshold的像素为前景，
+// 背景向当前值靠近差值的1/2^shift（前景像素用更大的shift）
+void update_background(const uint8_t* current, uint16_t* background, const uint8_t* zone_mask, uint8_t* foreground,
+                       size_t count, int threshold, int learn_shift, int foreground_shift) {
+    const uint16_t limit = static_cast<uint16_t>(threshold << 8);
+    size_t i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const uint16x8_t limit_v = vdupq_n_u16(limit);
+    const int16x8_t learn_v = vdupq_n_s16(static_cast<int16_t>(-learn_shift));        // 负数为右移
+    const int16x8_t foreground_v = vdupq_n_s16(static_cast<int16_t>(-foreground_shift));
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t cur = vshll_n_u8(vld1_u8(current + i), 8);
+        uint16x8_t bg = vld1q_u16(background + i);
+        uint16x8_t diff = vabdq_u16(cur, bg);
+        uint16x8_t fg = vcgtq_u16(diff, limit_v);
+        uint16x8_t step = vbslq_u16(fg, vshlq_u16(diff, foreground_v), vshlq_u16(diff, learn_v));
+        uint16x8_t up = vcgtq_u16(cur, bg);
+        vst1q_u16(background + i, vbslq_u16(up, vaddq_u16(bg, step), vsubq_u16(bg, step)));
+        vst1_u8(foreground + i, vand_u8(vmovn_u16(fg), vld1_u8(zone_mask + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        uint16_t cur = static_cast<uint16_t>(current[i] << 8);
+        uint16_t bg = background[i];
+        uint16_t diff = cur > bg ? cur - bg : bg - cur;
+        bool fg = diff > limit;
+        uint16_t step = static_cast<uint16_t>(diff >> (fg ? foreground_shift : learn_shift));
+        background[i] = cur > bg ? bg + step : bg - step;
+        foreground[i] = fg ? zone_mask[i] : 0;
+    }
+}
+
+} // namespace
+
+MotionDetector::MotionDetector(const MotionOptions& options, const MetricLabels& labels) : options_(options) {
+    options_.downscale = std::max(1, options_.downscale);
+    options_.learn_shift = std::min(std::max(1, options_.learn_shift), 15);
+    options_.foreground_learn_shift = std::min(std::max(options_.learn_shift, options_.foreground_learn_shift), 15);
+
+    std::vector<MotionZone> zones = options_.zones;
+    if (zones.empty()) {
+        zones.push_back({"full", {{0, 0}, {1, 0}, {1, 1}, {0, 1}}});
+    }
+    if (zones.size() > kMaxZones) {
+        LOG_WARN("MotionDetector", "Only the first %zu of %zu zones are used", kMaxZones, zones.size());
+        zones.resize(kMaxZones);
+    }
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    for (const MotionZone& zone : zones) {
+        ZoneState state;
+        state.name = zone.name;
+        state.polygon = zone.polygon;
+        MetricLabels zone_labels = labels;
+        zone_labels.emplace_back("zone", zone.name);
+        state.events = &registry.counter("motion_events_total", "Motion events started", zone_labels);
+        state.active_gauge = &registry.gauge("motion_active", "1 while a motion event is in progress", zone_labels);
+        zones_.push_back(state);
+    }
+    detect_seconds_ = &registry.histogram("motion_detect_seconds", "Motion detection time per frame", labels);
+}
+
+void MotionDetector::reset(int width, int height) {
+    width_ = width;
+    height_ = height;
+    small_width_ = std::max(1, width / options_.downscale);
+    small_height_ = std::max(1, height / options_.downscale);
+    cells_x_ = (small_width_ + kCellSize - 1) / kCellSize;
+    cells_y_ = (small_height_ + kCellSize - 1) / kCellSize;
+    size_t pixels = static_cast<size_t>(small_width_) * small_height_;
+    current_.assign(pixels, 0);
+    background_.assign(pixels, 0);
+    foreground_.assign(pixels, 0);
+    zone_mask_.assign(pixels, 0);
+    zone_bits_.assign(pixels, 0);
+    cell_counts_.assign(static_cast<size_t>(cells_x_) * zones_.size(), 0);
+    frames_ = 0;
+
+    for (int y = 0; y < small_height_; ++y) {
+        float fy = (y + 0.5f) / small_height_;
+        for (int x = 0; x < small_width_; ++x) {
+            float fx = (x + 0.5f) / small_width_;
+            uint8_t bits = 0;
+            for (size_t z = 0; z < zones_.size(); ++z) {
+                if (zones_[z].polygon.size() >= 3 && inside_polygon(zones_[z].polygon, fx, fy)) {
+                    bits |= static_cast<uint8_t>(1u << z);
+                }
+            }
+            size_t index = static_cast<size_t>(y) * small_width_ + x;
+            zone_bits_[index] = bits;
+            zone_mask_[index] = bits ? 0xFF : 0;
+        }
+    }
+}
+
+void MotionDetector::process(const uint8_t* yuyv, size_t stride, int width, int height, int camera_id,
+                             int64_t timestamp_us) {
+    if (!yuyv || width < 2 || height < 2) return;
+    int64_t start_us = monotonic_us();
+    if (width != width_ || height != height_) {
+        reset(width, height);
+    }
+
+    // 缩小：每个输出像素取2x2个Y（YUYV中Y在偶数字节）
+    const int step = options_.downscale;
+    for (int y = 0; y < small_height_; ++y) {
+        int row = std::min(y * step, height - 2);
+        const uint8_t* top = yuyv + static_cast<size_t>(row) * stride;
+        const uint8_t* bottom = top + stride;
+        uint8_t* out = &current_[static_cast<size_t>(y) * small_width_];
+        for (int x = 0; x < small_width_; ++x) {
+            size_t offset = static_cast<size_t>(std::min(x * step, width - 2)) * 2;
+            out[x] = static_cast<uint8_t>((top[offset] + top[offset + 2] + bottom[offset] + bottom[offset + 2] + 2) >> 2);
+        }
+    }
+
+    if (frames_ == 0) {
+        for (size_t i = 0; i < current_.size(); ++i) {
+            background_[i] = static_cast<uint16_t>(current_[i] << 8);
+        }
+    }
+    update_background(current_.data(), background_.data(), zone_mask_.data(), foreground_.data(), current_.size(),
+                      options_.threshold, options_.learn_shift, options_.foreground_learn_shift);
+    if (++frames_ <= options_.warmup_frames) {
+        detect_seconds_->observe((monotonic_us() - start_us) / 1e6);
+        return;
+    }
+
+    // 按单元统计各区域的前景像素
+    for (ZoneState& zone : zones_) {
+        zone.active_cells = 0;
+    }
+    std::vector<uint16_t>& counts = cell_counts_;
+    for (int cy = 0; cy < cells_y_; ++cy) {
+        std::fill(counts.begin(), counts.end(), 0);
+        int y_end = std::min((cy + 1) * kCellSize, small_height_);
+        for (int y = cy * kCellSize; y < y_end; ++y) {
+            const uint8_t* fg = &foreground_[static_cast<size_t>(y) * small_width_];
+            const uint8_t* bits = &zone_bits_[static_cast<size_t>(y) * small_width_];
+            for (int x = 0; x < small_width_; ++x) {
+                if (!fg[x]) continue;
+                uint16_t* cell = &counts[static_cast<size_t>(x / kCellSize) * zones_.size()];
+                for (unsigned b = bits[x], z = 0; b; b >>= 1, ++z) {
+                    if (b & 1) ++cell[z];
+                }
+            }
+        }
+        for (int cx = 0; cx < cells_x_; ++cx) {
+            for (size_t z = 0; z < zones_.size(); ++z) {
+                if (counts[static_cast<size_t>(cx) * zones_.size() + z] < options_.cell_fill) continue;
+                ZoneState& zone = zones_[z];
+                if (zone.active_cells++ == 0) {
+                    zone.min_cx = zone.max_cx = cx;
+                    zone.min_cy = zone.max_cy = cy;
+                } else {
+                    zone.min_cx = std::min(zone.min_cx, cx);
+                    zone.max_cx = std::max(zone.max_cx, cx);
+                    zone.max_cy = cy;
+                }
+            }
+        }
+    }
+
+    for (ZoneState& zone : zones_) {
+        update_zone(zone, camera_id, timestamp_us);
+    }
+    detect_seconds_->observe((monotonic_us() - start_us) / 1e6);
+}
+
+MotionBox MotionDetector::cell_box(const ZoneState& zone) const {
+    int unit = kCellSize * options_.downscale;
+    MotionBox box;
+    box.x = zone.min_cx * unit;
+    box.y = zone.min_cy * unit;
+    box.width = std::min((zone.max_cx + 1) * unit, width_) - box.x;
+    box.height = std::min((zone.max_cy + 1) * unit, height_) - box.y;
+    return box;
+}
+
+void MotionDetector::update_zone(ZoneState& zone, int camera_id, int64_t timestamp_us) {
+    bool motion = zone.active_cells >= options_.min_active_cells;
+    zone.motion_frames = motion ? zone.motion_frames + 1 : 0;
+    if (motion) {
+        zone.last_motion_us = timestamp_us;
+    }
+
+    if (!zone.active) {
+        if (zone.motion_frames >= options_.start_frames) {
+            zone.active = true;
+            zone.event_box = cell_box(zone);
+            zone.event_peak_cells = zone.active_cells;
+            zone.events->inc();
+            zone.active_gauge->set(1);
+            emit(MotionEvent::Type::Start, zone, camera_id, timestamp_us, zone.event_box, zone.active_cells);
+        }
+        return;
+    }
+
+    if (motion) {
+        // 事件期间累计运动范围
+        MotionBox box = cell_box(zone);
+        int right = std::max(zone.event_box.x + zone.event_box.width, box.x + box.width);
+        int bottom = std::max(zone.event_box.y + zone.event_box.height, box.y + box.height);
+        zone.event_box.x = std::min(zone.event_box.x, box.x);
+        zone.event_box.y = std::min(zone.event_box.y, box.y);
+        zone.event_box.width = right - zone.event_box.x;
+        zone.event_box.height = bottom - zone.event_box.y;
+        zone.event_peak_cells = std::max(zone.event_peak_cells, zone.active_cells);
+    } else if (timestamp_us - zone.last_motion_us >= options_.stop_ms * 1000LL) {
+        zone.active = false;
+        zone.active_gauge->set(0);
+        emit(MotionEvent::Type::Stop, zone, camera_id, timestamp_us, zone.event_box, zone.event_peak_cells);
+    }
+}
+
+void MotionDetector::emit(MotionEvent::Type type, const ZoneState& zone, int camera_id, int64_t timestamp_us,
+                          const MotionBox& box, int cells) {
+    LOG_INFO("MotionDetector", "[camera %d] Motion %s in zone %s: %dx%d at (%d,%d), %d cells", camera_id,
+             type == MotionEvent::Type::Start ? "started" : "stopped", zone.name.c_str(),
+             box.width, box.height, box.x, box.y, cells);
+    if (!callback_) return;
+    MotionEvent event;
+    event.type = type;
+    event.camera_id = camera_id;
+    event.zone = zone.name;
+    event.timestamp_us = timestamp_us;
+    event.box = box;
+    event.active_cells = cells;
+    callback_(event);
+}
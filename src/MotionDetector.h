@@ -0,0 +1,150 @@
+#pragma once
+/**
+ * @file MotionDetector.h
+ * @class MotionDetector
+ * @brief 内置移动侦测，按区域输出去抖后的开始/结束事件
+ *
+ * 直接读取YUYV采集缓冲区，不需要单独的分析进程解码推流：
+ * - 亮度按downscale倍缩小（每个输出像素取2x2个Y的平均），1080p缩小8倍为240x135
+ * - 背景模型为定点数（Q8）滑动平均：背景像素按1/2^learn_shift更新，前景像素按更慢的速率更新，
+ *   停下来的物体在数百帧后融入背景；背景更新和前景判定在ARM上用NEON每次处理8个像素
+ * - 区域为归一化坐标的多边形（最多8个），区域外的像素不参与判定；没有配置区域时整个画面为"full"
+ * - 前景按8x8单元统计，前景像素达到cell_fill的单元为活动单元，孤立噪点不会形成活动单元
+ * - 区域内活动单元连续start_frames帧不少于min_active_cells时开始事件，持续stop_ms没有运动时结束事件
+ *
+ * 事件通过回调输出，同时计入motion_events_total、motion_active指标，每帧耗时计入motion_detect_seconds。
+ * 非线程安全，由调用process()的线程（编码线程）使用。
+ */
+#include "Metrics.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 归一化坐标（0~1，相对于画面宽高）
+struct MotionPoint {
+    float x;
+    float y;
+};
+
+// 侦测区域
+struct MotionZone {
+    std::string name;
+    std::vector<MotionPoint> polygon;
+};
+
+// 采集分辨率下的矩形
+struct MotionBox {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+};
+
+// 移动侦测配置
+struct MotionOptions {
+    bool enabled = false;
+    std::vector<MotionZone> zones;      // 为空时整个画面为一个区域"full"
+    int downscale = 8;                  // 缩小倍数
+    int threshold = 20;                 // 与背景的亮度差阈值（0~255）
+    int learn_shift = 5;                // 背景像素的更新速率1/2^learn_shift（约32帧）
+    int foreground_learn_shift = 9;     // 前景像素的更新速率（约512帧）
+    int cell_fill = 16;                 // 8x8单元中前景像素达到该数量为活动单元
+    int min_active_cells = 2;
+    int start_frames = 3;
+    int stop_ms = 2000;
+    int warmup_frames = 30;             // 背景建立期间不判定
+};
+
+// 移动事件
+struct MotionEvent {
+    enum class Type { Start, Stop };
+    Type type;
+    int camera_id;
+    std::string zone;
+    int64_t timestamp_us;   // 帧采集时间（CLOCK_MONOTONIC微秒）
+    MotionBox box;          // Start：当前运动范围；Stop：整个事件期间的运动范围
+    int active_cells;       // Start：当前活动单元数；Stop：事件期间的最大值
+};
+
+class MotionDetector {
+public:
+    // 事件回调（在调用process()的线程中调用）
+    using EventCallback = std::function<void(const MotionEvent& event)>;
+
+    /**
+     * @brief 构造函数
+     * @param options 配置
+     * @param labels 运行指标标签（每个区域另加zone标签）
+     */
+    MotionDetector(const MotionOptions& options, const MetricLabels& labels);
+
+    void set_callback(EventCallback callback) { callback_ = std::move(callback); }
+
+    /**
+     * @brief 处理一帧
+     * @param yuyv YUYV数据
+     * @param stride 每行字节数
+     * @param width 宽度（像素）
+     * @param height 高度
+     * @param camera_id 来源摄像头（写入事件）
+     * @param timestamp_us 采集时间
+     */
+    void process(const uint8_t* yuyv, size_t stride, int width, int height, int camera_id, int64_t timestamp_us);
+
+    /**
+     * @brief 区域当前是否处于运动事件中
+     */
+    bool active(size_t zone) const { return zone < zones_.size() && zones_[zone].active; }
+
+private:
+    struct ZoneState {
+        std::string name;
+        std::vector<MotionPoint> polygon;
+        bool active = false;
+        int motion_frames = 0;        // 连续有运动的帧数
+        int64_t last_motion_us = 0;
+        int active_cells = 0;         // 本帧
+        int min_cx = 0, min_cy = 0, max_cx = 0, max_cy = 0;   // 本帧活动单元范围
+        MotionBox event_box;
+        int event_peak_cells = 0;
+        Counter* events = nullptr;
+        Gauge* active_gauge = nullptr;
+    };
+
+    /**
+     * @brief 尺寸变化时重新分配缓冲区并把区域多边形栅格化为像素掩码
+     */
+    void reset(int width, int height);
+
+    /**
+     * @brief 把本帧活动单元范围换算为采集分辨率下的矩形
+     */
+    MotionBox cell_box(const ZoneState& zone) const;
+
+    void update_zone(ZoneState& zone, int camera_id, int64_t timestamp_us);
+
+    void emit(MotionEvent::Type type, const ZoneState& zone, int camera_id, int64_t timestamp_us,
+              const MotionBox& box, int cells);
+
+private:
+    MotionOptions options_;
+    EventCallback callback_;
+    std::vector<ZoneState> zones_;
+    Histogram* detect_seconds_ = nullptr;
+
+    int width_ = 0;               // 采集尺寸
+    int height_ = 0;
+    int small_width_ = 0;         // 缩小后尺寸
+    int small_height_ = 0;
+    int cells_x_ = 0;
+    int cells_y_ = 0;
+    int frames_ = 0;
+    std::vector<uint8_t> current_;      // 缩小后的亮度
+    std::vector<uint16_t> background_;  // Q8背景
+    std::vector<uint8_t> zone_mask_;    // 像素所属区域（0xFF表示在任一区域内，用于前景掩码）
+    std::vector<uint8_t> zone_bits_;    // 像素所属区域的位掩码
+    std::vector<uint8_t> foreground_;   // 前景掩码（0或0xFF）
+    std::vector<uint16_t> cell_counts_; // 一个单元行内各单元、各区域的前景像素数
+};
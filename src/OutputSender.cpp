@@ -0,0 +1,446 @@
+#include "OutputSender.h"
+#include "FrameTrace.h"
+#include "Logger.h"
+#include <chrono>
+#include <ctime>
+#include <limits>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kIdleCheckMs = 100;
+constexpr int kProbeTimeoutMs = 2000;
+constexpr size_t kCongestionEventsUnhealthy = 3;
+constexpr int64_t kKeyframeRequestIntervalUs = 1000000;  // 拥塞丢包后请求IDR的最小间隔
+
+int64_t monotonic_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 从"scheme://[user@]host[:port]/..."中取出主机和端口
+bool parse_host_port(const std::string& url, std::string& host, std::string& port) {
+    size_t scheme_end = url.find("://");
+    if (scheme_end == std::string::npos) return false;
+    std::string scheme = url.substr(0, scheme_end);
+    size_t begin = scheme_end + 3;
+    size_t end = url.find_first_of("/?", begin);
+    std::string authority = url.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+    size_t at = authority.rfind('@');
+    if (at != std::string::npos) authority.erase(0, at + 1);
+
+    size_t colon;
+    if (!authority.empty() && authority[0] == '[') {
+        size_t close = authority.find(']');
+        if (close == std::string::npos) return false;
+        host = authority.substr(1, close - 1);
+        colon = authority.find(':', close);
+    } else {
+        colon = authority.rfind(':');
+        host = authority.substr(0, colon);
+    }
+    if (colon != std::string::npos) {
+        port = authority.substr(colon + 1);
+    } else if (scheme == "rtmps") {
+        port = "443";
+    } else if (scheme == "rtmp") {
+        port = "1935";
+    } else {
+        return false;
+    }
+    return !host.empty() && !port.empty();
+}
+
+// 非阻塞connect + poll，只检查TCP是否可达
+bool tcp_probe(const std::string& url, int timeout_ms) {
+    std::string host, port;
+    if (!parse_host_port(url, host, port)) return false;
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) return false;
+
+    bool reachable = false;
+    for (addrinfo* ai = result; ai && !reachable; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) continue;
+        int ret = connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (ret == 0) {
+            reachable = true;
+        } else if (errno == EINPROGRESS) {
+            pollfd pfd = {fd, POLLOUT, 0};
+            if (poll(&pfd, 1, timeout_ms) == 1) {
+                int error = 0;
+                socklen_t len = sizeof(error);
+                reachable = getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0;
+            }
+        }
+        ::close(fd);
+    }
+    freeaddrinfo(result);
+    return reachable;
+}
+
+std::vector<std::string> ingest_urls(const std::string& url, const OutputOptions& options) {
+    std::vector<std::string> urls(1, url);
+    urls.insert(urls.end(), options.backup_urls.begin(), options.backup_urls.end());
+    return urls;
+}
+
+} // namespace
+
+OutputSender::OutputSender(const std::string& url, const OutputOptions& options, const MetricLabels& labels)
+    : url_(url),
+      options_(options),
+      output_(new StreamOutput(ingest_urls(url, options), options.format, labels, options.rtmp_socket)) {
+    output_->set_pacing(options.pacing_multiplier, options.pacing_burst_ms);
+    max_temporal_layer_ = pending_temporal_layer_ = options.max_temporal_layer;
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    metrics_.queue_packets = &registry.gauge("output_queue_packets", "Packets waiting in the sender queue", labels);
+    metrics_.queue_latency = &registry.histogram("output_queue_seconds",
+                                                 "Time from enqueue to muxer write completion", labels);
+    metrics_.queue_dropped = &registry.counter("output_queue_dropped_total",
+                                               "Packets discarded by the congestion drop policy", labels);
+    metrics_.nonref_dropped = &registry.counter("output_queue_dropped_nonref_total",
+                                                "Non-reference packets discarded first by the priority drop policy",
+                                                labels);
+    metrics_.layer_dropped = &registry.counter("output_temporal_layer_dropped_total",
+                                               "Packets above the configured maximum temporal layer", labels);
+    metrics_.failovers = &registry.counter("output_failovers_total",
+                                           "Switches between primary and backup ingest URLs", labels);
+    metrics_.send_latency = &registry.gauge("output_send_latency_seconds",
+                                            "Smoothed time from enqueue to muxer write completion", labels);
+}
+
+OutputSender::~OutputSender() {
+    stop();
+    close();
+    std::lock_guard<std::mutex> lock(mutex_);
+    drop_front_locked(queue_.size());
+}
+
+bool OutputSender::open(const AVCodecContext* codec_ctx) {
+    return output_->open(codec_ctx);
+}
+
+void OutputSender::start() {
+    if (thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+    }
+    thread_ = std::thread(&OutputSender::send_loop, this);
+}
+
+void OutputSender::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (probe_thread_.joinable()) {
+        probe_thread_.join();
+    }
+}
+
+void OutputSender::close() {
+    output_->close();
+}
+
+void OutputSender::set_max_temporal_layer(int layer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_temporal_layer_ = layer;
+    bool lower = layer >= 0 && (max_temporal_layer_ < 0 || layer < max_temporal_layer_);
+    if (lower) {
+        max_temporal_layer_ = layer;  // 少发高层帧总是安全的
+    }
+}
+
+void OutputSender::enqueue(const AVPacket* pkt, uint64_t trace_id, int camera_id, PacketPriority priority,
+                           int temporal_layer) {
+    bool key = (pkt->flags & AV_PKT_FLAG_KEY) != 0;
+    int64_t now = monotonic_us();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (temporal_layer == 0) {
+            max_temporal_layer_ = pending_temporal_layer_;
+        }
+        if (max_temporal_layer_ >= 0 && temporal_layer > max_temporal_layer_) {
+            metrics_.layer_dropped->inc();
+            return;
+        }
+        if (wait_keyframe_) {
+            if (!key) {
+                metrics_.queue_dropped->inc();
+                return;
+            }
+            wait_keyframe_ = false;
+        }
+        if (congested_locked(now) && !apply_drop_policy_locked(key, priority, now)) {
+            if (wait_keyframe_ && now - keyframe_requested_us_ > kKeyframeRequestIntervalUs) {
+                // GOP可能很长（自适应GOP），不等下一个自然关键帧
+                keyframe_request_ = true;
+                keyframe_requested_us_ = now;
+            }
+            return;
+        }
+
+        QueuedPacket item;
+        item.pkt = av_packet_clone(pkt);  // 引用计数，不复制数据
+        if (!item.pkt) {
+            metrics_.queue_dropped->inc();
+            return;
+        }
+        item.enqueue_us = now;
+        item.trace_id = trace_id;
+        item.camera_id = camera_id;
+        item.priority = priority;
+        queue_.push_back(item);
+        metrics_.queue_packets->set(static_cast<double>(queue_.size()));
+    }
+    cv_.notify_one();
+}
+
+void OutputSender::drop_until_keyframe() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wait_keyframe_ = true;
+}
+
+bool OutputSender::congested_locked(int64_t now_us) const {
+    return !queue_.empty() &&
+           (queue_.size() >= options_.max_queue_packets ||
+            now_us - queue_.front().enqueue_us > options_.max_queue_ms * 1000LL ||
+            (options_.max_socket_queue_bytes > 0 && socket_queue_bytes_ > options_.max_socket_queue_bytes));
+}
+
+bool OutputSender::apply_drop_policy_locked(bool incoming_key, PacketPriority incoming_priority, int64_t now_us) {
+    size_t before = queue_.size();
+    bool keep_incoming = false;
+    if (options_.drop_policy == OutputDropPolicy::Priority) {
+        // 先丢非参考帧；已经没有非参考帧可丢时才丢参考帧（到下一个关键帧为止）
+        size_t dropped = drop_non_reference_locked();
+        if (incoming_priority == PacketPriority::NonReference) {
+            metrics_.nonref_dropped->inc();
+            ++dropped;
+        }
+        if (dropped > 0) {
+            keep_incoming = incoming_priority != PacketPriority::NonReference;
+            if (!keep_incoming) metrics_.queue_dropped->inc();
+            congestion_times_.push_back(now_us);
+            ++congestion_events_;
+            LOG_WARN_EVERY_MS_FOR("OutputSender", url_, 1000, "[%s] Sender congested, dropped %zu non-reference packets",
+                                  url_.c_str(), dropped);
+            metrics_.queue_packets->set(static_cast<double>(queue_.size()));
+            return keep_incoming;
+        }
+        keep_incoming = flush_to_keyframe_locked(incoming_key);
+    } else if (options_.drop_policy == OutputDropPolicy::FlushToKeyframe) {
+        keep_incoming = flush_to_keyframe_locked(incoming_key);
+    } else {
+        wait_keyframe_ = true;
+    }
+    if (!keep_incoming) {
+        metrics_.queue_dropped->inc();
+    }
+    congestion_times_.push_back(now_us);
+    ++congestion_events_;
+    LOG_WARN_EVERY_MS_FOR("OutputSender", url_, 1000, "[%s] Sender congested, dropped %zu queued packets%s",
+                          url_.c_str(), before - queue_.size(), wait_keyframe_ ? ", waiting for keyframe" : "");
+    metrics_.queue_packets->set(static_cast<double>(queue_.size()));
+    return keep_incoming;
+}
+
+bool OutputSender::flush_to_keyframe_locked(bool incoming_key) {
+    if (incoming_key) {
+        // 新包就是关键帧：之前的全部丢弃，从这里重新开始
+        drop_front_locked(queue_.size());
+        return true;
+    }
+    size_t last_key = queue_.size();
+    for (size_t i = queue_.size(); i-- > 0;) {
+        if (queue_[i].pkt->flags & AV_PKT_FLAG_KEY) {
+            last_key = i;
+            break;
+        }
+    }
+    if (last_key > 0 && last_key < queue_.size()) {
+        drop_front_locked(last_key);
+        return true;
+    }
+    // 队列里只有当前GOP：整段丢弃，等待下一个关键帧
+    drop_front_locked(queue_.size());
+    wait_keyframe_ = true;
+    return false;
+}
+
+size_t OutputSender::drop_non_reference_locked() {
+    size_t dropped = 0;
+    for (auto it = queue_.begin(); it != queue_.end();) {
+        if (it->priority == PacketPriority::NonReference) {
+            av_packet_free(&it->pkt);
+            it = queue_.erase(it);
+            ++dropped;
+        } else {
+            ++it;
+        }
+    }
+    metrics_.queue_dropped->inc(dropped);
+    metrics_.nonref_dropped->inc(dropped);
+    return dropped;
+}
+
+void OutputSender::drop_front_locked(size_t count) {
+    for (size_t i = 0; i < count && !queue_.empty(); ++i) {
+        av_packet_free(&queue_.front().pkt);
+        queue_.pop_front();
+    }
+    metrics_.queue_dropped->inc(count);
+}
+
+void OutputSender::send_loop() {
+    FrameTracer& tracer = FrameTracer::instance();
+    for (;;) {
+        QueuedPacket item;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            bool ready = cv_.wait_for(lock, std::chrono::milliseconds(kIdleCheckMs),
+                                      [this] { return !queue_.empty() || stopping_; });
+            if (!ready) {
+                // 空闲时也要检查健康状态（断线期间编码包可能全被丢弃）
+                lock.unlock();
+                check_health(monotonic_us());
+                continue;
+            }
+            if (queue_.empty()) break;  // 停止且已发送完
+            item = queue_.front();
+            queue_.pop_front();
+            metrics_.queue_packets->set(static_cast<double>(queue_.size()));
+        }
+
+        int64_t target_bps = target_bitrate_.exchange(0);
+        if (target_bps > 0) {
+            output_->set_target_bitrate(target_bps);  // 限速器只由发送线程访问
+        }
+
+        // 主地址恢复后在关键帧处切回，不打断GOP
+        if (fail_back_pending_ && (item.pkt->flags & AV_PKT_FLAG_KEY)) {
+            fail_back_pending_ = false;
+            int64_t now = monotonic_us();
+            if (output_->switch_url(0)) {
+                LOG_INFO("OutputSender", "[%s] Primary ingest reachable again, switched back", url_.c_str());
+                output_->take_keyframe_request();  // 当前包就是关键帧
+                metrics_.failovers->inc();
+                last_switch_us_ = now;
+                latency_ewma_us_ = 0;
+                unhealthy_since_us_ = 0;
+            } else {
+                next_probe_us_ = now + options_.probe_interval_ms * 1000LL;
+            }
+        }
+
+        if (output_->write(item.pkt)) {
+            int64_t latency_us = monotonic_us() - item.enqueue_us;
+            metrics_.queue_latency->observe(latency_us / 1e6);
+            tracer.record(item.trace_id, TraceStage::MuxerWrite, item.camera_id);
+            latency_ewma_us_ += (latency_us - latency_ewma_us_) / 8;
+            metrics_.send_latency->set(latency_ewma_us_ / 1e6);
+        }
+        if (output_->take_keyframe_request()) {
+            keyframe_request_ = true;
+        }
+        socket_queue_bytes_ = output_->send_queue_bytes();
+        av_packet_free(&item.pkt);
+        check_health(monotonic_us());
+    }
+}
+
+void OutputSender::check_health(int64_t now_us) {
+    if (output_->url_count() < 2 || output_->state() == StreamOutput::State::Closed) return;
+
+    size_t congestion_events;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (!congestion_times_.empty() &&
+               now_us - congestion_times_.front() > options_.unhealthy_hold_ms * 1000LL) {
+            congestion_times_.pop_front();
+        }
+        congestion_events = congestion_times_.size();
+    }
+
+    if (output_->state() == StreamOutput::State::Disconnected) {
+        if (now_us - output_->disconnected_since_us() > options_.failover_after_ms * 1000LL) {
+            fail_over(now_us, "disconnected");
+        }
+    } else {
+        bool slow = latency_ewma_us_ > options_.max_send_latency_ms * 1000LL;
+        bool congested = congestion_events >= kCongestionEventsUnhealthy;
+        if (!slow && !congested) {
+            unhealthy_since_us_ = 0;
+        } else if (unhealthy_since_us_ == 0) {
+            unhealthy_since_us_ = now_us;
+        } else if (now_us - unhealthy_since_us_ >= options_.unhealthy_hold_ms * 1000LL &&
+                   now_us - last_switch_us_ >= options_.unhealthy_hold_ms * 1000LL) {
+            fail_over(now_us, slow ? "send latency too high" : "repeated congestion");
+        }
+    }
+
+    // 使用备用地址期间定期探测主地址
+    if (output_->current_index() != 0) {
+        if (probe_done_.exchange(false)) {
+            if (probe_ok_) {
+                fail_back_pending_ = true;
+            } else {
+                next_probe_us_ = now_us + options_.probe_interval_ms * 1000LL;
+            }
+        }
+        if (!fail_back_pending_ && now_us >= next_probe_us_) {
+            start_probe();
+        }
+    } else {
+        fail_back_pending_ = false;
+    }
+}
+
+void OutputSender::fail_over(int64_t now_us, const char* reason) {
+    size_t from = output_->current_index();
+    size_t to = (from + 1) % output_->url_count();
+    LOG_WARN("OutputSender", "[%s] Ingest %zu unhealthy (%s), failing over to %zu", url_.c_str(), from, reason, to);
+    output_->switch_url(to);
+    metrics_.failovers->inc();  // 连接成功时由StreamOutput请求IDR
+    last_switch_us_ = now_us;
+    latency_ewma_us_ = 0;
+    unhealthy_since_us_ = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        congestion_times_.clear();
+    }
+    if (from == 0) {
+        next_probe_us_ = now_us + options_.probe_interval_ms * 1000LL;
+    }
+}
+
+void OutputSender::start_probe() {
+    if (probe_thread_.joinable()) {
+        probe_thread_.join();  // 上一次探测已返回结果
+    }
+    next_probe_us_ = std::numeric_limits<int64_t>::max();  // 结果返回后再安排下一次
+    probe_done_ = false;
+    std::string primary = url_;
+    probe_thread_ = std::thread([this, primary] {
+        probe_ok_ = tcp_probe(primary, kProbeTimeoutMs);
+        probe_done_ = true;
+    });
+}
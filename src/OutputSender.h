@@ -0,0 +1,249 @@
+#pragma once
+/**
+ * @file OutputSender.h
+ * @class OutputSender
+ * @brief 单个推流目的地的发送线程：独立的包队列、丢包策略和重连状态
+ *
+ * 编码线程把每个编码包（引用计数拷贝，不复制数据）放入各目的地的队列后立即返回，
+ * 发送线程负责写muxer和断线重连。一个目的地网络变慢或断开只会让它自己的队列积压、丢包，
+ * 不会阻塞编码线程，也不影响其他目的地。
+ *
+ * 队首包等待超过max_queue_ms、包数超过max_queue_packets或socket发送队列超过max_socket_queue_bytes
+ * 即视为拥塞，按丢包策略处理，
+ * 丢弃总是延续到下一个关键帧为止，不会发出残缺的GOP：
+ * - Priority：先丢弃非参考帧（不影响其他帧解码）；仍然拥塞时再按FlushToKeyframe处理
+ * - FlushToKeyframe：丢弃队列中最新关键帧之前的全部包（队列里没有关键帧则全部丢弃并等待下一个）
+ * - DropNewest：保留已排队的包，丢弃新包直到下一个关键帧
+ *
+ * 编码器开启时域分层时，set_max_temporal_layer()只转发不高于指定层的包（如低帧率的第二路输出），
+ * 立即降低码率而不需要重新编码。
+ *
+ * 配置了备用接入地址时，发送线程维护一个简单的健康模型：
+ * - 断线超过failover_after_ms仍未重连上，切换到下一个地址
+ * - 发送延迟（入队到写完成）的平滑值超过max_send_latency_ms，或unhealthy_hold_ms内拥塞丢包3次以上，
+ *   且持续unhealthy_hold_ms，切换到下一个地址；两次切换之间至少间隔unhealthy_hold_ms，避免来回抖动
+ * 切换先连新地址再断旧连接，并请求编码器立即产生IDR。使用备用地址期间每probe_interval_ms在后台
+ * 探测一次主地址的TCP连通性，探测成功后在下一个关键帧处切回主地址，切回不会打断GOP。
+ */
+#include "Metrics.h"
+#include "PacketPriority.h"
+#include "StreamOutput.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+enum class OutputDropPolicy {
+    Priority,
+    FlushToKeyframe,
+    DropNewest,
+};
+
+// 推流目的地配置
+struct OutputOptions {
+    std::string format = "flv";                                    // FFmpeg muxer名称
+    OutputDropPolicy drop_policy = OutputDropPolicy::Priority;
+    int max_queue_ms = 1000;                                       // 队首包最长等待时间
+    size_t max_queue_packets = 300;
+    int64_t max_socket_queue_bytes = 0;                            // socket发送队列上限，0表示不检查
+    RtmpSocketOptions rtmp_socket;                                 // rtmp://地址的传输参数
+    double pacing_multiplier = 0;                                  // 发送限速 = 目标码率 × 倍数，0表示不限速
+    int pacing_burst_ms = 20;                                      // 限速允许的突发量（按限速速率计）
+    int max_temporal_layer = -1;                                   // 只转发不高于该层的包，-1表示全部
+    std::vector<std::string> backup_urls;                          // 备用接入地址，按优先级排列
+    int failover_after_ms = 3000;                                  // 断线多久后切换到备用地址
+    int max_send_latency_ms = 2000;                                // 发送延迟平滑值上限
+    int unhealthy_hold_ms = 5000;                                  // 不健康持续多久后切换
+    int probe_interval_ms = 30000;                                 // 使用备用地址时探测主地址的间隔
+};
+
+class OutputSender {
+public:
+    /**
+     * @brief 构造函数
+     * @param url 目的地主地址（备用地址见OutputOptions::backup_urls）
+     * @param options 目的地配置
+     * @param labels 运行指标标签
+     */
+    OutputSender(const std::string& url, const OutputOptions& options, const MetricLabels& labels);
+
+    ~OutputSender();
+
+    OutputSender(const OutputSender&) = delete;
+    OutputSender& operator=(const OutputSender&) = delete;
+
+    /**
+     * @brief 按编码器参数打开输出
+     * @return 任一接入地址连接成功返回true；失败时网络目的地仍会在发送线程中按退避重连
+     */
+    bool open(const AVCodecContext* codec_ctx);
+
+    /**
+     * @brief 启动发送线程
+     */
+    void start();
+
+    /**
+     * @brief 发送完队列中剩余的包后停止发送线程
+     */
+    void stop();
+
+    /**
+     * @brief 写入文件尾并关闭输出
+     */
+    void close();
+
+    /**
+     * @brief 放入一个编码包（编码线程调用，不阻塞）
+     * @param pkt 编码包，时间戳为编码器时间基；内部增加引用，调用者保留所有权
+     * @param trace_id 来源帧的追踪ID（0表示无）
+     * @param camera_id 来源摄像头ID
+     * @param priority 包优先级（classify_h264_packet()），未知时按Reference处理
+     * @param temporal_layer 时域层号（h264_temporal_layer()），未分层时为0
+     */
+    void enqueue(const AVPacket* pkt, uint64_t trace_id, int camera_id,
+                 PacketPriority priority = PacketPriority::Reference, int temporal_layer = 0);
+
+    /**
+     * @brief 设置转发的最高时域层（任意线程调用）
+     * 降低立即生效；提高在下一个基础层包处生效，保证高层帧的参考帧都已发送。
+     * @param layer 最高层号，-1表示全部
+     */
+    void set_max_temporal_layer(int layer);
+
+    /**
+     * @brief 编码目标码率变化后更新发送限速（任意线程调用，发送线程在下一个包之前生效）
+     * @param target_bps 新的编码目标码率（VBV最大码率优先）
+     */
+    void set_target_bitrate(int64_t target_bps) { target_bitrate_ = target_bps; }
+
+    /**
+     * @brief 编码包丢失（编码器输出出错）后调用：丢弃之后送来的包直到下一个关键帧（与拥塞丢包相同）
+     */
+    void drop_until_keyframe();
+
+    /**
+     * @brief 目的地需要关键帧时返回true（每次请求只返回一次，编码线程调用）
+     */
+    bool take_keyframe_request() { return keyframe_request_.exchange(false); }
+
+    const std::string& url() const { return url_; }
+
+    /**
+     * @brief 最近一次写入后socket发送队列中的字节数，未知时返回-1（任意线程调用）
+     */
+    int64_t socket_queue_bytes() const { return socket_queue_bytes_; }
+
+    /**
+     * @brief 累计的拥塞丢包次数（任意线程调用），调用者按差值判断最近是否拥塞
+     */
+    uint64_t congestion_events() const { return congestion_events_; }
+
+private:
+    struct QueuedPacket {
+        AVPacket* pkt = nullptr;
+        int64_t enqueue_us = 0;
+        uint64_t trace_id = 0;
+        int camera_id = 0;
+        PacketPriority priority = PacketPriority::Reference;
+    };
+
+    /**
+     * @brief 发送线程函数
+     */
+    void send_loop();
+
+    /**
+     * @brief 队列是否拥塞（持有mutex_时调用）
+     */
+    bool congested_locked(int64_t now_us) const;
+
+    /**
+     * @brief 拥塞时按丢包策略处理（持有mutex_时调用）
+     * @return 新包是否仍应入队
+     */
+    bool apply_drop_policy_locked(bool incoming_key, PacketPriority incoming_priority, int64_t now_us);
+
+    /**
+     * @brief 丢弃队列中最新关键帧之前的全部包（持有mutex_时调用）
+     * @return 新包是否仍应入队
+     */
+    bool flush_to_keyframe_locked(bool incoming_key);
+
+    /**
+     * @brief 丢弃队列中所有非参考帧（持有mutex_时调用）
+     * @return 丢弃的包数
+     */
+    size_t drop_non_reference_locked();
+
+    /**
+     * @brief 丢弃队首count个包（持有mutex_时调用）
+     */
+    void drop_front_locked(size_t count);
+
+    /**
+     * @brief 按健康模型决定是否切换接入地址，并调度主地址探测（发送线程调用）
+     */
+    void check_health(int64_t now_us);
+
+    /**
+     * @brief 切换到下一个接入地址
+     */
+    void fail_over(int64_t now_us, const char* reason);
+
+    /**
+     * @brief 在后台线程探测主地址的TCP连通性
+     */
+    void start_probe();
+
+    struct SenderMetrics {
+        Gauge* queue_packets = nullptr;
+        Histogram* queue_latency = nullptr;
+        Counter* queue_dropped = nullptr;
+        Counter* nonref_dropped = nullptr;
+        Counter* layer_dropped = nullptr;
+        Counter* failovers = nullptr;
+        Gauge* send_latency = nullptr;
+    };
+
+private:
+    std::string url_;
+    OutputOptions options_;
+    std::unique_ptr<StreamOutput> output_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<QueuedPacket> queue_;
+    bool wait_keyframe_ = false;     // 拥塞丢包后，丢弃新包直到下一个关键帧
+    bool stopping_ = false;
+    std::thread thread_;
+    std::atomic<bool> keyframe_request_{false};
+    std::atomic<int64_t> socket_queue_bytes_{-1};
+    std::atomic<uint64_t> congestion_events_{0};
+    std::atomic<int64_t> target_bitrate_{0};   // 等待发送线程应用的目标码率，0表示没有变化
+    int max_temporal_layer_ = -1;          // 当前生效的最高层（受mutex_保护）
+    int pending_temporal_layer_ = -1;      // 等待基础层包后生效的最高层
+    std::deque<int64_t> congestion_times_;   // 最近的拥塞丢包时间（受mutex_保护）
+    int64_t keyframe_requested_us_ = 0;      // 上次因拥塞丢包请求IDR的时间（受mutex_保护）
+
+    // 以下只由发送线程访问
+    int64_t latency_ewma_us_ = 0;
+    int64_t unhealthy_since_us_ = 0;
+    int64_t last_switch_us_ = 0;
+    int64_t next_probe_us_ = 0;
+    bool fail_back_pending_ = false;
+    std::thread probe_thread_;
+    std::atomic<bool> probe_done_{false};
+    std::atomic<bool> probe_ok_{false};
+
+    SenderMetrics metrics_;
+};
@@ -0,0 +1,38 @@
+#include "Pacer.h"
+#include <algorithm>
+#include <cmath>
+
+void Pacer::configure(int64_t rate_bps, size_t burst_bytes) {
+    rate_bps_ = std::max<int64_t>(rate_bps, 0);
+    burst_bytes_ = std::max<size_t>(burst_bytes, 1);
+    tokens_ = static_cast<double>(burst_bytes_);
+    last_refill_us_ = 0;
+}
+
+void Pacer::refill(int64_t now_us) {
+    if (last_refill_us_ > 0 && now_us > last_refill_us_) {
+        tokens_ += (now_us - last_refill_us_) * (rate_bps_ / 8.0) / 1e6;
+        tokens_ = std::min(tokens_, static_cast<double>(burst_bytes_));
+    }
+    last_refill_us_ = now_us;
+}
+
+int64_t Pacer::wait_us(size_t bytes, int64_t now_us) {
+    if (!enabled()) return 0;
+    refill(now_us);
+    double needed = static_cast<double>(std::min(bytes, burst_bytes_));
+    if (tokens_ >= needed) return 0;
+    return static_cast<int64_t>(std::ceil((needed - tokens_) * 8e6 / rate_bps_));
+}
+
+void Pacer::consume(size_t bytes, int64_t now_us) {
+    if (!enabled()) return;
+    refill(now_us);
+    tokens_ -= static_cast<double>(bytes);
+}
+
+int64_t Pacer::take_delay_us() {
+    int64_t delay = delay_us_;
+    delay_us_ = 0;
+    return delay;
+}
@@ -0,0 +1,62 @@
+#pragma once
+/**
+ * @file Pacer.h
+ * @class Pacer
+ * @brief 令牌桶发送限速，把关键帧等大包分散到多个帧间隔内发出
+ *
+ * IDR帧通常是P帧的10~20倍，一次写入socket会在上行链路（如LTE）上形成突发，
+ * 每个GOP造成一次排队延迟尖峰甚至丢包。按“目标码率 × 倍数”限速后，大包被切成小段匀速发送，
+ * 平均码率不受影响（倍数 > 1），只是关键帧晚到若干毫秒。
+ *
+ * 令牌以字节计，按速率持续补充，桶容量（burst）决定允许的瞬时突发。
+ * 非线程安全，由发送线程使用。
+ */
+#include <cstddef>
+#include <cstdint>
+
+class Pacer {
+public:
+    /**
+     * @brief 设置限速
+     * @param rate_bps 发送速率上限（bit/s），0表示不限速
+     * @param burst_bytes 桶容量（字节），同时是单次发送的最大分段
+     */
+    void configure(int64_t rate_bps, size_t burst_bytes);
+
+    bool enabled() const { return rate_bps_ > 0; }
+    int64_t rate_bps() const { return rate_bps_; }
+    size_t burst_bytes() const { return burst_bytes_; }
+
+    /**
+     * @brief 距离有bytes字节额度还需等待的时间
+     * @param bytes 本次要发送的字节数（超过桶容量时按桶容量计算）
+     * @param now_us CLOCK_MONOTONIC微秒
+     * @return 需要等待的微秒数，0表示可以立即发送
+     */
+    int64_t wait_us(size_t bytes, int64_t now_us);
+
+    /**
+     * @brief 扣除已发送的字节（可以透支，之后的发送相应推迟）
+     */
+    void consume(size_t bytes, int64_t now_us);
+
+    /**
+     * @brief 记录因限速而等待的时间
+     */
+    void add_delay(int64_t delay_us) { delay_us_ += delay_us; }
+
+    /**
+     * @brief 取出并清零累计的限速等待时间（微秒）
+     */
+    int64_t take_delay_us();
+
+private:
+    void refill(int64_t now_us);
+
+private:
+    int64_t rate_bps_ = 0;
+    size_t burst_bytes_ = 0;
+    double tokens_ = 0;          // 当前额度（字节，可为负）
+    int64_t last_refill_us_ = 0;
+    int64_t delay_us_ = 0;
+};
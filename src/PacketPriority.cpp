@@ -0,0 +1,72 @@
+#include "PacketPriority.h"
+
+namespace {
+
+constexpr uint8_t kNalSlice = 1;
+constexpr uint8_t kNalIdrSlice = 5;
+
+// 返回起始码之后的位置，没有起始码返回size
+size_t find_start_code(const uint8_t* data, size_t size, size_t pos) {
+    for (; pos + 3 <= size; ++pos) {
+        if (data[pos] == 0 && data[pos + 1] == 0 && data[pos + 2] == 1) return pos + 3;
+    }
+    return size;
+}
+
+bool is_annexb(const uint8_t* data, size_t size) {
+    return (size >= 3 && data[0] == 0 && data[1] == 0 && data[2] == 1) ||
+           (size >= 4 && data[0] == 0 && data[1] == 0 && data[2] == 0 && data[3] == 1);
+}
+
+// 解析一个NAL头，是视频slice时输出优先级和nal_ref_idc并返回true
+bool classify_nal(uint8_t header, PacketPriority& priority, int& ref_idc) {
+    uint8_t type = header & 0x1f;
+    if (type < kNalSlice || type > kNalIdrSlice) return false;
+    ref_idc = (header >> 5) & 0x03;
+    priority = type == kNalIdrSlice ? PacketPriority::Idr
+               : (header & 0x60)    ? PacketPriority::Reference
+                                    : PacketPriority::NonReference;
+    return true;
+}
+
+} // namespace
+
+PacketPriority classify_h264_packet(const uint8_t* data, size_t size, int* nal_ref_idc) {
+    // 同一帧的所有slice的nal_unit_type和nal_ref_idc相同：找到第一个slice即返回，不扫描slice数据
+    PacketPriority priority = PacketPriority::Reference;
+    int ref_idc = -1;
+    bool has_slice = false;
+
+    if (is_annexb(data, size)) {
+        for (size_t pos = find_start_code(data, size, 0); pos < size && !has_slice;
+             pos = find_start_code(data, size, pos)) {
+            has_slice = classify_nal(data[pos], priority, ref_idc);
+        }
+    } else {
+        size_t pos = 0;
+        while (pos + 4 < size && !has_slice) {
+            size_t length = (static_cast<size_t>(data[pos]) << 24) | (static_cast<size_t>(data[pos + 1]) << 16) |
+                            (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+            if (length == 0 || length > size - pos - 4) break;
+            has_slice = classify_nal(data[pos + 4], priority, ref_idc);
+            pos += 4 + length;
+        }
+    }
+    if (nal_ref_idc) *nal_ref_idc = ref_idc;
+    return priority;
+}
+
+int h264_temporal_layer(int nal_ref_idc, int layers) {
+    if (layers <= 1 || nal_ref_idc < 0 || nal_ref_idc >= 2) return 0;
+    if (nal_ref_idc == 1) return layers >= 3 ? 1 : 0;  // 参考B帧
+    return layers - 1;                                  // 非参考B帧
+}
+
+const char* packet_priority_name(PacketPriority priority) {
+    switch (priority) {
+    case PacketPriority::Idr: return "idr";
+    case PacketPriority::Reference: return "ref";
+    case PacketPriority::NonReference: return "nonref";
+    }
+    return "unknown";
+}
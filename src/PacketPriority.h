@@ -0,0 +1,45 @@
+#pragma once
+/**
+ * @file PacketPriority.h
+ * @brief 按H.264 NAL头给编码包分级，拥塞时先丢不影响解码的包
+ *
+ * - Idr：IDR帧（NAL类型5），解码器可以从这里重新开始
+ * - Reference：被后续帧参考的帧（nal_ref_idc != 0），丢弃后直到下一个IDR的帧都无法正确解码
+ * - NonReference：不被任何帧参考（nal_ref_idc == 0，如非参考B帧、时域分层的最高层），丢弃不影响其他帧
+ *
+ * 同时支持Annex B（起始码）和AVCC（4字节长度前缀）格式的包。
+ *
+ * 时域分层（EncoderStreamer::set_temporal_layers()）由x264的分层B帧实现，层号由nal_ref_idc推出：
+ * x264在b-pyramid=strict时给IDR/I/P帧2~3、参考B帧1、非参考B帧0。丢弃最高层帧率减半，
+ * 丢弃k层以上的所有帧始终可以正确解码。
+ */
+#include <cstddef>
+#include <cstdint>
+
+enum class PacketPriority : uint8_t {
+    NonReference = 0,
+    Reference = 1,
+    Idr = 2,
+};
+
+/**
+ * @brief 按编码包中第一个视频slice的NAL头判断优先级（同一帧的所有slice类型相同，找到即返回）
+ * @param data 包数据
+ * @param size 包大小
+ * @param nal_ref_idc 可选，输出视频slice的nal_ref_idc（0~3），没有视频slice时为-1
+ * @return 包优先级；没有视频slice（只有参数集、SEI）或无法解析时按Reference处理
+ */
+PacketPriority classify_h264_packet(const uint8_t* data, size_t size, int* nal_ref_idc = nullptr);
+
+/**
+ * @brief 按x264的nal_ref_idc约定计算时域层号
+ * @param nal_ref_idc classify_h264_packet()输出的nal_ref_idc
+ * @param layers 编码时的时域层数（1表示不分层）
+ * @return 层号，0为基础层（IDR/I/P），layers-1为最高层（非参考帧）
+ */
+int h264_temporal_layer(int nal_ref_idc, int layers);
+
+/**
+ * @brief 优先级名称（用于日志和指标）
+ */
+const char* packet_priority_name(PacketPriority priority);
@@ -0,0 +1,51 @@
+#pragma once
+/**
+ * @file RawCaptureFormat.h
+ * @brief 原始采集录制文件（.rcap）格式定义
+ *
+ * 文件布局（全部小端，可直接mmap）：
+ *
+ *   RawCaptureHeader                      文件头，固定4096字节（一页，只有一个）
+ *   [RawFrameRecord + 帧数据 + 填充] * N  记录头占64字节，其后是bytes_used字节原始数据，
+ *                                         整条记录补齐到64字节；映射地址页对齐，回放时帧数据指针
+ *                                         按缓存行对齐，NEON/SIMD转换可以直接读取，每帧额外开销不超过127字节
+ *   uint64_t index[N]                     每帧记录相对文件头的偏移（正常关闭时写入）
+ *
+ * 录制进程异常退出时header.index_offset为0，回放端按记录头顺序扫描恢复。
+ */
+#include <cstdint>
+
+static constexpr char kRawCaptureMagic[8] = {'V', '4', 'L', 'R', 'C', 'A', 'P', '1'};
+static constexpr uint32_t kRawCaptureVersion = 2;  // 版本1的记录按4096字节对齐
+static constexpr uint32_t kRawFrameMagic = 0x454d5246;  // "FRME"
+static constexpr uint64_t kRawCaptureAlign = 4096;  // 文件头大小
+static constexpr uint64_t kRawRecordAlign = 64;     // 记录对齐（缓存行）
+
+struct RawCaptureHeader {
+    char magic[8];            // kRawCaptureMagic
+    uint32_t version;         // kRawCaptureVersion
+    uint32_t header_size;     // 文件头大小（kRawCaptureAlign）
+    uint32_t width;           // 图像宽度
+    uint32_t height;          // 图像高度
+    uint32_t stride;          // 步长
+    uint32_t pixel_format;    // V4L2_PIX_FMT_*
+    uint32_t buffer_length;   // 采集端单个缓冲区长度（CameraFrame::length）
+    int32_t camera_id;        // 录制时的摄像头ID
+    uint64_t frame_count;     // 帧数（正常关闭时写入）
+    uint64_t index_offset;    // 索引偏移（正常关闭时写入，0表示需扫描）
+    int64_t start_time_us;    // 录制开始的墙钟时间（仅供参考）
+};
+
+struct RawFrameRecord {
+    uint32_t magic;           // kRawFrameMagic
+    uint32_t sequence;        // CameraFrame::sequence
+    int64_t timestamp_us;     // CameraFrame::timestamp（微秒）
+    uint64_t bytes_used;      // 数据长度
+    uint64_t record_size;     // 整条记录（含头和填充）的大小
+};
+
+// 记录头之后数据起始的偏移（数据按缓存行对齐，回放端零拷贝）
+static constexpr uint64_t kRawFrameDataOffset = kRawRecordAlign;
+
+static_assert(sizeof(RawCaptureHeader) <= kRawCaptureAlign, "header must fit in one page");
+static_assert(sizeof(RawFrameRecord) <= kRawFrameDataOffset, "record header must fit before data");
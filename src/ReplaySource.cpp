@@ -0,0 +1,247 @@
+#include "ReplaySource.h"
+#include "FrameTrace.h"
+#include "Logger.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+int64_t monotonic_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+void sleep_until_us(int64_t deadline_us) {
+    timespec ts;
+    ts.tv_sec = deadline_us / 1000000;
+    ts.tv_nsec = (deadline_us % 1000000) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+}
+
+} // namespace
+
+ReplaySource::ReplaySource(const std::string& path, ReplayTiming timing, size_t buffer_count, bool loop)
+    : path_(path), timing_(timing), buffer_count_(buffer_count), loop_(loop) {
+    memset(&header_, 0, sizeof(header_));
+}
+
+ReplaySource::~ReplaySource() {
+    stop();
+    if (map_) {
+        munmap(map_, map_size_);
+        map_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool ReplaySource::initialize() {
+    if (initialized_) return true;
+    if (buffer_count_ < 2) {
+        LOG_ERROR("ReplaySource", "At least 2 buffers are required");
+        return false;
+    }
+
+    fd_ = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        LOG_ERROR("ReplaySource", "Cannot open %s: %s", path_.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd_, &st) < 0 || st.st_size < static_cast<off_t>(kRawCaptureAlign)) {
+        LOG_ERROR("ReplaySource", "%s is not a raw capture file", path_.c_str());
+        return false;
+    }
+
+    // MAP_PRIVATE + 可写：消费方原地处理帧数据时只修改私有页，不影响文件
+    map_size_ = static_cast<size_t>(st.st_size);
+    void* addr = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd_, 0);
+    if (addr == MAP_FAILED) {
+        LOG_ERROR("ReplaySource", "mmap %s failed: %s", path_.c_str(), strerror(errno));
+        map_size_ = 0;
+        return false;
+    }
+    map_ = static_cast<uint8_t*>(addr);
+    madvise(map_, map_size_, MADV_SEQUENTIAL);
+
+    if (!load_index()) {
+        return false;
+    }
+
+    free_buffers_.clear();
+    for (size_t i = 0; i < buffer_count_; ++i) {
+        free_buffers_.push_back(static_cast<int>(i));
+    }
+
+    LOG_INFO("ReplaySource", "Loaded %zu frames (%ux%u) from %s",
+             frames_.size(), header_.width, header_.height, path_.c_str());
+    initialized_ = true;
+    return true;
+}
+
+bool ReplaySource::load_index() {
+    memcpy(&header_, map_, sizeof(header_));
+    if (memcmp(header_.magic, kRawCaptureMagic, sizeof(header_.magic)) != 0 ||
+        header_.version != kRawCaptureVersion || header_.header_size != kRawCaptureAlign) {
+        LOG_ERROR("ReplaySource", "%s: bad header", path_.c_str());
+        return false;
+    }
+
+    frames_.clear();
+    uint64_t index_bytes = header_.frame_count * sizeof(uint64_t);
+    if (header_.index_offset && header_.index_offset + index_bytes <= map_size_) {
+        const uint64_t* index = reinterpret_cast<const uint64_t*>(map_ + header_.index_offset);
+        for (uint64_t i = 0; i < header_.frame_count; ++i) {
+            uint64_t offset = index[i];
+            if (offset < header_.header_size || offset % kRawRecordAlign != 0 ||
+                offset + kRawFrameDataOffset > map_size_) {
+                break;
+            }
+            const RawFrameRecord* rec = reinterpret_cast<const RawFrameRecord*>(map_ + offset);
+            if (!valid_record(rec, offset)) break;
+            frames_.push_back(rec);
+        }
+    } else {
+        // 录制未正常关闭：顺序扫描，遇到不完整的记录即停止
+        LOG_WARN("ReplaySource", "%s has no index, scanning records", path_.c_str());
+        uint64_t offset = header_.header_size;
+        while (offset + kRawFrameDataOffset <= map_size_) {
+            const RawFrameRecord* rec = reinterpret_cast<const RawFrameRecord*>(map_ + offset);
+            if (!valid_record(rec, offset)) break;
+            frames_.push_back(rec);
+            offset += rec->record_size;
+        }
+    }
+
+    if (frames_.empty()) {
+        LOG_ERROR("ReplaySource", "%s contains no frames", path_.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ReplaySource::valid_record(const RawFrameRecord* rec, uint64_t offset) const {
+    // 按减法比较，损坏的超大长度不会溢出
+    return rec->magic == kRawFrameMagic && rec->record_size >= kRawFrameDataOffset &&
+           rec->bytes_used <= rec->record_size - kRawFrameDataOffset && rec->record_size <= map_size_ - offset;
+}
+
+void ReplaySource::start() {
+    if (!initialized_ && !initialize()) {
+        return;
+    }
+    if (running_) return;
+
+    finished_ = false;
+    running_ = true;
+    thread_ = std::thread(&ReplaySource::replay_thread, this);
+}
+
+void ReplaySource::stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ReplaySource::return_buffer_to_pool(int index) {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    free_buffers_.push_back(index);
+}
+
+void ReplaySource::replay_thread() {
+    FrameTracer& tracer = FrameTracer::instance();
+
+    // 一轮回放的时长 = 首尾帧时间差 + 平均帧间隔，循环时时间轴和序列号顺延
+    const int64_t first_ts = frames_.front()->timestamp_us;
+    const int64_t last_ts = frames_.back()->timestamp_us;
+    const int64_t avg_interval = frames_.size() > 1
+        ? (last_ts - first_ts) / static_cast<int64_t>(frames_.size() - 1) : 33333;
+    const int64_t loop_duration = last_ts - first_ts + avg_interval;
+    const uint32_t loop_sequences = frames_.back()->sequence - frames_.front()->sequence + 1;
+
+    int64_t base_us = monotonic_us();
+    uint32_t sequence_offset = 0;
+    size_t pos = 0;
+
+    while (running_) {
+        if (pos == frames_.size()) {
+            if (!loop_) break;
+            pos = 0;
+            base_us += loop_duration;
+            sequence_offset += loop_sequences;
+        }
+        const RawFrameRecord* rec = frames_[pos];
+
+        int64_t due_us = base_us + (rec->timestamp_us - first_ts);
+        if (timing_ == ReplayTiming::Original) {
+            sleep_until_us(due_us);
+        }
+
+        int index = -1;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex_);
+            if (!free_buffers_.empty()) {
+                index = free_buffers_.back();
+                free_buffers_.pop_back();
+            }
+        }
+        if (index < 0) {
+            if (timing_ == ReplayTiming::Original) {
+                // 与V4L2驱动一致：到点时没有空闲缓冲区，该帧丢失
+                ++dropped_;
+                ++pos;
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            continue;
+        }
+
+        int64_t ts_us = timing_ == ReplayTiming::Original ? due_us : monotonic_us();
+
+        CameraFrame frame;
+        frame.camera_id = camera_id_;
+        frame.buf_index = index;
+        frame.fd = -1;
+        frame.data = const_cast<uint8_t*>(reinterpret_cast<const uint8_t*>(rec) + kRawFrameDataOffset);
+        frame.length = rec->record_size - kRawFrameDataOffset;  // 映射区内实际可访问的长度
+        frame.bytes_used = rec->bytes_used;
+        frame.width = header_.width;
+        frame.height = header_.height;
+        frame.stride = header_.stride;
+        frame.pixel_format = header_.pixel_format;
+        frame.timestamp.tv_sec = ts_us / 1000000;
+        frame.timestamp.tv_usec = ts_us % 1000000;
+        frame.sequence = rec->sequence + sequence_offset;
+        frame.trace_id = tracer.enabled() ? tracer.next_trace_id() : 0;
+        tracer.record(frame.trace_id, TraceStage::Dqbuf, camera_id_);
+        frame.return_buffer = [this, index]() {
+            this->return_buffer_to_pool(index);
+        };
+
+        ++pos;
+        ++delivered_;
+        if (frame_callback_) {
+            frame_callback_(frame);
+        } else {
+            return_buffer_to_pool(index);
+        }
+    }
+
+    if (pos == frames_.size() && !loop_) {
+        LOG_INFO("ReplaySource", "Replay of %s finished: %llu delivered, %llu dropped", path_.c_str(),
+                 static_cast<unsigned long long>(delivered_.load()),
+                 static_cast<unsigned long long>(dropped_.load()));
+        finished_ = true;
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+/**
+ * @file ReplaySource.h
+ * @class ReplaySource
+ * @brief 原始采集回放帧源
+ *
+ * 把FrameRecorder录制的.rcap文件通过与CameraCapture相同的帧回调路径重新送入流水线，
+ * 用于在没有摄像头的环境下复现现场问题、做可重复的性能对比。
+ *
+ * 缓冲区语义与V4L2一致：
+ * - 固定数量的缓冲区槽位（默认4），回调持有的帧在调用return_buffer()前占用一个槽位
+ * - Original模式下按录制时的时间间隔出帧，到点时没有空闲槽位则该帧被丢弃（如同驱动丢帧），
+ *   下游看到的sequence出现缺口，与现场表现一致
+ * - AsFastAsPossible模式下只要有空闲槽位就立即出帧，不丢帧，用于吞吐测试
+ *
+ * 文件通过mmap(MAP_PRIVATE)映射，帧数据零拷贝直接指向映射区；消费方即使原地修改数据
+ * 也只影响私有副本。timestamp重新基于CLOCK_MONOTONIC生成（保持录制时的相对间隔），
+ * 使采集→编码延迟等指标在回放时依然有效；sequence沿用录制值，循环回放时顺延。
+ */
+#include "FrameSource.h"
+#include "RawCaptureFormat.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum class ReplayTiming {
+    Original,          // 按录制时的帧间隔出帧
+    AsFastAsPossible   // 有空闲缓冲区就出帧
+};
+
+class ReplaySource : public FrameSource {
+public:
+    /**
+     * @brief 构造函数
+     * @param path .rcap文件路径
+     * @param timing 出帧节拍
+     * @param buffer_count 缓冲区槽位数量（与CameraCapture默认一致为4）
+     * @param loop 播放到文件末尾后是否从头循环
+     */
+    ReplaySource(const std::string& path, ReplayTiming timing = ReplayTiming::Original,
+                 size_t buffer_count = 4, bool loop = false);
+    ~ReplaySource() override;
+
+    bool initialize() override;
+    void start() override;
+    void stop() override;
+    void set_frame_callback(const FrameCallback& callback) override { frame_callback_ = callback; }
+    void set_frame_callback(FrameCallback&& callback) override { frame_callback_ = std::move(callback); }
+    bool is_running() const override { return running_; }
+    void set_camera_id(int id) override { camera_id_ = id; }
+    int get_camera_id() const override { return camera_id_; }
+
+    /**
+     * @brief 录制文件的格式信息（initialize()之后有效）
+     */
+    uint32_t width() const { return header_.width; }
+    uint32_t height() const { return header_.height; }
+    uint32_t pixel_format() const { return header_.pixel_format; }
+    size_t frame_count() const { return frames_.size(); }
+
+    /**
+     * @brief 因无空闲缓冲区而丢弃的帧数（仅Original模式）
+     */
+    uint64_t dropped_frames() const override { return dropped_; }
+
+    /**
+     * @brief 已交付的帧数
+     */
+    uint64_t delivered_frames() const { return delivered_; }
+
+    /**
+     * @brief 非循环模式下是否已播放完毕
+     */
+    bool finished() const { return finished_; }
+
+private:
+    /**
+     * @brief 解析文件头和索引；索引缺失（录制异常中断）时按记录头顺序扫描
+     * @return 成功返回true，失败返回false
+     */
+    bool load_index();
+
+    /**
+     * @brief 检查偏移offset处的记录头：魔数正确，数据和填充都在记录内，记录在映射区内
+     */
+    bool valid_record(const RawFrameRecord* rec, uint64_t offset) const;
+
+    /**
+     * @brief 回放线程：按节拍取空闲槽位并调用回调
+     */
+    void replay_thread();
+
+    /**
+     * @brief 归还槽位到空闲列表
+     */
+    void return_buffer_to_pool(int index);
+
+private:
+    std::string path_;
+    ReplayTiming timing_;
+    size_t buffer_count_;
+    bool loop_;
+    int camera_id_ = 0;
+
+    int fd_ = -1;
+    uint8_t* map_ = nullptr;
+    size_t map_size_ = 0;
+    RawCaptureHeader header_;
+    std::vector<const RawFrameRecord*> frames_;
+
+    std::atomic<bool> running_{false};
+    std::atomic<bool> finished_{false};
+    bool initialized_ = false;
+    std::thread thread_;
+    FrameCallback frame_callback_;
+
+    std::vector<int> free_buffers_;
+    std::mutex pool_mutex_;
+
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> delivered_{0};
+};
@@ -0,0 +1,64 @@
+#include "ResolutionController.h"
+#include <algorithm>
+
+namespace {
+
+// 编码器要求YUV420P的宽高为偶数
+int even(int value) {
+    return std::max(2, value & ~1);
+}
+
+} // namespace
+
+ResolutionController::ResolutionController(const AdaptiveResolutionOptions& options, int width, int height, int fps)
+    : options_(options), rungs_(options.rungs) {
+    if (rungs_.empty()) {
+        rungs_.push_back({even(width), even(height), fps});
+        rungs_.push_back({even(width * 2 / 3), even(height * 2 / 3), fps});
+        rungs_.push_back({even(width * 4 / 9), even(height * 4 / 9), fps});
+        if (fps >= 2) {
+            rungs_.push_back({rungs_.back().width, rungs_.back().height, fps / 2});
+        }
+    }
+    options_.down_after_s = std::max(1, options_.down_after_s);
+    options_.up_after_s = std::max(1, options_.up_after_s);
+    options_.up_max_s = std::max(options_.up_after_s, options_.up_max_s);
+    up_delay_s_ = options_.up_after_s;
+}
+
+size_t ResolutionController::update(const Sample& sample) {
+    bool pressure = sample.busy_ratio > options_.cpu_high || sample.queue_depth > options_.queue_high ||
+                    sample.network_congested;
+    bool headroom = sample.busy_ratio < options_.cpu_low && sample.queue_depth == 0 && !sample.network_congested;
+    pressure_s_ = pressure ? pressure_s_ + 1 : 0;
+    headroom_s_ = headroom ? headroom_s_ + 1 : 0;
+
+    // 长时间没有降档，说明当前负载稳定，恢复默认的升档等待时间
+    if (up_delay_s_ > options_.up_after_s && sample.now_us - last_down_us_ > options_.up_max_s * 1000000LL) {
+        up_delay_s_ = options_.up_after_s;
+    }
+
+    if (pressure_s_ >= options_.down_after_s && rung_ + 1 < rungs_.size()) {
+        return rung_ + 1;
+    }
+    if (headroom_s_ >= up_delay_s_ && rung_ > 0) {
+        return rung_ - 1;
+    }
+    return rung_;
+}
+
+void ResolutionController::set_rung(size_t index, int64_t now_us) {
+    if (index >= rungs_.size()) return;
+    if (index > rung_) {
+        // 升档后没撑过一个等待周期就又降档：下次升档前等更久
+        if (last_up_us_ > 0 && now_us - last_up_us_ < up_delay_s_ * 1000000LL) {
+            up_delay_s_ = std::min(up_delay_s_ * 2, options_.up_max_s);
+        }
+        last_down_us_ = now_us;
+    } else if (index < rung_) {
+        last_up_us_ = now_us;
+    }
+    rung_ = index;
+    pressure_s_ = 0;
+    headroom_s_ = 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+/**
+ * @file ResolutionController.h
+ * @class ResolutionController
+ * @brief 按CPU和网络压力选择编码分辨率/帧率档位
+ *
+ * CPU饱和时只降码率没有用（x264的耗时主要由像素数决定），需要降低编码分辨率或帧率。
+ * 档位从高到低排列（0为采集分辨率），EncoderStreamer每秒提供一次采样：
+ * - 压力：编码线程忙碌比例超过cpu_high、输入队列积压超过queue_high，或主目的地发生拥塞丢包
+ * - 余量：忙碌比例低于cpu_low、没有积压且没有拥塞
+ * 连续down_after_s秒有压力降一档；连续up_after_s秒有余量升一档。
+ * 升档后很快又降档说明上一档撑不住，升档等待时间加倍（最长up_max_s），避免在两档之间反复切换；
+ * 稳定运行up_max_s后恢复为up_after_s。
+ *
+ * 非线程安全，由编码线程使用。
+ */
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 编码档位
+struct ResolutionRung {
+    int width;
+    int height;
+    int fps;
+};
+
+// 分辨率/帧率自适应配置
+struct AdaptiveResolutionOptions {
+    bool enabled = false;
+    std::vector<ResolutionRung> rungs;  // 从高到低；为空时按采集尺寸生成：1、2/3、4/9（1080p→720p→480p），最后加一档半帧率
+    double cpu_high = 0.85;             // 编码线程忙碌比例高于该值视为CPU不足
+    double cpu_low = 0.55;              // 低于该值才算有余量
+    size_t queue_high = 3;              // 输入队列积压帧数高于该值视为CPU不足
+    int down_after_s = 2;
+    int up_after_s = 10;
+    int up_max_s = 120;
+};
+
+class ResolutionController {
+public:
+    // 一秒的运行采样
+    struct Sample {
+        int64_t now_us = 0;          // CLOCK_MONOTONIC微秒
+        double busy_ratio = 0;       // 编码线程处理帧的时间占比
+        size_t queue_depth = 0;      // 输入队列积压帧数
+        bool network_congested = false;
+    };
+
+    /**
+     * @brief 构造函数
+     * @param options 配置，rungs为空时按width/height/fps生成
+     */
+    ResolutionController(const AdaptiveResolutionOptions& options, int width, int height, int fps);
+
+    /**
+     * @brief 输入一次采样
+     * @return 目标档位（与rung()不同时，调用者应切换后调用set_rung()）
+     */
+    size_t update(const Sample& sample);
+
+    /**
+     * @brief 记录已切换到的档位，重新开始计数
+     */
+    void set_rung(size_t index, int64_t now_us);
+
+    size_t rung() const { return rung_; }
+    size_t rung_count() const { return rungs_.size(); }
+    const ResolutionRung& rung_at(size_t index) const { return rungs_[index]; }
+
+    /**
+     * @brief 当前升档等待时间（秒）
+     */
+    int up_delay_s() const { return up_delay_s_; }
+
+private:
+    AdaptiveResolutionOptions options_;
+    std::vector<ResolutionRung> rungs_;
+    size_t rung_ = 0;
+    int pressure_s_ = 0;          // 连续有压力的采样数
+    int headroom_s_ = 0;          // 连续有余量的采样数
+    int up_delay_s_ = 0;
+    int64_t last_up_us_ = 0;
+    int64_t last_down_us_ = 0;
+};
@@ -0,0 +1,462 @@
+#include "RtmpProtocol.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <random>
+
+namespace {
+
+// AMF0类型标记
+enum : uint8_t {
+    kAmfNumber = 0x00,
+    kAmfBoolean = 0x01,
+    kAmfString = 0x02,
+    kAmfObject = 0x03,
+    kAmfNull = 0x05,
+    kAmfUndefined = 0x06,
+    kAmfEcmaArray = 0x08,
+    kAmfObjectEnd = 0x09,
+    kAmfStrictArray = 0x0a,
+    kAmfDate = 0x0b,
+    kAmfLongString = 0x0c,
+};
+
+// 单条消息长度上限（消息长度字段为24位，这里只用于拒绝明显异常的输入）
+constexpr uint32_t kMaxMessageSize = 16 * 1024 * 1024;
+
+uint32_t be24(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+}
+
+uint32_t be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | be24(p + 1);
+}
+
+uint32_t le32(const uint8_t* p) {
+    return p[0] | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void put_be16(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back(static_cast<uint8_t>(v >> 8));
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+void put_be24(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back(static_cast<uint8_t>(v >> 16));
+    put_be16(out, v);
+}
+
+void put_be32(std::vector<uint8_t>& out, uint32_t v) {
+    out.push_back(static_cast<uint8_t>(v >> 24));
+    put_be24(out, v);
+}
+
+void put_le32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; ++i) out.push_back(static_cast<uint8_t>(v >> (8 * i)));
+}
+
+void put_basic_header(std::vector<uint8_t>& out, uint8_t fmt, uint32_t csid) {
+    if (csid < 64) {
+        out.push_back(static_cast<uint8_t>((fmt << 6) | csid));
+    } else if (csid < 64 + 256) {
+        out.push_back(static_cast<uint8_t>(fmt << 6));
+        out.push_back(static_cast<uint8_t>(csid - 64));
+    } else {
+        out.push_back(static_cast<uint8_t>((fmt << 6) | 1));
+        out.push_back(static_cast<uint8_t>((csid - 64) & 0xff));
+        out.push_back(static_cast<uint8_t>((csid - 64) >> 8));
+    }
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// RtmpChunkReader
+
+bool RtmpChunkReader::feed(const uint8_t* data, size_t size) {
+    bytes_received_ += size;
+    pending_.insert(pending_.end(), data, data + size);
+
+    size_t pos = 0;
+    while (pos < pending_.size()) {
+        long used = parse_chunk(pending_.data() + pos, pending_.size() - pos);
+        if (used < 0) return false;
+        if (used == 0) break;
+        pos += static_cast<size_t>(used);
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + pos);
+    return true;
+}
+
+long RtmpChunkReader::parse_chunk(const uint8_t* data, size_t size) {
+    size_t pos = 1;
+    uint8_t fmt = data[0] >> 6;
+    uint32_t csid = data[0] & 0x3f;
+    if (csid == 0) {
+        if (size < 2) return 0;
+        csid = 64 + data[1];
+        pos = 2;
+    } else if (csid == 1) {
+        if (size < 3) return 0;
+        csid = 64 + data[1] + (static_cast<uint32_t>(data[2]) << 8);
+        pos = 3;
+    }
+
+    static const size_t kHeaderSize[4] = {11, 7, 3, 0};
+    if (size < pos + kHeaderSize[fmt]) return 0;
+    const uint8_t* h = data + pos;
+    pos += kHeaderSize[fmt];
+
+    ChunkStream& cs = streams_[csid];
+    bool new_message = cs.payload.empty();
+    uint32_t field = cs.timestamp_field;
+    uint32_t length = cs.length;
+    uint8_t type = cs.type;
+    uint32_t stream_id = cs.stream_id;
+    bool extended = cs.extended;
+    if (fmt < 3) {
+        if (!new_message) return -1;  // 上一条消息尚未收完就换了新头
+        field = be24(h);
+        extended = field == 0xFFFFFF;
+    }
+    if (fmt < 2) {
+        length = be24(h + 3);
+        type = h[6];
+    }
+    if (fmt == 0) {
+        stream_id = le32(h + 7);
+    }
+    if (extended) {
+        if (size < pos + 4) return 0;
+        field = be32(data + pos);
+        pos += 4;
+    }
+    if (length > kMaxMessageSize) return -1;
+
+    uint32_t received = static_cast<uint32_t>(cs.payload.size());
+    uint32_t chunk = std::min(chunk_size_, length - received);
+    if (size < pos + chunk) return 0;
+
+    // 整个chunk已到齐，更新状态
+    if (new_message) {
+        cs.timestamp = fmt == 0 ? field : cs.timestamp + field;
+        cs.timestamp_field = field;
+        cs.length = length;
+        cs.type = type;
+        cs.stream_id = stream_id;
+        cs.extended = extended;
+        cs.payload.reserve(length);
+    }
+    cs.payload.insert(cs.payload.end(), data + pos, data + pos + chunk);
+    pos += chunk;
+
+    if (cs.payload.size() == cs.length) {
+        if (!dispatch(csid, cs)) return -1;
+    }
+    return static_cast<long>(pos);
+}
+
+bool RtmpChunkReader::dispatch(uint32_t csid, ChunkStream& cs) {
+    RtmpMessage message;
+    message.chunk_stream_id = csid;
+    message.timestamp = cs.timestamp;
+    message.type = cs.type;
+    message.stream_id = cs.stream_id;
+    message.payload.swap(cs.payload);
+    cs.payload.clear();
+
+    if (message.type == static_cast<uint8_t>(RtmpMessageType::SetChunkSize) && message.payload.size() >= 4) {
+        uint32_t size = be32(message.payload.data()) & 0x7fffffff;
+        if (size == 0) return false;
+        chunk_size_ = size;
+    } else if (message.type == static_cast<uint8_t>(RtmpMessageType::Abort) && message.payload.size() >= 4) {
+        auto it = streams_.find(be32(message.payload.data()));
+        if (it != streams_.end()) it->second.payload.clear();
+    }
+    return callback_(message);
+}
+
+// ---------------------------------------------------------------------------
+// RtmpChunkWriter
+
+void RtmpChunkWriter::write(const RtmpMessage& message, std::vector<uint8_t>& out) const {
+    std::vector<uint8_t> headers;
+    std::vector<size_t> offsets;
+    write_headers(message, message.payload.size(), headers, offsets);
+
+    size_t pos = 0;
+    for (size_t i = 0; i < offsets.size(); ++i) {
+        size_t end = i + 1 < offsets.size() ? offsets[i + 1] : headers.size();
+        out.insert(out.end(), headers.begin() + offsets[i], headers.begin() + end);
+        size_t chunk = std::min<size_t>(chunk_size_, message.payload.size() - pos);
+        out.insert(out.end(), message.payload.begin() + pos, message.payload.begin() + pos + chunk);
+        pos += chunk;
+    }
+}
+
+void RtmpChunkWriter::write_headers(const RtmpMessage& message, size_t payload_size,
+                                    std::vector<uint8_t>& headers, std::vector<size_t>& offsets) const {
+    const uint32_t length = static_cast<uint32_t>(payload_size);
+    const bool extended = message.timestamp >= 0xFFFFFF;
+
+    offsets.push_back(headers.size());
+    put_basic_header(headers, 0, message.chunk_stream_id);
+    put_be24(headers, extended ? 0xFFFFFF : message.timestamp);
+    put_be24(headers, length);
+    headers.push_back(message.type);
+    put_le32(headers, message.stream_id);
+    if (extended) put_be32(headers, message.timestamp);
+
+    for (size_t pos = chunk_size_; pos < length; pos += chunk_size_) {
+        offsets.push_back(headers.size());
+        put_basic_header(headers, 3, message.chunk_stream_id);
+        if (extended) put_be32(headers, message.timestamp);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// AMF0
+
+void Amf0Writer::number(double value) {
+    out_.push_back(kAmfNumber);
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 7; i >= 0; --i) out_.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+}
+
+void Amf0Writer::boolean(bool value) {
+    out_.push_back(kAmfBoolean);
+    out_.push_back(value ? 1 : 0);
+}
+
+void Amf0Writer::string(const std::string& value) {
+    if (value.size() > 0xffff) {
+        out_.push_back(kAmfLongString);
+        put_be32(out_, static_cast<uint32_t>(value.size()));
+    } else {
+        out_.push_back(kAmfString);
+        put_be16(out_, static_cast<uint32_t>(value.size()));
+    }
+    out_.insert(out_.end(), value.begin(), value.end());
+}
+
+void Amf0Writer::null() {
+    out_.push_back(kAmfNull);
+}
+
+void Amf0Writer::object_begin() {
+    out_.push_back(kAmfObject);
+}
+
+void Amf0Writer::object_end() {
+    put_be16(out_, 0);
+    out_.push_back(kAmfObjectEnd);
+}
+
+void Amf0Writer::key(const std::string& key) {
+    put_be16(out_, static_cast<uint32_t>(key.size()));
+    out_.insert(out_.end(), key.begin(), key.end());
+}
+
+void Amf0Writer::property(const std::string& name, double value) {
+    key(name);
+    number(value);
+}
+
+void Amf0Writer::property(const std::string& name, const std::string& value) {
+    key(name);
+    string(value);
+}
+
+bool Amf0Reader::read_number(double& value) {
+    if (pos_ + 9 > size_ || data_[pos_] != kAmfNumber) return false;
+    uint64_t bits = 0;
+    for (int i = 1; i <= 8; ++i) bits = (bits << 8) | data_[pos_ + i];
+    memcpy(&value, &bits, sizeof(value));
+    pos_ += 9;
+    return true;
+}
+
+bool Amf0Reader::read_utf8(std::string& value) {
+    if (pos_ + 2 > size_) return false;
+    size_t length = (static_cast<size_t>(data_[pos_]) << 8) | data_[pos_ + 1];
+    if (pos_ + 2 + length > size_) return false;
+    value.assign(reinterpret_cast<const char*>(data_ + pos_ + 2), length);
+    pos_ += 2 + length;
+    return true;
+}
+
+bool Amf0Reader::read_string(std::string& value) {
+    if (pos_ >= size_) return false;
+    if (data_[pos_] == kAmfString) {
+        ++pos_;
+        return read_utf8(value);
+    }
+    if (data_[pos_] == kAmfLongString) {
+        if (pos_ + 5 > size_) return false;
+        size_t length = be32(data_ + pos_ + 1);
+        if (pos_ + 5 + length > size_) return false;
+        value.assign(reinterpret_cast<const char*>(data_ + pos_ + 5), length);
+        pos_ += 5 + length;
+        return true;
+    }
+    return false;
+}
+
+bool Amf0Reader::read_null() {
+    if (pos_ >= size_ || (data_[pos_] != kAmfNull && data_[pos_] != kAmfUndefined)) return false;
+    ++pos_;
+    return true;
+}
+
+bool Amf0Reader::read_value_as_string(std::string& value, bool& simple) {
+    simple = true;
+    if (pos_ >= size_) return false;
+    switch (data_[pos_]) {
+    case kAmfNumber: {
+        double number = 0;
+        if (!read_number(number)) return false;
+        char text[32];
+        snprintf(text, sizeof(text), "%.17g", number);
+        value = text;
+        return true;
+    }
+    case kAmfBoolean:
+        if (pos_ + 2 > size_) return false;
+        value = data_[pos_ + 1] ? "true" : "false";
+        pos_ += 2;
+        return true;
+    case kAmfString:
+    case kAmfLongString:
+        return read_string(value);
+    default:
+        simple = false;
+        return skip();
+    }
+}
+
+bool Amf0Reader::read_object(std::map<std::string, std::string>& properties) {
+    if (pos_ >= size_) return false;
+    if (data_[pos_] == kAmfEcmaArray) {
+        if (pos_ + 5 > size_) return false;
+        pos_ += 5;  // 类型 + 元素数量（不可靠，以结束标记为准）
+    } else if (data_[pos_] == kAmfObject) {
+        ++pos_;
+    } else {
+        return false;
+    }
+    for (;;) {
+        std::string key;
+        if (!read_utf8(key)) return false;
+        if (key.empty() && pos_ < size_ && data_[pos_] == kAmfObjectEnd) {
+            ++pos_;
+            return true;
+        }
+        std::string value;
+        bool simple = false;
+        if (!read_value_as_string(value, simple)) return false;
+        if (simple) properties[key] = value;
+    }
+}
+
+bool Amf0Reader::skip() {
+    if (pos_ >= size_) return false;
+    switch (data_[pos_]) {
+    case kAmfNumber:
+        if (pos_ + 9 > size_) return false;
+        pos_ += 9;
+        return true;
+    case kAmfBoolean:
+        if (pos_ + 2 > size_) return false;
+        pos_ += 2;
+        return true;
+    case kAmfString:
+    case kAmfLongString: {
+        std::string ignored;
+        return read_string(ignored);
+    }
+    case kAmfNull:
+    case kAmfUndefined:
+        ++pos_;
+        return true;
+    case kAmfObject:
+    case kAmfEcmaArray: {
+        std::map<std::string, std::string> ignored;
+        return read_object(ignored);
+    }
+    case kAmfStrictArray: {
+        if (pos_ + 5 > size_) return false;
+        uint32_t count = be32(data_ + pos_ + 1);
+        pos_ += 5;
+        for (uint32_t i = 0; i < count; ++i) {
+            if (!skip()) return false;
+        }
+        return true;
+    }
+    case kAmfDate:
+        if (pos_ + 11 > size_) return false;
+        pos_ += 11;
+        return true;
+    default:
+        return false;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// 握手与控制消息
+
+std::vector<uint8_t> rtmp_server_handshake(const uint8_t* c0c1) {
+    std::vector<uint8_t> out;
+    out.reserve(1 + 2 * kRtmpHandshakeSize);
+    out.push_back(3);  // S0：RTMP版本3
+
+    // S1：时间(4) + 0(4) + 随机数据
+    uint32_t now = static_cast<uint32_t>(time(nullptr));
+    put_be32(out, now);
+    put_be32(out, 0);
+    std::minstd_rand rng(now);
+    for (size_t i = 8; i < kRtmpHandshakeSize; ++i) out.push_back(static_cast<uint8_t>(rng()));
+
+    // S2：回显C1
+    out.insert(out.end(), c0c1 + 1, c0c1 + 1 + kRtmpHandshakeSize);
+    return out;
+}
+
+std::vector<uint8_t> rtmp_client_handshake() {
+    std::vector<uint8_t> out;
+    out.reserve(1 + kRtmpHandshakeSize);
+    out.push_back(3);  // C0：RTMP版本3
+
+    // C1：时间(4) + 0(4) + 随机数据
+    uint32_t now = static_cast<uint32_t>(time(nullptr));
+    put_be32(out, now);
+    put_be32(out, 0);
+    std::minstd_rand rng(now ^ 0x5a5a5a5a);
+    for (size_t i = 8; i < kRtmpHandshakeSize; ++i) out.push_back(static_cast<uint8_t>(rng()));
+    return out;
+}
+
+RtmpMessage rtmp_control_message(RtmpMessageType type, uint32_t value) {
+    RtmpMessage message;
+    message.chunk_stream_id = kRtmpControlChunkStream;
+    message.type = static_cast<uint8_t>(type);
+    put_be32(message.payload, value);
+    return message;
+}
+
+RtmpMessage rtmp_peer_bandwidth_message(uint32_t window, uint8_t limit_type) {
+    RtmpMessage message = rtmp_control_message(RtmpMessageType::SetPeerBandwidth, window);
+    message.payload.push_back(limit_type);
+    return message;
+}
+
+RtmpMessage rtmp_user_control_message(uint16_t event, uint32_t value) {
+    RtmpMessage message;
+    message.chunk_stream_id = kRtmpControlChunkStream;
+    message.type = static_cast<uint8_t>(RtmpMessageType::UserControl);
+    put_be16(message.payload, event);
+    put_be32(message.payload, value);
+    return message;
+}
@@ -0,0 +1,225 @@
+#pragma once
+/**
+ * @file RtmpProtocol.h
+ * @brief RTMP协议基础组件：握手、chunk流收发、AMF0编解码
+ *
+ * 只实现推流用到的子集（AMF0命令、音视频/脚本消息、协议控制消息），
+ * 供本地RTMP接收端（tools/rtmp_sink.cpp）和自定义网络传输共用，不依赖FFmpeg。
+ *
+ * chunk解析与FFmpeg的rtmppkt.c保持一致：新消息以fmt3开头时时间戳累加上一个时间戳字段，
+ * 时间戳字段为0xFFFFFF时每个chunk（包括续传chunk）都带4字节扩展时间戳。
+ */
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+// RTMP消息类型
+enum class RtmpMessageType : uint8_t {
+    SetChunkSize = 1,
+    Abort = 2,
+    Acknowledgement = 3,
+    UserControl = 4,
+    WindowAckSize = 5,
+    SetPeerBandwidth = 6,
+    Audio = 8,
+    Video = 9,
+    DataAmf0 = 18,
+    CommandAmf0 = 20,
+};
+
+constexpr size_t kRtmpHandshakeSize = 1536;
+constexpr uint32_t kRtmpDefaultChunkSize = 128;
+
+// 常用chunk stream ID
+constexpr uint32_t kRtmpControlChunkStream = 2;   // 协议控制消息
+constexpr uint32_t kRtmpCommandChunkStream = 3;   // connect/createStream等命令
+constexpr uint32_t kRtmpStreamChunkStream = 5;    // onStatus等流命令
+
+struct RtmpMessage {
+    uint32_t chunk_stream_id = 0;
+    uint32_t timestamp = 0;     // 毫秒（已累加delta）
+    uint8_t type = 0;           // RtmpMessageType
+    uint32_t stream_id = 0;
+    std::vector<uint8_t> payload;
+};
+
+/**
+ * @class RtmpChunkReader
+ * @brief 把收到的字节流重组为RTMP消息
+ *
+ * 对端的Set Chunk Size/Abort消息在内部处理后仍会交给回调。
+ */
+class RtmpChunkReader {
+public:
+    // 返回false表示调用者要求停止解析
+    using MessageCallback = std::function<bool(const RtmpMessage& message)>;
+
+    explicit RtmpChunkReader(MessageCallback callback) : callback_(std::move(callback)) {}
+
+    /**
+     * @brief 送入收到的数据，凑满的消息逐条回调
+     * @return 协议错误或回调要求停止时返回false
+     */
+    bool feed(const uint8_t* data, size_t size);
+
+    /**
+     * @brief 已送入的总字节数（用于Acknowledgement）
+     */
+    uint64_t bytes_received() const { return bytes_received_; }
+
+    uint32_t chunk_size() const { return chunk_size_; }
+
+private:
+    struct ChunkStream {
+        uint32_t timestamp = 0;
+        uint32_t timestamp_field = 0;  // 上一个chunk头中的时间戳字段（fmt0为绝对值，其余为delta）
+        uint32_t length = 0;
+        uint8_t type = 0;
+        uint32_t stream_id = 0;
+        bool extended = false;
+        std::vector<uint8_t> payload;  // 正在拼接的消息
+    };
+
+    /**
+     * @brief 解析一个chunk
+     * @return 消耗的字节数；数据不足返回0，协议错误返回-1
+     */
+    long parse_chunk(const uint8_t* data, size_t size);
+
+    /**
+     * @brief 消息拼接完成
+     */
+    bool dispatch(uint32_t csid, ChunkStream& cs);
+
+private:
+    MessageCallback callback_;
+    std::map<uint32_t, ChunkStream> streams_;
+    std::vector<uint8_t> pending_;
+    uint32_t chunk_size_ = kRtmpDefaultChunkSize;
+    uint64_t bytes_received_ = 0;
+};
+
+/**
+ * @class RtmpChunkWriter
+ * @brief 把RTMP消息切分为chunk
+ *
+ * 每条消息的首个chunk使用fmt0完整头，后续chunk使用fmt3。
+ */
+class RtmpChunkWriter {
+public:
+    /**
+     * @brief 序列化一条消息，追加到out
+     */
+    void write(const RtmpMessage& message, std::vector<uint8_t>& out) const;
+
+    /**
+     * @brief 只生成chunk头，用于分散写（负载不复制）
+     * 第i个chunk头位于headers[offsets[i], offsets[i+1])（最后一个到headers末尾），
+     * 之后紧跟负载的第i段（每段chunk_size()字节，最后一段为余下部分）。
+     * @param message 消息头字段（payload不使用）
+     * @param payload_size 负载长度
+     */
+    void write_headers(const RtmpMessage& message, size_t payload_size,
+                       std::vector<uint8_t>& headers, std::vector<size_t>& offsets) const;
+
+    /**
+     * @brief 设置本端发送的chunk大小（需同时向对端发送Set Chunk Size消息）
+     */
+    void set_chunk_size(uint32_t size) { chunk_size_ = size; }
+
+    uint32_t chunk_size() const { return chunk_size_; }
+
+private:
+    uint32_t chunk_size_ = kRtmpDefaultChunkSize;
+};
+
+/**
+ * @class Amf0Writer
+ * @brief AMF0编码（追加到外部缓冲区）
+ */
+class Amf0Writer {
+public:
+    explicit Amf0Writer(std::vector<uint8_t>& out) : out_(out) {}
+
+    void number(double value);
+    void boolean(bool value);
+    void string(const std::string& value);
+    void null();
+    void object_begin();
+    void object_end();
+
+    // 对象属性（需在object_begin()/object_end()之间调用）
+    void property(const std::string& key, double value);
+    void property(const std::string& key, const std::string& value);
+    void property(const std::string& key, const char* value) { property(key, std::string(value)); }
+
+private:
+    void key(const std::string& key);
+
+    std::vector<uint8_t>& out_;
+};
+
+/**
+ * @class Amf0Reader
+ * @brief AMF0解码，只支持命令消息中出现的类型
+ */
+class Amf0Reader {
+public:
+    Amf0Reader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    bool read_number(double& value);
+    bool read_string(std::string& value);
+    bool read_null();
+
+    /**
+     * @brief 读取对象，数字/字符串/布尔属性转为字符串保存，嵌套对象跳过
+     */
+    bool read_object(std::map<std::string, std::string>& properties);
+
+    /**
+     * @brief 跳过一个任意类型的值
+     */
+    bool skip();
+
+    bool at_end() const { return pos_ >= size_; }
+    size_t position() const { return pos_; }
+
+private:
+    bool read_utf8(std::string& value);   // 无类型标记的短字符串（对象的键）
+    bool read_value_as_string(std::string& value, bool& simple);
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+/**
+ * @brief 服务端握手：根据客户端的C0+C1生成S0+S1+S2
+ * @param c0c1 客户端发送的1+1536字节
+ * @return 1+1536*2字节，C1的版本字段为0时按简单握手处理（FFmpeg推流端不校验S1摘要）
+ */
+std::vector<uint8_t> rtmp_server_handshake(const uint8_t* c0c1);
+
+/**
+ * @brief 客户端握手：生成C0+C1（简单握手，版本字段为0），收到S0+S1+S2后回送S1作为C2
+ */
+std::vector<uint8_t> rtmp_client_handshake();
+
+/**
+ * @brief 构造协议控制消息（Set Chunk Size/Window Ack Size/Acknowledgement，4字节参数）
+ */
+RtmpMessage rtmp_control_message(RtmpMessageType type, uint32_t value);
+
+/**
+ * @brief 构造Set Peer Bandwidth消息
+ * @param limit_type 0硬限制，1软限制，2动态
+ */
+RtmpMessage rtmp_peer_bandwidth_message(uint32_t window, uint8_t limit_type);
+
+/**
+ * @brief 构造User Control消息（Stream Begin等，事件参数为4字节）
+ */
+RtmpMessage rtmp_user_control_message(uint16_t event, uint32_t value);
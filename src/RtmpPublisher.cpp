@@ -0,0 +1,598 @@
+#include "RtmpPublisher.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <linux/sockios.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr int kPollSliceMs = 50;
+constexpr int kIoTimeoutMs = 10000;   // 没有设置interrupt回调时的兜底超时
+
+// 音视频/脚本消息使用的chunk stream（与FFmpeg rtmpproto一致）
+constexpr uint32_t kAudioChunkStream = 4;
+constexpr uint32_t kVideoChunkStream = 6;
+constexpr uint32_t kDataChunkStream = 8;
+
+constexpr size_t kFlvTagHeaderSize = 11;
+constexpr size_t kFlvPrevTagSize = 4;
+
+uint32_t be24(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+}
+
+uint32_t be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | be24(p + 1);
+}
+
+int64_t monotonic_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t monotonic_ms() {
+    return monotonic_us() / 1000;
+}
+
+RtmpMessage command_message(uint32_t chunk_stream_id, uint32_t stream_id) {
+    RtmpMessage message;
+    message.chunk_stream_id = chunk_stream_id;
+    message.type = static_cast<uint8_t>(RtmpMessageType::CommandAmf0);
+    message.stream_id = stream_id;
+    return message;
+}
+
+} // namespace
+
+RtmpPublisher::RtmpPublisher(const RtmpSocketOptions& options)
+    : options_(options),
+      reader_([this](const RtmpMessage& message) { return handle_message(message); }) {
+}
+
+RtmpPublisher::~RtmpPublisher() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool RtmpPublisher::fail(int error) {
+    error_ = error;
+    return false;
+}
+
+bool RtmpPublisher::connect(const std::string& url) {
+    // rtmp://host[:port]/app[/instance]/stream[?query]
+    const std::string scheme = "rtmp://";
+    url_ = url;
+    if (url.compare(0, scheme.size(), scheme) != 0) {
+        LOG_ERROR("RtmpPublisher", "Unsupported URL: %s", url.c_str());
+        return fail(EINVAL);
+    }
+    size_t path_begin = url.find('/', scheme.size());
+    std::string authority = url.substr(scheme.size(), path_begin == std::string::npos ? std::string::npos
+                                                                                          : path_begin - scheme.size());
+    std::string path = path_begin == std::string::npos ? std::string() : url.substr(path_begin + 1);
+    size_t query = path.find('?');
+    size_t slash = path.rfind('/', query == std::string::npos ? std::string::npos : query);
+    if (authority.empty() || slash == std::string::npos || slash == 0 || slash + 1 >= path.size()) {
+        LOG_ERROR("RtmpPublisher", "URL must be rtmp://host[:port]/app/stream: %s", url.c_str());
+        return fail(EINVAL);
+    }
+    app_ = path.substr(0, slash);
+    stream_name_ = path.substr(slash + 1);
+    tc_url_ = scheme + authority + "/" + app_;
+
+    std::string host = authority;
+    std::string port = "1935";
+    if (!authority.empty() && authority[0] == '[') {
+        size_t close = authority.find(']');
+        host = authority.substr(1, close == std::string::npos ? std::string::npos : close - 1);
+        if (close != std::string::npos && close + 1 < authority.size() && authority[close + 1] == ':') {
+            port = authority.substr(close + 2);
+        }
+    } else {
+        size_t colon = authority.rfind(':');
+        if (colon != std::string::npos) {
+            host = authority.substr(0, colon);
+            port = authority.substr(colon + 1);
+        }
+    }
+
+    if (!open_socket(host, port)) return false;
+    apply_socket_options();
+    if (!handshake() || !send_connect() || !send_publish()) {
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    LOG_INFO("RtmpPublisher", "Publishing %s (app=%s, stream id %u)", url.c_str(), app_.c_str(), stream_id_);
+    return true;
+}
+
+bool RtmpPublisher::open_socket(const std::string& host, const std::string& port) {
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* result = nullptr;
+    int ret = getaddrinfo(host.c_str(), port.c_str(), &hints, &result);
+    if (ret != 0) {
+        LOG_ERROR_EVERY_MS_FOR("RtmpPublisher", url_, 1000, "Cannot resolve %s: %s", host.c_str(), gai_strerror(ret));
+        return fail(EHOSTUNREACH);
+    }
+
+    for (addrinfo* ai = result; ai; ai = ai->ai_next) {
+        fd_ = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd_ < 0) {
+            error_ = errno;
+            continue;
+        }
+        bool connected = ::connect(fd_, ai->ai_addr, ai->ai_addrlen) == 0;
+        if (!connected) {
+            if (errno != EINPROGRESS) {
+                error_ = errno;
+            } else if (wait_fd(POLLOUT)) {
+                int error = 0;
+                socklen_t len = sizeof(error);
+                getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &len);
+                connected = error == 0;
+                error_ = error;
+            }
+        }
+        if (connected) {
+            freeaddrinfo(result);
+            error_ = 0;
+            return true;
+        }
+        ::close(fd_);
+        fd_ = -1;
+    }
+    freeaddrinfo(result);
+    if (error_ == 0) error_ = ECONNREFUSED;
+    return false;
+}
+
+void RtmpPublisher::apply_socket_options() {
+    // 设置失败不影响推流，只记录
+    if (options_.tcp_nodelay) {
+        int one = 1;
+        if (setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0) {
+            LOG_WARN("RtmpPublisher", "TCP_NODELAY failed: %s", strerror(errno));
+        }
+    }
+    if (options_.send_buffer_bytes > 0) {
+        int size = options_.send_buffer_bytes;
+        if (setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) < 0) {
+            LOG_WARN("RtmpPublisher", "SO_SNDBUF %d failed: %s", size, strerror(errno));
+        }
+    }
+#ifdef TCP_NOTSENT_LOWAT
+    if (options_.notsent_lowat_bytes > 0) {
+        int lowat = options_.notsent_lowat_bytes;
+        if (setsockopt(fd_, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat)) < 0) {
+            LOG_WARN("RtmpPublisher", "TCP_NOTSENT_LOWAT %d failed: %s", lowat, strerror(errno));
+        }
+    }
+#endif
+}
+
+bool RtmpPublisher::handshake() {
+    std::vector<uint8_t> c0c1 = rtmp_client_handshake();
+    if (!send_all(c0c1.data(), c0c1.size())) return false;
+
+    // S0 + S1 + S2
+    std::vector<uint8_t> response(1 + 2 * kRtmpHandshakeSize);
+    size_t received = 0;
+    while (received < response.size()) {
+        if (!wait_fd(POLLIN)) return false;
+        ssize_t n = recv(fd_, response.data() + received, response.size() - received, MSG_DONTWAIT);
+        if (n == 0) return fail(ECONNRESET);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            return fail(errno);
+        }
+        received += static_cast<size_t>(n);
+    }
+    if (response[0] != 3) {
+        LOG_ERROR("RtmpPublisher", "Unsupported RTMP version %u from server", response[0]);
+        return fail(EPROTO);
+    }
+    // C2：回送S1
+    return send_all(response.data() + 1, kRtmpHandshakeSize);
+}
+
+bool RtmpPublisher::send_connect() {
+    if (!send_message(rtmp_control_message(RtmpMessageType::SetChunkSize, options_.chunk_size))) return false;
+    writer_.set_chunk_size(options_.chunk_size);
+
+    RtmpMessage connect = command_message(kRtmpCommandChunkStream, 0);
+    Amf0Writer w(connect.payload);
+    w.string("connect");
+    w.number(1);
+    w.object_begin();
+    w.property("app", app_);
+    w.property("type", "nonprivate");
+    w.property("flashVer", "FMLE/3.0 (compatible; v4l2-streamer)");
+    w.property("tcUrl", tc_url_);
+    w.object_end();
+    if (!send_message(connect) || !wait_command(1, "_result")) {
+        LOG_ERROR_EVERY_MS_FOR("RtmpPublisher", url_, 1000, "connect rejected for app %s", app_.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool RtmpPublisher::send_publish() {
+    // releaseStream/FCPublish不等待应答（部分服务器不回复）
+    const char* prepare[] = {"releaseStream", "FCPublish"};
+    double transaction = 2;
+    for (const char* name : prepare) {
+        RtmpMessage message = command_message(kRtmpCommandChunkStream, 0);
+        Amf0Writer w(message.payload);
+        w.string(name);
+        w.number(transaction++);
+        w.null();
+        w.string(stream_name_);
+        if (!send_message(message)) return false;
+    }
+
+    RtmpMessage create = command_message(kRtmpCommandChunkStream, 0);
+    Amf0Writer cw(create.payload);
+    cw.string("createStream");
+    cw.number(transaction);
+    cw.null();
+    if (!send_message(create) || !wait_command(transaction, "_result")) {
+        LOG_ERROR_EVERY_MS_FOR("RtmpPublisher", url_, 1000, "createStream failed");
+        return false;
+    }
+    stream_id_ = static_cast<uint32_t>(created_stream_id_);
+
+    RtmpMessage publish = command_message(kRtmpStreamChunkStream, stream_id_);
+    Amf0Writer pw(publish.payload);
+    pw.string("publish");
+    pw.number(0);
+    pw.null();
+    pw.string(stream_name_);
+    pw.string("live");
+    if (!send_message(publish) || !wait_command(0, "onStatus")) {
+        LOG_ERROR_EVERY_MS_FOR("RtmpPublisher", url_, 1000, "publish rejected for stream %s", stream_name_.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool RtmpPublisher::wait_command(double transaction, const char* name) {
+    wait_transaction_ = transaction;
+    wait_name_ = name;
+    wait_done_ = false;
+    wait_ok_ = false;
+    while (!wait_done_) {
+        if (!pump_input(true)) return false;
+    }
+    wait_name_.clear();
+    return wait_ok_ || fail(ECONNREFUSED);
+}
+
+bool RtmpPublisher::handle_message(const RtmpMessage& message) {
+    const std::vector<uint8_t>& payload = message.payload;
+    switch (static_cast<RtmpMessageType>(message.type)) {
+    case RtmpMessageType::WindowAckSize:
+        if (payload.size() >= 4) ack_window_ = be32(payload.data());
+        return true;
+    case RtmpMessageType::UserControl:
+        // Ping Request(6) -> Ping Response(7)
+        if (payload.size() >= 6 && payload[0] == 0 && payload[1] == 6) {
+            return send_message(rtmp_user_control_message(7, be32(payload.data() + 2)));
+        }
+        return true;
+    case RtmpMessageType::CommandAmf0:
+        break;
+    default:
+        return true;
+    }
+
+    Amf0Reader amf(payload.data(), payload.size());
+    std::string name;
+    double transaction = 0;
+    if (!amf.read_string(name) || !amf.read_number(transaction)) return true;
+
+    if ((name == "_result" || name == "_error") && wait_name_ == "_result" && transaction == wait_transaction_) {
+        wait_done_ = true;
+        wait_ok_ = name == "_result";
+        double stream_id = 0;
+        if (wait_ok_ && amf.skip() && amf.read_number(stream_id)) {
+            created_stream_id_ = stream_id;  // createStream的应答
+        }
+    } else if (name == "onStatus") {
+        std::map<std::string, std::string> info;
+        amf.read_null();
+        amf.read_object(info);
+        if (info["level"] == "error") {
+            LOG_WARN("RtmpPublisher", "Server status %s: %s", info["code"].c_str(), info["description"].c_str());
+        }
+        if (wait_name_ == "onStatus") {
+            if (info["code"] == "NetStream.Publish.Start") {
+                wait_done_ = true;
+                wait_ok_ = true;
+            } else if (info["level"] == "error") {
+                wait_done_ = true;
+            }
+        }
+    }
+    return true;
+}
+
+bool RtmpPublisher::pump_input(bool wait) {
+    uint8_t buffer[4096];
+    for (;;) {
+        ssize_t n = recv(fd_, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (n == 0) return fail(ECONNRESET);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) return fail(errno);
+            if (!wait) break;
+            if (!wait_fd(POLLIN)) return false;
+            continue;
+        }
+        if (!reader_.feed(buffer, static_cast<size_t>(n))) {
+            return error_ ? false : fail(EPROTO);
+        }
+        wait = false;  // 已读到数据，剩余的不再等待
+    }
+
+    // 按服务器的窗口大小回复Acknowledgement
+    uint64_t received = reader_.bytes_received();
+    if (ack_window_ > 0 && received - acked_bytes_ >= ack_window_) {
+        acked_bytes_ = received;
+        return send_message(rtmp_control_message(RtmpMessageType::Acknowledgement,
+                                                 static_cast<uint32_t>(received)));
+    }
+    return true;
+}
+
+bool RtmpPublisher::write_flv(const uint8_t* data, size_t size) {
+    if (fd_ < 0) return fail(ENOTCONN);
+    if (!pump_input(false)) return false;
+
+    long consumed;
+    if (flv_pending_.empty()) {
+        consumed = parse_flv(data, size);  // 完整的tag直接引用muxer缓冲区
+        if (consumed < 0) return fail(EPROTO);
+        if (!flush_queued()) return false;
+        flv_pending_.assign(data + consumed, data + size);
+    } else {
+        flv_pending_.insert(flv_pending_.end(), data, data + size);
+        consumed = parse_flv(flv_pending_.data(), flv_pending_.size());
+        if (consumed < 0) return fail(EPROTO);
+        if (!flush_queued()) return false;
+        flv_pending_.erase(flv_pending_.begin(), flv_pending_.begin() + consumed);
+    }
+    return true;
+}
+
+long RtmpPublisher::parse_flv(const uint8_t* data, size_t size) {
+    size_t pos = 0;
+    if (!flv_header_done_) {
+        // FLV头（9字节，长度字段给出实际长度）+ PreviousTagSize0
+        if (size < 9) return 0;
+        if (std::memcmp(data, "FLV", 3) != 0) return -1;
+        size_t header_size = be32(data + 5) + kFlvPrevTagSize;
+        if (size < header_size) return 0;
+        pos = header_size;
+        flv_header_done_ = true;
+    }
+
+    while (size - pos >= kFlvTagHeaderSize) {
+        const uint8_t* tag = data + pos;
+        uint32_t data_size = be24(tag + 1);
+        if (size - pos < kFlvTagHeaderSize + data_size + kFlvPrevTagSize) break;
+
+        RtmpMessage header;
+        header.type = tag[0] & 0x1f;
+        header.timestamp = be24(tag + 4) | (static_cast<uint32_t>(tag[7]) << 24);
+        header.stream_id = stream_id_;
+        const uint8_t* payload = tag + kFlvTagHeaderSize;
+        switch (static_cast<RtmpMessageType>(header.type)) {
+        case RtmpMessageType::Audio:
+            header.chunk_stream_id = kAudioChunkStream;
+            queue_message(header, payload, data_size);
+            break;
+        case RtmpMessageType::Video:
+            header.chunk_stream_id = kVideoChunkStream;
+            queue_message(header, payload, data_size);
+            break;
+        case RtmpMessageType::DataAmf0: {
+            // 推流时onMetaData需加上@setDataFrame前缀，服务器才会保存并转发给播放端
+            header.chunk_stream_id = kDataChunkStream;
+            std::vector<uint8_t> prefixed;
+            Amf0Writer(prefixed).string("@setDataFrame");
+            prefixed.insert(prefixed.end(), payload, payload + data_size);
+            owned_payloads_.push_back(std::move(prefixed));
+            queue_message(header, owned_payloads_.back().data(), owned_payloads_.back().size());
+            break;
+        }
+        default:
+            break;
+        }
+        pos += kFlvTagHeaderSize + data_size + kFlvPrevTagSize;
+    }
+    return static_cast<long>(pos);
+}
+
+void RtmpPublisher::queue_message(const RtmpMessage& header, const uint8_t* payload, size_t size) {
+    size_t first = header_offsets_.size();
+    writer_.write_headers(header, size, chunk_headers_, header_offsets_);
+
+    size_t pos = 0;
+    for (size_t i = first; i < header_offsets_.size(); ++i) {
+        size_t end = i + 1 < header_offsets_.size() ? header_offsets_[i + 1] : chunk_headers_.size();
+        segments_.push_back(Segment{true, nullptr, header_offsets_[i], end - header_offsets_[i]});
+        size_t chunk = std::min<size_t>(writer_.chunk_size(), size - pos);
+        if (chunk > 0) {
+            segments_.push_back(Segment{false, payload + pos, 0, chunk});
+        }
+        pos += chunk;
+    }
+}
+
+bool RtmpPublisher::flush_queued() {
+    std::vector<iovec> iov;
+    iov.reserve(segments_.size());
+    for (const Segment& segment : segments_) {
+        const uint8_t* base = segment.header ? chunk_headers_.data() + segment.offset : segment.data;
+        iov.push_back(iovec{const_cast<uint8_t*>(base), segment.size});
+    }
+    bool ok = iov.empty() || send_iov(iov.data(), iov.size());
+    segments_.clear();
+    chunk_headers_.clear();
+    header_offsets_.clear();
+    owned_payloads_.clear();
+    return ok;
+}
+
+bool RtmpPublisher::send_message(const RtmpMessage& message) {
+    queue_message(message, message.payload.data(), message.payload.size());
+    return flush_queued();
+}
+
+bool RtmpPublisher::send_all(const uint8_t* data, size_t size) {
+    iovec iov{const_cast<uint8_t*>(data), size};
+    return send_iov(&iov, 1);
+}
+
+bool RtmpPublisher::send_iov(iovec* iov, size_t count) {
+    // sendmsg等同于writev，但可以用MSG_NOSIGNAL避免对端关闭时触发SIGPIPE
+    while (count > 0) {
+        // 限速时每次最多发送一个桶容量
+        size_t limit = SIZE_MAX;
+        if (pacer_ && pacer_->enabled()) {
+            size_t pending = 0;
+            for (size_t i = 0; i < count; ++i) pending += iov[i].iov_len;
+            limit = std::max<size_t>(std::min(pending, pacer_->burst_bytes()), 1);
+            if (!wait_pacer(limit)) return false;
+        }
+
+        // 设置了TCP_NOTSENT_LOWAT时，未发出数据低于水位才可写
+        if (!wait_fd(POLLOUT)) return false;
+
+        // 截短iovec列表，使本次发送不超过limit字节
+        size_t used = 0;
+        size_t total = 0;
+        size_t max_iov = std::min<size_t>(count, IOV_MAX);
+        while (used < max_iov && total < limit) total += iov[used++].iov_len;
+        size_t excess = total > limit ? total - limit : 0;
+        iov[used - 1].iov_len -= excess;
+
+        msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = used;
+        ssize_t n = sendmsg(fd_, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        iov[used - 1].iov_len += excess;
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+            return fail(errno);
+        }
+        size_t sent = static_cast<size_t>(n);
+        if (pacer_) pacer_->consume(sent, monotonic_us());
+        while (count > 0 && sent >= iov->iov_len) {
+            sent -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0 && sent > 0) {
+            iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    return true;
+}
+
+bool RtmpPublisher::wait_pacer(size_t bytes) {
+    int64_t start_us = monotonic_us();
+    int64_t now_us = start_us;
+    for (;;) {
+        int64_t wait_us = pacer_->wait_us(bytes, now_us);
+        if (wait_us == 0) break;
+        if (interrupt_ && interrupt_()) return fail(ETIMEDOUT);
+        usleep(static_cast<useconds_t>(std::min<int64_t>(wait_us, kPollSliceMs * 1000)));
+        now_us = monotonic_us();
+    }
+    pacer_->add_delay(now_us - start_us);
+    return true;
+}
+
+bool RtmpPublisher::wait_fd(short events) {
+    int64_t give_up_ms = monotonic_ms() + kIoTimeoutMs;
+    for (;;) {
+        if (interrupt_ ? interrupt_() : monotonic_ms() > give_up_ms) {
+            return fail(ETIMEDOUT);
+        }
+        pollfd pfd = {fd_, events, 0};
+        int ret = poll(&pfd, 1, kPollSliceMs);
+        if (ret < 0) {
+            if (errno == EINTR) continue;
+            return fail(errno);
+        }
+        if (ret == 0) continue;
+        if (pfd.revents & events) return true;
+        // 只有POLLERR/POLLHUP：取出socket错误
+        int error = 0;
+        socklen_t len = sizeof(error);
+        getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &len);
+        return fail(error ? error : ECONNRESET);
+    }
+}
+
+void RtmpPublisher::close() {
+    if (fd_ < 0) return;
+    if (stream_id_ != 0 && error_ == 0) {
+        // 尽力通知服务器，失败也直接关闭
+        RtmpMessage unpublish = command_message(kRtmpCommandChunkStream, 0);
+        Amf0Writer uw(unpublish.payload);
+        uw.string("FCUnpublish");
+        uw.number(0);
+        uw.null();
+        uw.string(stream_name_);
+
+        RtmpMessage remove = command_message(kRtmpCommandChunkStream, 0);
+        Amf0Writer rw(remove.payload);
+        rw.string("deleteStream");
+        rw.number(0);
+        rw.null();
+        rw.number(stream_id_);
+        if (send_message(unpublish)) {
+            send_message(remove);
+        }
+    }
+    ::close(fd_);
+    fd_ = -1;
+    stream_id_ = 0;
+}
+
+int64_t RtmpPublisher::send_queue_bytes() const {
+    int queued = 0;
+    if (fd_ < 0 || ioctl(fd_, SIOCOUTQ, &queued) < 0) return -1;
+    return queued;
+}
+
+int64_t RtmpPublisher::unsent_bytes() const {
+#ifdef SIOCOUTQNSD
+    int unsent = 0;
+    if (fd_ >= 0 && ioctl(fd_, SIOCOUTQNSD, &unsent) == 0) return unsent;
+#endif
+    return -1;
+}
@@ -0,0 +1,180 @@
+#pragma once
+/**
+ * @file RtmpPublisher.h
+ * @class RtmpPublisher
+ * @brief RTMP推流客户端，作为StreamOutput的自定义AVIO传输
+ *
+ * FFmpeg的flv muxer写出的FLV字节流交给write_flv()，按tag拆成RTMP消息发送：
+ * - 一个编码包的所有chunk头和负载用一次sendmsg分散写（iovec指向muxer缓冲区，负载不复制），
+ *   代替默认AVIO每个chunk一次的小写入
+ * - 可设置TCP_NODELAY、SO_SNDBUF和TCP_NOTSENT_LOWAT：低水位限制内核中未发出的数据量，
+ *   网络变慢时积压留在发送队列里，由OutputSender的丢包策略按GOP处理，而不是堆在socket缓冲区
+ * - send_queue_bytes()/unsent_bytes()读取SIOCOUTQ/SIOCOUTQNSD，供丢包和码率决策使用
+ * - 设置了Pacer时按令牌桶把大消息切段发送，关键帧不会一次性涌入上行链路
+ *
+ * 只支持rtmp://（不含rtmps、rtmpt），握手为简单握手。所有阻塞操作在interrupt回调返回true时中止。
+ * 非线程安全，只能在一个线程中调用。
+ */
+#include "Pacer.h"
+#include "RtmpProtocol.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct iovec;
+
+// 自定义RTMP传输的socket参数
+struct RtmpSocketOptions {
+    bool enabled = true;              // false时使用FFmpeg自带的rtmp协议
+    bool tcp_nodelay = true;
+    int send_buffer_bytes = 0;        // SO_SNDBUF，0表示保持系统自动调整
+    int notsent_lowat_bytes = 65536;  // TCP_NOTSENT_LOWAT，0表示不设置
+    uint32_t chunk_size = 4096;       // 发送chunk大小，越大chunk头越少
+};
+
+class RtmpPublisher {
+public:
+    // 返回true表示中止当前阻塞操作
+    using InterruptCallback = std::function<bool()>;
+
+    explicit RtmpPublisher(const RtmpSocketOptions& options);
+    ~RtmpPublisher();
+
+    RtmpPublisher(const RtmpPublisher&) = delete;
+    RtmpPublisher& operator=(const RtmpPublisher&) = delete;
+
+    void set_interrupt_callback(InterruptCallback callback) { interrupt_ = std::move(callback); }
+
+    /**
+     * @brief 设置发送限速器（由调用者持有，nullptr表示不限速）
+     */
+    void set_pacer(Pacer* pacer) { pacer_ = pacer; }
+
+    /**
+     * @brief 连接服务器并完成握手、connect、createStream和publish
+     * @param url rtmp://host[:port]/app/stream
+     * @return 服务器确认开始推流（NetStream.Publish.Start）返回true
+     */
+    bool connect(const std::string& url);
+
+    /**
+     * @brief 写入FLV字节流（可以在任意位置切分），凑满的tag作为RTMP消息发送
+     * @return 发送失败返回false，原因见error()
+     */
+    bool write_flv(const uint8_t* data, size_t size);
+
+    /**
+     * @brief 通知服务器停止推流并关闭连接
+     */
+    void close();
+
+    /**
+     * @brief 最近一次失败的errno（ETIMEDOUT、ECONNRESET、EPROTO等）
+     */
+    int error() const { return error_; }
+
+    /**
+     * @brief socket发送队列中的字节数（已发出未确认 + 未发出），未连接返回-1
+     */
+    int64_t send_queue_bytes() const;
+
+    /**
+     * @brief socket发送队列中尚未发出的字节数，未连接或内核不支持返回-1
+     */
+    int64_t unsent_bytes() const;
+
+private:
+    bool open_socket(const std::string& host, const std::string& port);
+    void apply_socket_options();
+    bool handshake();
+    bool send_connect();
+    bool send_publish();
+
+    /**
+     * @brief 发送一条完整消息（控制消息、命令）
+     */
+    bool send_message(const RtmpMessage& message);
+
+    /**
+     * @brief 为一条消息追加chunk头和负载分段到待发送的iovec列表
+     * @param payload 负载，发送完成前必须保持有效
+     */
+    void queue_message(const RtmpMessage& header, const uint8_t* payload, size_t size);
+
+    /**
+     * @brief 发送待发送列表，全部写完或失败后清空
+     */
+    bool flush_queued();
+
+    /**
+     * @brief 从FLV字节流中取出完整tag并排队
+     * @return 已消耗的字节数，格式错误返回-1
+     */
+    long parse_flv(const uint8_t* data, size_t size);
+
+    bool send_all(const uint8_t* data, size_t size);
+    bool send_iov(struct iovec* iov, size_t count);
+
+    /**
+     * @brief 读取并处理服务器发来的消息
+     * @param wait 没有数据时是否等待
+     */
+    bool pump_input(bool wait);
+    bool handle_message(const RtmpMessage& message);
+
+    /**
+     * @brief 等待指定事务号的_result或推流状态
+     */
+    bool wait_command(double transaction, const char* name);
+
+    bool wait_fd(short events);
+
+    /**
+     * @brief 等待限速器给出bytes字节的额度
+     */
+    bool wait_pacer(size_t bytes);
+
+    bool fail(int error);
+
+private:
+    RtmpSocketOptions options_;
+    InterruptCallback interrupt_;
+    Pacer* pacer_ = nullptr;
+    int fd_ = -1;
+    int error_ = 0;
+
+    std::string url_;  // 完整推流地址（日志按地址限速）
+    std::string app_;
+    std::string stream_name_;
+    std::string tc_url_;
+    uint32_t stream_id_ = 0;
+
+    RtmpChunkReader reader_;
+    RtmpChunkWriter writer_;
+    uint32_t ack_window_ = 0;
+    uint64_t acked_bytes_ = 0;
+
+    // 等待中的命令应答
+    double wait_transaction_ = 0;
+    std::string wait_name_;
+    bool wait_done_ = false;
+    bool wait_ok_ = false;
+    double created_stream_id_ = 0;
+
+    // FLV解析
+    bool flv_header_done_ = false;
+    std::vector<uint8_t> flv_pending_;         // 跨write_flv()调用的不完整tag
+
+    // 一次分散写的内容
+    std::vector<uint8_t> chunk_headers_;
+    std::vector<size_t> header_offsets_;
+    struct Segment {
+        bool header;        // true：chunk_headers_中的区间（以偏移保存，缓冲区扩容后仍有效）
+        const uint8_t* data;
+        size_t offset;
+        size_t size;
+    };
+    std::vector<Segment> segments_;
+    std::vector<std::vector<uint8_t>> owned_payloads_;  // 需要改写的负载（如onMetaData）
+};
@@ -0,0 +1,76 @@
+#include "SceneChangeDetector.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+
+constexpr int kSamplesPerCell = 4;  // 每个网格单元每个方向的采样点数
+
+} // namespace
+
+SceneChangeDetector::SceneChangeDetector(const AdaptiveGopOptions& options)
+    : options_(options),
+      thumbnail_(kGridWidth * kGridHeight),
+      previous_thumbnail_(kGridWidth * kGridHeight),
+      histogram_(kHistogramBins),
+      previous_histogram_(kHistogramBins) {}
+
+bool SceneChangeDetector::update(const uint8_t* luma, int linesize, int width, int height) {
+    if (!luma || width < kGridWidth || height < kGridHeight) return false;
+    if (width != width_ || height != height_) {
+        // 尺寸变化（如分辨率档位切换）：重新开始
+        width_ = width;
+        height_ = height;
+        has_previous_ = false;
+        average_sad_ = 0;
+    }
+
+    // 稀疏采样得到缩略图和直方图
+    std::fill(histogram_.begin(), histogram_.end(), 0);
+    for (int gy = 0; gy < kGridHeight; ++gy) {
+        int y0 = gy * height / kGridHeight;
+        int cell_height = (gy + 1) * height / kGridHeight - y0;
+        for (int gx = 0; gx < kGridWidth; ++gx) {
+            int x0 = gx * width / kGridWidth;
+            int cell_width = (gx + 1) * width / kGridWidth - x0;
+            uint32_t sum = 0;
+            for (int sy = 0; sy < kSamplesPerCell; ++sy) {
+                const uint8_t* row = luma + static_cast<size_t>(y0 + sy * cell_height / kSamplesPerCell) * linesize + x0;
+                for (int sx = 0; sx < kSamplesPerCell; ++sx) {
+                    uint8_t value = row[sx * cell_width / kSamplesPerCell];
+                    sum += value;
+                    ++histogram_[value * kHistogramBins / 256];
+                }
+            }
+            thumbnail_[gy * kGridWidth + gx] = static_cast<uint8_t>(sum / (kSamplesPerCell * kSamplesPerCell));
+        }
+    }
+
+    bool cut = false;
+    if (has_previous_) {
+        uint32_t sad = 0;
+        for (size_t i = 0; i < thumbnail_.size(); ++i) {
+            sad += static_cast<uint32_t>(std::abs(thumbnail_[i] - previous_thumbnail_[i]));
+        }
+        uint32_t histogram_diff = 0;
+        for (int i = 0; i < kHistogramBins; ++i) {
+            histogram_diff += static_cast<uint32_t>(std::abs(static_cast<int>(histogram_[i]) -
+                                                             static_cast<int>(previous_histogram_[i])));
+        }
+        const double samples = kGridWidth * kGridHeight * kSamplesPerCell * kSamplesPerCell;
+        last_sad_ = static_cast<double>(sad) / thumbnail_.size();
+        last_histogram_diff_ = histogram_diff / (2 * samples);
+
+        cut = last_sad_ > options_.sad_threshold && last_sad_ > average_sad_ * options_.sad_ratio &&
+              last_histogram_diff_ > options_.histogram_threshold;
+        // 切换帧不计入平均值，新场景从当前帧重新积累
+        if (!cut) {
+            average_sad_ += (last_sad_ - average_sad_) / 16;
+        }
+    }
+
+    thumbnail_.swap(previous_thumbnail_);
+    histogram_.swap(previous_histogram_);
+    has_previous_ = true;
+    return cut;
+}
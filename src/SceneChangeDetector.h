@@ -0,0 +1,69 @@
+#pragma once
+/**
+ * @file SceneChangeDetector.h
+ * @class SceneChangeDetector
+ * @brief 基于缩小亮度图的场景切换检测，用于自适应GOP
+ *
+ * 在Y平面上按固定网格稀疏采样（每个网格单元取4x4个点求平均），得到约32x18的缩略图和64级亮度直方图，
+ * 与上一帧比较：
+ * - 缩略图平均绝对差（SAD）反映画面内容变化，运动也会使它变大，因此同时要求超过近期平均值的sad_ratio倍
+ * - 直方图差异（0~1）对运动不敏感，切镜头、开关灯时明显变大
+ * 两者同时超过阈值判定为场景切换。1080p每帧只读取约一万个像素。
+ *
+ * 非线程安全，由编码线程使用。
+ */
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 自适应GOP配置
+struct AdaptiveGopOptions {
+    bool enabled = false;
+    int max_interval_ms = 10000;     // 没有场景切换时的最长关键帧间隔
+    int min_interval_ms = 500;       // 场景切换触发IDR的最小间隔，避免闪烁时连续产生IDR
+    double sad_threshold = 20;       // 缩略图平均绝对差阈值（0~255）
+    double sad_ratio = 3.0;          // 同时要求超过近期平均差的倍数
+    double histogram_threshold = 0.3; // 直方图差异阈值（0~1）
+};
+
+class SceneChangeDetector {
+public:
+    explicit SceneChangeDetector(const AdaptiveGopOptions& options);
+
+    /**
+     * @brief 输入一帧的Y平面
+     * @param luma Y平面数据
+     * @param linesize 每行字节数
+     * @param width 宽度
+     * @param height 高度
+     * @return 与上一帧相比发生场景切换返回true（尺寸变化后的第一帧返回false）
+     */
+    bool update(const uint8_t* luma, int linesize, int width, int height);
+
+    /**
+     * @brief 最近一帧的缩略图平均绝对差
+     */
+    double last_sad() const { return last_sad_; }
+
+    /**
+     * @brief 最近一帧的直方图差异
+     */
+    double last_histogram_diff() const { return last_histogram_diff_; }
+
+private:
+    static constexpr int kGridWidth = 32;
+    static constexpr int kGridHeight = 18;
+    static constexpr int kHistogramBins = 64;
+
+    AdaptiveGopOptions options_;
+    int width_ = 0;
+    int height_ = 0;
+    bool has_previous_ = false;
+    std::vector<uint8_t> thumbnail_;
+    std::vector<uint8_t> previous_thumbnail_;
+    std::vector<uint32_t> histogram_;
+    std::vector<uint32_t> previous_histogram_;
+    double average_sad_ = 0;          // 近期SAD的指数平均
+    double last_sad_ = 0;
+    double last_histogram_diff_ = 0;
+};
@@ -0,0 +1,63 @@
+#include "StaticSceneDetector.h"
+#include "ImageDiff.h"
+#include <algorithm>
+#include <cstring>
+
+StaticSceneDetector::StaticSceneDetector(const StaticSceneOptions& options) : options_(options) {
+    options_.min_changed_cells = std::max(1, options_.min_changed_cells);
+}
+
+void StaticSceneDetector::capture_reference(const uint8_t* yuyv, size_t stride, int64_t now_us) {
+    uint8_t* out = reference_.data();
+    for (int y = 0; y < height_; y += kRowStep) {
+        memcpy(out, yuyv + static_cast<size_t>(y) * stride, row_bytes_);
+        out += row_bytes_;
+    }
+    has_reference_ = true;
+    reference_us_ = now_us;
+}
+
+bool StaticSceneDetector::unchanged(const uint8_t* yuyv, size_t stride, int width, int height, int64_t now_us) {
+    if (!yuyv || width <= 0 || height <= 0) return false;
+    if (width != width_ || height != height_) {
+        width_ = width;
+        height_ = height;
+        row_bytes_ = static_cast<size_t>(width) * 2;
+        reference_.resize(row_bytes_ * ((height + kRowStep - 1) / kRowStep));
+        cell_sad_.resize((row_bytes_ + kCellBytes - 1) / kCellBytes);
+        has_reference_ = false;
+    }
+    if (!has_reference_ || now_us - reference_us_ >= options_.refresh_ms * 1000LL) {
+        capture_reference(yuyv, stride, now_us);
+        last_changed_cells_ = 0;
+        return false;
+    }
+
+    // 按单元行比较，变化单元数达到阈值即可提前结束
+    int changed = 0;
+    int sampled_rows = (height_ + kRowStep - 1) / kRowStep;
+    const uint8_t* ref = reference_.data();
+    for (int band = 0; band < sampled_rows && changed < options_.min_changed_cells; band += kCellRows) {
+        int rows = std::min(kCellRows, sampled_rows - band);
+        std::fill(cell_sad_.begin(), cell_sad_.end(), 0);
+        for (int r = 0; r < rows; ++r) {
+            const uint8_t* cur = yuyv + static_cast<size_t>(band + r) * kRowStep * stride;
+            const uint8_t* prev = ref + static_cast<size_t>(band + r) * row_bytes_;
+            for (size_t cell = 0, offset = 0; offset < row_bytes_; ++cell, offset += kCellBytes) {
+                cell_sad_[cell] += sad_bytes(cur + offset, prev + offset, std::min(kCellBytes, row_bytes_ - offset));
+            }
+        }
+        for (size_t cell = 0, offset = 0; offset < row_bytes_; ++cell, offset += kCellBytes) {
+            size_t samples = std::min(kCellBytes, row_bytes_ - offset) * rows;
+            if (cell_sad_[cell] > static_cast<uint32_t>(options_.cell_threshold) * samples) {
+                ++changed;
+            }
+        }
+    }
+    last_changed_cells_ = changed;
+    if (changed >= options_.min_changed_cells) {
+        capture_reference(yuyv, stride, now_us);
+        return false;
+    }
+    return true;
+}
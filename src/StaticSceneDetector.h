@@ -0,0 +1,75 @@
+#pragma once
+/**
+ * @file StaticSceneDetector.h
+ * @class StaticSceneDetector
+ * @brief 静止画面检测，直接在YUYV采集缓冲区上比较当前帧与参考帧
+ *
+ * 每隔kRowStep行取一整行YUYV字节（亮度和色度都参与比较），按64像素宽 × 4个采样行划分单元，
+ * 逐单元计算与参考帧的平均绝对差（NEON/SSE2的SAD，其他平台用标量实现）。
+ * 超过cell_threshold的单元数达到min_changed_cells即认为画面变化，当前帧成为新的参考帧。
+ * 参考帧是最近一次完整处理的帧而不是上一帧，缓慢的光照漂移累积到阈值后同样会触发。
+ * 1080p每帧读取约135行，单帧开销远小于YUYV→BGR转换。
+ *
+ * 非线程安全，由编码线程使用。
+ */
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 静止画面的处理方式
+enum class StaticSceneMode {
+    Drop,    // 不编码（可变帧率），只有画面变化或到达refresh_ms时才输出
+    Repeat,  // 重新提交上一帧的YUV，x264基本编码为skip宏块，输出保持恒定帧率
+};
+
+// 静止画面低功耗模式配置
+struct StaticSceneOptions {
+    bool enabled = false;
+    StaticSceneMode mode = StaticSceneMode::Repeat;
+    int cell_threshold = 8;       // 单元平均绝对差阈值（0~255），需高于传感器噪声
+    int min_changed_cells = 1;    // 变化单元数达到该值视为画面变化
+    int refresh_ms = 1000;        // 静止时至少每隔这么久完整处理一帧
+};
+
+class StaticSceneDetector {
+public:
+    explicit StaticSceneDetector(const StaticSceneOptions& options);
+
+    /**
+     * @brief 判断一帧YUYV与参考帧相比是否没有变化
+     * 返回false时当前帧成为新的参考帧（调用者应完整处理该帧）
+     * @param yuyv YUYV数据
+     * @param stride 每行字节数
+     * @param width 宽度（像素）
+     * @param height 高度
+     * @param now_us CLOCK_MONOTONIC微秒
+     * @return 没有变化返回true
+     */
+    bool unchanged(const uint8_t* yuyv, size_t stride, int width, int height, int64_t now_us);
+
+    /**
+     * @brief 最近一次比较中超过阈值的单元数（提前结束时为达到min_changed_cells的值）
+     */
+    int last_changed_cells() const { return last_changed_cells_; }
+
+private:
+    /**
+     * @brief 把当前帧的采样行保存为参考帧
+     */
+    void capture_reference(const uint8_t* yuyv, size_t stride, int64_t now_us);
+
+private:
+    static constexpr int kRowStep = 8;          // 每8行采样一行
+    static constexpr int kCellRows = 4;         // 每个单元的采样行数（覆盖32行）
+    static constexpr size_t kCellBytes = 128;   // 每个单元的宽度（64像素的YUYV字节）
+
+    StaticSceneOptions options_;
+    int width_ = 0;
+    int height_ = 0;
+    size_t row_bytes_ = 0;
+    bool has_reference_ = false;
+    int64_t reference_us_ = 0;
+    std::vector<uint8_t> reference_;     // 采样行，每行row_bytes_字节
+    std::vector<uint32_t> cell_sad_;     // 一个单元行内各单元的累计SAD
+    int last_changed_cells_ = 0;
+};
@@ -0,0 +1,446 @@
+#include "StreamOutput.h"
+#include "FaultInjector.h"
+#include "Logger.h"
+#include "RtmpPublisher.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <thread>
+
+namespace {
+
+constexpr int kConnectTimeoutMs = 3000;
+constexpr int kWriteTimeoutMs = 3000;
+constexpr int kBackoffInitialMs = 250;
+constexpr int kBackoffMaxMs = 10000;
+constexpr int kAvioBufferSize = 256 * 1024;   // 大于常见编码包，每个包通常一次回调交给RtmpPublisher
+constexpr size_t kMinPacingBurstBytes = 4096;  // 至少一个RTMP chunk
+constexpr int64_t kLossKeyframeIntervalUs = 1000000;  // 写失败丢包后请求IDR的最小间隔（持续写失败时不让每帧都是IDR）
+
+int64_t monotonic_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 只有网络地址断线后重连；文件重新打开会截断
+bool is_network_url(const std::string& url) {
+    return url.find("://") != std::string::npos && url.compare(0, 5, "file:") != 0;
+}
+
+// 自定义AVIO的写回调：FLV字节流交给RtmpPublisher
+#if LIBAVFORMAT_VERSION_MAJOR >= 61
+int write_rtmp_packet(void* opaque, const uint8_t* buf, int size) {
+#else
+int write_rtmp_packet(void* opaque, uint8_t* buf, int size) {
+#endif
+    RtmpPublisher* publisher = static_cast<RtmpPublisher*>(opaque);
+    if (!publisher->write_flv(buf, static_cast<size_t>(size))) {
+        return AVERROR(publisher->error());
+    }
+    return size;
+}
+
+std::string av_error_string(int error) {
+    char text[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(error, text, sizeof(text));
+    return text;
+}
+
+} // namespace
+
+StreamOutput::StreamOutput(const std::vector<std::string>& urls, const std::string& format,
+                           const MetricLabels& labels, const RtmpSocketOptions& socket_options)
+    : urls_(urls), format_(format), socket_options_(socket_options) {
+    if (urls_.empty()) urls_.push_back("null");
+
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    metrics_.bytes = &registry.counter("output_bytes_total", "Bytes written to the muxer", labels);
+    metrics_.packets = &registry.counter("output_packets_total", "Packets written to the muxer", labels);
+    metrics_.dropped = &registry.counter("output_packets_dropped_total",
+                                         "Packets discarded while disconnected or waiting for a keyframe", labels);
+    metrics_.write_errors = &registry.counter("output_write_errors_total", "Muxer write failures", labels);
+    metrics_.reconnects = &registry.counter("output_reconnects_total", "Output reconnect attempts", labels);
+    metrics_.connected = &registry.gauge("output_connected", "1 while the output is connected", labels);
+    metrics_.url_index = &registry.gauge("output_url_index", "Index of the ingest URL in use (0 = primary)", labels);
+    metrics_.socket_queue = &registry.gauge("output_socket_queue_bytes",
+                                            "Bytes in the socket send queue (SIOCOUTQ), native RTMP transport only",
+                                            labels);
+    metrics_.pacing_delay = &registry.histogram("output_pacing_delay_seconds",
+                                                "Delay added to each packet by send pacing", labels);
+    metrics_.pacing_rate = &registry.gauge("output_pacing_rate_bps", "Send pacing rate limit (0 = unpaced)", labels);
+}
+
+void StreamOutput::set_pacing(double multiplier, int burst_ms) {
+    pacing_multiplier_ = multiplier;
+    pacing_burst_ms_ = burst_ms;
+}
+
+StreamOutput::~StreamOutput() {
+    close();
+    avcodec_parameters_free(&codecpar_);
+}
+
+int StreamOutput::interrupt_callback(void* opaque) {
+    const StreamOutput* self = static_cast<const StreamOutput*>(opaque);
+    return self->deadline_us_ > 0 && monotonic_us() > self->deadline_us_;
+}
+
+void StreamOutput::set_deadline(int timeout_ms) {
+    deadline_us_ = timeout_ms > 0 ? monotonic_us() + timeout_ms * 1000LL : 0;
+}
+
+void StreamOutput::set_target_bitrate(int64_t target_bps) {
+    if (pacing_multiplier_ <= 0 || target_bps <= 0) return;
+    // 倍数小于1时平均码率都发不完，按1处理
+    int64_t rate_bps = static_cast<int64_t>(target_bps * std::max(pacing_multiplier_, 1.0));
+    if (rate_bps == pacer_.rate_bps()) return;
+    size_t burst = std::max<size_t>(static_cast<size_t>(rate_bps / 8 * pacing_burst_ms_ / 1000),
+                                    kMinPacingBurstBytes);
+    pacer_.configure(rate_bps, burst);
+    metrics_.pacing_rate->set(static_cast<double>(rate_bps));
+    LOG_INFO("StreamOutput", "[%s] Pacing at %.2f Mbit/s, burst %zu bytes", url().c_str(), rate_bps / 1e6, burst);
+}
+
+bool StreamOutput::open(const AVCodecContext* codec_ctx) {
+    if (!codecpar_) {
+        codecpar_ = avcodec_parameters_alloc();
+    }
+    if (!codecpar_ || avcodec_parameters_from_context(codecpar_, codec_ctx) < 0) {
+        LOG_ERROR("StreamOutput", "Failed to copy codec parameters");
+        return false;
+    }
+    time_base_ = codec_ctx->time_base;
+
+    set_target_bitrate(codec_ctx->rc_max_rate > 0 ? codec_ctx->rc_max_rate : codec_ctx->bit_rate);
+    // 按顺序尝试各接入地址
+    for (size_t i = 0; i < urls_.size(); ++i) {
+        current_ = i;
+        if (connect()) {
+            metrics_.url_index->set(static_cast<double>(i));
+            if (i > 0) {
+                LOG_WARN("StreamOutput", "Primary ingest %s unavailable, using %s", urls_[0].c_str(), url().c_str());
+            }
+            return true;
+        }
+    }
+    current_ = 0;
+    if (is_network_url(url())) {
+        // 由后续write()按退避继续尝试，调用者决定首次失败是否致命
+        state_ = State::Disconnected;
+        disconnected_us_ = monotonic_us();
+        backoff_ms_ = kBackoffInitialMs;
+        next_attempt_us_ = disconnected_us_ + backoff_ms_ * 1000LL;
+    }
+    return false;
+}
+
+bool StreamOutput::connect() {
+    // 初始化输出格式上下文
+    avformat_alloc_output_context2(&fmt_ctx_, nullptr, format_.c_str(), url().c_str());
+    if (!fmt_ctx_) {
+        LOG_ERROR("StreamOutput", "[%s] Could not create output context", url().c_str());
+        return false;
+    }
+    fmt_ctx_->interrupt_callback.callback = &StreamOutput::interrupt_callback;
+    fmt_ctx_->interrupt_callback.opaque = this;
+
+    // 创建输出流
+    stream_ = avformat_new_stream(fmt_ctx_, nullptr);
+    if (!stream_ || avcodec_parameters_copy(stream_->codecpar, codecpar_) < 0) {
+        LOG_ERROR("StreamOutput", "[%s] Failed allocating output stream", url().c_str());
+        disconnect(false);
+        return false;
+    }
+    stream_->codecpar->codec_tag = 0;
+    stream_->time_base = time_base_;
+
+    fmt_ctx_->max_delay = 0;  // 消除格式容器延迟
+
+    // 打开输出（超时由interrupt_callback控制）
+    set_deadline(kConnectTimeoutMs);
+    if (use_rtmp_publisher()) {
+        if (!open_rtmp_publisher()) {
+            set_deadline(0);
+            disconnect(false);
+            return false;
+        }
+    } else if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+        int ret = avio_open2(&fmt_ctx_->pb, url().c_str(), AVIO_FLAG_WRITE, &fmt_ctx_->interrupt_callback, nullptr);
+        if (ret < 0) {
+            LOG_ERROR_EVERY_MS_FOR("StreamOutput", url(), 1000, "Could not open output URL: %s (%s)",
+                                   url().c_str(), av_error_string(ret).c_str());
+            set_deadline(0);
+            disconnect(false);
+            return false;
+        }
+    }
+
+    // 写入文件头（FLV头、onMetaData、AVC序列头）
+    int ret = avformat_write_header(fmt_ctx_, nullptr);
+    set_deadline(0);
+    if (ret < 0) {
+        LOG_ERROR_EVERY_MS_FOR("StreamOutput", url(), 1000, "[%s] Error occurred when opening output URL: %s",
+                               url().c_str(), av_error_string(ret).c_str());
+        disconnect(false);
+        return false;
+    }
+
+    state_ = State::Connected;
+    metrics_.connected->set(1);
+    return true;
+}
+
+bool StreamOutput::use_rtmp_publisher() const {
+    return socket_options_.enabled && format_ == "flv" && url().compare(0, 7, "rtmp://") == 0;
+}
+
+bool StreamOutput::open_rtmp_publisher() {
+    std::unique_ptr<RtmpPublisher> publisher(new RtmpPublisher(socket_options_));
+    publisher->set_interrupt_callback([this] { return interrupt_callback(this) != 0; });
+    publisher->set_pacer(&pacer_);
+    if (!publisher->connect(url())) {
+        LOG_ERROR_EVERY_MS_FOR("StreamOutput", url(), 1000, "Could not open output URL: %s (%s)",
+                               url().c_str(), av_error_string(AVERROR(publisher->error())).c_str());
+        return false;
+    }
+    uint8_t* buffer = static_cast<uint8_t*>(av_malloc(kAvioBufferSize));
+    AVIOContext* pb = buffer ? avio_alloc_context(buffer, kAvioBufferSize, 1, publisher.get(), nullptr,
+                                                  &write_rtmp_packet, nullptr)
+                             : nullptr;
+    if (!pb) {
+        av_free(buffer);
+        LOG_ERROR("StreamOutput", "[%s] Failed to allocate AVIO context", url().c_str());
+        return false;
+    }
+    fmt_ctx_->pb = pb;
+    // 每个包写完立即交给RtmpPublisher，一个包的所有chunk一次发送
+    fmt_ctx_->flags |= AVFMT_FLAG_CUSTOM_IO | AVFMT_FLAG_FLUSH_PACKETS;
+    publisher.release();  // 由pb->opaque持有，disconnect()中释放
+    return true;
+}
+
+RtmpPublisher* StreamOutput::rtmp_publisher() const {
+    if (!fmt_ctx_ || !fmt_ctx_->pb || !(fmt_ctx_->flags & AVFMT_FLAG_CUSTOM_IO)) return nullptr;
+    return static_cast<RtmpPublisher*>(fmt_ctx_->pb->opaque);
+}
+
+int64_t StreamOutput::send_queue_bytes() const {
+    RtmpPublisher* publisher = rtmp_publisher();
+    return publisher ? publisher->send_queue_bytes() : -1;
+}
+
+void StreamOutput::disconnect(bool write_trailer) {
+    if (fmt_ctx_) {
+        set_deadline(kWriteTimeoutMs);
+        if (write_trailer) {
+            av_write_trailer(fmt_ctx_);
+        }
+        if (RtmpPublisher* publisher = rtmp_publisher()) {
+            if (write_trailer) {
+                publisher->close();  // 正常结束时通知服务器停止推流
+            }
+            delete publisher;
+            av_freep(&fmt_ctx_->pb->buffer);
+            avio_context_free(&fmt_ctx_->pb);
+        } else if (!(fmt_ctx_->oformat->flags & AVFMT_NOFILE)) {
+            avio_closep(&fmt_ctx_->pb);
+        }
+        set_deadline(0);
+        avformat_free_context(fmt_ctx_);
+        fmt_ctx_ = nullptr;
+    }
+    stream_ = nullptr;
+    metrics_.connected->set(0);
+}
+
+void StreamOutput::connection_lost(int error) {
+    LOG_WARN("StreamOutput", "[%s] Connection lost (%s), reconnecting", url().c_str(), av_error_string(error).c_str());
+    disconnect(false);
+    state_ = State::Disconnected;
+    disconnected_us_ = monotonic_us();
+    backoff_ms_ = kBackoffInitialMs;
+    next_attempt_us_ = disconnected_us_;  // 第一次立即重试
+}
+
+void StreamOutput::update_extradata(const AVPacket* pkt) {
+#if LIBAVCODEC_VERSION_MAJOR >= 59
+    size_t size = 0;
+#else
+    int size = 0;
+#endif
+    const uint8_t* data = av_packet_get_side_data(pkt, AV_PKT_DATA_NEW_EXTRADATA, &size);
+    if (!data || size == 0 || !codecpar_) return;
+    if (static_cast<int>(size) == codecpar_->extradata_size && memcmp(data, codecpar_->extradata, size) == 0) return;
+
+    uint8_t* extradata = static_cast<uint8_t*>(av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE));
+    if (!extradata) return;
+    memcpy(extradata, data, size);
+    av_freep(&codecpar_->extradata);
+    codecpar_->extradata = extradata;
+    codecpar_->extradata_size = static_cast<int>(size);
+    LOG_INFO("StreamOutput", "[%s] Codec extradata changed (%d bytes)", url().c_str(), codecpar_->extradata_size);
+}
+
+bool StreamOutput::write(AVPacket* pkt) {
+    if (state_ == State::Closed) {
+        av_packet_unref(pkt);
+        return false;
+    }
+    update_extradata(pkt);
+
+    if (state_ == State::Disconnected) {
+        int64_t now = monotonic_us();
+        if (now < next_attempt_us_) {
+            metrics_.dropped->inc();
+            av_packet_unref(pkt);
+            return false;
+        }
+        metrics_.reconnects->inc();
+        if (!connect()) {
+            next_attempt_us_ = monotonic_us() + backoff_ms_ * 1000LL;
+            backoff_ms_ = std::min(backoff_ms_ * 2, kBackoffMaxMs);
+            metrics_.dropped->inc();
+            av_packet_unref(pkt);
+            return false;
+        }
+        LOG_INFO("StreamOutput", "[%s] Reconnected after %.1f ms, waiting for keyframe",
+                 url().c_str(), (monotonic_us() - disconnected_us_) / 1000.0);
+        state_ = State::WaitKeyframe;
+        keyframe_request_ = true;
+    }
+
+    if (state_ == State::WaitKeyframe) {
+        if (!(pkt->flags & AV_PKT_FLAG_KEY)) {
+            metrics_.dropped->inc();
+            av_packet_unref(pkt);
+            return false;
+        }
+        LOG_INFO("StreamOutput", "[%s] Output resumed %.1f ms after interruption",
+                 url().c_str(), (monotonic_us() - disconnected_us_) / 1000.0);
+        state_ = State::Connected;
+    }
+
+    // 重新缩放PTS/DTS
+    av_packet_rescale_ts(pkt, time_base_, stream_->time_base);
+    pkt->stream_index = stream_->index;
+    int packet_size = pkt->size;
+
+    // 其他传输无法切分一个包：等额度够一个桶容量后整包写出，透支部分推迟后续的包
+    RtmpPublisher* publisher = rtmp_publisher();
+    if (pacer_.enabled() && !publisher) {
+        int64_t now = monotonic_us();
+        int64_t wait_us = pacer_.wait_us(static_cast<size_t>(packet_size), now);
+        if (wait_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(wait_us));
+            pacer_.add_delay(wait_us);
+        }
+        pacer_.consume(static_cast<size_t>(packet_size), monotonic_us());
+    }
+
+    // 写入帧
+    if (FAULT_POINT(MuxerSlow, urls_.front())) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(FAULT_PARAM(MuxerSlow, 100)));
+    }
+    int ret;
+    if (FAULT_POINT(MuxerEagain, urls_.front())) {
+        ret = AVERROR(EAGAIN);
+        av_packet_unref(pkt);
+    } else if (FAULT_POINT(MuxerEpipe, urls_.front())) {
+        ret = AVERROR(EPIPE);
+        av_packet_unref(pkt);
+    } else {
+        set_deadline(kWriteTimeoutMs);
+        ret = av_interleaved_write_frame(fmt_ctx_, pkt);
+        set_deadline(0);
+    }
+    if (pacer_.enabled()) {
+        metrics_.pacing_delay->observe(pacer_.take_delay_us() / 1e6);
+    }
+    if (ret < 0) {
+        metrics_.write_errors->inc();
+        if (is_network_url(url()) && ret != AVERROR(EAGAIN)) {
+            connection_lost(ret);
+        } else {
+            LOG_ERROR_EVERY_MS_FOR("StreamOutput", url(), 1000, "[%s] Error while writing video packet: %s",
+                                   url().c_str(), av_error_string(ret).c_str());
+            // 丢的是GOP中间的包，后续参考帧在接收端无法正确解码：丢弃到下一个关键帧并请求IDR
+            int64_t now = monotonic_us();
+            state_ = State::WaitKeyframe;
+            disconnected_us_ = now;
+            if (now - loss_keyframe_us_ >= kLossKeyframeIntervalUs) {
+                keyframe_request_ = true;
+                loss_keyframe_us_ = now;
+            }
+        }
+        return false;
+    }
+    metrics_.bytes->inc(packet_size);
+    metrics_.packets->inc();
+    if (publisher) {
+        metrics_.socket_queue->set(static_cast<double>(publisher->send_queue_bytes()));
+    }
+    return true;
+}
+
+bool StreamOutput::switch_url(size_t index) {
+    if (index >= urls_.size() || state_ == State::Closed) return false;
+
+    // 先连接新地址，成功后再断开旧连接
+    AVFormatContext* old_ctx = fmt_ctx_;
+    AVStream* old_stream = stream_;
+    State old_state = state_;
+    size_t old_index = current_;
+    fmt_ctx_ = nullptr;
+    stream_ = nullptr;
+    current_ = index;
+    metrics_.reconnects->inc();
+    bool ok = connect();
+
+    AVFormatContext* new_ctx = fmt_ctx_;
+    AVStream* new_stream = stream_;
+    if (ok || old_ctx) {
+        // 拆除不再使用的那一个
+        fmt_ctx_ = ok ? old_ctx : nullptr;
+        disconnect(ok && old_state == State::Connected);
+    }
+    if (ok) {
+        fmt_ctx_ = new_ctx;
+        stream_ = new_stream;
+        state_ = State::WaitKeyframe;
+        keyframe_request_ = true;
+        disconnected_us_ = monotonic_us();
+        metrics_.connected->set(1);
+        metrics_.url_index->set(static_cast<double>(index));
+        return true;
+    }
+    if (old_ctx && old_state != State::Disconnected) {
+        // 新地址不可用，继续使用原连接
+        fmt_ctx_ = old_ctx;
+        stream_ = old_stream;
+        state_ = old_state;
+        current_ = old_index;
+        metrics_.connected->set(1);
+        return false;
+    }
+    // 原连接已断开：改为在新地址上按退避重连
+    state_ = State::Disconnected;
+    disconnected_us_ = monotonic_us();
+    backoff_ms_ = kBackoffInitialMs;
+    next_attempt_us_ = disconnected_us_ + backoff_ms_ * 1000LL;
+    metrics_.url_index->set(static_cast<double>(index));
+    return false;
+}
+
+bool StreamOutput::take_keyframe_request() {
+    bool requested = keyframe_request_;
+    keyframe_request_ = false;
+    return requested;
+}
+
+void StreamOutput::close() {
+    disconnect(state_ == State::Connected || state_ == State::WaitKeyframe);
+    state_ = State::Closed;
+}
@@ -0,0 +1,208 @@
+#pragma once
+/**
+ * @file StreamOutput.h
+ * @class StreamOutput
+ * @brief 单个推流目的地（muxer + AVIO），连接断开后自动重连
+ *
+ * 写入失败（RTMP服务器重启、连接被重置、写超时）时只拆除muxer/AVIO，编码器继续工作；
+ * 之后按指数退避（250ms起，最长10s）重新连接，重新写入流头（FLV头、onMetaData、AVC序列头），
+ * 丢弃非关键帧直到下一个关键帧再恢复输出，并通过take_keyframe_request()请求编码器立即产生IDR，
+ * 恢复时间取决于重连耗时而不是GOP长度。
+ *
+ * 所有阻塞操作（连接、写包、关闭）都受interrupt_callback截止时间约束，服务器无响应时不会无限阻塞。
+ * 只有网络地址（含"://"且不是file:）启用重连；文件输出重新打开会截断文件，写失败时不重连。
+ * 不触发重连的写失败（文件写错误、EAGAIN）丢掉的是GOP中间的包，之后同样丢弃到下一个关键帧并请求IDR。
+ *
+ * 可配置按优先级排列的多个接入地址：open()依次尝试直到连上，switch_url()在运行中切换（先连新地址再断旧连接），
+ * 是否切换由调用者（OutputSender的健康模型）决定。
+ *
+ * rtmp://地址配合flv格式时默认使用RtmpPublisher作为自定义AVIO（分散写、可调socket参数、发送队列遥测），
+ * 其他地址使用FFmpeg自带的协议实现。
+ *
+ * 编码器中途改变分辨率时，关键帧带AV_PKT_DATA_NEW_EXTRADATA：flv muxer写出新的AVC序列头，
+ * 重连时也使用新的extradata（onMetaData中的宽高保持初始值，解码以SPS为准）。
+ *
+ * set_pacing()按目标码率的倍数限速：RtmpPublisher把大包切段匀速发送，其他传输只能按整包推迟下一次写入。
+ *
+ * 非线程安全，只能在一个线程中调用。
+ */
+#include "Metrics.h"
+#include "Pacer.h"
+#include "RtmpPublisher.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+class StreamOutput {
+public:
+    enum class State {
+        Closed,        // 未打开或已关闭
+        Connected,     // 正常输出
+        WaitKeyframe,  // 刚重连或写失败丢过包，等待关键帧
+        Disconnected,  // 连接断开，等待下一次重连
+    };
+
+    /**
+     * @brief 构造函数
+     * @param urls 接入地址，按优先级排列（urls[0]为主地址）
+     * @param format FFmpeg muxer名称（"flv"、"null"、"mp4"等）
+     * @param labels 运行指标标签
+     * @param socket_options rtmp://地址使用的传输参数
+     */
+    StreamOutput(const std::vector<std::string>& urls, const std::string& format, const MetricLabels& labels,
+                 const RtmpSocketOptions& socket_options = RtmpSocketOptions());
+
+    ~StreamOutput();
+
+    StreamOutput(const StreamOutput&) = delete;
+    StreamOutput& operator=(const StreamOutput&) = delete;
+
+    /**
+     * @brief 设置发送限速（需在open()前调用）
+     * @param multiplier 限速为编码器目标码率（rc_max_rate，未设置时为bit_rate）的倍数，0表示不限速
+     * @param burst_ms 允许的突发量，按限速速率计的毫秒数
+     */
+    void set_pacing(double multiplier, int burst_ms);
+
+    /**
+     * @brief 按编码器参数创建输出流并连接
+     * @param codec_ctx 已打开的编码器（复制其参数和时间基，重连时复用）
+     * @return 任一接入地址连接成功返回true；全部失败时（网络地址）以主地址进入Disconnected状态，
+     *         后续write()会继续重连
+     */
+    bool open(const AVCodecContext* codec_ctx);
+
+    /**
+     * @brief 按新的编码目标码率重新设置限速（编码参数运行中修改后，由发送线程调用）
+     * @param target_bps 编码目标码率（VBV最大码率优先），未开启限速或为0时忽略
+     */
+    void set_target_bitrate(int64_t target_bps);
+
+    /**
+     * @brief 写入一个编码包
+     * @param pkt 编码包，时间戳为编码器时间基；调用后内容被清空
+     * @return 写入成功返回true；断线、等待关键帧或写失败时丢弃该包并返回false
+     */
+    bool write(AVPacket* pkt);
+
+    /**
+     * @brief 写入文件尾并关闭
+     */
+    void close();
+
+    /**
+     * @brief 重连成功后需要尽快得到关键帧时返回true（每次重连只返回一次）
+     */
+    bool take_keyframe_request();
+
+    /**
+     * @brief 切换到另一个接入地址
+     * 新地址连接成功后才断开原连接，之后丢弃非关键帧直到关键帧（并请求IDR）；
+     * 新地址连接失败时，若原连接仍可用则继续使用原连接，否则改为在新地址上按退避重连。
+     * @param index 地址序号
+     * @return 新地址连接成功返回true
+     */
+    bool switch_url(size_t index);
+
+    State state() const { return state_; }
+    const std::string& url() const { return urls_[current_]; }
+    size_t current_index() const { return current_; }
+    size_t url_count() const { return urls_.size(); }
+
+    /**
+     * @brief socket发送队列中的字节数（SIOCOUTQ），未使用RtmpPublisher或未连接时返回-1
+     */
+    int64_t send_queue_bytes() const;
+
+    /**
+     * @brief 最近一次断线（或切换地址）的时间，CLOCK_MONOTONIC微秒
+     */
+    int64_t disconnected_since_us() const { return disconnected_us_; }
+
+private:
+    /**
+     * @brief 创建muxer、打开AVIO并写入流头
+     */
+    bool connect();
+
+    /**
+     * @brief 拆除muxer/AVIO
+     * @param write_trailer 是否写入文件尾（连接已断开时不写）
+     */
+    void disconnect(bool write_trailer);
+
+    /**
+     * @brief 写失败后进入断线状态，安排下一次重连
+     */
+    void connection_lost(int error);
+
+    /**
+     * @brief 包带有AV_PKT_DATA_NEW_EXTRADATA（编码器换了分辨率）时更新保存的流参数，
+     * 之后重连写入新的序列头；当前连接由muxer自己处理（flv写出新的AVC序列头）
+     */
+    void update_extradata(const AVPacket* pkt);
+
+    /**
+     * @brief 设置阻塞操作的截止时间（0表示不限）
+     */
+    void set_deadline(int timeout_ms);
+
+    static int interrupt_callback(void* opaque);
+
+    /**
+     * @brief 是否使用RtmpPublisher代替FFmpeg的rtmp协议
+     */
+    bool use_rtmp_publisher() const;
+
+    /**
+     * @brief 连接RtmpPublisher并创建自定义AVIO
+     */
+    bool open_rtmp_publisher();
+
+    /**
+     * @brief 当前连接使用的RtmpPublisher（保存在pb->opaque中），没有返回nullptr
+     */
+    RtmpPublisher* rtmp_publisher() const;
+
+    struct OutputMetrics {
+        Counter* bytes = nullptr;
+        Counter* packets = nullptr;
+        Counter* dropped = nullptr;
+        Counter* write_errors = nullptr;
+        Counter* reconnects = nullptr;
+        Gauge* connected = nullptr;
+        Gauge* url_index = nullptr;
+        Gauge* socket_queue = nullptr;
+        Histogram* pacing_delay = nullptr;
+        Gauge* pacing_rate = nullptr;
+    };
+
+private:
+    std::vector<std::string> urls_;
+    size_t current_ = 0;
+    std::string format_;
+    RtmpSocketOptions socket_options_;
+    double pacing_multiplier_ = 0;
+    int pacing_burst_ms_ = 20;
+    Pacer pacer_;
+
+    AVCodecParameters* codecpar_ = nullptr;
+    AVRational time_base_{1, 1000};     // 输入包的时间基（编码器时间基）
+    AVFormatContext* fmt_ctx_ = nullptr;
+    AVStream* stream_ = nullptr;
+
+    State state_ = State::Closed;
+    int backoff_ms_ = 0;
+    int64_t next_attempt_us_ = 0;
+    int64_t disconnected_us_ = 0;
+    int64_t deadline_us_ = 0;
+    bool keyframe_request_ = false;
+    int64_t loss_keyframe_us_ = 0;  // 上次因写失败丢包请求IDR的时间
+
+    OutputMetrics metrics_;
+};
@@ -0,0 +1,151 @@
+#include "SyntheticSource.h"
+#include "FrameTrace.h"
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <linux/videodev2.h>
+
+SyntheticSource::SyntheticSource(uint32_t width, uint32_t height, uint32_t fps, size_t buffer_count)
+    : width_(width & ~1u),
+      height_(height),
+      fps_(fps),
+      stride_((width & ~1u) * 2),
+      buffers_(buffer_count) {}
+
+SyntheticSource::~SyntheticSource() {
+    stop();
+}
+
+bool SyntheticSource::initialize() {
+    if (initialized_) return true;
+    if (width_ == 0 || height_ == 0 || buffers_.size() < 2) {
+        return false;
+    }
+
+    size_t frame_size = static_cast<size_t>(stride_) * height_;
+    for (size_t i = 0; i < buffers_.size(); ++i) {
+        buffers_[i].assign(frame_size, 0);
+        free_buffers_.push_back(static_cast<int>(i));
+    }
+    render_patterns();
+
+    initialized_ = true;
+    return true;
+}
+
+void SyntheticSource::render_patterns() {
+    patterns_.resize(kPatternFrames);
+    for (size_t f = 0; f < kPatternFrames; ++f) {
+        std::vector<uint8_t>& p = patterns_[f];
+        p.resize(static_cast<size_t>(stride_) * height_);
+        // 斜向移动的亮度渐变 + 移动色块 + 少量伪随机纹理，保证编码器有真实负载
+        uint32_t shift = static_cast<uint32_t>(f * 8);
+        uint32_t noise = 0x12345678u + static_cast<uint32_t>(f);
+        uint32_t box_x = (width_ / 8) * static_cast<uint32_t>(f) % (width_ ? width_ : 1);
+        for (uint32_t y = 0; y < height_; ++y) {
+            uint8_t* row = &p[static_cast<size_t>(y) * stride_];
+            bool in_box_row = (y >= height_ / 3 && y < height_ / 3 + height_ / 4);
+            for (uint32_t x = 0; x < width_; x += 2) {
+                noise = noise * 1664525u + 1013904223u;
+                uint8_t luma = static_cast<uint8_t>((x + y + shift) & 0xff);
+                luma = static_cast<uint8_t>(luma ^ ((noise >> 28) & 0x07));
+                bool in_box = in_box_row && x >= box_x && x < box_x + width_ / 6;
+                row[x * 2 + 0] = in_box ? 235 : luma;
+                row[x * 2 + 1] = in_box ? 90 : static_cast<uint8_t>(128 + ((y >> 3) & 0x1f));
+                row[x * 2 + 2] = in_box ? 235 : static_cast<uint8_t>(luma + 1);
+                row[x * 2 + 3] = in_box ? 240 : static_cast<uint8_t>(128 - ((x >> 3) & 0x1f));
+            }
+        }
+    }
+}
+
+void SyntheticSource::start() {
+    if (!initialized_ && !initialize()) {
+        return;
+    }
+    if (running_) return;
+
+    running_ = true;
+    thread_ = std::thread(&SyntheticSource::produce_thread, this);
+}
+
+void SyntheticSource::stop() {
+    running_ = false;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void SyntheticSource::return_buffer_to_pool(int index) {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    free_buffers_.push_back(index);
+}
+
+void SyntheticSource::produce_thread() {
+    using clock = std::chrono::steady_clock;
+    const auto interval = fps_ ? std::chrono::nanoseconds(1000000000LL / fps_)
+                               : std::chrono::nanoseconds(0);
+    auto next_due = clock::now();
+    FrameTracer& tracer = FrameTracer::instance();
+
+    while (running_) {
+        if (fps_) {
+            std::this_thread::sleep_until(next_due);
+            next_due += interval;
+        }
+
+        int index = -1;
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex_);
+            if (!free_buffers_.empty()) {
+                index = free_buffers_.back();
+                free_buffers_.pop_back();
+            }
+        }
+        uint32_t sequence = sequence_++;
+        if (index < 0) {
+            if (fps_) {
+                // 与V4L2驱动一致：没有空闲缓冲区时该帧丢失
+                ++dropped_;
+            } else {
+                --sequence_;
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            continue;
+        }
+
+        std::vector<uint8_t>& buffer = buffers_[index];
+        const std::vector<uint8_t>& pattern = patterns_[sequence % kPatternFrames];
+        memcpy(buffer.data(), pattern.data(), buffer.size());
+
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        CameraFrame frame;
+        frame.camera_id = camera_id_;
+        frame.buf_index = index;
+        frame.fd = -1;
+        frame.data = buffer.data();
+        frame.length = buffer.size();
+        frame.bytes_used = buffer.size();
+        frame.width = width_;
+        frame.height = height_;
+        frame.stride = stride_;
+        frame.pixel_format = V4L2_PIX_FMT_YUYV;
+        frame.timestamp.tv_sec = ts.tv_sec;
+        frame.timestamp.tv_usec = ts.tv_nsec / 1000;
+        frame.sequence = sequence;
+        frame.trace_id = tracer.enabled() ? tracer.next_trace_id() : 0;
+        tracer.record(frame.trace_id, TraceStage::Dqbuf, camera_id_);
+        frame.return_buffer = [this, index]() {
+            this->return_buffer_to_pool(index);
+        };
+
+        ++delivered_;
+        if (frame_callback_) {
+            frame_callback_(frame);
+        } else {
+            return_buffer_to_pool(index);
+        }
+    }
+}
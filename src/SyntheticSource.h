@@ -0,0 +1,91 @@
+#pragma once
+/**
+ * @file SyntheticSource.h
+ * @class SyntheticSource
+ * @brief 合成YUYV帧源，用于无摄像头环境下的基准测试与调试
+ *
+ * 按指定分辨率和帧率产出带运动图案的YUYV帧，缓冲区语义与V4L2一致：
+ * - 固定数量的缓冲区，帧回调持有缓冲区直到调用return_buffer()
+ * - 到达出帧时刻时若没有空闲缓冲区，该帧被“驱动”丢弃，sequence照常递增
+ * - timestamp使用CLOCK_MONOTONIC，与V4L2默认时间戳时钟一致
+ *
+ * fps为0时不做节拍控制，只要有空闲缓冲区就立即出帧（吞吐测试用）。
+ */
+#include "FrameSource.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class SyntheticSource : public FrameSource {
+public:
+    /**
+     * @brief 构造函数
+     * @param width 帧宽度（像素，需为偶数）
+     * @param height 帧高度（像素）
+     * @param fps 帧率（0表示尽可能快）
+     * @param buffer_count 缓冲区数量（与CameraCapture默认一致为4）
+     */
+    SyntheticSource(uint32_t width, uint32_t height, uint32_t fps, size_t buffer_count = 4);
+    ~SyntheticSource() override;
+
+    bool initialize() override;
+    void start() override;
+    void stop() override;
+    void set_frame_callback(const FrameCallback& callback) override { frame_callback_ = callback; }
+    void set_frame_callback(FrameCallback&& callback) override { frame_callback_ = std::move(callback); }
+    bool is_running() const override { return running_; }
+    void set_camera_id(int id) override { camera_id_ = id; }
+    int get_camera_id() const override { return camera_id_; }
+
+    /**
+     * @brief 因无空闲缓冲区而丢弃的帧数
+     */
+    uint64_t dropped_frames() const override { return dropped_; }
+
+    /**
+     * @brief 已产出的帧数
+     */
+    uint64_t delivered_frames() const { return delivered_; }
+
+private:
+    /**
+     * @brief 出帧线程：按节拍取空闲缓冲区、填充图案、调用回调
+     */
+    void produce_thread();
+
+    /**
+     * @brief 预渲染一组运动图案帧，出帧时只做一次拷贝，避免图案生成本身干扰CPU测量
+     */
+    void render_patterns();
+
+    /**
+     * @brief 归还缓冲区到空闲列表
+     */
+    void return_buffer_to_pool(int index);
+
+private:
+    static constexpr size_t kPatternFrames = 8;
+
+    uint32_t width_;
+    uint32_t height_;
+    uint32_t fps_;
+    uint32_t stride_;
+    int camera_id_ = 0;
+
+    std::atomic<bool> running_{false};
+    bool initialized_ = false;
+    std::thread thread_;
+    FrameCallback frame_callback_;
+
+    std::vector<std::vector<uint8_t>> buffers_;
+    std::vector<std::vector<uint8_t>> patterns_;
+    std::vector<int> free_buffers_;
+    std::mutex pool_mutex_;
+
+    uint32_t sequence_ = 0;
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> delivered_{0};
+};
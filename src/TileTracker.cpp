@@ -0,0 +1,85 @@
+#include "TileTracker.h"
+#include "ImageDiff.h"
+#include <algorithm>
+#include <cstring>
+
+TileTracker::TileTracker(const TileTrackingOptions& options) : options_(options) {}
+
+void TileTracker::capture_tile(const uint8_t* yuyv, size_t stride, const ImageTile& tile) {
+    size_t offset = static_cast<size_t>(tile.rect.x) * 2;
+    size_t bytes = static_cast<size_t>(tile.rect.width) * 2;
+    for (int y = tile.rect.y; y < tile.rect.y + tile.rect.height; ++y) {
+        memcpy(&reference_[static_cast<size_t>(y) * row_bytes_ + offset],
+               yuyv + static_cast<size_t>(y) * stride + offset, bytes);
+    }
+}
+
+int TileTracker::update(const uint8_t* yuyv, size_t stride, int width, int height, int64_t now_us) {
+    if (!yuyv || width <= 0 || height <= 0) return 0;
+    if (width != width_ || height != height_) {
+        width_ = width;
+        height_ = height;
+        row_bytes_ = static_cast<size_t>(width) * 2;
+        reference_.resize(row_bytes_ * height);
+        tiles_.clear();
+        for (int y = 0; y < height; y += kTileSize) {
+            for (int x = 0; x < width; x += kTileSize) {
+                ImageTile tile;
+                tile.index = static_cast<int>(tiles_.size());
+                tile.rect = cv::Rect(x, y, std::min(kTileSize, width - x), std::min(kTileSize, height - y));
+                tile.dirty = true;
+                tiles_.push_back(tile);
+            }
+        }
+        refresh_cursor_ = 0;
+        refresh_credit_ = 0;
+        valid_ = false;
+    }
+
+    int dirty = 0;
+    if (!valid_) {
+        for (ImageTile& tile : tiles_) {
+            tile.dirty = true;
+            tile.result.reset();
+            capture_tile(yuyv, stride, tile);
+        }
+        valid_ = true;
+        last_update_us_ = now_us;
+        return static_cast<int>(tiles_.size());
+    }
+
+    // 按kBandRows行的条带判断，小物体的变化不会被整个块平均掉
+    for (ImageTile& tile : tiles_) {
+        size_t offset = static_cast<size_t>(tile.rect.x) * 2;
+        size_t bytes = static_cast<size_t>(tile.rect.width) * 2;
+        tile.dirty = false;
+        for (int band = tile.rect.y; band < tile.rect.y + tile.rect.height && !tile.dirty; band += kBandRows) {
+            int band_end = std::min(band + kBandRows, tile.rect.y + tile.rect.height);
+            uint32_t sad = 0;
+            for (int y = band; y < band_end; ++y) {
+                sad += sad_bytes(yuyv + static_cast<size_t>(y) * stride + offset,
+                                 &reference_[static_cast<size_t>(y) * row_bytes_ + offset], bytes);
+            }
+            tile.dirty = sad > static_cast<uint32_t>(options_.threshold) * bytes * (band_end - band);
+        }
+    }
+
+    // 轮转刷新：每帧刷新的块数与距上一帧的时间成正比
+    if (options_.refresh_ms > 0 && now_us > last_update_us_) {
+        refresh_credit_ += static_cast<double>(tiles_.size()) * (now_us - last_update_us_) / (options_.refresh_ms * 1000.0);
+        refresh_credit_ = std::min(refresh_credit_, static_cast<double>(tiles_.size()));
+        for (; refresh_credit_ >= 1; refresh_credit_ -= 1) {
+            tiles_[refresh_cursor_].dirty = true;
+            refresh_cursor_ = (refresh_cursor_ + 1) % tiles_.size();
+        }
+    }
+    last_update_us_ = now_us;
+
+    for (const ImageTile& tile : tiles_) {
+        if (tile.dirty) {
+            capture_tile(yuyv, stride, tile);
+            ++dirty;
+        }
+    }
+    return dirty;
+}
@@ -0,0 +1,72 @@
+#pragma once
+/**
+ * @file TileTracker.h
+ * @class TileTracker
+ * @brief 按64x64块跟踪画面变化，供ImageProcessor分块增量处理
+ *
+ * 直接在YUYV采集缓冲区上逐块计算与参考数据的SAD（NEON/SSE2），
+ * 块内任一8行条带的平均绝对差超过threshold即为dirty（小物体的变化不会被整个块平均掉），
+ * 判定dirty后不再比较该块的其余条带。dirty块的参考数据替换为当前帧，
+ * 因此参考是该块最近一次处理时的内容，缓慢变化累积到阈值后同样会触发。
+ * 每帧另外按轮转顺序把一部分块标记为dirty，使所有块至少每refresh_ms重新处理一次，
+ * 低于阈值的细小变化不会长期残留，刷新开销分摊到各帧。
+ *
+ * 非线程安全，由编码线程使用。
+ */
+#include "ImageProcessor.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 分块增量处理配置
+struct TileTrackingOptions {
+    int threshold = 3;       // 条带平均绝对差阈值（0~255），需高于传感器噪声
+    int refresh_ms = 2000;   // 每个块至少每隔这么久重新处理一次，0表示不定期刷新
+};
+
+class TileTracker {
+public:
+    static constexpr int kTileSize = 64;
+    static constexpr int kBandRows = 8;
+
+    explicit TileTracker(const TileTrackingOptions& options);
+
+    /**
+     * @brief 比较一帧YUYV，更新各块的dirty标记（尺寸变化时全部为dirty）
+     * @param yuyv YUYV数据
+     * @param stride 每行字节数
+     * @param width 宽度（像素）
+     * @param height 高度
+     * @param now_us CLOCK_MONOTONIC微秒
+     * @return dirty块数
+     */
+    int update(const uint8_t* yuyv, size_t stride, int width, int height, int64_t now_us);
+
+    /**
+     * @brief 全部块（含缓存的处理结果）
+     */
+    std::vector<ImageTile>& tiles() { return tiles_; }
+
+    /**
+     * @brief 下一帧把全部块标记为dirty（如处理器输出无法复用时）
+     */
+    void invalidate() { valid_ = false; }
+
+private:
+    /**
+     * @brief 把当前帧中一个块的数据保存为参考
+     */
+    void capture_tile(const uint8_t* yuyv, size_t stride, const ImageTile& tile);
+
+private:
+    TileTrackingOptions options_;
+    int width_ = 0;
+    int height_ = 0;
+    size_t row_bytes_ = 0;
+    bool valid_ = false;
+    std::vector<ImageTile> tiles_;
+    std::vector<uint8_t> reference_;   // 参考帧（YUYV，每行row_bytes_字节）
+    size_t refresh_cursor_ = 0;        // 轮转刷新的下一个块
+    double refresh_credit_ = 0;        // 累计应刷新的块数（小数部分留到下一帧）
+    int64_t last_update_us_ = 0;
+};
@@ -2,10 +2,14 @@
 #include "CameraCapture.h"
 #include "EncoderStreamer.h"
 #include "ImageProcessor.h"
+#include "FrameTrace.h"
+#include "FrameRecorder.h"
+#include "Metrics.h"
 #include <vector>
 #include <memory>
 #include <iostream>
 #include <csignal>
+#include <cstdlib>
 
 class GrayImageProcessor : public ImageProcessor
 {
@@ -17,15 +21,37 @@ public:
 
 
 std::atomic<bool> running(true);
+std::atomic<bool> dump_trace(false);
 
 void signal_handler(int signum) {
     running = false;
 }
 
+// kill -USR1 <pid> 导出逐帧追踪
+void trace_signal_handler(int signum) {
+    dump_trace = true;
+}
+
 int main() {
     // 设置信号处理
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
+    signal(SIGUSR1, trace_signal_handler);
+    
+    // FRAME_TRACE=1 开启逐帧追踪
+    const char* trace_env = getenv("FRAME_TRACE");
+    if (trace_env && trace_env[0] == '1') {
+        FrameTracer::instance().set_enabled(true);
+    }
+    
+    // 运行指标：本地 http://127.0.0.1:9464/metrics，METRICS_TEXTFILE 指定时同时写textfile
+    MetricsExporter metrics_exporter;
+    const char* metrics_port = getenv("METRICS_PORT");
+    metrics_exporter.start_http_server(metrics_port ? atoi(metrics_port) : 9464);
+    const char* metrics_textfile = getenv("METRICS_TEXTFILE");
+    if (metrics_textfile) {
+        metrics_exporter.start_textfile_writer(metrics_textfile);
+    }
     
     // 摄像头配置
     struct CameraConfig {
@@ -53,10 +79,24 @@ int main() {
     ImageProcessor* gray_processor = new GrayImageProcessor();
     stream1.set_processor(gray_processor);
 
-    cam1.set_frame_callback([&stream1](const CameraFrame& frame) {
+    // RAW_RECORD_DIR 指定时把原始帧录制为 <dir>/cam0.rcap、cam1.rcap，可用ReplaySource回放
+    std::unique_ptr<FrameRecorder> recorder1, recorder2;
+    const char* record_dir = getenv("RAW_RECORD_DIR");
+    if (record_dir) {
+        recorder1.reset(new FrameRecorder(std::string(record_dir) + "/cam0.rcap"));
+        recorder2.reset(new FrameRecorder(std::string(record_dir) + "/cam1.rcap"));
+        if (!recorder1->open()) recorder1.reset();
+        if (!recorder2->open()) recorder2.reset();
+    }
+    FrameRecorder* rec1 = recorder1.get();
+    FrameRecorder* rec2 = recorder2.get();
+
+    cam1.set_frame_callback([&stream1, rec1](const CameraFrame& frame) {
+            if (rec1) rec1->record(frame);
             stream1.push_frame(frame);
     });
-    cam2.set_frame_callback([&stream2](const CameraFrame& frame) {
+    cam2.set_frame_callback([&stream2, rec2](const CameraFrame& frame) {
+        if (rec2) rec2->record(frame);
         stream2.push_frame(frame);
     });
 
@@ -90,13 +130,22 @@ int main() {
         
         // 输出状态信息
         std::cout << "Running... (" << 2 << " streams active)" << std::endl;
+        
+        if (dump_trace.exchange(false)) {
+            FrameTracer::instance().dump_chrome_json("/tmp/frame_trace.json");
+            FrameTracer::instance().dump_binary("/tmp/frame_trace.bin");
+            std::cout << "Frame trace written to /tmp/frame_trace.json" << std::endl;
+        }
     }
     
     cam1.stop();
     cam2.stop();
+    if (recorder1) recorder1->close();
+    if (recorder2) recorder2->close();
 
     stream1.stop();
     stream2.stop();
+    metrics_exporter.stop();
     
     std::cout << "All streams stopped. Exiting." << std::endl;
     return 0;
@@ -0,0 +1,304 @@
+/**
+ * @file bench_micro.cpp
+ * @brief 组件级微基准
+ *
+ * 覆盖encoding_loop()中的各个基础操作：
+ * - sws_scale 三条转换路径（YUYV→BGR24、BGR24→YUV420P、GRAY8→YUV420P），VGA/720p/1080p
+ * - ThreadSafeQueue 单线程push/pop、跨线程往返延迟、多生产者竞争下的吞吐
+ * - cv::Mat 包装已有缓冲区与ImageProcessor虚函数调用开销
+ * - avcodec_send_frame/avcodec_receive_packet 按x264预设的单帧编码耗时
+ *
+ * 用法：./bench_micro [--benchmark_filter=Sws]
+ */
+#ifdef USE_GOOGLE_BENCHMARK
+#include <benchmark/benchmark.h>
+#else
+#include "microbench.h"
+#endif
+
+#include "FrameSource.h"
+#include "ImageProcessor.h"
+#include "thread_safe_queue.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+namespace {
+
+const char* kPresets[] = {"ultrafast", "superfast", "veryfast", "faster", "fast", "medium"};
+
+// 填充带运动的YUYV测试图案
+void fill_yuyv(std::vector<uint8_t>& buf, int width, int height, int shift) {
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = &buf[static_cast<size_t>(y) * width * 2];
+        for (int x = 0; x < width * 2; x += 2) {
+            row[x] = static_cast<uint8_t>(x / 2 + y + shift);
+            row[x + 1] = static_cast<uint8_t>(128 + ((x ^ y) & 0x1f));
+        }
+    }
+}
+
+// 一次sws转换所需的源/目的缓冲区
+struct SwsCase {
+    SwsContext* ctx = nullptr;
+    AVFrame* dst = nullptr;
+    std::vector<uint8_t> src;
+    int src_linesize = 0;
+
+    ~SwsCase() {
+        sws_freeContext(ctx);
+        av_frame_free(&dst);
+    }
+};
+
+bool setup_sws(SwsCase& c, int width, int height, AVPixelFormat src_fmt, int src_bpp, AVPixelFormat dst_fmt) {
+    c.ctx = sws_getContext(width, height, src_fmt, width, height, dst_fmt, SWS_BILINEAR, nullptr, nullptr, nullptr);
+    c.dst = av_frame_alloc();
+    if (!c.ctx || !c.dst) return false;
+    c.dst->format = dst_fmt;
+    c.dst->width = width;
+    c.dst->height = height;
+    if (av_frame_get_buffer(c.dst, 32) < 0) return false;
+    c.src_linesize = width * src_bpp;
+    c.src.resize(static_cast<size_t>(c.src_linesize) * height);
+    if (src_fmt == AV_PIX_FMT_YUYV422) {
+        fill_yuyv(c.src, width, height, 0);
+    } else {
+        for (size_t i = 0; i < c.src.size(); ++i) c.src[i] = static_cast<uint8_t>(i * 7);
+    }
+    return true;
+}
+
+void run_sws(benchmark::State& state, AVPixelFormat src_fmt, int src_bpp, AVPixelFormat dst_fmt) {
+    int width = static_cast<int>(state.range(0));
+    int height = static_cast<int>(state.range(1));
+    SwsCase c;
+    if (!setup_sws(c, width, height, src_fmt, src_bpp, dst_fmt)) {
+        state.SkipWithError("sws setup failed");
+        return;
+    }
+    const uint8_t* src_data[1] = {c.src.data()};
+    int src_linesize[1] = {c.src_linesize};
+    for (auto _ : state) {
+        sws_scale(c.ctx, src_data, src_linesize, 0, height, c.dst->data, c.dst->linesize);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(c.src.size()));
+}
+
+// ------------------------------------------------------------ sws_scale
+
+void BM_SwsYuyvToBgr24(benchmark::State& state) {
+    run_sws(state, AV_PIX_FMT_YUYV422, 2, AV_PIX_FMT_BGR24);
+}
+BENCHMARK(BM_SwsYuyvToBgr24)->Args({640, 480})->Args({1280, 720})->Args({1920, 1080})->Unit(benchmark::kMicrosecond);
+
+void BM_SwsBgr24ToYuv420p(benchmark::State& state) {
+    run_sws(state, AV_PIX_FMT_BGR24, 3, AV_PIX_FMT_YUV420P);
+}
+BENCHMARK(BM_SwsBgr24ToYuv420p)->Args({640, 480})->Args({1280, 720})->Args({1920, 1080})->Unit(benchmark::kMicrosecond);
+
+void BM_SwsGray8ToYuv420p(benchmark::State& state) {
+    run_sws(state, AV_PIX_FMT_GRAY8, 1, AV_PIX_FMT_YUV420P);
+}
+BENCHMARK(BM_SwsGray8ToYuv420p)->Args({640, 480})->Args({1280, 720})->Args({1920, 1080})->Unit(benchmark::kMicrosecond);
+
+// ------------------------------------------------------------ ThreadSafeQueue
+
+CameraFrame make_frame() {
+    CameraFrame frame;
+    memset(&frame.timestamp, 0, sizeof(frame.timestamp));
+    frame.camera_id = 0;
+    frame.buf_index = 0;
+    frame.fd = -1;
+    frame.data = nullptr;
+    frame.length = 0;
+    frame.bytes_used = 0;
+    frame.width = 640;
+    frame.height = 480;
+    frame.stride = 1280;
+    frame.pixel_format = 0;
+    frame.sequence = 0;
+    frame.return_buffer = []() {};
+    return frame;
+}
+
+// 单线程push+pop（无竞争时的固定开销，含CameraFrame及其std::function的拷贝）
+void BM_QueuePushPop(benchmark::State& state) {
+    ThreadSafeQueue<CameraFrame> queue;
+    CameraFrame frame = make_frame();
+    CameraFrame out;
+    for (auto _ : state) {
+        queue.push(frame);
+        queue.pop(out, 0);
+        benchmark::DoNotOptimize(out.sequence);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QueuePushPop);
+
+// 跨线程往返：主线程push到ping，回声线程pop后push到pong，主线程再pop
+void BM_QueueRoundTrip(benchmark::State& state) {
+    ThreadSafeQueue<CameraFrame> ping;
+    ThreadSafeQueue<CameraFrame> pong;
+    std::thread echo([&]() {
+        CameraFrame f;
+        while (ping.pop(f)) {
+            pong.push(std::move(f));
+        }
+    });
+    CameraFrame frame = make_frame();
+    CameraFrame out;
+    for (auto _ : state) {
+        ping.push(frame);
+        pong.pop(out);
+    }
+    ping.terminate();
+    echo.join();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QueueRoundTrip)->Unit(benchmark::kMicrosecond);
+
+// 多生产者单消费者吞吐（有界队列，容量64），参数为生产者数量
+void BM_QueueContended(benchmark::State& state) {
+    const int producers = static_cast<int>(state.range(0));
+    ThreadSafeQueue<CameraFrame> queue(64);
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; ++i) {
+        threads.emplace_back([&queue, &stop]() {
+            CameraFrame frame = make_frame();
+            while (!stop.load(std::memory_order_relaxed)) {
+                queue.push(frame, 10);
+            }
+        });
+    }
+    CameraFrame out;
+    for (auto _ : state) {
+        queue.pop(out);
+        benchmark::DoNotOptimize(out.sequence);
+    }
+    stop = true;
+    queue.terminate();
+    for (auto& t : threads) t.join();
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_QueueContended)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+
+// ------------------------------------------------------------ cv::Mat / ImageProcessor
+
+void BM_MatWrap(benchmark::State& state) {
+    std::vector<uint8_t> buffer(1920 * 1080 * 3);
+    for (auto _ : state) {
+        cv::Mat mat(1080, 1920, CV_8UC3, buffer.data(), 1920 * 3);
+        benchmark::DoNotOptimize(mat.data);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MatWrap);
+
+void BM_ProcessorCall(benchmark::State& state) {
+    std::vector<uint8_t> buffer(1920 * 1080 * 3);
+    cv::Mat mat(1080, 1920, CV_8UC3, buffer.data(), 1920 * 3);
+    std::unique_ptr<ImageProcessor> processor(new ImageProcessor());
+    ImageProcessor* volatile p = processor.get();  // 阻止去虚化
+    for (auto _ : state) {
+        p->processFrame(mat);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ProcessorCall);
+
+// ------------------------------------------------------------ 编码
+
+// 参数：预设下标（见kPresets）、宽、高；编码器配置与EncoderStreamer::init_ffmpeg()一致
+void BM_EncodeFrame(benchmark::State& state) {
+    const char* preset = kPresets[state.range(0)];
+    int width = static_cast<int>(state.range(1));
+    int height = static_cast<int>(state.range(2));
+    const int fps = 30;
+
+    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    AVCodecContext* ctx = codec ? avcodec_alloc_context3(codec) : nullptr;
+    if (!ctx) {
+        state.SkipWithError("H.264 encoder not available");
+        return;
+    }
+    ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    ctx->thread_count = 8;
+    ctx->bit_rate = 2000000;
+    ctx->width = width;
+    ctx->height = height;
+    ctx->time_base = AVRational{1, fps};
+    ctx->framerate = AVRational{fps, 1};
+    ctx->gop_size = fps;
+    ctx->max_b_frames = 0;
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    AVDictionary* options = nullptr;
+    av_dict_set(&options, "crf", "23", 0);
+    av_dict_set(&options, "preset", preset, 0);
+    int ret = avcodec_open2(ctx, codec, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        avcodec_free_context(&ctx);
+        state.SkipWithError("avcodec_open2 failed");
+        return;
+    }
+
+    // 预生成8帧运动图案，循环送入
+    std::vector<AVFrame*> frames;
+    SwsCase convert;
+    setup_sws(convert, width, height, AV_PIX_FMT_YUYV422, 2, AV_PIX_FMT_YUV420P);
+    for (int i = 0; i < 8; ++i) {
+        AVFrame* f = av_frame_alloc();
+        f->format = AV_PIX_FMT_YUV420P;
+        f->width = width;
+        f->height = height;
+        av_frame_get_buffer(f, 32);
+        fill_yuyv(convert.src, width, height, i * 8);
+        const uint8_t* src_data[1] = {convert.src.data()};
+        int src_linesize[1] = {convert.src_linesize};
+        sws_scale(convert.ctx, src_data, src_linesize, 0, height, f->data, f->linesize);
+        frames.push_back(f);
+    }
+
+    AVPacket* pkt = av_packet_alloc();
+    int64_t pts = 0;
+    int64_t bytes = 0;
+    for (auto _ : state) {
+        AVFrame* f = frames[pts % frames.size()];
+        f->pts = pts++;
+        avcodec_send_frame(ctx, f);
+        while (avcodec_receive_packet(ctx, pkt) == 0) {
+            bytes += pkt->size;
+            av_packet_unref(pkt);
+        }
+    }
+    // 冲刷编码器（循环结束后已停止计时）
+    avcodec_send_frame(ctx, nullptr);
+    while (avcodec_receive_packet(ctx, pkt) == 0) {
+        av_packet_unref(pkt);
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetLabel(std::string(preset) + " " + std::to_string(bytes * 8 / (state.iterations() ? state.iterations() : 1)) + " bits/frame");
+    av_packet_free(&pkt);
+    for (auto f : frames) av_frame_free(&f);
+    avcodec_free_context(&ctx);
+}
+BENCHMARK(BM_EncodeFrame)
+    ->Args({0, 1280, 720})->Args({1, 1280, 720})->Args({2, 1280, 720})
+    ->Args({3, 1280, 720})->Args({0, 1920, 1080})->Args({2, 1920, 1080})
+    ->Unit(benchmark::kMillisecond)->MinTime(2.0);
+
+} // namespace
+
+BENCHMARK_MAIN();
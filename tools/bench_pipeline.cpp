@@ -0,0 +1,505 @@
+/**
+ * @file bench_pipeline.cpp
+ * @brief 端到端流水线基准测试
+ *
+ * 用合成帧源（或录制的原始采集文件）驱动EncoderStreamer，输出到null muxer或本地文件，按参数组合扫描：
+ * 流数量、分辨率、帧率、图像处理器类型、x264预设。每个组合输出一行结果：
+ * 实际帧率、采集→编码包延迟p50/p99、CPU占用、常驻内存，格式为CSV或JSON，便于对比不同构建、评估硬件规格。
+ *
+ * 用法：
+ *   ./bench_pipeline --streams 1,2,4 --res 640x480,1280x720 --fps 30 \
+ *                    --processor none,gray --preset ultrafast,veryfast \
+ *                    --duration 10 --output null --format csv --out result.csv
+ *
+ *   # 回放现场录制的原始帧（分辨率取自文件，--fps 0 为尽可能快，否则按录制节拍）
+ *   ./bench_pipeline --source replay:/data/cam0.rcap --fps 30 --preset veryfast
+ *
+ *   # 推流到本地限速RTMP接收端（tools/rtmp_sink.cpp），评估受限上行下的表现
+ *   ./rtmp_sink --rate 1M --stats sink.json &
+ *   ./bench_pipeline --output rtmp://127.0.0.1:1935/live --duration 30
+ *
+ *   # 故障场景（需以ENABLE_FAULT_INJECTION构建），分号分隔的每个场景单独跑一轮，同一--seed结果可复现
+ *   LD_PRELOAD=./libv4l2_emu.so ./bench_pipeline --source v4l2:/dev/video0 \
+ *       --faults "none;capture.dqbuf@p=0.02;muxer.slow=150@every=30,encoder.send@from=100-110" --seed 7
+ */
+#include "CameraCapture.h"
+#include "EncoderStreamer.h"
+#include "FaultInjector.h"
+#include "ImageProcessor.h"
+#include "Logger.h"
+#include "ReplaySource.h"
+#include "SyntheticSource.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+namespace {
+
+// ------------------------------------------------------------ 图像处理器
+
+class GrayProcessor : public ImageProcessor {
+public:
+    void processFrame(cv::Mat& mat) override {
+        cv::cvtColor(mat, mat, cv::COLOR_BGR2GRAY);
+    }
+};
+
+class BlurProcessor : public ImageProcessor {
+public:
+    void processFrame(cv::Mat& mat) override {
+        cv::GaussianBlur(mat, mat, cv::Size(5, 5), 0);
+    }
+};
+
+std::unique_ptr<ImageProcessor> make_processor(const std::string& name) {
+    if (name == "gray") return std::unique_ptr<ImageProcessor>(new GrayProcessor());
+    if (name == "blur") return std::unique_ptr<ImageProcessor>(new BlurProcessor());
+    return std::unique_ptr<ImageProcessor>(new ImageProcessor());
+}
+
+// ------------------------------------------------------------ 参数
+
+struct Options {
+    std::vector<int> streams = {1};
+    std::vector<std::pair<int, int>> resolutions = {{640, 480}};
+    std::vector<int> fps = {30};
+    std::vector<std::string> processors = {"none"};
+    std::vector<std::string> presets = {"ultrafast"};
+    std::string source = "synthetic"; // synthetic | replay:<file> | v4l2:<dev>[:<dev>...]
+    std::vector<std::string> faults = {""};  // 故障调度表，空字符串表示不注入
+    uint64_t seed = 1;
+    int duration_s = 10;
+    int warmup_s = 2;
+    std::string output = "null";     // null | file | rtmp://host:port/app
+    std::string output_dir = "/tmp";
+    std::string format = "csv";      // csv | json
+    std::string out_path;            // 为空时输出到stdout
+};
+
+struct Config {
+    int streams;
+    int width;
+    int height;
+    int fps;
+    std::string processor;
+    std::string preset;
+    std::string faults;
+};
+
+struct Result {
+    Config config;
+    double elapsed_s = 0;
+    uint64_t packets = 0;
+    uint64_t source_dropped = 0;
+    uint64_t faults_fired = 0;
+    double fps_achieved = 0;     // 每路平均
+    double latency_p50_ms = 0;
+    double latency_p99_ms = 0;
+    double latency_max_ms = 0;
+    double cpu_percent = 0;
+    double rss_mb = 0;
+    double bitrate_kbps = 0;     // 每路平均
+};
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, sep)) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return out;
+}
+
+std::vector<int> split_ints(const std::string& s) {
+    std::vector<int> out;
+    for (const auto& item : split(s, ',')) out.push_back(atoi(item.c_str()));
+    return out;
+}
+
+void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --streams 1,2,4          concurrent streams\n"
+            "  --res 640x480,1280x720   resolutions\n"
+            "  --fps 15,30              source frame rates (0 = as fast as possible)\n"
+            "  --source synthetic|replay:<file.rcap>|v4l2:<dev>[:<dev>...]\n"
+            "                           frame source (replay takes resolution from the file\n"
+            "                           and loops it; fps>0 keeps the recorded timing;\n"
+            "                           v4l2 assigns devices to streams round-robin)\n"
+            "  --faults \"none;<spec>\"    fault scenarios, see FaultInjector.h for the syntax\n"
+            "  --seed 1                 fault schedule seed\n"
+            "  --processor none,gray,blur\n"
+            "  --preset ultrafast,veryfast\n"
+            "  --duration 10            measured seconds per configuration\n"
+            "  --warmup 2               seconds discarded before measuring\n"
+            "  --output null|file|rtmp://127.0.0.1:1935/live\n"
+            "                           muxer sink (file writes FLV into --output-dir,\n"
+            "                           rtmp pushes stream i to <url>/bench<i>, e.g. to rtmp_sink)\n"
+            "  --output-dir /tmp\n"
+            "  --format csv|json\n"
+            "  --out path               result file (default stdout)\n",
+            prog);
+}
+
+bool parse_args(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string key = argv[i];
+        if (key == "-h" || key == "--help") return false;
+        if (i + 1 >= argc) {
+            fprintf(stderr, "missing value for %s\n", key.c_str());
+            return false;
+        }
+        std::string value = argv[++i];
+        if (key == "--streams") {
+            opt.streams = split_ints(value);
+        } else if (key == "--res") {
+            opt.resolutions.clear();
+            for (const auto& r : split(value, ',')) {
+                int w = 0, h = 0;
+                if (sscanf(r.c_str(), "%dx%d", &w, &h) != 2) {
+                    fprintf(stderr, "bad resolution: %s\n", r.c_str());
+                    return false;
+                }
+                opt.resolutions.emplace_back(w, h);
+            }
+        } else if (key == "--fps") {
+            opt.fps = split_ints(value);
+        } else if (key == "--source") {
+            if (value != "synthetic" && value.compare(0, 7, "replay:") != 0 &&
+                value.compare(0, 5, "v4l2:") != 0) {
+                fprintf(stderr, "bad source: %s\n", value.c_str());
+                return false;
+            }
+            opt.source = value;
+        } else if (key == "--faults") {
+            opt.faults.clear();
+            for (const auto& spec : split(value, ';')) {
+                opt.faults.push_back(spec == "none" ? std::string() : spec);
+            }
+            if (opt.faults.empty()) opt.faults.push_back(std::string());
+        } else if (key == "--seed") {
+            opt.seed = strtoull(value.c_str(), nullptr, 10);
+        } else if (key == "--processor") {
+            opt.processors = split(value, ',');
+        } else if (key == "--preset") {
+            opt.presets = split(value, ',');
+        } else if (key == "--duration") {
+            opt.duration_s = atoi(value.c_str());
+        } else if (key == "--warmup") {
+            opt.warmup_s = atoi(value.c_str());
+        } else if (key == "--output") {
+            opt.output = value;
+        } else if (key == "--output-dir") {
+            opt.output_dir = value;
+        } else if (key == "--format") {
+            opt.format = value;
+        } else if (key == "--out") {
+            opt.out_path = value;
+        } else {
+            fprintf(stderr, "unknown option: %s\n", key.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// ------------------------------------------------------------ 帧源
+
+bool is_replay(const Options& opt) {
+    return opt.source.compare(0, 7, "replay:") == 0;
+}
+
+std::unique_ptr<FrameSource> make_source(const Options& opt, const Config& cfg, int index) {
+    if (is_replay(opt)) {
+        ReplayTiming timing = cfg.fps ? ReplayTiming::Original : ReplayTiming::AsFastAsPossible;
+        return std::unique_ptr<FrameSource>(new ReplaySource(opt.source.substr(7), timing, 4, true));
+    }
+    if (opt.source.compare(0, 5, "v4l2:") == 0) {
+        std::vector<std::string> devices = split(opt.source.substr(5), ':');
+        const std::string& device = devices[index % devices.size()];
+        return std::unique_ptr<FrameSource>(new CameraCapture(device, cfg.width, cfg.height, cfg.fps ? cfg.fps : 30));
+    }
+    return std::unique_ptr<FrameSource>(new SyntheticSource(cfg.width, cfg.height, cfg.fps));
+}
+
+// ------------------------------------------------------------ 资源统计
+
+double cpu_seconds() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+double rss_mb() {
+    FILE* fp = fopen("/proc/self/status", "r");
+    if (!fp) return 0;
+    char line[256];
+    long kb = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            kb = atol(line + 6);
+            break;
+        }
+    }
+    fclose(fp);
+    return kb / 1024.0;
+}
+
+double percentile(std::vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0;
+    size_t idx = static_cast<size_t>(q * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+// ------------------------------------------------------------ 单个配置
+
+// 测量窗口内收集的每路统计
+struct StreamStats {
+    std::mutex mutex;
+    bool measuring = false;
+    std::vector<double> latencies_ms;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+};
+
+bool run_config(const Options& opt, const Config& cfg, Result& result) {
+    std::vector<std::unique_ptr<FrameSource>> sources;
+    std::vector<std::unique_ptr<EncoderStreamer>> streamers;
+    std::vector<std::unique_ptr<StreamStats>> stats;
+
+    // 每个场景从同一种子重新开始，触发序列可复现
+    FaultInjector& faults = FaultInjector::instance();
+    if (!faults.configure(cfg.faults, opt.seed)) {
+        fprintf(stderr, "bad fault schedule: %s\n", cfg.faults.c_str());
+        return false;
+    }
+
+    for (int i = 0; i < cfg.streams; ++i) {
+        std::string url = "null";
+        std::string format = "null";
+        if (opt.output == "file") {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/bench_%dx%d_%d_%d.flv",
+                     opt.output_dir.c_str(), cfg.width, cfg.height, cfg.fps, i);
+            url = path;
+            format = "flv";
+        } else if (opt.output.compare(0, 7, "rtmp://") == 0) {
+            url = opt.output + "/bench" + std::to_string(i);
+            format = "flv";
+        }
+
+        std::unique_ptr<EncoderStreamer> streamer(
+            new EncoderStreamer(url, cfg.width, cfg.height, cfg.fps ? cfg.fps : 30));
+        streamer->set_output_format(format);
+        streamer->set_preset(cfg.preset);
+        streamer->set_processor(make_processor(cfg.processor));
+
+        std::unique_ptr<StreamStats> st(new StreamStats());
+        StreamStats* st_ptr = st.get();
+        streamer->set_packet_callback([st_ptr](const AVPacket*, const EncodedPacketInfo& info) {
+            std::lock_guard<std::mutex> lock(st_ptr->mutex);
+            if (!st_ptr->measuring) return;
+            ++st_ptr->packets;
+            st_ptr->bytes += info.size;
+            if (info.capture_us > 0) {
+                st_ptr->latencies_ms.push_back((info.packet_us - info.capture_us) / 1000.0);
+            }
+        });
+        if (!streamer->initialize()) {
+            fprintf(stderr, "failed to initialize streamer %d\n", i);
+            return false;
+        }
+
+        std::unique_ptr<FrameSource> source = make_source(opt, cfg, i);
+        source->set_camera_id(i);
+        EncoderStreamer* streamer_ptr = streamer.get();
+        source->set_frame_callback([streamer_ptr](const CameraFrame& frame) {
+            streamer_ptr->push_frame(frame);
+        });
+        if (!source->initialize()) {
+            fprintf(stderr, "failed to initialize source %d\n", i);
+            return false;
+        }
+
+        sources.push_back(std::move(source));
+        streamers.push_back(std::move(streamer));
+        stats.push_back(std::move(st));
+    }
+
+    for (auto& s : streamers) s->start();
+    for (auto& s : sources) s->start();
+
+    std::this_thread::sleep_for(std::chrono::seconds(opt.warmup_s));
+
+    uint64_t dropped_before = 0;
+    for (auto& s : sources) dropped_before += s->dropped_frames();
+    for (auto& st : stats) {
+        std::lock_guard<std::mutex> lock(st->mutex);
+        st->measuring = true;
+    }
+    double cpu_start = cpu_seconds();
+    auto wall_start = std::chrono::steady_clock::now();
+
+    double peak_rss = 0;
+    auto deadline = wall_start + std::chrono::seconds(opt.duration_s);
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        peak_rss = std::max(peak_rss, rss_mb());
+    }
+
+    for (auto& st : stats) {
+        std::lock_guard<std::mutex> lock(st->mutex);
+        st->measuring = false;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    double cpu_used = cpu_seconds() - cpu_start;
+    uint64_t dropped_after = 0;
+    for (auto& s : sources) dropped_after += s->dropped_frames();
+
+    for (auto& s : sources) s->stop();
+    for (auto& s : streamers) s->stop();
+
+    std::vector<double> latencies;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+    for (auto& st : stats) {
+        std::lock_guard<std::mutex> lock(st->mutex);
+        latencies.insert(latencies.end(), st->latencies_ms.begin(), st->latencies_ms.end());
+        packets += st->packets;
+        bytes += st->bytes;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    result.config = cfg;
+    result.elapsed_s = elapsed;
+    result.packets = packets;
+    result.source_dropped = dropped_after - dropped_before;
+    result.faults_fired = faults.total_fired();
+    if (!cfg.faults.empty()) {
+        fprintf(stderr, "  faults fired: %s\n", faults.summary().c_str());
+    }
+    faults.clear();
+    result.fps_achieved = packets / elapsed / cfg.streams;
+    result.latency_p50_ms = percentile(latencies, 0.50);
+    result.latency_p99_ms = percentile(latencies, 0.99);
+    result.latency_max_ms = latencies.empty() ? 0 : latencies.back();
+    result.cpu_percent = cpu_used / elapsed * 100.0;
+    result.rss_mb = peak_rss;
+    result.bitrate_kbps = bytes * 8 / elapsed / 1000.0 / cfg.streams;
+    return true;
+}
+
+// ------------------------------------------------------------ 输出
+
+void write_csv(FILE* fp, const std::vector<Result>& results) {
+    fprintf(fp, "streams,width,height,fps,processor,preset,faults,duration_s,packets,source_dropped,"
+                "faults_fired,fps_per_stream,latency_p50_ms,latency_p99_ms,latency_max_ms,cpu_percent,rss_mb,"
+                "bitrate_kbps_per_stream\n");
+    for (const auto& r : results) {
+        fprintf(fp, "%d,%d,%d,%d,%s,%s,\"%s\",%.2f,%llu,%llu,%llu,%.2f,%.2f,%.2f,%.2f,%.1f,%.1f,%.1f\n",
+                r.config.streams, r.config.width, r.config.height, r.config.fps,
+                r.config.processor.c_str(), r.config.preset.c_str(), r.config.faults.c_str(), r.elapsed_s,
+                static_cast<unsigned long long>(r.packets),
+                static_cast<unsigned long long>(r.source_dropped),
+                static_cast<unsigned long long>(r.faults_fired),
+                r.fps_achieved, r.latency_p50_ms, r.latency_p99_ms, r.latency_max_ms,
+                r.cpu_percent, r.rss_mb, r.bitrate_kbps);
+    }
+}
+
+void write_json(FILE* fp, const std::vector<Result>& results) {
+    fprintf(fp, "[\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        fprintf(fp, "  {\"streams\": %d, \"width\": %d, \"height\": %d, \"fps\": %d, "
+                    "\"processor\": \"%s\", \"preset\": \"%s\", \"faults\": \"%s\", \"duration_s\": %.2f, "
+                    "\"packets\": %llu, \"source_dropped\": %llu, \"faults_fired\": %llu, \"fps_per_stream\": %.2f, "
+                    "\"latency_p50_ms\": %.2f, \"latency_p99_ms\": %.2f, \"latency_max_ms\": %.2f, "
+                    "\"cpu_percent\": %.1f, \"rss_mb\": %.1f, \"bitrate_kbps_per_stream\": %.1f}%s\n",
+                r.config.streams, r.config.width, r.config.height, r.config.fps,
+                r.config.processor.c_str(), r.config.preset.c_str(), r.config.faults.c_str(), r.elapsed_s,
+                static_cast<unsigned long long>(r.packets),
+                static_cast<unsigned long long>(r.source_dropped),
+                static_cast<unsigned long long>(r.faults_fired),
+                r.fps_achieved, r.latency_p50_ms, r.latency_p99_ms, r.latency_max_ms,
+                r.cpu_percent, r.rss_mb, r.bitrate_kbps,
+                i + 1 < results.size() ? "," : "");
+    }
+    fprintf(fp, "]\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+    Logger::instance().set_level(LogLevel::Warn);
+    av_log_set_level(AV_LOG_ERROR);
+
+    if (is_replay(opt)) {
+        // 回放时分辨率由录制文件决定
+        ReplaySource probe(opt.source.substr(7));
+        if (!probe.initialize()) {
+            fprintf(stderr, "cannot load %s\n", opt.source.c_str() + 7);
+            return 1;
+        }
+        opt.resolutions = {{static_cast<int>(probe.width()), static_cast<int>(probe.height())}};
+    }
+
+#ifndef ENABLE_FAULT_INJECTION
+    for (const auto& spec : opt.faults) {
+        if (!spec.empty()) {
+            fprintf(stderr, "warning: built without ENABLE_FAULT_INJECTION, --faults has no effect\n");
+            break;
+        }
+    }
+#endif
+
+    std::vector<Config> configs;
+    for (int streams : opt.streams)
+        for (const auto& res : opt.resolutions)
+            for (int fps : opt.fps)
+                for (const auto& processor : opt.processors)
+                    for (const auto& preset : opt.presets)
+                        for (const auto& faults : opt.faults)
+                            configs.push_back(Config{streams, res.first, res.second, fps, processor, preset, faults});
+
+    std::vector<Result> results;
+    for (size_t i = 0; i < configs.size(); ++i) {
+        const Config& cfg = configs[i];
+        fprintf(stderr, "[%zu/%zu] streams=%d %dx%d@%d processor=%s preset=%s faults=%s\n",
+                i + 1, configs.size(), cfg.streams, cfg.width, cfg.height, cfg.fps,
+                cfg.processor.c_str(), cfg.preset.c_str(), cfg.faults.empty() ? "none" : cfg.faults.c_str());
+        Result result;
+        if (run_config(opt, cfg, result)) {
+            results.push_back(result);
+        }
+    }
+
+    FILE* fp = opt.out_path.empty() ? stdout : fopen(opt.out_path.c_str(), "w");
+    if (!fp) {
+        fprintf(stderr, "cannot open %s\n", opt.out_path.c_str());
+        return 1;
+    }
+    if (opt.format == "json") {
+        write_json(fp, results);
+    } else {
+        write_csv(fp, results);
+    }
+    if (fp != stdout) fclose(fp);
+    return results.size() == configs.size() ? 0 : 1;
+}
@@ -0,0 +1,249 @@
+#pragma once
+/**
+ * @file microbench.h
+ * @brief 轻量微基准框架（Google Benchmark API子集）
+ *
+ * 板端交叉编译环境通常没有Google Benchmark，这里提供与其接口兼容的最小实现，
+ * 基准代码可以不加修改地在两者之间切换（CMake中 USE_GOOGLE_BENCHMARK=ON 时使用官方库）。
+ *
+ * 支持的接口：
+ * - BENCHMARK(fn)->Arg(x)->Args({x, y})->Unit(benchmark::kMicrosecond)->MinTime(s)
+ * - for (auto _ : state) {...}、state.range(i)、state.PauseTiming()/ResumeTiming()
+ * - state.SetItemsProcessed()/SetBytesProcessed()/SetLabel()
+ * - benchmark::DoNotOptimize()/ClobberMemory()、BENCHMARK_MAIN()
+ *
+ * 只依赖std::chrono和GCC/Clang内联汇编约束，x86_64与aarch64均可编译。
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+enum TimeUnit { kNanosecond, kMicrosecond, kMillisecond };
+
+template <typename T>
+inline void DoNotOptimize(T const& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template <typename T>
+inline void DoNotOptimize(T& value) {
+    asm volatile("" : "+r,m"(value) : : "memory");
+}
+
+inline void ClobberMemory() {
+    asm volatile("" : : : "memory");
+}
+
+class State {
+public:
+    using clock = std::chrono::steady_clock;
+
+    State(int64_t iterations, std::vector<int64_t> args)
+        : max_iterations_(iterations), args_(std::move(args)) {}
+
+    // 循环变量类型（标记为unused，避免for (auto _ : state)触发告警）
+    struct __attribute__((unused)) Value {};
+
+    // 供 for (auto _ : state) 使用的计数迭代器
+    struct Iterator {
+        State* state;
+        int64_t remaining;
+        bool operator!=(const Iterator&) const {
+            if (remaining > 0) return true;
+            state->finish();
+            return false;
+        }
+        void operator++() { --remaining; }
+        Value operator*() const { return Value(); }
+    };
+
+    Iterator begin() {
+        start();
+        return Iterator{this, max_iterations_};
+    }
+    Iterator end() { return Iterator{this, 0}; }
+
+    int64_t range(size_t i = 0) const { return i < args_.size() ? args_[i] : 0; }
+    int64_t iterations() const { return max_iterations_; }
+
+    void PauseTiming() {
+        if (paused_) return;
+        elapsed_ += clock::now() - start_time_;
+        paused_ = true;
+    }
+    void ResumeTiming() {
+        if (!paused_) return;
+        start_time_ = clock::now();
+        paused_ = false;
+    }
+
+    void SetItemsProcessed(int64_t n) { items_ = n; }
+    void SetBytesProcessed(int64_t n) { bytes_ = n; }
+    void SetLabel(const std::string& label) { label_ = label; }
+    void SkipWithError(const char* msg) { error_ = msg; max_iterations_ = 0; }
+
+    double elapsed_seconds() const { return std::chrono::duration<double>(elapsed_).count(); }
+    int64_t items_processed() const { return items_; }
+    int64_t bytes_processed() const { return bytes_; }
+    const std::string& label() const { return label_; }
+    const std::string& error() const { return error_; }
+
+private:
+    void start() {
+        elapsed_ = clock::duration::zero();
+        start_time_ = clock::now();
+        paused_ = false;
+    }
+    void finish() {
+        if (!paused_) {
+            elapsed_ += clock::now() - start_time_;
+            paused_ = true;
+        }
+    }
+
+    int64_t max_iterations_;
+    std::vector<int64_t> args_;
+    clock::time_point start_time_;
+    clock::duration elapsed_ = clock::duration::zero();
+    bool paused_ = true;
+    int64_t items_ = 0;
+    int64_t bytes_ = 0;
+    std::string label_;
+    std::string error_;
+};
+
+namespace internal {
+
+class Benchmark {
+public:
+    Benchmark(const char* name, std::function<void(State&)> fn)
+        : name_(name), fn_(std::move(fn)) {}
+
+    Benchmark* Arg(int64_t x) {
+        arg_sets_.push_back({x});
+        return this;
+    }
+    Benchmark* Args(std::initializer_list<int64_t> args) {
+        arg_sets_.push_back(std::vector<int64_t>(args));
+        return this;
+    }
+    Benchmark* Unit(TimeUnit unit) {
+        unit_ = unit;
+        return this;
+    }
+    Benchmark* MinTime(double seconds) {
+        min_time_ = seconds;
+        return this;
+    }
+    Benchmark* UseRealTime() { return this; }
+
+    void run_all(const std::string& filter) const {
+        std::vector<std::vector<int64_t>> sets = arg_sets_;
+        if (sets.empty()) sets.push_back({});
+        for (const auto& args : sets) {
+            std::string full = name_;
+            for (int64_t a : args) full += "/" + std::to_string(a);
+            if (!filter.empty() && full.find(filter) == std::string::npos) continue;
+            run_one(full, args);
+        }
+    }
+
+private:
+    void run_one(const std::string& name, const std::vector<int64_t>& args) const {
+        // 迭代次数按10倍递增，直到单次运行时间超过min_time
+        int64_t iterations = 1;
+        for (;;) {
+            State state(iterations, args);
+            fn_(state);
+            if (!state.error().empty()) {
+                printf("%-48s ERROR: %s\n", name.c_str(), state.error().c_str());
+                return;
+            }
+            double seconds = state.elapsed_seconds();
+            if (seconds >= min_time_ || iterations >= (int64_t(1) << 40)) {
+                report(name, state, seconds, iterations);
+                return;
+            }
+            double scale = seconds > 0 ? min_time_ * 1.4 / seconds : 10.0;
+            int64_t next = static_cast<int64_t>(iterations * (scale < 10.0 ? scale : 10.0));
+            iterations = next > iterations ? next : iterations + 1;
+        }
+    }
+
+    void report(const std::string& name, const State& state, double seconds, int64_t iterations) const {
+        double per_iter = seconds / iterations;
+        const char* unit = "ns";
+        double value = per_iter * 1e9;
+        if (unit_ == kMicrosecond) { unit = "us"; value = per_iter * 1e6; }
+        if (unit_ == kMillisecond) { unit = "ms"; value = per_iter * 1e3; }
+        printf("%-48s %12.1f %s %12lld", name.c_str(), value, unit, static_cast<long long>(iterations));
+        if (state.items_processed()) {
+            printf("   items/s=%.3g", state.items_processed() / seconds);
+        }
+        if (state.bytes_processed()) {
+            printf("   MB/s=%.1f", state.bytes_processed() / seconds / 1e6);
+        }
+        if (!state.label().empty()) {
+            printf("   %s", state.label().c_str());
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    std::string name_;
+    std::function<void(State&)> fn_;
+    std::vector<std::vector<int64_t>> arg_sets_;
+    TimeUnit unit_ = kNanosecond;
+    double min_time_ = 0.5;
+};
+
+inline std::vector<std::unique_ptr<Benchmark>>& registry() {
+    static std::vector<std::unique_ptr<Benchmark>> benchmarks;
+    return benchmarks;
+}
+
+inline Benchmark* register_benchmark(const char* name, void (*fn)(State&)) {
+    registry().emplace_back(new Benchmark(name, fn));
+    return registry().back().get();
+}
+
+} // namespace internal
+
+inline internal::Benchmark* RegisterBenchmark(const char* name, std::function<void(State&)> fn) {
+    internal::registry().emplace_back(new internal::Benchmark(name, std::move(fn)));
+    return internal::registry().back().get();
+}
+
+inline void RunSpecifiedBenchmarks(int argc, char** argv) {
+    std::string filter;
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "--benchmark_filter=", 19) == 0) filter = argv[i] + 19;
+    }
+    printf("%-48s %15s %12s\n", "Benchmark", "Time", "Iterations");
+    printf("%s\n", std::string(80, '-').c_str());
+    for (const auto& b : internal::registry()) {
+        b->run_all(filter);
+    }
+}
+
+} // namespace benchmark
+
+#define MICROBENCH_CONCAT_(a, b) a##b
+#define MICROBENCH_CONCAT(a, b) MICROBENCH_CONCAT_(a, b)
+#define BENCHMARK(fn)                                                           \
+    static ::benchmark::internal::Benchmark* MICROBENCH_CONCAT(_bench_, __LINE__) \
+        __attribute__((unused)) = ::benchmark::internal::register_benchmark(#fn, fn)
+
+#define BENCHMARK_MAIN()                                  \
+    int main(int argc, char** argv) {                     \
+        ::benchmark::RunSpecifiedBenchmarks(argc, argv);  \
+        return 0;                                         \
+    }
@@ -0,0 +1,755 @@
+/**
+ * @file rtmp_sink.cpp
+ * @brief 本地限速RTMP接收端（网络背压测试用）
+ *
+ * 在回环地址上接受EncoderStreamer的RTMP推流，模拟受限上行链路：
+ * - 带宽：按令牌桶限速读取socket，配合较小的SO_RCVBUF，推流端很快感受到TCP背压
+ * - 时延/抖动：收到的数据经过延迟线后才交给RTMP解析，到达时间按延迟后计算
+ * - 停顿：周期性停止读取（--stall-every/--stall-ms），模拟链路中断但连接未断
+ * - 断线：连接建立一段时间后强制关闭，并在--outage-ms内拒绝新连接，模拟服务器重启
+ *
+ * 每个推流会话可录制为FLV文件，并统计每个视频帧的到达时间：
+ * 相对延迟 = (到达时间 - 帧时间戳) - 该会话中的最小值，即链路带来的排队延迟；
+ * 时间戳跳变按帧间隔折算为丢失帧数。结束时输出JSON汇总（--stats）和逐帧CSV（--csv），
+ * 可用于断言1Mbps上行或5秒中断下的端到端延迟和丢帧行为。
+ *
+ * 用法：
+ *   ./rtmp_sink --port 1935 --rate 1M --latency 40 --jitter 10 --record /tmp/sink --stats sink.json
+ *   ./bench_pipeline --output rtmp://127.0.0.1:1935/live --duration 30
+ *
+ *   # 每20秒断线一次，服务器5秒后恢复
+ *   ./rtmp_sink --reset-after 20 --outage-ms 5000
+ */
+#include "RtmpProtocol.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> g_running(true);
+
+void signal_handler(int) {
+    g_running = false;
+}
+
+int64_t monotonic_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct Options {
+    int port = 1935;
+    int64_t rate_bps = 0;        // 0表示不限速
+    int latency_ms = 0;
+    int jitter_ms = 0;
+    int stall_every_s = 0;       // 每隔多少秒停顿一次（从接收端启动算起）
+    int stall_ms = 0;
+    int reset_after_s = 0;       // 会话建立多少秒后强制断开
+    int outage_ms = 0;           // 断开后拒绝新连接的时长
+    int rcvbuf = 64 * 1024;
+    int duration_s = 0;          // 0表示一直运行到SIGINT
+    uint32_t seed = 1;
+    std::string record_dir;
+    std::string stats_path;
+    std::string csv_path;
+};
+
+// 单个视频帧的到达记录
+struct FrameArrival {
+    uint32_t timestamp_ms;
+    int64_t arrival_us;
+    uint32_t size;
+    bool keyframe;
+};
+
+// 会话统计（会话结束后汇总）
+struct SessionSummary {
+    int id = 0;
+    std::string peer;
+    std::string app;
+    std::string stream;
+    std::string end_reason;
+    int64_t start_us = 0;
+    int64_t end_us = 0;
+    uint64_t bytes = 0;
+    std::vector<FrameArrival> frames;
+};
+
+int64_t parse_rate(const std::string& s) {
+    if (s.empty()) return 0;
+    double value = atof(s.c_str());
+    switch (s.back()) {
+    case 'k': case 'K': return static_cast<int64_t>(value * 1000);
+    case 'm': case 'M': return static_cast<int64_t>(value * 1000000);
+    default: return static_cast<int64_t>(value);
+    }
+}
+
+void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --port 1935\n"
+            "  --rate 1M                  read bandwidth in bit/s (k/M suffix, 0 = unlimited)\n"
+            "  --latency 0                one-way delay in ms added before parsing\n"
+            "  --jitter 0                 +/- ms of random delay on top of --latency\n"
+            "  --stall-every 0            stop reading every N seconds ...\n"
+            "  --stall-ms 0               ... for this long\n"
+            "  --reset-after 0            drop each connection after N seconds\n"
+            "  --outage-ms 0              refuse connections for this long after a drop\n"
+            "  --rcvbuf 65536             SO_RCVBUF of accepted sockets\n"
+            "  --duration 0               exit after N seconds (0 = until SIGINT)\n"
+            "  --seed 1                   jitter seed\n"
+            "  --record <dir>             write each published stream to <dir>/<app>_<stream>_<n>.flv\n"
+            "  --stats <file.json>        per-session summary\n"
+            "  --csv <file.csv>           per-frame arrivals\n",
+            prog);
+}
+
+bool parse_args(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string key = argv[i];
+        if (key == "-h" || key == "--help") return false;
+        if (i + 1 >= argc) {
+            fprintf(stderr, "missing value for %s\n", key.c_str());
+            return false;
+        }
+        std::string value = argv[++i];
+        if (key == "--port") {
+            opt.port = atoi(value.c_str());
+        } else if (key == "--rate") {
+            opt.rate_bps = parse_rate(value);
+        } else if (key == "--latency") {
+            opt.latency_ms = atoi(value.c_str());
+        } else if (key == "--jitter") {
+            opt.jitter_ms = atoi(value.c_str());
+        } else if (key == "--stall-every") {
+            opt.stall_every_s = atoi(value.c_str());
+        } else if (key == "--stall-ms") {
+            opt.stall_ms = atoi(value.c_str());
+        } else if (key == "--reset-after") {
+            opt.reset_after_s = atoi(value.c_str());
+        } else if (key == "--outage-ms") {
+            opt.outage_ms = atoi(value.c_str());
+        } else if (key == "--rcvbuf") {
+            opt.rcvbuf = atoi(value.c_str());
+        } else if (key == "--duration") {
+            opt.duration_s = atoi(value.c_str());
+        } else if (key == "--seed") {
+            opt.seed = static_cast<uint32_t>(strtoul(value.c_str(), nullptr, 10));
+        } else if (key == "--record") {
+            opt.record_dir = value;
+        } else if (key == "--stats") {
+            opt.stats_path = value;
+        } else if (key == "--csv") {
+            opt.csv_path = value;
+        } else {
+            fprintf(stderr, "unknown option: %s\n", key.c_str());
+            return false;
+        }
+    }
+    return opt.port > 0;
+}
+
+// 服务器全局状态：会话结束后的汇总、断线后的拒绝连接窗口
+struct Server {
+    Options opt;
+    int64_t start_us = 0;
+    std::atomic<int64_t> outage_until_us{0};
+    std::mutex mutex;
+    std::vector<SessionSummary> finished;
+};
+
+bool send_all(int fd, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool recv_all(int fd, uint8_t* data, size_t size) {
+    while (size > 0) {
+        pollfd pfd = {fd, POLLIN, 0};
+        int r = poll(&pfd, 1, 200);
+        if (r < 0 && errno != EINTR) return false;
+        if (!g_running) return false;
+        if (r <= 0) continue;
+        ssize_t n = recv(fd, data, size, 0);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * @brief 单个推流连接：握手、限速读取、RTMP命令应答、录制与到达统计
+ */
+class Session {
+public:
+    Session(Server& server, int fd, int id, const std::string& peer)
+        : server_(server), opt_(server.opt), fd_(fd),
+          reader_([this](const RtmpMessage& message) { return on_message(message); }),
+          rng_(opt_.seed + id) {
+        summary_.id = id;
+        summary_.peer = peer;
+    }
+
+    ~Session() {
+        if (flv_) fclose(flv_);
+        close(fd_);
+    }
+
+    void run() {
+        summary_.start_us = monotonic_us();
+        if (handshake()) {
+            summary_.end_reason = loop();
+        } else {
+            summary_.end_reason = "handshake failed";
+        }
+        summary_.end_us = monotonic_us();
+        print_summary();
+        std::lock_guard<std::mutex> lock(server_.mutex);
+        server_.finished.push_back(std::move(summary_));
+    }
+
+private:
+    // 等待交给解析器的数据（模拟链路时延）
+    struct Delayed {
+        int64_t deliver_us;
+        std::vector<uint8_t> data;
+    };
+
+    bool handshake() {
+        uint8_t c0c1[1 + kRtmpHandshakeSize];
+        if (!recv_all(fd_, c0c1, sizeof(c0c1))) return false;
+        if (c0c1[0] != 3) {
+            fprintf(stderr, "[session %d] unsupported RTMP version %u\n", summary_.id, c0c1[0]);
+            return false;
+        }
+        std::vector<uint8_t> s0s1s2 = rtmp_server_handshake(c0c1);
+        if (!send_all(fd_, s0s1s2.data(), s0s1s2.size())) return false;
+        uint8_t c2[kRtmpHandshakeSize];
+        return recv_all(fd_, c2, sizeof(c2));
+    }
+
+    bool stalled(int64_t now) const {
+        if (opt_.stall_every_s <= 0 || opt_.stall_ms <= 0) return false;
+        int64_t period = static_cast<int64_t>(opt_.stall_every_s) * 1000000;
+        int64_t phase = (now - server_.start_us) % period;
+        return now - server_.start_us >= period && phase < static_cast<int64_t>(opt_.stall_ms) * 1000;
+    }
+
+    std::string loop() {
+        std::vector<uint8_t> buf(64 * 1024);
+        const double bytes_per_us = opt_.rate_bps / 8e6;
+        const double burst = std::max(1500.0, opt_.rate_bps / 8.0 / 50);  // 20ms的数据量
+        double tokens = burst;
+        int64_t last_refill = monotonic_us();
+        int64_t last_delivery = 0;
+        bool eof = false;
+
+        while (g_running) {
+            int64_t now = monotonic_us();
+            if (opt_.reset_after_s > 0 && now - summary_.start_us >= opt_.reset_after_s * 1000000LL) {
+                server_.outage_until_us = now + opt_.outage_ms * 1000LL;
+                struct linger lg = {1, 0};  // RST，推流端立即感知
+                setsockopt(fd_, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+                return "reset";
+            }
+
+            // 交付到期的数据
+            while (!delayed_.empty() && delayed_.front().deliver_us <= now) {
+                deliver_us_ = delayed_.front().deliver_us;
+                bool ok = reader_.feed(delayed_.front().data.data(), delayed_.front().data.size());
+                delayed_.pop_front();
+                if (!ok) return protocol_error_.empty() ? "protocol error" : protocol_error_;
+                if (!send_pending()) return "send failed";
+            }
+            if (eof) {
+                if (delayed_.empty()) return "closed";
+                std::this_thread::sleep_for(std::chrono::microseconds(delayed_.front().deliver_us - now));
+                continue;
+            }
+
+            // 计算本轮允许读取的字节数
+            size_t allowed = buf.size();
+            int wait_ms = 10;
+            if (stalled(now)) {
+                allowed = 0;
+            } else if (opt_.rate_bps > 0) {
+                tokens = std::min(burst, tokens + (now - last_refill) * bytes_per_us);
+                last_refill = now;
+                if (tokens < 1) {
+                    allowed = 0;
+                    wait_ms = std::max(1, static_cast<int>((1 - tokens) / bytes_per_us / 1000));
+                } else {
+                    allowed = std::min(allowed, static_cast<size_t>(tokens));
+                }
+            }
+            if (!delayed_.empty()) {
+                wait_ms = std::min<int64_t>(wait_ms, std::max<int64_t>(0, (delayed_.front().deliver_us - now) / 1000));
+            }
+            if (allowed == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(std::max(wait_ms, 1)));
+                continue;
+            }
+
+            pollfd pfd = {fd_, POLLIN, 0};
+            int r = poll(&pfd, 1, wait_ms);
+            if (r < 0 && errno != EINTR) return "poll failed";
+            if (r <= 0) continue;
+            ssize_t n = recv(fd_, buf.data(), allowed, 0);
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN) continue;
+                return "recv failed";
+            }
+            if (n == 0) {
+                eof = true;
+                continue;
+            }
+            if (opt_.rate_bps > 0) tokens -= n;
+
+            now = monotonic_us();
+            int64_t delay_us = opt_.latency_ms * 1000LL;
+            if (opt_.jitter_ms > 0) {
+                std::uniform_int_distribution<int64_t> jitter(-opt_.jitter_ms * 1000LL, opt_.jitter_ms * 1000LL);
+                delay_us = std::max<int64_t>(0, delay_us + jitter(rng_));
+            }
+            // TCP保序：不能早于前一段数据交付
+            int64_t deliver_us = std::max(last_delivery, now + delay_us);
+            last_delivery = deliver_us;
+            delayed_.push_back(Delayed{deliver_us, std::vector<uint8_t>(buf.begin(), buf.begin() + n)});
+        }
+        return "stopped";
+    }
+
+    // 把排队的应答发给推流端
+    bool send_pending() {
+        if (out_.empty()) return true;
+        bool ok = send_all(fd_, out_.data(), out_.size());
+        out_.clear();
+        return ok;
+    }
+
+    void queue(const RtmpMessage& message) {
+        writer_.write(message, out_);
+    }
+
+    bool on_message(const RtmpMessage& message) {
+        summary_.bytes += message.payload.size();
+        // 对端声明了确认窗口时按窗口发送Acknowledgement
+        if (ack_window_ > 0 && reader_.bytes_received() - last_ack_ >= ack_window_) {
+            last_ack_ = reader_.bytes_received();
+            queue(rtmp_control_message(RtmpMessageType::Acknowledgement, static_cast<uint32_t>(last_ack_)));
+        }
+
+        switch (static_cast<RtmpMessageType>(message.type)) {
+        case RtmpMessageType::WindowAckSize:
+            if (message.payload.size() >= 4) {
+                const uint8_t* p = message.payload.data();
+                ack_window_ = (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+            }
+            return true;
+        case RtmpMessageType::CommandAmf0:
+            return on_command(message);
+        case RtmpMessageType::Video:
+            on_video(message);
+            write_tag(message);
+            return true;
+        case RtmpMessageType::Audio:
+            write_tag(message);
+            return true;
+        case RtmpMessageType::DataAmf0:
+            write_tag(message);
+            return true;
+        default:
+            return true;
+        }
+    }
+
+    bool on_command(const RtmpMessage& message) {
+        Amf0Reader amf(message.payload.data(), message.payload.size());
+        std::string name;
+        double txn = 0;
+        if (!amf.read_string(name) || !amf.read_number(txn)) {
+            protocol_error_ = "malformed command";
+            return false;
+        }
+
+        if (name == "connect") {
+            std::map<std::string, std::string> props;
+            amf.read_object(props);
+            summary_.app = props["app"];
+            queue(rtmp_control_message(RtmpMessageType::WindowAckSize, 2500000));
+            queue(rtmp_peer_bandwidth_message(2500000, 2));
+            queue(rtmp_control_message(RtmpMessageType::SetChunkSize, 4096));
+            writer_.set_chunk_size(4096);
+
+            RtmpMessage result;
+            result.chunk_stream_id = kRtmpCommandChunkStream;
+            result.type = static_cast<uint8_t>(RtmpMessageType::CommandAmf0);
+            Amf0Writer w(result.payload);
+            w.string("_result");
+            w.number(txn);
+            w.object_begin();
+            w.property("fmsVer", "FMS/3,0,1,123");
+            w.property("capabilities", 31.0);
+            w.object_end();
+            w.object_begin();
+            w.property("level", "status");
+            w.property("code", "NetConnection.Connect.Success");
+            w.property("description", "Connection succeeded.");
+            w.property("objectEncoding", 0.0);
+            w.object_end();
+            queue(result);
+        } else if (name == "createStream") {
+            RtmpMessage result;
+            result.chunk_stream_id = kRtmpCommandChunkStream;
+            result.type = static_cast<uint8_t>(RtmpMessageType::CommandAmf0);
+            Amf0Writer w(result.payload);
+            w.string("_result");
+            w.number(txn);
+            w.null();
+            w.number(1);
+            queue(result);
+        } else if (name == "publish") {
+            amf.read_null();
+            amf.read_string(summary_.stream);
+            fprintf(stderr, "[session %d] %s publishing %s/%s\n", summary_.id, summary_.peer.c_str(),
+                    summary_.app.c_str(), summary_.stream.c_str());
+            open_recording();
+
+            queue(rtmp_user_control_message(0, message.stream_id));  // Stream Begin
+            RtmpMessage status;
+            status.chunk_stream_id = kRtmpStreamChunkStream;
+            status.type = static_cast<uint8_t>(RtmpMessageType::CommandAmf0);
+            status.stream_id = message.stream_id;
+            Amf0Writer w(status.payload);
+            w.string("onStatus");
+            w.number(0);
+            w.null();
+            w.object_begin();
+            w.property("level", "status");
+            w.property("code", "NetStream.Publish.Start");
+            w.property("description", "Start publishing.");
+            w.object_end();
+            queue(status);
+        } else if (txn > 0) {
+            // releaseStream/FCPublish等：回复空结果即可
+            RtmpMessage result;
+            result.chunk_stream_id = kRtmpCommandChunkStream;
+            result.type = static_cast<uint8_t>(RtmpMessageType::CommandAmf0);
+            Amf0Writer w(result.payload);
+            w.string("_result");
+            w.number(txn);
+            w.null();
+            queue(result);
+        }
+        return true;
+    }
+
+    void on_video(const RtmpMessage& message) {
+        if (message.payload.size() < 2) return;
+        // AVC序列头不是视频帧
+        bool avc = (message.payload[0] & 0x0f) == 7;
+        if (avc && message.payload[1] == 0) return;
+        FrameArrival arrival;
+        arrival.timestamp_ms = message.timestamp;
+        arrival.arrival_us = deliver_us_;
+        arrival.size = static_cast<uint32_t>(message.payload.size());
+        arrival.keyframe = (message.payload[0] >> 4) == 1;
+        summary_.frames.push_back(arrival);
+    }
+
+    void open_recording() {
+        if (opt_.record_dir.empty() || flv_) return;
+        std::string app = summary_.app;
+        std::replace(app.begin(), app.end(), '/', '_');
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s_%s_%d.flv", opt_.record_dir.c_str(), app.c_str(),
+                 summary_.stream.c_str(), summary_.id);
+        flv_ = fopen(path, "wb");
+        if (!flv_) {
+            fprintf(stderr, "[session %d] cannot create %s: %s\n", summary_.id, path, strerror(errno));
+            return;
+        }
+        static const uint8_t kHeader[] = {'F', 'L', 'V', 1, 0x05, 0, 0, 0, 9, 0, 0, 0, 0};
+        fwrite(kHeader, 1, sizeof(kHeader), flv_);
+    }
+
+    // 以FLV tag写入录制文件（去掉推流端添加的@setDataFrame前缀）
+    void write_tag(const RtmpMessage& message) {
+        if (!flv_) return;
+        const uint8_t* data = message.payload.data();
+        size_t size = message.payload.size();
+        if (message.type == static_cast<uint8_t>(RtmpMessageType::DataAmf0)) {
+            Amf0Reader amf(data, size);
+            std::string name;
+            if (amf.read_string(name) && name == "@setDataFrame") {
+                data += amf.position();
+                size -= amf.position();
+            }
+        }
+        uint8_t tag[11];
+        tag[0] = message.type;
+        tag[1] = static_cast<uint8_t>(size >> 16);
+        tag[2] = static_cast<uint8_t>(size >> 8);
+        tag[3] = static_cast<uint8_t>(size);
+        tag[4] = static_cast<uint8_t>(message.timestamp >> 16);
+        tag[5] = static_cast<uint8_t>(message.timestamp >> 8);
+        tag[6] = static_cast<uint8_t>(message.timestamp);
+        tag[7] = static_cast<uint8_t>(message.timestamp >> 24);
+        tag[8] = tag[9] = tag[10] = 0;
+        uint32_t tag_size = static_cast<uint32_t>(size + sizeof(tag));
+        uint8_t prev[4] = {static_cast<uint8_t>(tag_size >> 24), static_cast<uint8_t>(tag_size >> 16),
+                           static_cast<uint8_t>(tag_size >> 8), static_cast<uint8_t>(tag_size)};
+        fwrite(tag, 1, sizeof(tag), flv_);
+        fwrite(data, 1, size, flv_);
+        fwrite(prev, 1, sizeof(prev), flv_);
+    }
+
+    void print_summary() const {
+        const auto& frames = summary_.frames;
+        double seconds = (summary_.end_us - summary_.start_us) / 1e6;
+        fprintf(stderr, "[session %d] %s/%s ended (%s): %zu frames, %.1f kbit/s over %.1f s\n",
+                summary_.id, summary_.app.c_str(), summary_.stream.c_str(), summary_.end_reason.c_str(),
+                frames.size(), seconds > 0 ? summary_.bytes * 8 / seconds / 1000 : 0.0, seconds);
+    }
+
+private:
+    Server& server_;
+    const Options& opt_;
+    int fd_;
+    RtmpChunkReader reader_;
+    RtmpChunkWriter writer_;
+    std::vector<uint8_t> out_;
+    std::deque<Delayed> delayed_;
+    int64_t deliver_us_ = 0;      // 正在交付的数据的到达时间
+    uint32_t ack_window_ = 0;
+    uint64_t last_ack_ = 0;
+    std::string protocol_error_;
+    std::mt19937 rng_;
+    FILE* flv_ = nullptr;
+    SessionSummary summary_;
+};
+
+// 帧统计
+struct FrameStats {
+    double delay_p50_ms = 0;
+    double delay_p95_ms = 0;
+    double delay_p99_ms = 0;
+    double delay_max_ms = 0;
+    double max_arrival_gap_ms = 0;
+    uint64_t keyframes = 0;
+    uint64_t missing_frames = 0;
+};
+
+FrameStats compute_stats(const std::vector<FrameArrival>& frames) {
+    FrameStats stats;
+    if (frames.empty()) return stats;
+
+    // 相对延迟：到达时间与帧时间戳之差，减去最小值
+    std::vector<double> delays;
+    delays.reserve(frames.size());
+    for (const auto& f : frames) {
+        delays.push_back(f.arrival_us / 1000.0 - f.timestamp_ms);
+        if (f.keyframe) ++stats.keyframes;
+    }
+    double base = *std::min_element(delays.begin(), delays.end());
+    for (auto& d : delays) d -= base;
+    std::vector<double> sorted = delays;
+    std::sort(sorted.begin(), sorted.end());
+    auto pct = [&](double p) { return sorted[static_cast<size_t>(p * (sorted.size() - 1))]; };
+    stats.delay_p50_ms = pct(0.50);
+    stats.delay_p95_ms = pct(0.95);
+    stats.delay_p99_ms = pct(0.99);
+    stats.delay_max_ms = sorted.back();
+
+    // 帧间隔取时间戳差的中位数，大于1.5倍视为丢帧
+    std::vector<uint32_t> deltas;
+    for (size_t i = 1; i < frames.size(); ++i) {
+        stats.max_arrival_gap_ms = std::max(stats.max_arrival_gap_ms,
+                                            (frames[i].arrival_us - frames[i - 1].arrival_us) / 1000.0);
+        if (frames[i].timestamp_ms > frames[i - 1].timestamp_ms) {
+            deltas.push_back(frames[i].timestamp_ms - frames[i - 1].timestamp_ms);
+        }
+    }
+    if (!deltas.empty()) {
+        std::vector<uint32_t> sorted_deltas = deltas;
+        std::nth_element(sorted_deltas.begin(), sorted_deltas.begin() + sorted_deltas.size() / 2, sorted_deltas.end());
+        double interval = std::max<uint32_t>(1, sorted_deltas[sorted_deltas.size() / 2]);
+        for (uint32_t d : deltas) {
+            if (d > interval * 1.5) stats.missing_frames += static_cast<uint64_t>(d / interval + 0.5) - 1;
+        }
+    }
+    return stats;
+}
+
+void write_stats(const std::string& path, const std::vector<SessionSummary>& sessions) {
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        fprintf(stderr, "cannot write %s: %s\n", path.c_str(), strerror(errno));
+        return;
+    }
+    fprintf(fp, "{\"sessions\": [\n");
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        const SessionSummary& s = sessions[i];
+        FrameStats st = compute_stats(s.frames);
+        double seconds = (s.end_us - s.start_us) / 1e6;
+        fprintf(fp,
+                "  {\"id\": %d, \"peer\": \"%s\", \"app\": \"%s\", \"stream\": \"%s\", \"end\": \"%s\", "
+                "\"duration_s\": %.2f, \"bytes\": %llu, \"bitrate_kbps\": %.1f, \"video_frames\": %zu, "
+                "\"keyframes\": %llu, \"missing_frames\": %llu, \"delay_p50_ms\": %.1f, \"delay_p95_ms\": %.1f, "
+                "\"delay_p99_ms\": %.1f, \"delay_max_ms\": %.1f, \"max_arrival_gap_ms\": %.1f}%s\n",
+                s.id, s.peer.c_str(), s.app.c_str(), s.stream.c_str(), s.end_reason.c_str(), seconds,
+                static_cast<unsigned long long>(s.bytes), seconds > 0 ? s.bytes * 8 / seconds / 1000 : 0.0,
+                s.frames.size(), static_cast<unsigned long long>(st.keyframes),
+                static_cast<unsigned long long>(st.missing_frames), st.delay_p50_ms, st.delay_p95_ms,
+                st.delay_p99_ms, st.delay_max_ms, st.max_arrival_gap_ms,
+                i + 1 < sessions.size() ? "," : "");
+    }
+    fprintf(fp, "]}\n");
+    fclose(fp);
+}
+
+void write_csv(const std::string& path, const std::vector<SessionSummary>& sessions) {
+    FILE* fp = fopen(path.c_str(), "w");
+    if (!fp) {
+        fprintf(stderr, "cannot write %s: %s\n", path.c_str(), strerror(errno));
+        return;
+    }
+    fprintf(fp, "session,timestamp_ms,arrival_ms,size,keyframe\n");
+    for (const auto& s : sessions) {
+        for (const auto& f : s.frames) {
+            fprintf(fp, "%d,%u,%.3f,%u,%d\n", s.id, f.timestamp_ms, (f.arrival_us - s.start_us) / 1000.0,
+                    f.size, f.keyframe ? 1 : 0);
+        }
+    }
+    fclose(fp);
+}
+
+int open_listener(const Options& opt) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    // 在listen前设置，accept得到的socket继承该值，窗口从握手起就受限
+    if (opt.rcvbuf > 0) setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &opt.rcvbuf, sizeof(opt.rcvbuf));
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(opt.port));
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        fprintf(stderr, "cannot listen on port %d: %s\n", opt.port, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Server server;
+    if (!parse_args(argc, argv, server.opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+    const Options& opt = server.opt;
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    int listen_fd = open_listener(opt);
+    if (listen_fd < 0) return 1;
+    fprintf(stderr, "listening on rtmp://127.0.0.1:%d\n", opt.port);
+
+    server.start_us = monotonic_us();
+    std::vector<std::thread> threads;
+    int next_id = 0;
+    while (g_running) {
+        int64_t now = monotonic_us();
+        if (opt.duration_s > 0 && now - server.start_us >= opt.duration_s * 1000000LL) break;
+
+        // 模拟服务器重启：中断期间关闭监听socket，推流端连接被拒绝
+        if (now < server.outage_until_us) {
+            if (listen_fd >= 0) {
+                close(listen_fd);
+                listen_fd = -1;
+                fprintf(stderr, "server down for %d ms\n", opt.outage_ms);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            continue;
+        }
+        if (listen_fd < 0) {
+            listen_fd = open_listener(opt);
+            if (listen_fd < 0) break;
+            fprintf(stderr, "server up\n");
+        }
+
+        pollfd pfd = {listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 200) <= 0) continue;
+        sockaddr_in peer;
+        socklen_t len = sizeof(peer);
+        int fd = accept(listen_fd, reinterpret_cast<sockaddr*>(&peer), &len);
+        if (fd < 0) continue;
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        char name[64];
+        snprintf(name, sizeof(name), "%s:%d", inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+
+        int id = next_id++;
+        std::string peer_name = name;
+        threads.emplace_back([&server, fd, id, peer_name]() {
+            Session session(server, fd, id, peer_name);
+            session.run();
+        });
+    }
+
+    g_running = false;
+    if (listen_fd >= 0) close(listen_fd);
+    for (auto& t : threads) t.join();
+
+    std::lock_guard<std::mutex> lock(server.mutex);
+    std::sort(server.finished.begin(), server.finished.end(),
+              [](const SessionSummary& a, const SessionSummary& b) { return a.id < b.id; });
+    for (const auto& s : server.finished) {
+        FrameStats st = compute_stats(s.frames);
+        fprintf(stderr, "session %d %s/%s: %zu frames, %llu missing, delay p50 %.1f ms p99 %.1f ms max %.1f ms, "
+                "max gap %.1f ms\n", s.id, s.app.c_str(), s.stream.c_str(), s.frames.size(),
+                static_cast<unsigned long long>(st.missing_frames), st.delay_p50_ms, st.delay_p99_ms,
+                st.delay_max_ms, st.max_arrival_gap_ms);
+    }
+    if (!opt.stats_path.empty()) write_stats(opt.stats_path, server.finished);
+    if (!opt.csv_path.empty()) write_csv(opt.csv_path, server.finished);
+    return 0;
+}
@@ -0,0 +1,249 @@
+/**
+ * @file sei_latency.cpp
+ * @brief 读取码流中的帧元数据SEI（EncoderStreamer::set_frame_sei()），计算逐帧延迟
+ *
+ * 输入可以是FLV/MP4文件或RTMP等网络地址（由libavformat打开）：
+ * - 设备处理耗时：SEI中的pipeline_us，即设备上从采集到得到编码包的时间
+ * - 端到端延迟（只对网络输入）：收到该帧的系统时间 - SEI中的capture_wall_us，
+ *   需要接收端与设备的系统时钟同步（NTP/PTP）。网络输入不缓存探测流信息时读到的包
+ *   （这些包的接收时间晚于实际到达时间），并把探测量降到最小
+ * - 丢帧：同一摄像头按sequence排序后（开启B帧时包按解码顺序到达）的跳变，
+ *   减去SEI中记录的有意跳过的帧数（降帧率档位、静止画面Drop模式），后者单独统计为skipped
+ *
+ * 结束时输出汇总，--csv输出逐帧记录（含处理器元数据的长度）。
+ *
+ * 用法：
+ *   ./sei_latency capture.flv --csv frames.csv
+ *   ./sei_latency rtmp://127.0.0.1:1935/live --listen 1 --duration 30   # 作为服务器直接接收推流
+ *   ./sei_latency rtmp://server/live/cam0                               # 从服务器拉流
+ */
+#include "FrameSei.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace {
+
+volatile sig_atomic_t g_running = 1;
+
+void signal_handler(int) {
+    g_running = 0;
+}
+
+int64_t realtime_us() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct Options {
+    std::string input;
+    bool listen = false;      // 作为RTMP服务器等待推流
+    int duration_s = 0;       // 0表示读到结束或SIGINT
+    std::string csv_path;
+};
+
+// 单个视频帧的记录
+struct FrameRecord {
+    double pts_ms;
+    bool has_sei;
+    FrameSeiData sei;
+    int64_t receive_wall_us;  // 文件输入为0
+    uint32_t missing;         // 与同一摄像头上一帧之间丢失的帧数（不含有意跳过的帧）
+};
+
+void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s <input> [options]\n"
+            "  <input>                    FLV/MP4 file or network URL (rtmp://...)\n"
+            "  --listen 0                 1 = act as the RTMP server for <input>\n"
+            "  --duration 0               stop after N seconds (0 = until end of input or SIGINT)\n"
+            "  --csv <file.csv>           per-frame records\n",
+            prog);
+}
+
+bool parse_args(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string key = argv[i];
+        if (key == "-h" || key == "--help") return false;
+        if (key.compare(0, 2, "--") != 0) {
+            opt.input = key;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "missing value for %s\n", key.c_str());
+            return false;
+        }
+        std::string value = argv[++i];
+        if (key == "--listen") {
+            opt.listen = atoi(value.c_str()) != 0;
+        } else if (key == "--duration") {
+            opt.duration_s = atoi(value.c_str());
+        } else if (key == "--csv") {
+            opt.csv_path = value;
+        } else {
+            fprintf(stderr, "unknown option: %s\n", key.c_str());
+            return false;
+        }
+    }
+    return !opt.input.empty();
+}
+
+double percentile(std::vector<double> values, double q) {
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(q * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+void write_csv(const std::string& path, const std::vector<FrameRecord>& frames) {
+    FILE* f = fopen(path.c_str(), "w");
+    if (!f) {
+        fprintf(stderr, "cannot write %s\n", path.c_str());
+        return;
+    }
+    fprintf(f, "pts_ms,camera_id,sequence,capture_wall_us,pipeline_ms,end_to_end_ms,missing,skipped,metadata_bytes\n");
+    for (const auto& r : frames) {
+        if (!r.has_sei) {
+            fprintf(f, "%.1f,,,,,,,,\n", r.pts_ms);
+            continue;
+        }
+        double e2e = r.receive_wall_us > 0 && r.sei.capture_wall_us > 0
+                         ? (r.receive_wall_us - r.sei.capture_wall_us) / 1000.0 : 0;
+        fprintf(f, "%.1f,%d,%u,%lld,%.2f,%.2f,%u,%u,%zu\n", r.pts_ms, r.sei.camera_id, r.sei.sequence,
+                static_cast<long long>(r.sei.capture_wall_us), r.sei.pipeline_us / 1000.0, e2e, r.missing,
+                r.sei.skipped, r.sei.blob.size());
+    }
+    fclose(f);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    // 网络输入才有意义的接收时间；文件输入只统计设备处理耗时和丢帧
+    bool live = opt.input.find("://") != std::string::npos && opt.input.compare(0, 7, "file://") != 0;
+
+    avformat_network_init();
+    AVDictionary* input_options = nullptr;
+    if (opt.listen) {
+        av_dict_set(&input_options, "listen", "1", 0);
+    }
+    if (live) {
+        // 探测流信息时读到的包会积压到探测结束才交给av_read_frame，接收时间偏晚、端到端延迟虚高：
+        // 尽量少探测，且不缓存这些包（只需要知道有H.264流）
+        av_dict_set(&input_options, "fflags", "nobuffer", 0);
+        av_dict_set(&input_options, "probesize", "32768", 0);
+        av_dict_set(&input_options, "analyzeduration", "500000", 0);
+    }
+    AVFormatContext* fmt_ctx = nullptr;
+    int ret = avformat_open_input(&fmt_ctx, opt.input.c_str(), nullptr, &input_options);
+    av_dict_free(&input_options);
+    if (ret < 0) {
+        fprintf(stderr, "cannot open %s: %d\n", opt.input.c_str(), ret);
+        return 1;
+    }
+    if (avformat_find_stream_info(fmt_ctx, nullptr) < 0) {
+        fprintf(stderr, "cannot read stream info from %s\n", opt.input.c_str());
+        avformat_close_input(&fmt_ctx);
+        return 1;
+    }
+    int video = -1;
+    for (unsigned i = 0; i < fmt_ctx->nb_streams; ++i) {
+        if (fmt_ctx->streams[i]->codecpar->codec_id == AV_CODEC_ID_H264) {
+            video = static_cast<int>(i);
+            break;
+        }
+    }
+    if (video < 0) {
+        fprintf(stderr, "no H.264 stream in %s\n", opt.input.c_str());
+        avformat_close_input(&fmt_ctx);
+        return 1;
+    }
+    AVRational time_base = fmt_ctx->streams[video]->time_base;
+
+    std::vector<FrameRecord> frames;
+    int64_t start_us = realtime_us();
+    AVPacket* pkt = av_packet_alloc();
+    while (g_running && av_read_frame(fmt_ctx, pkt) >= 0) {
+        int64_t receive_us = realtime_us();
+        if (pkt->stream_index == video) {
+            FrameRecord record;
+            record.pts_ms = pkt->pts == AV_NOPTS_VALUE ? 0 : pkt->pts * av_q2d(time_base) * 1000;
+            record.has_sei = find_frame_sei(pkt->data, static_cast<size_t>(pkt->size), &record.sei);
+            record.receive_wall_us = live ? receive_us : 0;
+            record.missing = 0;
+            frames.push_back(record);
+        }
+        av_packet_unref(pkt);
+        if (opt.duration_s > 0 && receive_us - start_us >= opt.duration_s * 1000000LL) break;
+    }
+    av_packet_free(&pkt);
+    avformat_close_input(&fmt_ctx);
+
+    // 包是解码顺序（B帧在其后向参考帧之后），skipped按采集顺序记录：每个摄像头按sequence排序后再算跳变
+    std::map<int, std::vector<size_t>> by_camera;
+    for (size_t i = 0; i < frames.size(); ++i) {
+        if (frames[i].has_sei) by_camera[frames[i].sei.camera_id].push_back(i);
+    }
+    for (auto& entry : by_camera) {
+        std::vector<size_t>& order = entry.second;
+        std::stable_sort(order.begin(), order.end(), [&frames](size_t a, size_t b) {
+            return frames[a].sei.sequence < frames[b].sei.sequence;
+        });
+        for (size_t k = 1; k < order.size(); ++k) {
+            FrameRecord& r = frames[order[k]];
+            uint32_t previous = frames[order[k - 1]].sei.sequence;
+            if (r.sei.sequence > previous + 1) {
+                uint32_t gap = r.sei.sequence - previous - 1;
+                r.missing = gap > r.sei.skipped ? gap - r.sei.skipped : 0;
+            }
+        }
+    }
+
+    std::vector<double> pipeline_ms;
+    std::vector<double> e2e_ms;
+    uint64_t missing = 0;
+    uint64_t skipped = 0;
+    size_t with_sei = 0;
+    for (const auto& r : frames) {
+        if (!r.has_sei) continue;
+        ++with_sei;
+        missing += r.missing;
+        skipped += r.sei.skipped;
+        pipeline_ms.push_back(r.sei.pipeline_us / 1000.0);
+        if (r.receive_wall_us > 0 && r.sei.capture_wall_us > 0) {
+            e2e_ms.push_back((r.receive_wall_us - r.sei.capture_wall_us) / 1000.0);
+        }
+    }
+    fprintf(stderr, "%zu frames, %zu with metadata SEI, %llu missing, %llu skipped by frame-rate/static-scene modes\n",
+            frames.size(), with_sei, static_cast<unsigned long long>(missing),
+            static_cast<unsigned long long>(skipped));
+    if (!pipeline_ms.empty()) {
+        fprintf(stderr, "device pipeline: p50 %.1f ms p99 %.1f ms max %.1f ms\n", percentile(pipeline_ms, 0.5),
+                percentile(pipeline_ms, 0.99), percentile(pipeline_ms, 1.0));
+    }
+    if (!e2e_ms.empty()) {
+        fprintf(stderr, "end-to-end: p50 %.1f ms p99 %.1f ms max %.1f ms (requires synchronized clocks)\n",
+                percentile(e2e_ms, 0.5), percentile(e2e_ms, 0.99), percentile(e2e_ms, 1.0));
+    }
+    if (!opt.csv_path.empty()) write_csv(opt.csv_path, frames);
+    return with_sei > 0 ? 0 : 2;
+}
@@ -0,0 +1,221 @@
+/**
+ * @file soak_test.cpp
+ * @brief 长时间稳定性测试（缓冲区泄漏/采集停流检测）
+ *
+ * 用真实的CameraCapture + EncoderStreamer（null输出）连续运行数小时，
+ * 配合libv4l2_emu.so的故障注入（丢帧、抖动、损坏帧、断流、EINTR），检查流水线是否会因
+ * 漏还缓冲区而停住。任何一路超过--stall-timeout秒没有新帧即判定失败：输出缓冲区租借报告
+ * （需以BUFFER_LEASE_DEBUG构建）后以非0退出。
+ *
+ * 用法：
+ *   LD_PRELOAD=./libv4l2_emu.so V4L2EMU_DROP_RATE=0.01 V4L2EMU_ERROR_RATE=0.005 \
+ *       ./soak_test --devices /dev/video0,/dev/video2 --duration 4h
+ *   或直接 cmake --build build --target soak（SOAK_DURATION控制时长）
+ */
+#include "BufferLease.h"
+#include "CameraCapture.h"
+#include "EncoderStreamer.h"
+#include "Logger.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> g_running(true);
+
+void signal_handler(int) {
+    g_running = false;
+}
+
+struct Options {
+    std::vector<std::string> devices = {"/dev/video0"};
+    int width = 640;
+    int height = 480;
+    int fps = 30;
+    int64_t duration_s = 3600;
+    int stall_timeout_s = 10;
+    int report_interval_s = 60;
+    int slow_consumer_ms = 0;   // 每帧在回调中额外持有缓冲区的最长时间（随机）
+};
+
+int64_t parse_duration(const std::string& s) {
+    if (s.empty()) return 0;
+    int64_t value = atoll(s.c_str());
+    switch (s.back()) {
+    case 'h': return value * 3600;
+    case 'm': return value * 60;
+    default: return value;
+    }
+}
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> out;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, sep)) {
+        if (!item.empty()) out.push_back(item);
+    }
+    return out;
+}
+
+void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --devices /dev/video0,/dev/video2\n"
+            "  --res 640x480\n"
+            "  --fps 30\n"
+            "  --duration 4h              total run time (s/m/h suffix)\n"
+            "  --stall-timeout 10         seconds without a frame before failing\n"
+            "  --report-interval 60       seconds between progress lines\n"
+            "  --slow-consumer 0          max extra ms a callback holds each frame\n",
+            prog);
+}
+
+bool parse_args(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string key = argv[i];
+        if (key == "-h" || key == "--help") return false;
+        if (i + 1 >= argc) {
+            fprintf(stderr, "missing value for %s\n", key.c_str());
+            return false;
+        }
+        std::string value = argv[++i];
+        if (key == "--devices") {
+            opt.devices = split(value, ',');
+        } else if (key == "--res") {
+            if (sscanf(value.c_str(), "%dx%d", &opt.width, &opt.height) != 2) {
+                fprintf(stderr, "bad resolution: %s\n", value.c_str());
+                return false;
+            }
+        } else if (key == "--fps") {
+            opt.fps = atoi(value.c_str());
+        } else if (key == "--duration") {
+            opt.duration_s = parse_duration(value);
+        } else if (key == "--stall-timeout") {
+            opt.stall_timeout_s = atoi(value.c_str());
+        } else if (key == "--report-interval") {
+            opt.report_interval_s = atoi(value.c_str());
+        } else if (key == "--slow-consumer") {
+            opt.slow_consumer_ms = atoi(value.c_str());
+        } else {
+            fprintf(stderr, "unknown option: %s\n", key.c_str());
+            return false;
+        }
+    }
+    return !opt.devices.empty() && opt.duration_s > 0;
+}
+
+// 单路采集→编码
+struct Lane {
+    std::unique_ptr<CameraCapture> camera;
+    std::unique_ptr<EncoderStreamer> streamer;
+    std::atomic<uint64_t> frames{0};
+    uint64_t frames_at_last_check = 0;
+    int64_t last_progress_s = 0;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) {
+        usage(argv[0]);
+        return 1;
+    }
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    Logger::instance().set_level(LogLevel::Warn);
+    av_log_set_level(AV_LOG_ERROR);
+
+#ifndef BUFFER_LEASE_DEBUG
+    fprintf(stderr, "note: built without BUFFER_LEASE_DEBUG, stalls are detected but not diagnosed\n");
+#endif
+
+    std::vector<std::unique_ptr<Lane>> lanes;
+    for (size_t i = 0; i < opt.devices.size(); ++i) {
+        std::unique_ptr<Lane> lane(new Lane());
+        lane->camera.reset(new CameraCapture(opt.devices[i], opt.width, opt.height, opt.fps));
+        lane->streamer.reset(new EncoderStreamer("null", opt.width, opt.height, opt.fps));
+        lane->streamer->set_output_format("null");
+
+        Lane* lane_ptr = lane.get();
+        int slow_ms = opt.slow_consumer_ms;
+        std::shared_ptr<std::mt19937> rng = std::make_shared<std::mt19937>(static_cast<uint32_t>(i + 1));
+        lane->camera->set_frame_callback([lane_ptr, slow_ms, rng](const CameraFrame& frame) {
+            ++lane_ptr->frames;
+            if (slow_ms > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds((*rng)() % (slow_ms + 1)));
+            }
+            lane_ptr->streamer->push_frame(frame);
+        });
+
+        lane->camera->set_camera_id(static_cast<int>(i));
+        if (!lane->camera->initialize() || !lane->streamer->initialize()) {
+            fprintf(stderr, "failed to initialize %s\n", opt.devices[i].c_str());
+            return 1;
+        }
+        lanes.push_back(std::move(lane));
+    }
+
+    for (auto& lane : lanes) {
+        lane->streamer->start();
+        lane->camera->start();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    int64_t last_report_s = 0;
+    bool stalled = false;
+    while (g_running) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        int64_t elapsed_s = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        for (size_t i = 0; i < lanes.size(); ++i) {
+            Lane& lane = *lanes[i];
+            uint64_t frames = lane.frames;
+            if (frames != lane.frames_at_last_check) {
+                lane.frames_at_last_check = frames;
+                lane.last_progress_s = elapsed_s;
+            } else if (elapsed_s - lane.last_progress_s >= opt.stall_timeout_s) {
+                fprintf(stderr, "STALL: %s produced no frame for %lld s (total %llu frames)\n",
+                        opt.devices[i].c_str(), static_cast<long long>(elapsed_s - lane.last_progress_s),
+                        static_cast<unsigned long long>(frames));
+                BufferLeaseTracker::instance().dump(static_cast<int>(i), "soak_test stall");
+                stalled = true;
+            }
+        }
+        if (stalled) break;
+
+        if (elapsed_s - last_report_s >= opt.report_interval_s) {
+            last_report_s = elapsed_s;
+            for (size_t i = 0; i < lanes.size(); ++i) {
+                fprintf(stderr, "[%llds] %s frames=%llu driver_dropped=%llu\n",
+                        static_cast<long long>(elapsed_s), opt.devices[i].c_str(),
+                        static_cast<unsigned long long>(lanes[i]->frames.load()),
+                        static_cast<unsigned long long>(lanes[i]->camera->dropped_frames()));
+            }
+        }
+        if (elapsed_s >= opt.duration_s) break;
+    }
+
+    for (auto& lane : lanes) lane->camera->stop();
+    for (auto& lane : lanes) lane->streamer->stop();
+    Logger::instance().flush();
+
+    for (size_t i = 0; i < lanes.size(); ++i) {
+        fprintf(stderr, "%s: %llu frames, %llu driver drops\n", opt.devices[i].c_str(),
+                static_cast<unsigned long long>(lanes[i]->frames.load()),
+                static_cast<unsigned long long>(lanes[i]->camera->dropped_frames()));
+    }
+    fprintf(stderr, "%s\n", stalled ? "FAIL" : "PASS");
+    return stalled ? 2 : 0;
+}
@@ -0,0 +1,790 @@
+/**
+ * @file v4l2_emu.cpp
+ * @brief LD_PRELOAD V4L2设备模拟器
+ *
+ * 拦截对 /dev/videoN 的 open/close/ioctl/mmap/select/poll，在用户态模拟一个YUYV采集设备，
+ * 让CameraCapture真实的ioctl/mmap/select代码路径在任何Linux机器上都能运行、压测和注入故障，
+ * 无需摄像头，也无需修改被测程序。
+ *
+ * 模拟的ioctl：QUERYCAP、ENUM_FMT、G_FMT/S_FMT/TRY_FMT、G_PARM/S_PARM、REQBUFS、QUERYBUF、
+ * QBUF/DQBUF、EXPBUF、STREAMON/STREAMOFF。其余请求返回ENOTTY。
+ *
+ * 实现要点：
+ * - 设备fd是一个EFD_SEMAPHORE的eventfd，出帧时+1、DQBUF时-1，select/poll原生可用
+ * - 每个缓冲区是一个memfd，mmap映射的就是它，EXPBUF返回dup出的fd，语义与真实DMA-BUF一致
+ * - 出帧线程按帧率（可加抖动）把已入队的缓冲区移到完成队列；到点时没有入队的缓冲区，
+ *   该帧丢失且sequence照常递增，与驱动行为一致
+ *
+ * 用法：
+ *   LD_PRELOAD=./libv4l2_emu.so V4L2EMU_FPS=30 V4L2EMU_DROP_RATE=0.01 ./example_test
+ *
+ * 环境变量：
+ *   V4L2EMU_DEVICES      拦截的设备路径，逗号分隔，末尾*为前缀匹配（默认 /dev/video*）
+ *   V4L2EMU_FPS          强制帧率（默认采用S_PARM设置的值）
+ *   V4L2EMU_JITTER_US    帧间隔均匀抖动幅度（±微秒）
+ *   V4L2EMU_DROP_RATE    每帧被“传感器”丢弃的概率（0~1）
+ *   V4L2EMU_ERROR_RATE   DQBUF返回带V4L2_BUF_FLAG_ERROR的损坏帧的概率（0~1）
+ *   V4L2EMU_STALL_EVERY  每出N帧停顿一次（模拟USB断流/饥饿）
+ *   V4L2EMU_STALL_MS     停顿时长（毫秒）
+ *   V4L2EMU_EINTR_RATE   select/poll被信号打断（返回EINTR）的概率（0~1）
+ *   V4L2EMU_FAIL_IOCTL   总是以EIO失败的ioctl，逗号分隔（如 STREAMON,REQBUFS）
+ *   V4L2EMU_SEED         随机种子（默认1，保证可复现）
+ *   V4L2EMU_VERBOSE      为1时在close时打印统计
+ */
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+// ------------------------------------------------------------ 真实libc函数
+
+struct RealFunctions {
+    int (*open)(const char*, int, ...) = nullptr;
+    int (*open64)(const char*, int, ...) = nullptr;
+    int (*openat)(int, const char*, int, ...) = nullptr;
+    int (*close)(int) = nullptr;
+    int (*ioctl)(int, unsigned long, ...) = nullptr;
+    void* (*mmap)(void*, size_t, int, int, int, off_t) = nullptr;
+    void* (*mmap64)(void*, size_t, int, int, int, off64_t) = nullptr;
+    int (*select)(int, fd_set*, fd_set*, fd_set*, timeval*) = nullptr;
+    int (*poll)(pollfd*, nfds_t, int) = nullptr;
+};
+
+template <typename T>
+void resolve(T& fn, const char* name) {
+    fn = reinterpret_cast<T>(dlsym(RTLD_NEXT, name));
+}
+
+RealFunctions& real() {
+    static RealFunctions fns = [] {
+        RealFunctions f;
+        resolve(f.open, "open");
+        resolve(f.open64, "open64");
+        resolve(f.openat, "openat");
+        resolve(f.close, "close");
+        resolve(f.ioctl, "ioctl");
+        resolve(f.mmap, "mmap");
+        resolve(f.mmap64, "mmap64");
+        resolve(f.select, "select");
+        resolve(f.poll, "poll");
+        return f;
+    }();
+    return fns;
+}
+
+// ------------------------------------------------------------ 配置
+
+double env_double(const char* name, double def) {
+    const char* v = getenv(name);
+    return v ? atof(v) : def;
+}
+
+struct EmuConfig {
+    std::vector<std::string> devices;
+    double fps = 0;
+    double jitter_us = 0;
+    double drop_rate = 0;
+    double error_rate = 0;
+    double eintr_rate = 0;
+    int stall_every = 0;
+    int stall_ms = 0;
+    std::vector<std::string> fail_ioctls;
+    uint32_t seed = 1;
+    bool verbose = false;
+};
+
+std::vector<std::string> split_list(const char* s) {
+    std::vector<std::string> out;
+    std::string item;
+    for (; s && *s; ++s) {
+        if (*s == ',') {
+            if (!item.empty()) out.push_back(item);
+            item.clear();
+        } else {
+            item += *s;
+        }
+    }
+    if (!item.empty()) out.push_back(item);
+    return out;
+}
+
+const EmuConfig& config() {
+    static EmuConfig cfg = [] {
+        EmuConfig c;
+        const char* devices = getenv("V4L2EMU_DEVICES");
+        c.devices = split_list(devices ? devices : "/dev/video*");
+        c.fps = env_double("V4L2EMU_FPS", 0);
+        c.jitter_us = env_double("V4L2EMU_JITTER_US", 0);
+        c.drop_rate = env_double("V4L2EMU_DROP_RATE", 0);
+        c.error_rate = env_double("V4L2EMU_ERROR_RATE", 0);
+        c.eintr_rate = env_double("V4L2EMU_EINTR_RATE", 0);
+        c.stall_every = static_cast<int>(env_double("V4L2EMU_STALL_EVERY", 0));
+        c.stall_ms = static_cast<int>(env_double("V4L2EMU_STALL_MS", 0));
+        c.fail_ioctls = split_list(getenv("V4L2EMU_FAIL_IOCTL"));
+        c.seed = static_cast<uint32_t>(env_double("V4L2EMU_SEED", 1));
+        c.verbose = env_double("V4L2EMU_VERBOSE", 0) != 0;
+        return c;
+    }();
+    return cfg;
+}
+
+bool is_emulated_path(const char* path) {
+    if (!path) return false;
+    for (const auto& pattern : config().devices) {
+        if (!pattern.empty() && pattern.back() == '*') {
+            if (strncmp(path, pattern.c_str(), pattern.size() - 1) == 0) return true;
+        } else if (pattern == path) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void emu_log(const char* fmt, ...) {
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "[v4l2_emu] %s\n", line);
+}
+
+int64_t monotonic_us() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// ------------------------------------------------------------ 模拟设备
+
+struct EmuBuffer {
+    int memfd = -1;
+    uint8_t* data = nullptr;     // 模拟器自己的映射，出帧线程写入
+    size_t length = 0;
+    bool queued = false;         // 在驱动入队队列或完成队列中
+    uint32_t bytesused = 0;
+    uint32_t sequence = 0;
+    uint32_t flags = 0;
+    timeval timestamp{0, 0};
+};
+
+struct PixelFormatInfo {
+    uint32_t fourcc;
+    const char* name;
+    uint32_t bpp_num;   // 每像素字节数 = bpp_num / bpp_den
+    uint32_t bpp_den;
+};
+
+const PixelFormatInfo kFormats[] = {
+    {V4L2_PIX_FMT_YUYV, "YUYV 4:2:2", 2, 1},
+    {V4L2_PIX_FMT_UYVY, "UYVY 4:2:2", 2, 1},
+    {V4L2_PIX_FMT_NV12, "Y/CbCr 4:2:0", 3, 2},
+    {V4L2_PIX_FMT_GREY, "8-bit Greyscale", 1, 1},
+};
+
+const PixelFormatInfo* find_format(uint32_t fourcc) {
+    for (const auto& f : kFormats) {
+        if (f.fourcc == fourcc) return &f;
+    }
+    return nullptr;
+}
+
+class EmuDevice {
+public:
+    EmuDevice(int fd, const std::string& path) : fd_(fd), path_(path), rng_(config().seed + fd) {
+        set_format(640, 480, V4L2_PIX_FMT_YUYV);
+    }
+
+    ~EmuDevice() {
+        stream_off();
+        free_buffers();
+        if (config().verbose) {
+            emu_log("%s closed: produced=%llu dropped=%llu starved=%llu errors=%llu",
+                    path_.c_str(), static_cast<unsigned long long>(produced_),
+                    static_cast<unsigned long long>(dropped_), static_cast<unsigned long long>(starved_),
+                    static_cast<unsigned long long>(errors_));
+        }
+    }
+
+    int ioctl(unsigned long request, void* arg);
+    void* mmap(size_t length, int prot, int flags, off_t offset);
+
+private:
+    int fail(int err) {
+        errno = err;
+        return -1;
+    }
+
+    void set_format(uint32_t width, uint32_t height, uint32_t fourcc) {
+        const PixelFormatInfo* info = find_format(fourcc);
+        if (!info) info = &kFormats[0];  // 驱动对不支持的格式会改成自己支持的格式
+        width_ = std::max<uint32_t>(16, std::min<uint32_t>(width, 4096)) & ~1u;
+        height_ = std::max<uint32_t>(16, std::min<uint32_t>(height, 2160));
+        fourcc_ = info->fourcc;
+        bytesperline_ = info->fourcc == V4L2_PIX_FMT_NV12 || info->fourcc == V4L2_PIX_FMT_GREY
+                            ? width_ : width_ * info->bpp_num / info->bpp_den;
+        sizeimage_ = width_ * height_ * info->bpp_num / info->bpp_den;
+    }
+
+    void fill_format(v4l2_format* fmt) const {
+        fmt->fmt.pix.width = width_;
+        fmt->fmt.pix.height = height_;
+        fmt->fmt.pix.pixelformat = fourcc_;
+        fmt->fmt.pix.field = V4L2_FIELD_NONE;
+        fmt->fmt.pix.bytesperline = bytesperline_;
+        fmt->fmt.pix.sizeimage = sizeimage_;
+        fmt->fmt.pix.colorspace = V4L2_COLORSPACE_SRGB;
+    }
+
+    int request_buffers(v4l2_requestbuffers* req);
+    int query_buffer(v4l2_buffer* buf);
+    int queue_buffer(v4l2_buffer* buf);
+    int dequeue_buffer(v4l2_buffer* buf);
+    int export_buffer(v4l2_exportbuffer* exp);
+    int stream_on();
+    int stream_off();
+    void free_buffers();
+    void produce_thread();
+    void render(EmuBuffer& buffer, uint32_t sequence);
+
+    bool chance(double p) {
+        if (p <= 0) return false;
+        return std::uniform_real_distribution<double>(0.0, 1.0)(rng_) < p;
+    }
+
+private:
+    int fd_;
+    std::string path_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::mt19937 rng_;
+
+    uint32_t width_ = 0;
+    uint32_t height_ = 0;
+    uint32_t fourcc_ = 0;
+    uint32_t bytesperline_ = 0;
+    uint32_t sizeimage_ = 0;
+    uint32_t fps_num_ = 30;   // 帧率 = fps_num_ / fps_den_
+    uint32_t fps_den_ = 1;
+
+    std::vector<EmuBuffer> buffers_;
+    std::deque<uint32_t> incoming_;   // 应用QBUF后等待填充的缓冲区
+    std::deque<uint32_t> done_;       // 已填充、等待DQBUF的缓冲区
+
+    bool streaming_ = false;
+    std::thread thread_;
+    uint32_t sequence_ = 0;
+
+    uint64_t produced_ = 0;
+    uint64_t dropped_ = 0;
+    uint64_t starved_ = 0;
+    uint64_t errors_ = 0;
+};
+
+int EmuDevice::ioctl(unsigned long request, void* arg) {
+    static const struct {
+        unsigned long request;
+        const char* name;
+    } names[] = {
+        {VIDIOC_QUERYCAP, "QUERYCAP"}, {VIDIOC_S_FMT, "S_FMT"}, {VIDIOC_G_FMT, "G_FMT"},
+        {VIDIOC_S_PARM, "S_PARM"}, {VIDIOC_REQBUFS, "REQBUFS"}, {VIDIOC_QUERYBUF, "QUERYBUF"},
+        {VIDIOC_QBUF, "QBUF"}, {VIDIOC_DQBUF, "DQBUF"}, {VIDIOC_EXPBUF, "EXPBUF"},
+        {VIDIOC_STREAMON, "STREAMON"}, {VIDIOC_STREAMOFF, "STREAMOFF"},
+    };
+    for (const auto& n : names) {
+        if (n.request != request) continue;
+        for (const auto& f : config().fail_ioctls) {
+            if (f == n.name) return fail(EIO);
+        }
+    }
+
+    switch (request) {
+    case VIDIOC_QUERYCAP: {
+        v4l2_capability* cap = static_cast<v4l2_capability*>(arg);
+        memset(cap, 0, sizeof(*cap));
+        snprintf(reinterpret_cast<char*>(cap->driver), sizeof(cap->driver), "v4l2_emu");
+        snprintf(reinterpret_cast<char*>(cap->card), sizeof(cap->card), "Emulated camera");
+        snprintf(reinterpret_cast<char*>(cap->bus_info), sizeof(cap->bus_info), "emu:%s", path_.c_str());
+        cap->version = 0x00050a00;
+        cap->device_caps = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING;
+        cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+        return 0;
+    }
+    case VIDIOC_ENUM_FMT: {
+        v4l2_fmtdesc* desc = static_cast<v4l2_fmtdesc*>(arg);
+        if (desc->type != V4L2_BUF_TYPE_VIDEO_CAPTURE ||
+            desc->index >= sizeof(kFormats) / sizeof(kFormats[0])) {
+            return fail(EINVAL);
+        }
+        const PixelFormatInfo& f = kFormats[desc->index];
+        desc->flags = 0;
+        desc->pixelformat = f.fourcc;
+        snprintf(reinterpret_cast<char*>(desc->description), sizeof(desc->description), "%s", f.name);
+        return 0;
+    }
+    case VIDIOC_G_FMT:
+    case VIDIOC_S_FMT:
+    case VIDIOC_TRY_FMT: {
+        v4l2_format* fmt = static_cast<v4l2_format*>(arg);
+        if (fmt->type != V4L2_BUF_TYPE_VIDEO_CAPTURE) return fail(EINVAL);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (request == VIDIOC_G_FMT) {
+            fill_format(fmt);
+            return 0;
+        }
+        if (!buffers_.empty() && request == VIDIOC_S_FMT) return fail(EBUSY);
+        uint32_t w = width_, h = height_, f = fourcc_, bpl = bytesperline_, size = sizeimage_;
+        set_format(fmt->fmt.pix.width, fmt->fmt.pix.height, fmt->fmt.pix.pixelformat);
+        fill_format(fmt);
+        if (request == VIDIOC_TRY_FMT) {
+            width_ = w; height_ = h; fourcc_ = f; bytesperline_ = bpl; sizeimage_ = size;
+        }
+        return 0;
+    }
+    case VIDIOC_G_PARM:
+    case VIDIOC_S_PARM: {
+        v4l2_streamparm* parm = static_cast<v4l2_streamparm*>(arg);
+        if (parm->type != V4L2_BUF_TYPE_VIDEO_CAPTURE) return fail(EINVAL);
+        std::lock_guard<std::mutex> lock(mutex_);
+        v4l2_fract& tpf = parm->parm.capture.timeperframe;
+        if (request == VIDIOC_S_PARM && tpf.numerator && tpf.denominator) {
+            fps_num_ = tpf.denominator;
+            fps_den_ = tpf.numerator;
+        }
+        memset(&parm->parm, 0, sizeof(parm->parm));
+        parm->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+        parm->parm.capture.timeperframe.numerator = fps_den_;
+        parm->parm.capture.timeperframe.denominator = fps_num_;
+        return 0;
+    }
+    case VIDIOC_REQBUFS:
+        return request_buffers(static_cast<v4l2_requestbuffers*>(arg));
+    case VIDIOC_QUERYBUF:
+        return query_buffer(static_cast<v4l2_buffer*>(arg));
+    case VIDIOC_QBUF:
+        return queue_buffer(static_cast<v4l2_buffer*>(arg));
+    case VIDIOC_DQBUF:
+        return dequeue_buffer(static_cast<v4l2_buffer*>(arg));
+    case VIDIOC_EXPBUF:
+        return export_buffer(static_cast<v4l2_exportbuffer*>(arg));
+    case VIDIOC_STREAMON:
+        if (*static_cast<int*>(arg) != V4L2_BUF_TYPE_VIDEO_CAPTURE) return fail(EINVAL);
+        return stream_on();
+    case VIDIOC_STREAMOFF:
+        if (*static_cast<int*>(arg) != V4L2_BUF_TYPE_VIDEO_CAPTURE) return fail(EINVAL);
+        return stream_off();
+    default:
+        return fail(ENOTTY);
+    }
+}
+
+int EmuDevice::request_buffers(v4l2_requestbuffers* req) {
+    if (req->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || req->memory != V4L2_MEMORY_MMAP) {
+        return fail(EINVAL);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (streaming_) return fail(EBUSY);
+    free_buffers();
+    if (req->count == 0) return 0;
+
+    req->count = std::max<uint32_t>(2, std::min<uint32_t>(req->count, VIDEO_MAX_FRAME));
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t length = (sizeimage_ + page - 1) / page * page;
+    buffers_.resize(req->count);
+    for (uint32_t i = 0; i < req->count; ++i) {
+        EmuBuffer& b = buffers_[i];
+        b.memfd = static_cast<int>(syscall(SYS_memfd_create, "v4l2_emu", 1u /* MFD_CLOEXEC */));
+        if (b.memfd < 0 || ftruncate(b.memfd, static_cast<off_t>(length)) < 0) {
+            free_buffers();
+            return fail(ENOMEM);
+        }
+        void* p = real().mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, b.memfd, 0);
+        if (p == MAP_FAILED) {
+            free_buffers();
+            return fail(ENOMEM);
+        }
+        b.data = static_cast<uint8_t*>(p);
+        b.length = length;
+    }
+    return 0;
+}
+
+int EmuDevice::query_buffer(v4l2_buffer* buf) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buf->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buf->index >= buffers_.size()) return fail(EINVAL);
+    const EmuBuffer& b = buffers_[buf->index];
+    buf->memory = V4L2_MEMORY_MMAP;
+    buf->length = static_cast<uint32_t>(b.length);
+    buf->m.offset = static_cast<uint32_t>(buf->index * b.length);
+    buf->flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC | (b.queued ? V4L2_BUF_FLAG_QUEUED : 0);
+    return 0;
+}
+
+int EmuDevice::queue_buffer(v4l2_buffer* buf) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buf->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buf->memory != V4L2_MEMORY_MMAP ||
+        buf->index >= buffers_.size()) {
+        return fail(EINVAL);
+    }
+    EmuBuffer& b = buffers_[buf->index];
+    if (b.queued) return fail(EINVAL);  // 重复入队
+    b.queued = true;
+    incoming_.push_back(buf->index);
+    buf->flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC | V4L2_BUF_FLAG_QUEUED;
+    return 0;
+}
+
+int EmuDevice::dequeue_buffer(v4l2_buffer* buf) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buf->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || buf->memory != V4L2_MEMORY_MMAP) return fail(EINVAL);
+    if (!streaming_) return fail(EINVAL);
+    if (done_.empty()) return fail(EAGAIN);
+
+    uint64_t one;
+    if (::read(fd_, &one, sizeof(one)) != sizeof(one)) return fail(EAGAIN);
+
+    uint32_t index = done_.front();
+    done_.pop_front();
+    EmuBuffer& b = buffers_[index];
+    b.queued = false;
+    buf->index = index;
+    buf->bytesused = b.bytesused;
+    buf->flags = b.flags;
+    buf->field = V4L2_FIELD_NONE;
+    buf->timestamp = b.timestamp;
+    buf->sequence = b.sequence;
+    buf->length = static_cast<uint32_t>(b.length);
+    buf->m.offset = static_cast<uint32_t>(index * b.length);
+    return 0;
+}
+
+int EmuDevice::export_buffer(v4l2_exportbuffer* exp) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (exp->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || exp->index >= buffers_.size()) return fail(EINVAL);
+    int fd = fcntl(buffers_[exp->index].memfd, (exp->flags & O_CLOEXEC) ? F_DUPFD_CLOEXEC : F_DUPFD, 0);
+    if (fd < 0) return -1;
+    exp->fd = fd;
+    return 0;
+}
+
+void* EmuDevice::mmap(size_t length, int prot, int flags, off_t offset) {
+    int memfd = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& b : buffers_) {
+            size_t index = static_cast<size_t>(&b - &buffers_[0]);
+            if (static_cast<off_t>(index * b.length) == offset && length <= b.length) {
+                memfd = b.memfd;
+                break;
+            }
+        }
+    }
+    if (memfd < 0) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    return real().mmap(nullptr, length, prot, flags, memfd, 0);
+}
+
+int EmuDevice::stream_on() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buffers_.empty()) return fail(EINVAL);
+    if (streaming_) return 0;
+    streaming_ = true;
+    thread_ = std::thread(&EmuDevice::produce_thread, this);
+    return 0;
+}
+
+int EmuDevice::stream_off() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!streaming_) return 0;
+        streaming_ = false;
+    }
+    cond_.notify_all();
+    if (thread_.joinable()) thread_.join();
+
+    // 与驱动一致：STREAMOFF后所有缓冲区回到出队状态，清空eventfd计数
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t value;
+    for (size_t i = 0; i < done_.size(); ++i) {
+        if (::read(fd_, &value, sizeof(value)) != sizeof(value)) break;
+    }
+    incoming_.clear();
+    done_.clear();
+    for (auto& b : buffers_) b.queued = false;
+    return 0;
+}
+
+void EmuDevice::free_buffers() {
+    for (auto& b : buffers_) {
+        if (b.data) munmap(b.data, b.length);
+        if (b.memfd >= 0) real().close(b.memfd);
+    }
+    buffers_.clear();
+    incoming_.clear();
+    done_.clear();
+}
+
+void EmuDevice::render(EmuBuffer& buffer, uint32_t sequence) {
+    // 斜向移动的渐变，保证编码器有真实负载、相邻帧内容不同
+    uint8_t* p = buffer.data;
+    uint32_t shift = sequence * 4;
+    for (uint32_t y = 0; y < height_; ++y) {
+        uint8_t* row = p + static_cast<size_t>(y) * bytesperline_;
+        if (fourcc_ == V4L2_PIX_FMT_YUYV || fourcc_ == V4L2_PIX_FMT_UYVY) {
+            int luma_off = fourcc_ == V4L2_PIX_FMT_YUYV ? 0 : 1;
+            for (uint32_t x = 0; x < width_ * 2; x += 2) {
+                row[x + luma_off] = static_cast<uint8_t>((x / 2 + y + shift) & 0xff);
+                row[x + 1 - luma_off] = 128;
+            }
+        } else {
+            memset(row, static_cast<int>((y + shift) & 0xff), bytesperline_);
+        }
+    }
+    if (fourcc_ == V4L2_PIX_FMT_NV12) {
+        memset(p + static_cast<size_t>(height_) * bytesperline_, 128,
+               sizeimage_ - static_cast<size_t>(height_) * bytesperline_);
+    }
+}
+
+void EmuDevice::produce_thread() {
+    const EmuConfig& cfg = config();
+    std::unique_lock<std::mutex> lock(mutex_);
+    double fps = cfg.fps > 0 ? cfg.fps : static_cast<double>(fps_num_) / (fps_den_ ? fps_den_ : 1);
+    const int64_t interval_us = static_cast<int64_t>(1e6 / (fps > 0 ? fps : 30));
+    int64_t next_due = monotonic_us() + interval_us;
+    uint64_t frames_since_stall = 0;
+
+    while (streaming_) {
+        int64_t due = next_due;
+        if (cfg.jitter_us > 0) {
+            due += static_cast<int64_t>(
+                std::uniform_real_distribution<double>(-cfg.jitter_us, cfg.jitter_us)(rng_));
+        }
+        next_due += interval_us;
+        if (cfg.stall_every > 0 && ++frames_since_stall >= static_cast<uint64_t>(cfg.stall_every)) {
+            frames_since_stall = 0;
+            due += static_cast<int64_t>(cfg.stall_ms) * 1000;
+            next_due += static_cast<int64_t>(cfg.stall_ms) * 1000;
+        }
+        int64_t wait_us = due - monotonic_us();
+        if (wait_us > 0) {
+            cond_.wait_for(lock, std::chrono::microseconds(wait_us), [this] { return !streaming_; });
+            if (!streaming_) break;
+        }
+
+        uint32_t sequence = sequence_++;
+        if (chance(cfg.drop_rate)) {
+            ++dropped_;
+            continue;
+        }
+        if (incoming_.empty()) {
+            // 应用没有及时归还缓冲区，这一帧丢失
+            ++starved_;
+            continue;
+        }
+
+        uint32_t index = incoming_.front();
+        incoming_.pop_front();
+        EmuBuffer& b = buffers_[index];
+        lock.unlock();
+        render(b, sequence);
+        lock.lock();
+        if (!streaming_) break;
+
+        int64_t now = monotonic_us();
+        b.timestamp.tv_sec = now / 1000000;
+        b.timestamp.tv_usec = now % 1000000;
+        b.sequence = sequence;
+        b.bytesused = sizeimage_;
+        b.flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC | V4L2_BUF_FLAG_DONE;
+        if (chance(cfg.error_rate)) {
+            b.flags |= V4L2_BUF_FLAG_ERROR;
+            b.bytesused = 0;
+            ++errors_;
+        }
+        done_.push_back(index);
+        ++produced_;
+        uint64_t one = 1;
+        if (::write(fd_, &one, sizeof(one)) != sizeof(one)) {
+            emu_log("%s: eventfd write failed", path_.c_str());
+        }
+    }
+}
+
+// ------------------------------------------------------------ 设备表
+
+std::mutex g_devices_mutex;
+std::map<int, std::shared_ptr<EmuDevice>> g_devices;
+std::atomic<bool> g_has_devices{false};
+
+std::shared_ptr<EmuDevice> find_device(int fd) {
+    if (!g_has_devices.load(std::memory_order_acquire)) return nullptr;
+    std::lock_guard<std::mutex> lock(g_devices_mutex);
+    auto it = g_devices.find(fd);
+    return it == g_devices.end() ? nullptr : it->second;
+}
+
+int open_device(const char* path) {
+    int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC | EFD_SEMAPHORE);
+    if (fd < 0) return -1;
+    std::lock_guard<std::mutex> lock(g_devices_mutex);
+    g_devices[fd] = std::make_shared<EmuDevice>(fd, path);
+    g_has_devices.store(true, std::memory_order_release);
+    if (config().verbose) emu_log("opened %s as fd %d", path, fd);
+    return fd;
+}
+
+bool any_emulated(const fd_set* set, int nfds) {
+    if (!set || !g_has_devices.load(std::memory_order_acquire)) return false;
+    std::lock_guard<std::mutex> lock(g_devices_mutex);
+    for (const auto& kv : g_devices) {
+        if (kv.first < nfds && FD_ISSET(kv.first, set)) return true;
+    }
+    return false;
+}
+
+// 模拟等待被信号打断
+bool inject_eintr() {
+    double rate = config().eintr_rate;
+    if (rate <= 0) return false;
+    static std::mutex mutex;
+    static std::mt19937 rng(config().seed);
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::uniform_real_distribution<double>(0.0, 1.0)(rng) < rate;
+}
+
+} // namespace
+
+// ------------------------------------------------------------ 拦截入口
+
+extern "C" {
+
+int open(const char* path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    if (is_emulated_path(path)) return open_device(path);
+    return real().open(path, flags, mode);
+}
+
+int open64(const char* path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    if (is_emulated_path(path)) return open_device(path);
+    return real().open64(path, flags, mode);
+}
+
+int openat(int dirfd, const char* path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list ap;
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+    if (is_emulated_path(path)) return open_device(path);
+    return real().openat(dirfd, path, flags, mode);
+}
+
+int close(int fd) {
+    if (g_has_devices.load(std::memory_order_acquire)) {
+        std::shared_ptr<EmuDevice> device;
+        {
+            std::lock_guard<std::mutex> lock(g_devices_mutex);
+            auto it = g_devices.find(fd);
+            if (it != g_devices.end()) {
+                device = it->second;
+                g_devices.erase(it);
+            }
+        }
+        device.reset();  // 停止出帧线程、释放缓冲区后再关闭eventfd
+    }
+    return real().close(fd);
+}
+
+int ioctl(int fd, unsigned long request, ...) {
+    va_list ap;
+    va_start(ap, request);
+    void* arg = va_arg(ap, void*);
+    va_end(ap);
+
+    std::shared_ptr<EmuDevice> device = find_device(fd);
+    if (device) return device->ioctl(request, arg);
+    return real().ioctl(fd, request, arg);
+}
+
+void* mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    std::shared_ptr<EmuDevice> device = find_device(fd);
+    if (device) return device->mmap(length, prot, flags, offset);
+    return real().mmap(addr, length, prot, flags, fd, offset);
+}
+
+void* mmap64(void* addr, size_t length, int prot, int flags, int fd, off64_t offset) {
+    std::shared_ptr<EmuDevice> device = find_device(fd);
+    if (device) return device->mmap(length, prot, flags, static_cast<off_t>(offset));
+    return real().mmap64(addr, length, prot, flags, fd, offset);
+}
+
+int select(int nfds, fd_set* readfds, fd_set* writefds, fd_set* exceptfds, timeval* timeout) {
+    if (any_emulated(readfds, nfds) && inject_eintr()) {
+        errno = EINTR;
+        return -1;
+    }
+    return real().select(nfds, readfds, writefds, exceptfds, timeout);
+}
+
+int poll(pollfd* fds, nfds_t nfds, int timeout) {
+    if (g_has_devices.load(std::memory_order_acquire)) {
+        for (nfds_t i = 0; i < nfds; ++i) {
+            if (find_device(fds[i].fd)) {
+                if (inject_eintr()) {
+                    errno = EINTR;
+                    return -1;
+                }
+                break;
+            }
+        }
+    }
+    return real().poll(fds, nfds, timeout);
+}
+
+} // extern "C"